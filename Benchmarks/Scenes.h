@@ -0,0 +1,214 @@
+//
+//  Scenes.h
+//  Vortex2D
+//
+
+#ifndef Benchmarks_Scenes_h
+#define Benchmarks_Scenes_h
+
+#include <Vortex2D/Vortex2D.h>
+
+#include "ObstacleSmokeExample.h"
+#include "Runner.h"
+#include "WatermillExample.h"
+
+#include <algorithm>
+#include <memory>
+
+class Scene
+{
+public:
+  virtual ~Scene() {}
+  virtual void Step(Vortex2D::Fluid::LinearSolver::Parameters& params) = 0;
+};
+
+// the scenes are laid out for 256x256 grids and scaled to the grid size
+inline float Scale(const glm::ivec2& size)
+{
+  return std::min(size.x, size.y) / 256.0f;
+}
+
+class SmokeScene : public Scene
+{
+public:
+  SmokeScene(const Vortex2D::Renderer::Device& device, const glm::ivec2& size, float dt)
+      : source1(device, glm::vec2(20.0f * Scale(size)))
+      , source2(device, glm::vec2(20.0f * Scale(size)))
+      , force1(device, glm::vec2(20.0f * Scale(size)))
+      , force2(device, glm::vec2(20.0f * Scale(size)))
+      , density(device, size, vk::Format::eR8G8B8A8Unorm)
+      , world(device, size, dt, Vortex2D::Fluid::Velocity::InterpolationMode::Linear)
+  {
+    float scale = Scale(size);
+
+    world.FieldBind(density);
+
+    source1.Position = force1.Position = glm::vec2(75.0f, 25.0f) * scale;
+    source2.Position = force2.Position = glm::vec2(175.0f, 225.0f) * scale;
+
+    source1.Anchor = source2.Anchor = glm::vec2(10.0f * scale);
+    force1.Anchor = force2.Anchor = glm::vec2(10.0f * scale);
+
+    source1.Colour = source2.Colour = glm::vec4(0.3f, 0.3f, 0.3f, 1.0f);
+
+    force1.Colour = {0.0f, 30.0f, 0.0f, 0.0f};
+    force2.Colour = {0.0f, -30.0f, 0.0f, 0.0f};
+
+    // Draw liquid boundaries
+    Vortex2D::Renderer::Rectangle area(device, glm::vec2(size) - glm::vec2(4.0f));
+    area.Colour = glm::vec4(-1);
+    area.Position = glm::vec2(2.0f);
+
+    Vortex2D::Renderer::Clear clearLiquid({1.0f, 0.0f, 0.0f, 0.0f});
+
+    world.RecordLiquidPhi({clearLiquid, area}).Submit().Wait();
+
+    // Draw solid boundaries
+    Vortex2D::Fluid::Circle obstacle1(device, 15.0f * scale);
+    Vortex2D::Fluid::Circle obstacle2(device, 15.0f * scale);
+
+    obstacle1.Position = glm::vec2(75.0f, 100.0f) * scale;
+    obstacle2.Position = glm::vec2(175.0f, 125.0f) * scale;
+
+    world.RecordStaticSolidPhi({Vortex2D::Fluid::BoundariesClear, obstacle1, obstacle2})
+        .Submit()
+        .Wait();
+
+    // Draw sources and forces
+    velocityRender = world.RecordVelocity({force1, force2}, Vortex2D::Fluid::VelocityOp::Set);
+    densityRender = density.Record({source1, source2});
+  }
+
+  void Step(Vortex2D::Fluid::LinearSolver::Parameters& params) override
+  {
+    velocityRender.Submit();
+    densityRender.Submit();
+    world.Step(params);
+  }
+
+private:
+  Vortex2D::Renderer::Rectangle source1, source2;
+  Vortex2D::Renderer::Rectangle force1, force2;
+  Vortex2D::Fluid::Density density;
+  Vortex2D::Fluid::SmokeWorld world;
+  Vortex2D::Renderer::RenderCommand velocityRender, densityRender;
+};
+
+class WaterScene : public Scene
+{
+public:
+  WaterScene(const Vortex2D::Renderer::Device& device,
+             const glm::ivec2& size,
+             float dt,
+             int numSubSteps)
+      : gravity(device, glm::vec2(size))
+      , world(device, size, dt, numSubSteps, Vortex2D::Fluid::Velocity::InterpolationMode::Linear)
+  {
+    float scale = Scale(size);
+
+    gravity.Colour = {0.0f, 3.0f, 0.0f, 0.0f};
+
+    // Add particles
+    Vortex2D::Renderer::IntRectangle fluid(device, glm::vec2(150.0f, 50.0f) * scale);
+    fluid.Position = glm::vec2(50.0f, 25.0f) * scale;
+    fluid.Colour = glm::vec4(4);
+
+    world.RecordParticleCount({fluid}).Submit().Wait();
+
+    // Draw solid boundaries
+    Vortex2D::Fluid::Rectangle obstacle1(device, glm::vec2(50.0f, 25.0f) * scale);
+    Vortex2D::Fluid::Rectangle obstacle2(device, glm::vec2(50.0f, 25.0f) * scale);
+    Vortex2D::Fluid::Rectangle area(device, glm::vec2(size) - glm::vec2(6.0f), true, 5.0f);
+
+    area.Position = glm::vec2(3.0f);
+
+    obstacle1.Position = glm::vec2(75.0f, 150.0f) * scale;
+    obstacle1.Rotation = 45.0f;
+
+    obstacle2.Position = glm::vec2(150.0f, 150.0f) * scale;
+    obstacle2.Rotation = 30.0f;
+
+    world.RecordStaticSolidPhi({area, obstacle1, obstacle2}).Submit().Wait();
+
+    // Set gravity
+    velocityRender = world.RecordVelocity({gravity}, Vortex2D::Fluid::VelocityOp::Add);
+  }
+
+  void Step(Vortex2D::Fluid::LinearSolver::Parameters& params) override
+  {
+    world.SubmitVelocity(velocityRender);
+    world.Step(params);
+  }
+
+private:
+  Vortex2D::Renderer::Rectangle gravity;
+  Vortex2D::Fluid::WaterWorld world;
+  Vortex2D::Renderer::RenderCommand velocityRender;
+};
+
+// a pool of water of a fixed size in the corner of the grid, the rest of the
+// grid is empty, to compare the step cost with and without the tiles
+class PoolScene : public Scene
+{
+public:
+  PoolScene(const Vortex2D::Renderer::Device& device, const glm::ivec2& size, float dt, bool tiled)
+      : gravity(device, glm::vec2(size))
+      , world(device, size, dt, 1, Vortex2D::Fluid::Velocity::InterpolationMode::Linear)
+  {
+    if (tiled)
+    {
+      world.EnableTiles();
+    }
+
+    gravity.Colour = {0.0f, 3.0f, 0.0f, 0.0f};
+
+    // Add particles
+    Vortex2D::Renderer::IntRectangle fluid(device, glm::vec2(96.0f, 48.0f));
+    fluid.Position = glm::vec2(16.0f, 16.0f);
+    fluid.Colour = glm::vec4(4);
+
+    world.RecordParticleCount({fluid}).Submit().Wait();
+
+    // Draw solid boundaries
+    Vortex2D::Fluid::Rectangle area(device, glm::vec2(size) - glm::vec2(6.0f), true, 5.0f);
+    area.Position = glm::vec2(3.0f);
+
+    world.RecordStaticSolidPhi({area}).Submit().Wait();
+
+    // Set gravity
+    velocityRender = world.RecordVelocity({gravity}, Vortex2D::Fluid::VelocityOp::Add);
+  }
+
+  void Step(Vortex2D::Fluid::LinearSolver::Parameters& params) override
+  {
+    world.SubmitVelocity(velocityRender);
+    world.Step(params);
+  }
+
+private:
+  Vortex2D::Renderer::Rectangle gravity;
+  Vortex2D::Fluid::WaterWorld world;
+  Vortex2D::Renderer::RenderCommand velocityRender;
+};
+
+// runs one of the examples as is, with its own solver parameters, rendering to
+// a texture instead of a window
+class ExampleScene : public Scene
+{
+public:
+  ExampleScene(const Vortex2D::Renderer::Device& device,
+               const glm::ivec2& size,
+               std::unique_ptr<Runner> runner)
+      : target(device, size.x, size.y, vk::Format::eR8G8B8A8Unorm), runner(std::move(runner))
+  {
+    this->runner->Init(device, target);
+  }
+
+  void Step(Vortex2D::Fluid::LinearSolver::Parameters& params) override { runner->Step(); }
+
+private:
+  Vortex2D::Renderer::RenderTexture target;
+  std::unique_ptr<Runner> runner;
+};
+
+#endif
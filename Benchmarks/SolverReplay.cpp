@@ -0,0 +1,409 @@
+//
+//  SolverReplay.cpp
+//  Vortex2D
+//
+
+#include <Vortex2D/Engine/LinearSolver/Chebyshev.h>
+#include <Vortex2D/Engine/LinearSolver/CompactConjugateGradient.h>
+#include <Vortex2D/Engine/LinearSolver/Diagonal.h>
+#include <Vortex2D/Engine/LinearSolver/GaussSeidel.h>
+#include <Vortex2D/Engine/LinearSolver/IncompletePoisson.h>
+#include <Vortex2D/Engine/LinearSolver/Jacobi.h>
+#include <Vortex2D/Engine/LinearSolver/PipelinedConjugateGradient.h>
+#include <Vortex2D/Vortex2D.h>
+
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace Vortex2D;
+
+namespace
+{
+struct Options
+{
+  std::string Output = "solvers.json";
+  std::vector<std::string> Captures;
+  float Tolerance = 1e-3f;
+  unsigned MaxIterations = 1000;
+  int Runs = 3;
+  bool Validation = false;
+};
+
+// the equations of a capture, with the fields needed to build the multigrid
+// hierarchies from its level sets
+struct System
+{
+  System(const Renderer::Device& device, const Fluid::LinearSolver::Data::CaptureInfo& info)
+      : Info(info)
+      , Data(device, info.Size)
+      , LiquidPhi(device, info.Size.x, info.Size.y, vk::Format::eR32Sfloat)
+      , SolidPhi(device, info.Size.x, info.Size.y, vk::Format::eR32Sfloat)
+      , Velocity(device, info.Size)
+      , Valid(device, info.Size.x * info.Size.y)
+      , Pressure(device, info.Delta, info.Size, Data, Velocity, SolidPhi, LiquidPhi, Valid)
+  {
+  }
+
+  Fluid::LinearSolver::Data::CaptureInfo Info;
+  Fluid::LinearSolver::Data Data;
+  Renderer::Texture LiquidPhi, SolidPhi;
+  Fluid::Velocity Velocity;
+  Renderer::Buffer<glm::ivec2> Valid;
+  Fluid::Pressure Pressure;
+};
+
+struct SolverInstance
+{
+  std::unique_ptr<Fluid::Preconditioner> Preconditioner;
+  std::unique_ptr<Fluid::LinearSolver> LinearSolver;
+  // called once the equations are bound, e.g. to build the multigrid hierarchies
+  std::function<void()> Prepare;
+};
+
+struct Combination
+{
+  std::string Solver;
+  std::string Preconditioner;
+  bool NeedsLevelSets;
+  std::function<SolverInstance(const Renderer::Device&, System&)> Create;
+};
+
+struct Result
+{
+  unsigned Iterations = 0;
+  float Error = 0.0f;
+  double SolveMs = 0.0;
+};
+
+Options ParseOptions(int argc, char** argv)
+{
+  Options options;
+  for (int i = 1; i < argc; i++)
+  {
+    std::string arg = argv[i];
+    auto next = [&]() -> std::string {
+      if (i + 1 >= argc)
+        throw std::runtime_error("Missing value for " + arg);
+      return argv[++i];
+    };
+
+    if (arg == "--output")
+    {
+      options.Output = next();
+    }
+    else if (arg == "--tolerance")
+    {
+      options.Tolerance = std::stof(next());
+    }
+    else if (arg == "--max-iterations")
+    {
+      options.MaxIterations = std::stoi(next());
+    }
+    else if (arg == "--runs")
+    {
+      options.Runs = std::stoi(next());
+    }
+    else if (arg == "--validation")
+    {
+      options.Validation = true;
+    }
+    else if (arg.compare(0, 2, "--") == 0)
+    {
+      throw std::runtime_error("Unknown argument: " + arg);
+    }
+    else
+    {
+      options.Captures.push_back(arg);
+    }
+  }
+
+  if (options.Captures.empty())
+    throw std::runtime_error("No capture files given");
+
+  if (options.Runs <= 0)
+    throw std::runtime_error("Number of runs needs to be positive");
+
+  return options;
+}
+
+using PreconditionerFactory =
+    std::function<std::unique_ptr<Fluid::Preconditioner>(const Renderer::Device&, System&)>;
+
+struct PreconditionerType
+{
+  std::string Name;
+  bool NeedsLevelSets;
+  PreconditionerFactory Create;
+};
+
+std::vector<PreconditionerType> GetPreconditioners()
+{
+  return {{"diagonal",
+           false,
+           [](const Renderer::Device& device, System& system) {
+             return std::unique_ptr<Fluid::Preconditioner>(
+                 new Fluid::Diagonal(device, system.Info.Size));
+           }},
+          {"incomplete_poisson",
+           false,
+           [](const Renderer::Device& device, System& system) {
+             return std::unique_ptr<Fluid::Preconditioner>(
+                 new Fluid::IncompletePoisson(device, system.Info.Size));
+           }},
+          {"jacobi",
+           false,
+           [](const Renderer::Device& device, System& system) {
+             auto jacobi = new Fluid::Jacobi(device, system.Info.Size);
+             jacobi->SetW(1.0f);
+             jacobi->SetPreconditionerIterations(8);
+             return std::unique_ptr<Fluid::Preconditioner>(jacobi);
+           }},
+          {"gauss_seidel",
+           false,
+           [](const Renderer::Device& device, System& system) {
+             auto gaussSeidel = new Fluid::GaussSeidel(device, system.Info.Size);
+             gaussSeidel->SetW(1.0f);
+             gaussSeidel->SetPreconditionerIterations(8);
+             return std::unique_ptr<Fluid::Preconditioner>(gaussSeidel);
+           }},
+          {"local_gauss_seidel",
+           false,
+           [](const Renderer::Device& device, System& system) {
+             return std::unique_ptr<Fluid::Preconditioner>(
+                 new Fluid::LocalGaussSeidel(device, system.Info.Size));
+           }},
+          {"chebyshev",
+           false,
+           [](const Renderer::Device& device, System& system) {
+             return std::unique_ptr<Fluid::Preconditioner>(
+                 new Fluid::Chebyshev(device, system.Info.Size));
+           }},
+          {"multigrid", true, [](const Renderer::Device& device, System& system) {
+             auto multigrid = new Fluid::Multigrid(device, system.Info.Size, system.Info.Delta);
+             multigrid->BuildHierarchiesBind(system.Pressure, system.SolidPhi, system.LiquidPhi);
+             return std::unique_ptr<Fluid::Preconditioner>(multigrid);
+           }}};
+}
+
+// the preconditioners which need the bound equations before solving
+std::function<void()> GetPrepare(Fluid::Preconditioner* preconditioner)
+{
+  if (auto multigrid = dynamic_cast<Fluid::Multigrid*>(preconditioner))
+    return [=] { multigrid->BuildHierarchies(); };
+  if (auto chebyshev = dynamic_cast<Fluid::Chebyshev*>(preconditioner))
+    return [=] { chebyshev->EstimateBounds(); };
+  return [] {};
+}
+
+std::vector<Combination> GetCombinations()
+{
+  std::vector<Combination> combinations;
+
+  for (auto& preconditioner : GetPreconditioners())
+  {
+    auto create = preconditioner.Create;
+    combinations.push_back(
+        {"cg",
+         preconditioner.Name,
+         preconditioner.NeedsLevelSets,
+         [=](const Renderer::Device& device, System& system) {
+           SolverInstance solver;
+           solver.Preconditioner = create(device, system);
+           solver.LinearSolver.reset(
+               new Fluid::ConjugateGradient(device, system.Info.Size, *solver.Preconditioner));
+           solver.Prepare = GetPrepare(solver.Preconditioner.get());
+           return solver;
+         }});
+
+    combinations.push_back({"pipelined_cg",
+                            preconditioner.Name,
+                            preconditioner.NeedsLevelSets,
+                            [=](const Renderer::Device& device, System& system) {
+                              SolverInstance solver;
+                              solver.Preconditioner = create(device, system);
+                              solver.LinearSolver.reset(new Fluid::PipelinedConjugateGradient(
+                                  device, system.Info.Size, *solver.Preconditioner));
+                              solver.Prepare = GetPrepare(solver.Preconditioner.get());
+                              return solver;
+                            }});
+  }
+
+  combinations.push_back(
+      {"compact_cg", "", false, [](const Renderer::Device& device, System& system) {
+         SolverInstance solver;
+         solver.LinearSolver.reset(new Fluid::CompactConjugateGradient(device, system.Info.Size));
+         solver.Prepare = [] {};
+         return solver;
+       }});
+
+  combinations.push_back(
+      {"gauss_seidel", "", false, [](const Renderer::Device& device, System& system) {
+         SolverInstance solver;
+         solver.LinearSolver.reset(new Fluid::GaussSeidel(device, system.Info.Size));
+         solver.Prepare = [] {};
+         return solver;
+       }});
+
+  combinations.push_back(
+      {"chebyshev", "", false, [](const Renderer::Device& device, System& system) {
+         auto chebyshev = new Fluid::Chebyshev(device, system.Info.Size);
+         SolverInstance solver;
+         solver.LinearSolver.reset(chebyshev);
+         solver.Prepare = [=] { chebyshev->EstimateBounds(); };
+         return solver;
+       }});
+
+  combinations.push_back(
+      {"multigrid", "", true, [](const Renderer::Device& device, System& system) {
+         auto multigrid = new Fluid::Multigrid(device, system.Info.Size, system.Info.Delta);
+         multigrid->BuildHierarchiesBind(system.Pressure, system.SolidPhi, system.LiquidPhi);
+         SolverInstance solver;
+         solver.LinearSolver.reset(multigrid);
+         solver.Prepare = [=] { multigrid->BuildHierarchies(); };
+         return solver;
+       }});
+
+  return combinations;
+}
+
+Result Run(const Renderer::Device& device,
+           const std::string& capture,
+           System& system,
+           const Combination& combination,
+           const Options& options)
+{
+  Result result;
+
+  auto solver = combination.Create(device, system);
+
+  // the first run is not timed, it includes the creation of the pipelines
+  for (int i = 0; i <= options.Runs; i++)
+  {
+    system.Data.Replay(capture, &system.LiquidPhi, &system.SolidPhi);
+
+    solver.LinearSolver->Bind(
+        system.Data.Diagonal, system.Data.Lower, system.Data.B, system.Data.X);
+    solver.Prepare();
+    device.Handle().waitIdle();
+
+    Fluid::LinearSolver::Parameters params(Fluid::LinearSolver::Parameters::SolverType::Iterative,
+                                           options.MaxIterations,
+                                           options.Tolerance);
+
+    auto start = std::chrono::steady_clock::now();
+    solver.LinearSolver->Solve(params);
+    device.Handle().waitIdle();
+    auto end = std::chrono::steady_clock::now();
+
+    if (i > 0)
+    {
+      result.SolveMs +=
+          std::chrono::duration<double, std::milli>(end - start).count() / options.Runs;
+    }
+
+    result.Iterations = params.OutIterations;
+    result.Error = params.OutError;
+  }
+
+  return result;
+}
+
+std::string Quote(const std::string& str)
+{
+  std::string quoted = "\"";
+  for (char c : str)
+  {
+    if (c == '"' || c == '\\')
+      quoted += '\\';
+    quoted += c;
+  }
+  return quoted + "\"";
+}
+
+void WriteResult(std::ostream& stream,
+                 const std::string& capture,
+                 const Fluid::LinearSolver::Data::CaptureInfo& info,
+                 const Combination& combination,
+                 const Result& result)
+{
+  stream << "    {\n";
+  stream << "      \"capture\": " << Quote(capture) << ",\n";
+  stream << "      \"width\": " << info.Size.x << ",\n";
+  stream << "      \"height\": " << info.Size.y << ",\n";
+  stream << "      \"solver\": " << Quote(combination.Solver) << ",\n";
+  stream << "      \"preconditioner\": "
+         << (combination.Preconditioner.empty() ? "null" : Quote(combination.Preconditioner))
+         << ",\n";
+  stream << "      \"iterations\": " << result.Iterations << ",\n";
+  stream << "      \"error\": " << result.Error << ",\n";
+  stream << "      \"solve_ms\": " << result.SolveMs << ",\n";
+  stream << "      \"iteration_ms\": ";
+  if (result.Iterations > 0)
+    stream << result.SolveMs / result.Iterations;
+  else
+    stream << "null";
+  stream << "\n    }";
+}
+}  // namespace
+
+int main(int argc, char** argv)
+{
+  try
+  {
+    auto options = ParseOptions(argc, argv);
+
+    Renderer::Instance instance("Solver Replay", {}, options.Validation);
+    Renderer::Device device(instance);
+
+    std::ofstream file(options.Output);
+    if (!file.is_open())
+    {
+      throw std::runtime_error("Couldn't open output file: " + options.Output);
+    }
+
+    auto properties = device.GetPhysicalDevice().getProperties();
+    file << "{\n";
+    file << "  \"device\": " << Quote(properties.deviceName) << ",\n";
+    file << "  \"tolerance\": " << options.Tolerance << ",\n";
+    file << "  \"max_iterations\": " << options.MaxIterations << ",\n";
+    file << "  \"results\": [";
+
+    bool first = true;
+    auto combinations = GetCombinations();
+    for (auto& capture : options.Captures)
+    {
+      auto info = Fluid::LinearSolver::Data::ReadCaptureInfo(capture);
+      System system(device, info);
+
+      for (auto& combination : combinations)
+      {
+        // the multigrid hierarchies are built from the level sets
+        if (combination.NeedsLevelSets && !info.LevelSets)
+          continue;
+
+        std::cerr << capture << " " << combination.Solver << " " << combination.Preconditioner
+                  << std::endl;
+
+        auto result = Run(device, capture, system, combination, options);
+        file << (first ? "\n" : ",\n");
+        WriteResult(file, capture, info, combination, result);
+        first = false;
+      }
+    }
+
+    file << (first ? "]\n" : "\n  ]\n");
+    file << "}\n";
+  }
+  catch (const std::exception& error)
+  {
+    std::cerr << "Error: " << error.what() << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,413 @@
+//
+//  main.cpp
+//  Vortex2D
+//
+
+#include <Vortex2D/Renderer/Profiler.h>
+#include <Vortex2D/Vortex2D.h>
+
+#include "Scenes.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace Vortex2D;
+
+// colours used by the examples
+glm::vec4 green = glm::vec4(92.0f, 173.0f, 159.0f, 255.0f) / glm::vec4(255.0f);
+glm::vec4 gray = glm::vec4(80.0f, 81.0f, 79.0f, 255.0f) / glm::vec4(255.0f);
+glm::vec4 blue = glm::vec4(36.0f, 123.0f, 160.0f, 255.0f) / glm::vec4(255.0f);
+
+namespace
+{
+const float delta = 0.016f;
+
+struct Options
+{
+  std::string Output = "benchmarks.json";
+  std::vector<int> Sizes = {128, 256, 512, 1024};
+  std::vector<std::string> Scenes = {
+      "smoke", "water", "pool", "pool_tiled", "obstacle_smoke", "watermill"};
+  int Steps = 20;
+  int Warmup = 5;
+  bool Validation = false;
+};
+
+struct Case
+{
+  std::string Scene;
+  glm::ivec2 Size;
+  std::string Solver;
+  int NumSubSteps;
+  std::function<std::unique_ptr<Scene>(const Renderer::Device&)> Create;
+  std::function<Fluid::LinearSolver::Parameters()> Params;
+};
+
+struct Result
+{
+  std::vector<double> StepMs;
+  double Iterations = 0.0;
+  uint64_t PeakMemory = 0;
+  bool HasGpuTimes = false;
+  double SubstepMs = 0.0;
+  std::map<std::string, double> StageMs;
+};
+
+std::vector<std::string> Split(const std::string& str)
+{
+  std::vector<std::string> values;
+  std::stringstream stream(str);
+  std::string value;
+  while (std::getline(stream, value, ','))
+  {
+    values.push_back(value);
+  }
+  return values;
+}
+
+Options ParseOptions(int argc, char** argv)
+{
+  Options options;
+  for (int i = 1; i < argc; i++)
+  {
+    std::string arg = argv[i];
+    auto next = [&]() -> std::string {
+      if (i + 1 >= argc)
+        throw std::runtime_error("Missing value for " + arg);
+      return argv[++i];
+    };
+
+    if (arg == "--output")
+    {
+      options.Output = next();
+    }
+    else if (arg == "--sizes")
+    {
+      options.Sizes.clear();
+      for (auto& size : Split(next()))
+        options.Sizes.push_back(std::stoi(size));
+    }
+    else if (arg == "--scenes")
+    {
+      options.Scenes = Split(next());
+    }
+    else if (arg == "--steps")
+    {
+      options.Steps = std::stoi(next());
+    }
+    else if (arg == "--warmup")
+    {
+      options.Warmup = std::stoi(next());
+    }
+    else if (arg == "--validation")
+    {
+      options.Validation = true;
+    }
+    else
+    {
+      throw std::runtime_error("Unknown argument: " + arg);
+    }
+  }
+
+  if (options.Steps <= 0)
+    throw std::runtime_error("Number of steps needs to be positive");
+
+  return options;
+}
+
+bool HasScene(const Options& options, const std::string& scene)
+{
+  return std::find(options.Scenes.begin(), options.Scenes.end(), scene) != options.Scenes.end();
+}
+
+std::vector<Case> GetCases(const Options& options)
+{
+  std::vector<std::pair<std::string, std::function<Fluid::LinearSolver::Parameters()>>> solvers = {
+      {"fixed", [] { return Fluid::FixedParams(12); }},
+      {"iterative", [] { return Fluid::IterativeParams(1e-3f); }}};
+
+  std::vector<Case> cases;
+  for (int size : options.Sizes)
+  {
+    glm::ivec2 gridSize(size);
+    for (auto& solver : solvers)
+    {
+      if (HasScene(options, "smoke"))
+      {
+        cases.push_back({"smoke",
+                         gridSize,
+                         solver.first,
+                         1,
+                         [=](const Renderer::Device& device) {
+                           return std::unique_ptr<Scene>(new SmokeScene(device, gridSize, delta));
+                         },
+                         solver.second});
+      }
+
+      if (HasScene(options, "water"))
+      {
+        for (int numSubSteps : {1, 2})
+        {
+          cases.push_back({"water",
+                           gridSize,
+                           solver.first,
+                           numSubSteps,
+                           [=](const Renderer::Device& device) {
+                             return std::unique_ptr<Scene>(
+                                 new WaterScene(device, gridSize, delta, numSubSteps));
+                           },
+                           solver.second});
+        }
+      }
+
+      for (bool tiled : {false, true})
+      {
+        std::string scene = tiled ? "pool_tiled" : "pool";
+        if (HasScene(options, scene))
+        {
+          cases.push_back({scene,
+                           gridSize,
+                           solver.first,
+                           1,
+                           [=](const Renderer::Device& device) {
+                             return std::unique_ptr<Scene>(
+                                 new PoolScene(device, gridSize, delta, tiled));
+                           },
+                           solver.second});
+        }
+      }
+    }
+  }
+
+  // the examples are laid out for their own size and solver
+  glm::ivec2 exampleSize(256);
+  if (HasScene(options, "obstacle_smoke"))
+  {
+    cases.push_back({"obstacle_smoke",
+                     exampleSize,
+                     "",
+                     0,
+                     [=](const Renderer::Device& device) {
+                       return std::unique_ptr<Scene>(new ExampleScene(
+                           device,
+                           exampleSize,
+                           std::unique_ptr<Runner>(
+                               new ObstacleSmokeExample(device, exampleSize, delta))));
+                     },
+                     [] { return Fluid::FixedParams(12); }});
+  }
+
+  if (HasScene(options, "watermill"))
+  {
+    cases.push_back({"watermill",
+                     exampleSize,
+                     "",
+                     0,
+                     [=](const Renderer::Device& device) {
+                       return std::unique_ptr<Scene>(new ExampleScene(
+                           device,
+                           exampleSize,
+                           std::unique_ptr<Runner>(
+                               new WatermillExample(device, exampleSize, delta))));
+                     },
+                     [] { return Fluid::FixedParams(12); }});
+  }
+
+  return cases;
+}
+
+uint64_t GetUsedMemory(const Renderer::Device& device)
+{
+  VmaStats stats;
+  vmaCalculateStats(device.Allocator(), &stats);
+  return stats.total.usedBytes;
+}
+
+std::unique_ptr<Renderer::Profiler> CreateProfiler(const Renderer::Device& device)
+{
+  if (!device.GetPhysicalDevice().getProperties().limits.timestampComputeAndGraphics)
+    return nullptr;
+
+  try
+  {
+    return std::unique_ptr<Renderer::Profiler>(new Renderer::Profiler(device));
+  }
+  catch (const std::exception&)
+  {
+    return nullptr;
+  }
+}
+
+Result Run(const Renderer::Device& device, const Case& benchmark, const Options& options)
+{
+  Result result;
+
+  auto profiler = CreateProfiler(device);
+  auto scene = benchmark.Create(device);
+
+  for (int i = 0; i < options.Warmup; i++)
+  {
+    auto params = benchmark.Params();
+    scene->Step(params);
+  }
+
+  device.Handle().waitIdle();
+  if (profiler)
+  {
+    profiler->Flush();
+    profiler->ClearFrames();
+  }
+
+  for (int i = 0; i < options.Steps; i++)
+  {
+    auto params = benchmark.Params();
+
+    auto start = std::chrono::steady_clock::now();
+    scene->Step(params);
+    device.Handle().waitIdle();
+    auto end = std::chrono::steady_clock::now();
+
+    result.StepMs.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+    result.Iterations += static_cast<double>(params.OutIterations) / options.Steps;
+    result.PeakMemory = std::max(result.PeakMemory, GetUsedMemory(device));
+  }
+
+  if (profiler)
+  {
+    profiler->Flush();
+
+    // each stage is averaged over the sub-steps it was executed in
+    std::map<std::string, int> stageCounts;
+    auto& frames = profiler->GetFrames();
+    for (auto& frame : frames)
+    {
+      result.SubstepMs += (frame.EndNs - frame.BeginNs) / 1e6 / frames.size();
+      for (auto& scope : frame.Scopes)
+      {
+        result.StageMs[scope.Name] += (scope.EndNs - scope.BeginNs) / 1e6;
+        stageCounts[scope.Name]++;
+      }
+    }
+
+    for (auto& stage : result.StageMs)
+    {
+      stage.second /= stageCounts[stage.first];
+    }
+
+    result.HasGpuTimes = !frames.empty();
+  }
+
+  return result;
+}
+
+std::string Quote(const std::string& str)
+{
+  std::string quoted = "\"";
+  for (char c : str)
+  {
+    if (c == '"' || c == '\\')
+      quoted += '\\';
+    quoted += c;
+  }
+  return quoted + "\"";
+}
+
+void WriteCase(std::ostream& stream, const Case& benchmark, const Result& result)
+{
+  auto minmax = std::minmax_element(result.StepMs.begin(), result.StepMs.end());
+  double mean = 0.0;
+  for (double stepMs : result.StepMs)
+  {
+    mean += stepMs / result.StepMs.size();
+  }
+
+  bool configurable = !benchmark.Solver.empty();
+
+  stream << "    {\n";
+  stream << "      \"scene\": " << Quote(benchmark.Scene) << ",\n";
+  stream << "      \"width\": " << benchmark.Size.x << ",\n";
+  stream << "      \"height\": " << benchmark.Size.y << ",\n";
+  stream << "      \"solver\": " << (configurable ? Quote(benchmark.Solver) : "null") << ",\n";
+  stream << "      \"substeps\": "
+         << (configurable ? std::to_string(benchmark.NumSubSteps) : "null") << ",\n";
+  stream << "      \"step_ms\": {\"mean\": " << mean << ", \"min\": " << *minmax.first
+         << ", \"max\": " << *minmax.second << "},\n";
+  stream << "      \"iterations\": ";
+  if (configurable)
+    stream << result.Iterations;
+  else
+    stream << "null";
+  stream << ",\n";
+  stream << "      \"peak_memory_bytes\": " << result.PeakMemory << ",\n";
+  stream << "      \"substep_gpu_ms\": ";
+  if (result.HasGpuTimes)
+    stream << result.SubstepMs;
+  else
+    stream << "null";
+  stream << ",\n";
+  stream << "      \"stages_gpu_ms\": {";
+
+  bool first = true;
+  for (auto& stage : result.StageMs)
+  {
+    stream << (first ? "\n" : ",\n") << "        " << Quote(stage.first) << ": " << stage.second;
+    first = false;
+  }
+
+  stream << (first ? "}\n" : "\n      }\n");
+  stream << "    }";
+}
+}  // namespace
+
+int main(int argc, char** argv)
+{
+  try
+  {
+    auto options = ParseOptions(argc, argv);
+
+    Renderer::Instance instance("Benchmarks", {}, options.Validation);
+    Renderer::Device device(instance);
+
+    std::ofstream file(options.Output);
+    if (!file.is_open())
+    {
+      throw std::runtime_error("Couldn't open output file: " + options.Output);
+    }
+
+    auto properties = device.GetPhysicalDevice().getProperties();
+    file << "{\n";
+    file << "  \"device\": " << Quote(properties.deviceName) << ",\n";
+    file << "  \"steps\": " << options.Steps << ",\n";
+    file << "  \"cases\": [\n";
+
+    auto cases = GetCases(options);
+    for (std::size_t i = 0; i < cases.size(); i++)
+    {
+      auto& benchmark = cases[i];
+      std::cerr << benchmark.Scene << " " << benchmark.Size.x << "x" << benchmark.Size.y << " "
+                << benchmark.Solver << std::endl;
+
+      auto result = Run(device, benchmark, options);
+      WriteCase(file, benchmark, result);
+      file << (i + 1 < cases.size() ? ",\n" : "\n");
+    }
+
+    file << "  ]\n";
+    file << "}\n";
+  }
+  catch (const std::exception& error)
+  {
+    std::cerr << "Error: " << error.what() << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
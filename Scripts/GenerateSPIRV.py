@@ -18,8 +18,13 @@ dirpath = tempfile.mkdtemp()
 def genCArray(file):
   basename = ntpath.basename(file).replace('.', '_')
   temp_file = dirpath + '/' + basename + '.txt'
+  # subgroup operations require at least vulkan 1.1
+  version = args.version
+  with open(file, 'r') as source_file:
+    if 'GL_KHR_shader_subgroup' in source_file.read() and float(version) < 1.1:
+      version = '1.1'
   try:
-    subprocess.check_output([args.compiler,'--target-env', 'vulkan' + args.version, '-V',file,'-x','-o',temp_file]).decode('utf-8')
+    subprocess.check_output([args.compiler,'--target-env', 'vulkan' + version, '-V',file,'-x','-o',temp_file]).decode('utf-8')
   except subprocess.CalledProcessError as e:
     print(e.output)
   content = None
@@ -3,11 +3,15 @@
 //  Vortex2D
 //
 
+#include <Vortex2D/Engine/LinearSolver/Chebyshev.h>
+#include <Vortex2D/Engine/LinearSolver/CompactConjugateGradient.h>
 #include <Vortex2D/Engine/LinearSolver/ConjugateGradient.h>
+#include <Vortex2D/Engine/LinearSolver/CpuConjugateGradient.h>
 #include <Vortex2D/Engine/LinearSolver/Diagonal.h>
 #include <Vortex2D/Engine/LinearSolver/GaussSeidel.h>
 #include <Vortex2D/Engine/LinearSolver/IncompletePoisson.h>
 #include <Vortex2D/Engine/LinearSolver/Multigrid.h>
+#include <Vortex2D/Engine/LinearSolver/PipelinedConjugateGradient.h>
 #include <Vortex2D/Engine/LinearSolver/Reduce.h>
 #include <Vortex2D/Engine/LinearSolver/Transfer.h>
 #include <Vortex2D/Engine/Pressure.h>
@@ -16,6 +20,7 @@
 
 #include <algorithm>
 #include <chrono>
+#include <cstdio>
 #include <numeric>
 
 using namespace Vortex2D::Renderer;
@@ -106,6 +111,173 @@ TEST(LinearSolverTests, ReduceMax)
   ASSERT_EQ(150.0f, outputData[0]);
 }
 
+TEST(LinearSolverTests, ReduceSumMax)
+{
+  glm::ivec2 size(10, 15);
+  int total_size = size.x * size.y;
+
+  Buffer<glm::vec4> input(*device, total_size, VMA_MEMORY_USAGE_CPU_ONLY);
+  Buffer<glm::vec4> output(*device, 1, VMA_MEMORY_USAGE_CPU_ONLY);
+
+  ReduceSumMax reduce(*device, size);
+  auto reduceBound = reduce.Bind(input, output);
+
+  std::vector<glm::vec4> inputData(total_size);
+
+  {
+    float n = 1.0f;
+    std::generate(inputData.begin(), inputData.end(), [&n] {
+      glm::vec4 value(n, 2.0f * n, n, 0.0f);
+      n++;
+      return value;
+    });
+  }
+
+  CopyFrom(input, inputData);
+
+  device->Execute([&](vk::CommandBuffer commandBuffer) { reduceBound.Record(commandBuffer); });
+
+  std::vector<glm::vec4> outputData(1, glm::vec4(0.0f));
+  CopyTo(output, outputData);
+
+  ASSERT_EQ(0.5f * 150.0f * 151.0f, outputData[0].x);
+  ASSERT_EQ(150.0f * 151.0f, outputData[0].y);
+  ASSERT_EQ(150.0f, outputData[0].z);
+}
+
+TEST(LinearSolverTests, ReduceSinglePassSum)
+{
+  glm::ivec2 size(500);
+  int total_size = size.x * size.y;
+
+  Buffer<float> input(*device, total_size, VMA_MEMORY_USAGE_CPU_ONLY);
+  Buffer<float> output(*device, 1, VMA_MEMORY_USAGE_CPU_ONLY);
+
+  ReduceSum reduce(*device, size, Reduce::Method::SinglePass);
+  auto reduceBound = reduce.Bind(input, output);
+
+  std::vector<float> inputData(total_size, 1.0f);
+  CopyFrom(input, inputData);
+
+  // recorded twice to check the counter of work groups is reset
+  device->Execute([&](vk::CommandBuffer commandBuffer) {
+    reduceBound.Record(commandBuffer);
+    reduceBound.Record(commandBuffer);
+  });
+
+  std::vector<float> outputData(1, 0.0f);
+  CopyTo(output, outputData);
+
+  ASSERT_EQ(static_cast<float>(total_size), outputData[0]);
+}
+
+TEST(LinearSolverTests, ReduceSinglePassMax)
+{
+  glm::ivec2 size(500);
+  int total_size = size.x * size.y;
+
+  Buffer<float> input(*device, total_size, VMA_MEMORY_USAGE_CPU_ONLY);
+  Buffer<float> output(*device, 1, VMA_MEMORY_USAGE_CPU_ONLY);
+
+  ReduceMax reduce(*device, size, Reduce::Method::SinglePass);
+  auto reduceBound = reduce.Bind(input, output);
+
+  std::vector<float> inputData(total_size);
+
+  {
+    float n = -1.0f;
+    std::generate(inputData.begin(), inputData.end(), [&n] { return n--; });
+  }
+
+  CopyFrom(input, inputData);
+
+  // recorded twice to check the counter of work groups is reset
+  device->Execute([&](vk::CommandBuffer commandBuffer) {
+    reduceBound.Record(commandBuffer);
+    reduceBound.Record(commandBuffer);
+  });
+
+  std::vector<float> outputData(1, 0.0f);
+  CopyTo(output, outputData);
+
+  ASSERT_EQ(static_cast<float>(total_size), outputData[0]);
+}
+
+TEST(LinearSolverTests, ReduceSinglePassSumMax)
+{
+  glm::ivec2 size(500);
+  int total_size = size.x * size.y;
+
+  Buffer<glm::vec4> input(*device, total_size, VMA_MEMORY_USAGE_CPU_ONLY);
+  Buffer<glm::vec4> output(*device, 1, VMA_MEMORY_USAGE_CPU_ONLY);
+
+  ReduceSumMax reduce(*device, size, Reduce::Method::SinglePass);
+  auto reduceBound = reduce.Bind(input, output);
+
+  // the sums stay exact in float, whatever order the work groups finish in
+  std::vector<glm::vec4> inputData(total_size);
+
+  {
+    float n = 1.0f;
+    std::generate(inputData.begin(), inputData.end(), [&n] {
+      glm::vec4 value(1.0f, 2.0f, n, 0.0f);
+      n++;
+      return value;
+    });
+  }
+
+  CopyFrom(input, inputData);
+
+  device->Execute([&](vk::CommandBuffer commandBuffer) { reduceBound.Record(commandBuffer); });
+
+  std::vector<glm::vec4> outputData(1, glm::vec4(0.0f));
+  CopyTo(output, outputData);
+
+  float n = static_cast<float>(total_size);
+  ASSERT_EQ(n, outputData[0].x);
+  ASSERT_EQ(2.0f * n, outputData[0].y);
+  ASSERT_EQ(n, outputData[0].z);
+}
+
+TEST(LinearSolverTests, ReduceMultiple)
+{
+  glm::ivec2 size(50);
+  int total_size = size.x * size.y;
+
+  Buffer<float> r(*device, total_size, VMA_MEMORY_USAGE_CPU_ONLY);
+  Buffer<float> s(*device, total_size, VMA_MEMORY_USAGE_CPU_ONLY);
+  Buffer<float> z(*device, total_size, VMA_MEMORY_USAGE_CPU_ONLY);
+  Buffer<glm::vec4> output(*device, 1, VMA_MEMORY_USAGE_CPU_ONLY);
+
+  ReduceMultiple reduce(*device,
+                        size,
+                        {ReduceMultiple::Operation::Sum,
+                         ReduceMultiple::Operation::Sum,
+                         ReduceMultiple::Operation::Max});
+  auto reduceBound = reduce.Bind({{z, r}, {z, s}, {r, r}}, output);
+
+  std::vector<float> rData(total_size), sData(total_size, 2.0f), zData(total_size, 1.0f);
+
+  {
+    float n = 1.0f;
+    std::generate(rData.begin(), rData.end(), [&n] { return -(n++); });
+  }
+
+  CopyFrom(r, rData);
+  CopyFrom(s, sData);
+  CopyFrom(z, zData);
+
+  device->Execute([&](vk::CommandBuffer commandBuffer) { reduceBound.Record(commandBuffer); });
+
+  glm::vec4 outputData;
+  CopyTo(output, outputData);
+
+  float n = static_cast<float>(total_size);
+  ASSERT_EQ(-0.5f * n * (n + 1.0f), outputData.x);
+  ASSERT_EQ(2.0f * n, outputData.y);
+  ASSERT_EQ(n, outputData.z);
+}
+
 TEST(LinearSolverTests, Transfer_Prolongate)
 {
   glm::ivec2 coarseSize(2);
@@ -237,6 +409,39 @@ TEST(LinearSolverTests, Simple_SOR)
   std::cout << "Solved with number of iterations: " << params.OutIterations << std::endl;
 }
 
+TEST(LinearSolverTests, Simple_Chebyshev)
+{
+  glm::ivec2 size(50);
+
+  FluidSim sim;
+  sim.initialize(1.0f, size.x, size.y);
+  sim.set_boundary(boundary_phi);
+
+  AddParticles(size, sim, boundary_phi);
+
+  sim.add_force(0.01f);
+  sim.compute_phi();
+  sim.extrapolate_phi();
+  sim.apply_projection(0.01f);
+
+  LinearSolver::Data data(*device, size, VMA_MEMORY_USAGE_CPU_ONLY);
+
+  BuildLinearEquation(size, data.Diagonal, data.Lower, data.B, sim);
+
+  LinearSolver::Parameters params(LinearSolver::Parameters::SolverType::Iterative, 1000, 1e-4f);
+  Chebyshev solver(*device, size, 8);
+
+  solver.Bind(data.Diagonal, data.Lower, data.B, data.X);
+  solver.EstimateBounds();
+  solver.Solve(params);
+
+  device->Queue().waitIdle();
+
+  CheckPressure(size, sim.pressure, data.X, 1e-4f);
+
+  std::cout << "Solved with number of iterations: " << params.OutIterations << std::endl;
+}
+
 TEST(LinearSolverTests, Complex_SOR)
 {
   glm::ivec2 size(50);
@@ -332,7 +537,7 @@ TEST(LinearSolverTests, Diagonal_Simple_PCG)
   std::cout << "Solved with number of iterations: " << params.OutIterations << std::endl;
 }
 
-TEST(LinearSolverTests, GaussSeidel_Simple_PCG)
+TEST(LinearSolverTests, Diagonal_Simple_PCG_Batch)
 {
   glm::ivec2 size(50);
 
@@ -351,9 +556,7 @@ TEST(LinearSolverTests, GaussSeidel_Simple_PCG)
 
   BuildLinearEquation(size, data.Diagonal, data.Lower, data.B, sim);
 
-  GaussSeidel preconditioner(*device, size);
-  preconditioner.SetW(1.0f);
-  preconditioner.SetPreconditionerIterations(8);
+  Diagonal preconditioner(*device, size);
 
   LinearSolver::Parameters params(LinearSolver::Parameters::SolverType::Iterative, 1000, 1e-5f);
   ConjugateGradient solver(*device, size, preconditioner);
@@ -363,12 +566,31 @@ TEST(LinearSolverTests, GaussSeidel_Simple_PCG)
 
   device->Queue().waitIdle();
 
-  CheckPressure(size, sim.pressure, data.X, 1e-4f);
+  LinearSolver::Parameters batchParams(
+      LinearSolver::Parameters::SolverType::Iterative, 1000, 1e-5f);
+  solver.SetBatchIterations(8);
+  solver.Solve(batchParams);
 
-  std::cout << "Solved with number of iterations: " << params.OutIterations << std::endl;
+  device->Queue().waitIdle();
+
+  CheckPressure(size, sim.pressure, data.X, 1e-5f);
+
+  // convergence is checked on the GPU, so we stop at the same iteration
+  EXPECT_EQ(params.OutIterations, batchParams.OutIterations);
+  EXPECT_FLOAT_EQ(params.OutError, batchParams.OutError);
+
+  // the relative tolerance is computed on the GPU, without waiting
+  LinearSolver::Parameters asyncParams(
+      LinearSolver::Parameters::SolverType::Iterative, 1000, 1e-5f);
+  solver.SolveAsync(asyncParams);
+
+  EXPECT_FLOAT_EQ(batchParams.OutError, solver.GetError());
+  CheckPressure(size, sim.pressure, data.X, 1e-5f);
+
+  std::cout << "Solved with number of iterations: " << batchParams.OutIterations << std::endl;
 }
 
-TEST(LinearSolverTests, IncompletePoisson_Simple_PCG)
+TEST(LinearSolverTests, Diagonal_Simple_PCG_WarmStart)
 {
   glm::ivec2 size(50);
 
@@ -387,7 +609,7 @@ TEST(LinearSolverTests, IncompletePoisson_Simple_PCG)
 
   BuildLinearEquation(size, data.Diagonal, data.Lower, data.B, sim);
 
-  IncompletePoisson preconditioner(*device, size);
+  Diagonal preconditioner(*device, size);
 
   LinearSolver::Parameters params(LinearSolver::Parameters::SolverType::Iterative, 1000, 1e-5f);
   ConjugateGradient solver(*device, size, preconditioner);
@@ -397,16 +619,71 @@ TEST(LinearSolverTests, IncompletePoisson_Simple_PCG)
 
   device->Queue().waitIdle();
 
-  CheckPressure(size, sim.pressure, data.X, 1e-5f);
+  // perturb the right hand side, the solution is scaled accordingly
+  const float scale = 1.001f;
+  std::vector<float> b(size.x * size.y);
+  Renderer::CopyTo(data.B, b);
+  for (auto& value : b)
+  {
+    value *= scale;
+  }
+  Renderer::CopyFrom(data.B, b);
 
-  std::cout << "Solved with number of iterations: " << params.OutIterations << std::endl;
+  std::vector<double> scaledPressure(sim.pressure.size());
+  for (std::size_t i = 0; i < scaledPressure.size(); i++)
+  {
+    scaledPressure[i] = scale * sim.pressure[i];
+  }
+
+  // solve the perturbed system starting from the previous solution
+  LinearSolver::Parameters warmParams(
+      LinearSolver::Parameters::SolverType::Iterative, 1000, 1e-5f);
+  warmParams.WarmStart = true;
+  solver.Solve(warmParams);
+
+  device->Queue().waitIdle();
+
+  CheckPressure(size, scaledPressure, data.X, 1e-5f);
+
+  // and starting from zero
+  LinearSolver::Parameters coldParams(
+      LinearSolver::Parameters::SolverType::Iterative, 1000, 1e-5f);
+  solver.Solve(coldParams);
+
+  device->Queue().waitIdle();
+
+  CheckPressure(size, scaledPressure, data.X, 1e-5f);
+
+  // a small perturbation needs at most half of the iterations
+  EXPECT_LE(2 * warmParams.OutIterations, coldParams.OutIterations);
+
+  std::cout << "Solved with number of iterations: " << warmParams.OutIterations << " instead of "
+            << coldParams.OutIterations << std::endl;
 }
 
-TEST(LinearSolverTests, Zero_PCG)
+TEST(LinearSolverTests, Diagonal_MatrixFree_PCG)
 {
   glm::ivec2 size(50);
 
+  FluidSim sim;
+  sim.initialize(1.0f, size.x, size.y);
+  sim.set_boundary(boundary_phi);
+
+  AddParticles(size, sim, boundary_phi);
+
+  sim.add_force(0.01f);
+
+  Velocity velocity(*device, size);
+  Texture solidPhi(*device, size.x, size.y, vk::Format::eR32Sfloat);
+  Texture liquidPhi(*device, size.x, size.y, vk::Format::eR32Sfloat);
+  Buffer<glm::ivec2> valid(*device, size.x * size.y, VMA_MEMORY_USAGE_CPU_ONLY);
+
+  BuildInputs(*device, size, sim, velocity, solidPhi, liquidPhi);
+
+  // reference solution with the explicit matrix
   LinearSolver::Data data(*device, size, VMA_MEMORY_USAGE_CPU_ONLY);
+  Pressure pressure(*device, 0.01f, size, data, velocity, solidPhi, liquidPhi, valid);
+  pressure.BuildLinearEquation();
 
   Diagonal preconditioner(*device, size);
 
@@ -416,25 +693,68 @@ TEST(LinearSolverTests, Zero_PCG)
   solver.Bind(data.Diagonal, data.Lower, data.B, data.X);
   solver.Solve(params);
 
-  device->Queue().waitIdle();
+  // matrix free solution with only the diagonal stored
+  LinearSolver::Data matrixFreeData(
+      *device, size, VMA_MEMORY_USAGE_CPU_ONLY, LinearSolver::Matrix::Free);
+  Pressure matrixFreePressure(*device,
+                              0.01f,
+                              size,
+                              matrixFreeData,
+                              velocity,
+                              solidPhi,
+                              liquidPhi,
+                              valid,
+                              LinearSolver::Matrix::Free);
+  matrixFreePressure.BuildLinearEquation();
+
+  Diagonal matrixFreePreconditioner(*device, size);
+
+  LinearSolver::Parameters matrixFreeParams(
+      LinearSolver::Parameters::SolverType::Iterative, 1000, 1e-5f);
+  ConjugateGradient matrixFreeSolver(*device, size, matrixFreePreconditioner);
+
+  matrixFreeSolver.BindMatrixFree(0.01f, solidPhi, liquidPhi);
+  matrixFreeSolver.Bind(matrixFreeData.Diagonal,
+                        matrixFreeData.Lower,
+                        matrixFreeData.B,
+                        matrixFreeData.X);
+  matrixFreeSolver.Solve(matrixFreeParams);
 
-  ASSERT_EQ(0, params.OutIterations);
+  device->Queue().waitIdle();
 
-  std::vector<float> pressureData(size.x * size.y, 1.0f);
-  CopyTo(data.X, pressureData);
+  std::vector<float> x(size.x * size.y), matrixFreeX(size.x * size.y);
+  CopyTo(data.X, x);
+  CopyTo(matrixFreeData.X, matrixFreeX);
 
-  for (int i = 0; i < size.x; i++)
+  for (std::size_t i = 0; i < x.size(); i++)
   {
-    for (int j = 0; j < size.y; j++)
-    {
-      EXPECT_FLOAT_EQ(0.0f, pressureData[i + size.x * j]);
-    }
+    EXPECT_NEAR(x[i], matrixFreeX[i], 1e-5f);
   }
+
+  std::cout << "Solved with number of iterations: " << matrixFreeParams.OutIterations
+            << std::endl;
 }
 
-TEST(LinearSolverTests, Multigrid_Simple_PCG)
+TEST(LinearSolverTests, IncompletePoisson_MatrixFree_PCG)
 {
-  glm::ivec2 size(64);
+  glm::ivec2 size(50);
+
+  Texture solidPhi(*device, size.x, size.y, vk::Format::eR32Sfloat);
+  Texture liquidPhi(*device, size.x, size.y, vk::Format::eR32Sfloat);
+
+  LinearSolver::Data data(*device, size, VMA_MEMORY_USAGE_CPU_ONLY, LinearSolver::Matrix::Free);
+
+  // the preconditioner reads the lower matrix, which isn't allocated
+  IncompletePoisson preconditioner(*device, size);
+  ConjugateGradient solver(*device, size, preconditioner);
+
+  solver.BindMatrixFree(0.01f, solidPhi, liquidPhi);
+  EXPECT_THROW(solver.Bind(data.Diagonal, data.Lower, data.B, data.X), std::runtime_error);
+}
+
+TEST(LinearSolverTests, GaussSeidel_Simple_PCG)
+{
+  glm::ivec2 size(50);
 
   FluidSim sim;
   sim.initialize(1.0f, size.x, size.y);
@@ -449,39 +769,28 @@ TEST(LinearSolverTests, Multigrid_Simple_PCG)
 
   LinearSolver::Data data(*device, size, VMA_MEMORY_USAGE_CPU_ONLY);
 
-  Velocity velocity(*device, size);
-  Texture liquidPhi(*device, size.x, size.y, vk::Format::eR32Sfloat);
-  Texture solidPhi(*device, size.x, size.y, vk::Format::eR32Sfloat);
-  Buffer<glm::ivec2> valid(*device, size.x * size.y, VMA_MEMORY_USAGE_CPU_ONLY);
-
-  SetSolidPhi(*device, size, solidPhi, sim, (float)size.x);
-  SetLiquidPhi(*device, size, liquidPhi, sim, (float)size.x);
-
   BuildLinearEquation(size, data.Diagonal, data.Lower, data.B, sim);
 
-  Pressure pressure(*device, 0.01f, size, data, velocity, solidPhi, liquidPhi, valid);
-
-  Multigrid preconditioner(*device, size, 0.01f);
-  preconditioner.BuildHierarchiesBind(pressure, solidPhi, liquidPhi);
+  GaussSeidel preconditioner(*device, size);
+  preconditioner.SetW(1.0f);
+  preconditioner.SetPreconditionerIterations(8);
 
   LinearSolver::Parameters params(LinearSolver::Parameters::SolverType::Iterative, 1000, 1e-5f);
   ConjugateGradient solver(*device, size, preconditioner);
 
   solver.Bind(data.Diagonal, data.Lower, data.B, data.X);
-
-  preconditioner.BuildHierarchies();
   solver.Solve(params);
 
   device->Queue().waitIdle();
 
-  CheckPressure(size, sim.pressure, data.X, 1e-5f);
+  CheckPressure(size, sim.pressure, data.X, 1e-4f);
 
   std::cout << "Solved with number of iterations: " << params.OutIterations << std::endl;
 }
 
-TEST(LinearSolverTests, Multigrid_Simple)
+TEST(LinearSolverTests, Chebyshev_Simple_PCG)
 {
-  glm::ivec2 size(64);
+  glm::ivec2 size(50);
 
   FluidSim sim;
   sim.initialize(1.0f, size.x, size.y);
@@ -496,30 +805,902 @@ TEST(LinearSolverTests, Multigrid_Simple)
 
   LinearSolver::Data data(*device, size, VMA_MEMORY_USAGE_CPU_ONLY);
 
-  Velocity velocity(*device, size);
-  Texture liquidPhi(*device, size.x, size.y, vk::Format::eR32Sfloat);
-  Texture solidPhi(*device, size.x, size.y, vk::Format::eR32Sfloat);
-  Buffer<glm::ivec2> valid(*device, size.x * size.y, VMA_MEMORY_USAGE_CPU_ONLY);
-
-  SetSolidPhi(*device, size, solidPhi, sim, (float)size.x);
-  SetLiquidPhi(*device, size, liquidPhi, sim, (float)size.x);
-
   BuildLinearEquation(size, data.Diagonal, data.Lower, data.B, sim);
 
-  Pressure pressure(*device, 0.01f, size, data, velocity, solidPhi, liquidPhi, valid);
+  Chebyshev preconditioner(*device, size);
 
-  Multigrid solver(*device, size, 0.01f, 3, Multigrid::SmootherSolver::GaussSeidel);
-  solver.BuildHierarchiesBind(pressure, solidPhi, liquidPhi);
-  solver.BuildHierarchies();
+  LinearSolver::Parameters params(LinearSolver::Parameters::SolverType::Iterative, 1000, 1e-5f);
+  ConjugateGradient solver(*device, size, preconditioner);
 
   solver.Bind(data.Diagonal, data.Lower, data.B, data.X);
+  preconditioner.EstimateBounds();
 
-  LinearSolver::Parameters params(LinearSolver::Parameters::SolverType::Fixed, 3);
+  // the diagonally preconditioned matrix has its eigenvalues in (0, 2]
+  glm::vec2 bounds = preconditioner.GetBounds();
+  EXPECT_GT(bounds.x, 0.0f);
+  EXPECT_LT(bounds.x, bounds.y);
+  EXPECT_LT(bounds.y, 2.2f);
 
   solver.Solve(params);
 
   device->Queue().waitIdle();
 
-  // Very bad error due to multigrid optimized as preconditioner and not solver
-  CheckPressure(size, sim.pressure, data.X, 1e-1f);
+  CheckPressure(size, sim.pressure, data.X, 1e-5f);
+
+  std::cout << "Solved with number of iterations: " << params.OutIterations << std::endl;
+}
+
+TEST(LinearSolverTests, IncompletePoisson_Simple_PCG)
+{
+  glm::ivec2 size(50);
+
+  FluidSim sim;
+  sim.initialize(1.0f, size.x, size.y);
+  sim.set_boundary(boundary_phi);
+
+  AddParticles(size, sim, boundary_phi);
+
+  sim.add_force(0.01f);
+  sim.compute_phi();
+  sim.extrapolate_phi();
+  sim.apply_projection(0.01f);
+
+  LinearSolver::Data data(*device, size, VMA_MEMORY_USAGE_CPU_ONLY);
+
+  BuildLinearEquation(size, data.Diagonal, data.Lower, data.B, sim);
+
+  IncompletePoisson preconditioner(*device, size);
+
+  LinearSolver::Parameters params(LinearSolver::Parameters::SolverType::Iterative, 1000, 1e-5f);
+  ConjugateGradient solver(*device, size, preconditioner);
+
+  solver.Bind(data.Diagonal, data.Lower, data.B, data.X);
+  solver.Solve(params);
+
+  device->Queue().waitIdle();
+
+  CheckPressure(size, sim.pressure, data.X, 1e-5f);
+
+  std::cout << "Solved with number of iterations: " << params.OutIterations << std::endl;
+}
+
+TEST(LinearSolverTests, Diagonal_Simple_PipelinedPCG)
+{
+  glm::ivec2 size(50);
+
+  FluidSim sim;
+  sim.initialize(1.0f, size.x, size.y);
+  sim.set_boundary(boundary_phi);
+
+  AddParticles(size, sim, boundary_phi);
+
+  sim.add_force(0.01f);
+  sim.compute_phi();
+  sim.extrapolate_phi();
+  sim.apply_projection(0.01f);
+
+  LinearSolver::Data data(*device, size, VMA_MEMORY_USAGE_CPU_ONLY);
+
+  BuildLinearEquation(size, data.Diagonal, data.Lower, data.B, sim);
+
+  Diagonal preconditioner(*device, size);
+
+  LinearSolver::Parameters params(LinearSolver::Parameters::SolverType::Iterative, 1000, 1e-5f);
+  PipelinedConjugateGradient solver(*device, size, preconditioner);
+
+  solver.Bind(data.Diagonal, data.Lower, data.B, data.X);
+  solver.Solve(params);
+
+  device->Queue().waitIdle();
+
+  CheckPressure(size, sim.pressure, data.X, 1e-5f);
+
+  std::cout << "Solved with number of iterations: " << params.OutIterations << std::endl;
+}
+
+TEST(LinearSolverTests, IncompletePoisson_Simple_PipelinedPCG)
+{
+  glm::ivec2 size(50);
+
+  FluidSim sim;
+  sim.initialize(1.0f, size.x, size.y);
+  sim.set_boundary(boundary_phi);
+
+  AddParticles(size, sim, boundary_phi);
+
+  sim.add_force(0.01f);
+  sim.compute_phi();
+  sim.extrapolate_phi();
+  sim.apply_projection(0.01f);
+
+  LinearSolver::Data data(*device, size, VMA_MEMORY_USAGE_CPU_ONLY);
+
+  BuildLinearEquation(size, data.Diagonal, data.Lower, data.B, sim);
+
+  IncompletePoisson preconditioner(*device, size);
+
+  LinearSolver::Parameters params(LinearSolver::Parameters::SolverType::Iterative, 1000, 1e-5f);
+  PipelinedConjugateGradient solver(*device, size, preconditioner);
+
+  solver.Bind(data.Diagonal, data.Lower, data.B, data.X);
+  solver.Solve(params);
+
+  device->Queue().waitIdle();
+
+  CheckPressure(size, sim.pressure, data.X, 1e-5f);
+
+  std::cout << "Solved with number of iterations: " << params.OutIterations << std::endl;
+}
+
+TEST(LinearSolverTests, Diagonal_Simple_CompactPCG)
+{
+  glm::ivec2 size(50);
+
+  FluidSim sim;
+  sim.initialize(1.0f, size.x, size.y);
+  sim.set_boundary(boundary_phi);
+
+  AddParticles(size, sim, boundary_phi);
+
+  sim.add_force(0.01f);
+  sim.compute_phi();
+  sim.extrapolate_phi();
+  sim.apply_projection(0.01f);
+
+  LinearSolver::Data data(*device, size, VMA_MEMORY_USAGE_CPU_ONLY);
+
+  BuildLinearEquation(size, data.Diagonal, data.Lower, data.B, sim);
+
+  LinearSolver::Parameters params(LinearSolver::Parameters::SolverType::Iterative, 1000, 1e-5f);
+  CompactConjugateGradient solver(*device, size);
+
+  solver.Bind(data.Diagonal, data.Lower, data.B, data.X);
+  solver.Solve(params);
+
+  device->Queue().waitIdle();
+
+  CheckPressure(size, sim.pressure, data.X, 1e-5f);
+
+  // only the fluid cells are solved
+  int fluidCells = 0;
+  for (int i = 1; i < size.x - 1; i++)
+  {
+    for (int j = 1; j < size.y - 1; j++)
+    {
+      if (sim.matrix(i + size.x * j, i + size.x * j) != 0.0f)
+      {
+        fluidCells++;
+      }
+    }
+  }
+
+  EXPECT_EQ(fluidCells, solver.GetCount());
+
+  std::cout << "Solved with number of iterations: " << params.OutIterations << std::endl;
+}
+
+TEST(LinearSolverTests, Diagonal_Simple_CompactPCG_WarmStart)
+{
+  glm::ivec2 size(50);
+
+  FluidSim sim;
+  sim.initialize(1.0f, size.x, size.y);
+  sim.set_boundary(boundary_phi);
+
+  AddParticles(size, sim, boundary_phi);
+
+  sim.add_force(0.01f);
+  sim.compute_phi();
+  sim.extrapolate_phi();
+  sim.apply_projection(0.01f);
+
+  LinearSolver::Data data(*device, size, VMA_MEMORY_USAGE_CPU_ONLY);
+
+  BuildLinearEquation(size, data.Diagonal, data.Lower, data.B, sim);
+
+  LinearSolver::Parameters params(LinearSolver::Parameters::SolverType::Iterative, 1000, 1e-5f);
+  CompactConjugateGradient solver(*device, size);
+
+  solver.Bind(data.Diagonal, data.Lower, data.B, data.X);
+  solver.Solve(params);
+
+  device->Queue().waitIdle();
+
+  // perturb the right hand side, the solution is scaled accordingly
+  const float scale = 1.001f;
+  std::vector<float> b(size.x * size.y);
+  Renderer::CopyTo(data.B, b);
+  for (auto& value : b)
+  {
+    value *= scale;
+  }
+  Renderer::CopyFrom(data.B, b);
+
+  std::vector<double> scaledPressure(sim.pressure.size());
+  for (std::size_t i = 0; i < scaledPressure.size(); i++)
+  {
+    scaledPressure[i] = scale * sim.pressure[i];
+  }
+
+  // solve the perturbed system starting from the previous solution
+  LinearSolver::Parameters warmParams(
+      LinearSolver::Parameters::SolverType::Iterative, 1000, 1e-5f);
+  warmParams.WarmStart = true;
+  solver.Solve(warmParams);
+
+  device->Queue().waitIdle();
+
+  CheckPressure(size, scaledPressure, data.X, 1e-5f);
+
+  // and starting from zero
+  LinearSolver::Parameters coldParams(
+      LinearSolver::Parameters::SolverType::Iterative, 1000, 1e-5f);
+  solver.Solve(coldParams);
+
+  device->Queue().waitIdle();
+
+  CheckPressure(size, scaledPressure, data.X, 1e-5f);
+
+  // a small perturbation needs at most half of the iterations
+  EXPECT_LE(2 * warmParams.OutIterations, coldParams.OutIterations);
+
+  std::cout << "Solved with number of iterations: " << warmParams.OutIterations << " instead of "
+            << coldParams.OutIterations << std::endl;
+}
+
+TEST(LinearSolverTests, Simple_CpuPCG)
+{
+  glm::ivec2 size(50);
+
+  FluidSim sim;
+  sim.initialize(1.0f, size.x, size.y);
+  sim.set_boundary(boundary_phi);
+
+  AddParticles(size, sim, boundary_phi);
+
+  sim.add_force(0.01f);
+  sim.compute_phi();
+  sim.extrapolate_phi();
+  sim.apply_projection(0.01f);
+
+  LinearSolver::Data data(*device, size, VMA_MEMORY_USAGE_CPU_ONLY);
+
+  BuildLinearEquation(size, data.Diagonal, data.Lower, data.B, sim);
+
+  LinearSolver::Parameters params(LinearSolver::Parameters::SolverType::Iterative, 1000, 1e-5f);
+  CpuConjugateGradient solver(*device, size);
+
+  solver.Bind(data.Diagonal, data.Lower, data.B, data.X);
+  solver.Solve(params);
+
+  CheckPressure(size, sim.pressure, data.X, 1e-5f);
+  EXPECT_FLOAT_EQ(params.OutError, solver.GetError());
+
+  std::cout << "Solved with number of iterations: " << params.OutIterations << std::endl;
+}
+
+TEST(LinearSolverTests, Host_CpuPCG)
+{
+  glm::ivec2 size(100);
+
+  FluidSim sim;
+  sim.initialize(1.0f, size.x, size.y);
+  sim.set_boundary(boundary_phi);
+
+  AddParticles(size, sim, boundary_phi);
+
+  sim.add_force(0.01f);
+  sim.compute_phi();
+  sim.extrapolate_phi();
+  sim.apply_projection(0.01f);
+
+  LinearSolver::Data data(*device, size, VMA_MEMORY_USAGE_CPU_ONLY);
+
+  BuildLinearEquation(size, data.Diagonal, data.Lower, data.B, sim);
+
+  CpuConjugateGradient::HostData hostData(size);
+  CopyTo(data.Diagonal, hostData.Diagonal);
+  CopyTo(data.Lower, hostData.Lower);
+  CopyTo(data.B, hostData.B);
+
+  // the preconditioner is factored per strip, so the solution doesn't depend
+  // on the number of threads but the iterations do
+  for (unsigned threadCount : {1u, 4u})
+  {
+    LinearSolver::Parameters params(LinearSolver::Parameters::SolverType::Iterative, 1000, 1e-5f);
+    CpuConjugateGradient solver(*device, size, threadCount);
+
+    solver.Solve(hostData, params);
+
+    EXPECT_LT(params.OutIterations, 1000u);
+
+    CopyFrom(data.X, hostData.X);
+    CheckPressure(size, sim.pressure, data.X, 1e-5f);
+
+    std::cout << "Solved with " << threadCount
+              << " threads and number of iterations: " << params.OutIterations << std::endl;
+  }
+}
+
+TEST(LinearSolverTests, Zero_PCG)
+{
+  glm::ivec2 size(50);
+
+  LinearSolver::Data data(*device, size, VMA_MEMORY_USAGE_CPU_ONLY);
+
+  Diagonal preconditioner(*device, size);
+
+  LinearSolver::Parameters params(LinearSolver::Parameters::SolverType::Iterative, 1000, 1e-5f);
+  ConjugateGradient solver(*device, size, preconditioner);
+
+  solver.Bind(data.Diagonal, data.Lower, data.B, data.X);
+  solver.Solve(params);
+
+  device->Queue().waitIdle();
+
+  ASSERT_EQ(0, params.OutIterations);
+
+  std::vector<float> pressureData(size.x * size.y, 1.0f);
+  CopyTo(data.X, pressureData);
+
+  for (int i = 0; i < size.x; i++)
+  {
+    for (int j = 0; j < size.y; j++)
+    {
+      EXPECT_FLOAT_EQ(0.0f, pressureData[i + size.x * j]);
+    }
+  }
+}
+
+TEST(LinearSolverTests, Multigrid_Simple_PCG)
+{
+  glm::ivec2 size(64);
+
+  FluidSim sim;
+  sim.initialize(1.0f, size.x, size.y);
+  sim.set_boundary(boundary_phi);
+
+  AddParticles(size, sim, boundary_phi);
+
+  sim.add_force(0.01f);
+  sim.compute_phi();
+  sim.extrapolate_phi();
+  sim.apply_projection(0.01f);
+
+  LinearSolver::Data data(*device, size, VMA_MEMORY_USAGE_CPU_ONLY);
+
+  Velocity velocity(*device, size);
+  Texture liquidPhi(*device, size.x, size.y, vk::Format::eR32Sfloat);
+  Texture solidPhi(*device, size.x, size.y, vk::Format::eR32Sfloat);
+  Buffer<glm::ivec2> valid(*device, size.x * size.y, VMA_MEMORY_USAGE_CPU_ONLY);
+
+  SetSolidPhi(*device, size, solidPhi, sim, (float)size.x);
+  SetLiquidPhi(*device, size, liquidPhi, sim, (float)size.x);
+
+  BuildLinearEquation(size, data.Diagonal, data.Lower, data.B, sim);
+
+  Pressure pressure(*device, 0.01f, size, data, velocity, solidPhi, liquidPhi, valid);
+
+  Multigrid preconditioner(*device, size, 0.01f);
+  preconditioner.BuildHierarchiesBind(pressure, solidPhi, liquidPhi);
+
+  LinearSolver::Parameters params(LinearSolver::Parameters::SolverType::Iterative, 1000, 1e-5f);
+  ConjugateGradient solver(*device, size, preconditioner);
+
+  solver.Bind(data.Diagonal, data.Lower, data.B, data.X);
+
+  preconditioner.BuildHierarchies();
+  solver.Solve(params);
+
+  device->Queue().waitIdle();
+
+  CheckPressure(size, sim.pressure, data.X, 1e-5f);
+
+  std::cout << "Solved with number of iterations: " << params.OutIterations << std::endl;
+}
+
+TEST(LinearSolverTests, Multigrid_MatrixFree_PCG)
+{
+  glm::ivec2 size(64);
+
+  FluidSim sim;
+  sim.initialize(1.0f, size.x, size.y);
+  sim.set_boundary(boundary_phi);
+
+  AddParticles(size, sim, boundary_phi);
+
+  sim.add_force(0.01f);
+
+  Velocity velocity(*device, size);
+  Texture solidPhi(*device, size.x, size.y, vk::Format::eR32Sfloat);
+  Texture liquidPhi(*device, size.x, size.y, vk::Format::eR32Sfloat);
+  Buffer<glm::ivec2> valid(*device, size.x * size.y, VMA_MEMORY_USAGE_CPU_ONLY);
+
+  BuildInputs(*device, size, sim, velocity, solidPhi, liquidPhi);
+
+  // reference solution with the explicit matrix
+  LinearSolver::Data data(*device, size, VMA_MEMORY_USAGE_CPU_ONLY);
+  Pressure pressure(*device, 0.01f, size, data, velocity, solidPhi, liquidPhi, valid);
+  pressure.BuildLinearEquation();
+
+  Diagonal diagonal(*device, size);
+
+  LinearSolver::Parameters params(LinearSolver::Parameters::SolverType::Iterative, 1000, 1e-5f);
+  ConjugateGradient solver(*device, size, diagonal);
+
+  solver.Bind(data.Diagonal, data.Lower, data.B, data.X);
+  solver.Solve(params);
+
+  device->Queue().waitIdle();
+
+  std::vector<float> x(size.x * size.y);
+  CopyTo(data.X, x);
+
+  // the finest level is matrix free, the coarser levels are still built
+  LinearSolver::Data matrixFreeData(
+      *device, size, VMA_MEMORY_USAGE_CPU_ONLY, LinearSolver::Matrix::Free);
+  Pressure matrixFreePressure(*device,
+                              0.01f,
+                              size,
+                              matrixFreeData,
+                              velocity,
+                              solidPhi,
+                              liquidPhi,
+                              valid,
+                              LinearSolver::Matrix::Free);
+  matrixFreePressure.BuildLinearEquation();
+
+  for (auto smoother : {Multigrid::SmootherSolver::Jacobi, Multigrid::SmootherSolver::GaussSeidel})
+  {
+    Multigrid preconditioner(*device, size, 0.01f, 3, smoother);
+    preconditioner.BuildHierarchiesBind(matrixFreePressure, solidPhi, liquidPhi);
+
+    LinearSolver::Parameters matrixFreeParams(
+        LinearSolver::Parameters::SolverType::Iterative, 1000, 1e-5f);
+    ConjugateGradient matrixFreeSolver(*device, size, preconditioner);
+
+    matrixFreeSolver.BindMatrixFree(0.01f, solidPhi, liquidPhi);
+    matrixFreeSolver.Bind(matrixFreeData.Diagonal,
+                          matrixFreeData.Lower,
+                          matrixFreeData.B,
+                          matrixFreeData.X);
+
+    preconditioner.BuildHierarchies();
+    matrixFreeSolver.Solve(matrixFreeParams);
+
+    device->Queue().waitIdle();
+
+    std::vector<float> matrixFreeX(size.x * size.y);
+    CopyTo(matrixFreeData.X, matrixFreeX);
+
+    for (std::size_t i = 0; i < x.size(); i++)
+    {
+      EXPECT_NEAR(x[i], matrixFreeX[i], 1e-5f);
+    }
+
+    // the multigrid still preconditions better than the diagonal
+    EXPECT_LT(matrixFreeParams.OutIterations, params.OutIterations);
+
+    std::cout << "Solved with number of iterations: " << matrixFreeParams.OutIterations
+              << std::endl;
+  }
+}
+
+TEST(LinearSolverTests, Multigrid_Depth)
+{
+  Depth depth(glm::ivec2(600, 340));
+
+  ASSERT_EQ(6, depth.GetMaxDepth());
+  EXPECT_EQ(glm::ivec2(300, 170), depth.GetDepthSize(1));
+  EXPECT_EQ(glm::ivec2(150, 85), depth.GetDepthSize(2));
+  EXPECT_EQ(glm::ivec2(75, 43), depth.GetDepthSize(3));
+  EXPECT_EQ(glm::ivec2(38, 22), depth.GetDepthSize(4));
+  EXPECT_EQ(glm::ivec2(19, 11), depth.GetDepthSize(5));
+  EXPECT_EQ(glm::ivec2(10, 6), depth.GetDepthSize(6));
+  EXPECT_TRUE(depth.IsCoarsestLocal());
+
+  // thin domains stop coarsening before a side gets smaller than 3
+  Depth thinDepth(glm::ivec2(256, 16));
+
+  ASSERT_EQ(2, thinDepth.GetMaxDepth());
+  EXPECT_EQ(glm::ivec2(64, 4), thinDepth.GetDepthSize(2));
+  EXPECT_FALSE(thinDepth.IsCoarsestLocal());
+}
+
+TEST(LinearSolverTests, Multigrid_Rectangular_PCG)
+{
+  glm::ivec2 size(75, 49);
+
+  FluidSim sim;
+  sim.initialize(1.0f, size.x, size.y);
+  sim.set_boundary(boundary_phi);
+
+  AddParticles(size, sim, boundary_phi);
+
+  sim.add_force(0.01f);
+  sim.compute_phi();
+  sim.extrapolate_phi();
+  sim.apply_projection(0.01f);
+
+  LinearSolver::Data data(*device, size, VMA_MEMORY_USAGE_CPU_ONLY);
+
+  Velocity velocity(*device, size);
+  Texture liquidPhi(*device, size.x, size.y, vk::Format::eR32Sfloat);
+  Texture solidPhi(*device, size.x, size.y, vk::Format::eR32Sfloat);
+  Buffer<glm::ivec2> valid(*device, size.x * size.y, VMA_MEMORY_USAGE_CPU_ONLY);
+
+  SetSolidPhi(*device, size, solidPhi, sim, (float)size.x);
+  SetLiquidPhi(*device, size, liquidPhi, sim, (float)size.x);
+
+  BuildLinearEquation(size, data.Diagonal, data.Lower, data.B, sim);
+
+  Pressure pressure(*device, 0.01f, size, data, velocity, solidPhi, liquidPhi, valid);
+
+  Multigrid preconditioner(*device, size, 0.01f);
+  preconditioner.BuildHierarchiesBind(pressure, solidPhi, liquidPhi);
+
+  LinearSolver::Parameters params(LinearSolver::Parameters::SolverType::Iterative, 1000, 1e-5f);
+  ConjugateGradient solver(*device, size, preconditioner);
+
+  solver.Bind(data.Diagonal, data.Lower, data.B, data.X);
+
+  preconditioner.BuildHierarchies();
+  solver.Solve(params);
+
+  device->Queue().waitIdle();
+
+  CheckPressure(size, sim.pressure, data.X, 1e-5f);
+
+  std::cout << "Solved with number of iterations: " << params.OutIterations << std::endl;
+}
+
+TEST(LinearSolverTests, Multigrid_Simple)
+{
+  glm::ivec2 size(64);
+
+  FluidSim sim;
+  sim.initialize(1.0f, size.x, size.y);
+  sim.set_boundary(boundary_phi);
+
+  AddParticles(size, sim, boundary_phi);
+
+  sim.add_force(0.01f);
+  sim.compute_phi();
+  sim.extrapolate_phi();
+  sim.apply_projection(0.01f);
+
+  LinearSolver::Data data(*device, size, VMA_MEMORY_USAGE_CPU_ONLY);
+
+  Velocity velocity(*device, size);
+  Texture liquidPhi(*device, size.x, size.y, vk::Format::eR32Sfloat);
+  Texture solidPhi(*device, size.x, size.y, vk::Format::eR32Sfloat);
+  Buffer<glm::ivec2> valid(*device, size.x * size.y, VMA_MEMORY_USAGE_CPU_ONLY);
+
+  SetSolidPhi(*device, size, solidPhi, sim, (float)size.x);
+  SetLiquidPhi(*device, size, liquidPhi, sim, (float)size.x);
+
+  BuildLinearEquation(size, data.Diagonal, data.Lower, data.B, sim);
+
+  Pressure pressure(*device, 0.01f, size, data, velocity, solidPhi, liquidPhi, valid);
+
+  Multigrid solver(*device, size, 0.01f, 3, Multigrid::SmootherSolver::GaussSeidel);
+  solver.BuildHierarchiesBind(pressure, solidPhi, liquidPhi);
+  solver.BuildHierarchies();
+
+  solver.Bind(data.Diagonal, data.Lower, data.B, data.X);
+
+  LinearSolver::Parameters params(LinearSolver::Parameters::SolverType::Fixed, 3);
+
+  solver.Solve(params);
+
+  device->Queue().waitIdle();
+
+  // Very bad error due to multigrid optimized as preconditioner and not solver
+  CheckPressure(size, sim.pressure, data.X, 1e-1f);
+}
+
+TEST(LinearSolverTests, Multigrid_Iterative)
+{
+  glm::ivec2 size(64);
+
+  FluidSim sim;
+  sim.initialize(1.0f, size.x, size.y);
+  sim.set_boundary(boundary_phi);
+
+  AddParticles(size, sim, boundary_phi);
+
+  sim.add_force(0.01f);
+  sim.compute_phi();
+  sim.extrapolate_phi();
+  sim.apply_projection(0.01f);
+
+  LinearSolver::Data data(*device, size, VMA_MEMORY_USAGE_CPU_ONLY);
+
+  Velocity velocity(*device, size);
+  Texture liquidPhi(*device, size.x, size.y, vk::Format::eR32Sfloat);
+  Texture solidPhi(*device, size.x, size.y, vk::Format::eR32Sfloat);
+  Buffer<glm::ivec2> valid(*device, size.x * size.y, VMA_MEMORY_USAGE_CPU_ONLY);
+
+  SetSolidPhi(*device, size, solidPhi, sim, (float)size.x);
+  SetLiquidPhi(*device, size, liquidPhi, sim, (float)size.x);
+
+  BuildLinearEquation(size, data.Diagonal, data.Lower, data.B, sim);
+
+  Pressure pressure(*device, 0.01f, size, data, velocity, solidPhi, liquidPhi, valid);
+
+  Multigrid solver(*device, size, 0.01f, 3, Multigrid::SmootherSolver::GaussSeidel);
+  solver.BuildHierarchiesBind(pressure, solidPhi, liquidPhi);
+  solver.BuildHierarchies();
+
+  solver.Bind(data.Diagonal, data.Lower, data.B, data.X);
+
+  for (auto cycle : {Multigrid::CycleType::V, Multigrid::CycleType::W, Multigrid::CycleType::F})
+  {
+    solver.SetCycle(cycle);
+
+    LinearSolver::Parameters params(LinearSolver::Parameters::SolverType::Iterative, 100, 1e-4f);
+    solver.Solve(params);
+
+    device->Queue().waitIdle();
+
+    EXPECT_LT(params.OutIterations, 100u);
+    EXPECT_FLOAT_EQ(params.OutError, solver.GetError());
+
+    CheckPressure(size, sim.pressure, data.X, 1e-2f);
+
+    std::cout << "Solved with number of iterations: " << params.OutIterations << std::endl;
+  }
+}
+
+TEST(LinearSolverTests, Multigrid_Batch)
+{
+  glm::ivec2 size(64);
+
+  FluidSim sim;
+  sim.initialize(1.0f, size.x, size.y);
+  sim.set_boundary(boundary_phi);
+
+  AddParticles(size, sim, boundary_phi);
+
+  sim.add_force(0.01f);
+  sim.compute_phi();
+  sim.extrapolate_phi();
+  sim.apply_projection(0.01f);
+
+  LinearSolver::Data data(*device, size, VMA_MEMORY_USAGE_CPU_ONLY);
+
+  Velocity velocity(*device, size);
+  Texture liquidPhi(*device, size.x, size.y, vk::Format::eR32Sfloat);
+  Texture solidPhi(*device, size.x, size.y, vk::Format::eR32Sfloat);
+  Buffer<glm::ivec2> valid(*device, size.x * size.y, VMA_MEMORY_USAGE_CPU_ONLY);
+
+  SetSolidPhi(*device, size, solidPhi, sim, (float)size.x);
+  SetLiquidPhi(*device, size, liquidPhi, sim, (float)size.x);
+
+  BuildLinearEquation(size, data.Diagonal, data.Lower, data.B, sim);
+
+  Pressure pressure(*device, 0.01f, size, data, velocity, solidPhi, liquidPhi, valid);
+
+  for (auto smoother : {Multigrid::SmootherSolver::GaussSeidel, Multigrid::SmootherSolver::Jacobi})
+  {
+    Multigrid solver(*device, size, 0.01f, 3, smoother);
+    solver.BuildHierarchiesBind(pressure, solidPhi, liquidPhi);
+    solver.BuildHierarchies();
+
+    solver.Bind(data.Diagonal, data.Lower, data.B, data.X);
+
+    LinearSolver::Parameters params(LinearSolver::Parameters::SolverType::Iterative, 100, 1e-4f);
+    solver.SetBatchIterations(1);
+    solver.Solve(params);
+
+    device->Queue().waitIdle();
+
+    LinearSolver::Parameters batchParams(
+        LinearSolver::Parameters::SolverType::Iterative, 100, 1e-4f);
+    solver.SetBatchIterations(8);
+    solver.Solve(batchParams);
+
+    device->Queue().waitIdle();
+
+    CheckPressure(size, sim.pressure, data.X, 1e-2f);
+
+    // convergence is checked on the GPU, so we stop at the same cycle
+    EXPECT_EQ(params.OutIterations, batchParams.OutIterations);
+    EXPECT_FLOAT_EQ(params.OutError, batchParams.OutError);
+
+    std::cout << "Solved with number of iterations: " << batchParams.OutIterations << std::endl;
+  }
+}
+
+TEST(LinearSolverTests, Multigrid_Half_Iterative)
+{
+  glm::ivec2 size(64);
+
+  FluidSim sim;
+  sim.initialize(1.0f, size.x, size.y);
+  sim.set_boundary(boundary_phi);
+
+  AddParticles(size, sim, boundary_phi);
+
+  sim.add_force(0.01f);
+  sim.compute_phi();
+  sim.extrapolate_phi();
+  sim.apply_projection(0.01f);
+
+  LinearSolver::Data data(*device, size, VMA_MEMORY_USAGE_CPU_ONLY);
+
+  Velocity velocity(*device, size);
+  Texture liquidPhi(*device, size.x, size.y, vk::Format::eR32Sfloat);
+  Texture solidPhi(*device, size.x, size.y, vk::Format::eR32Sfloat);
+  Buffer<glm::ivec2> valid(*device, size.x * size.y, VMA_MEMORY_USAGE_CPU_ONLY);
+
+  SetSolidPhi(*device, size, solidPhi, sim, (float)size.x);
+  SetLiquidPhi(*device, size, liquidPhi, sim, (float)size.x);
+
+  BuildLinearEquation(size, data.Diagonal, data.Lower, data.B, sim);
+
+  Pressure pressure(*device, 0.01f, size, data, velocity, solidPhi, liquidPhi, valid);
+
+  Multigrid solver(*device,
+                   size,
+                   0.01f,
+                   3,
+                   Multigrid::SmootherSolver::GaussSeidel,
+                   LinearSolver::Precision::Half);
+  solver.BuildHierarchiesBind(pressure, solidPhi, liquidPhi);
+  solver.BuildHierarchies();
+
+  solver.Bind(data.Diagonal, data.Lower, data.B, data.X);
+
+  for (auto cycle : {Multigrid::CycleType::V, Multigrid::CycleType::W, Multigrid::CycleType::F})
+  {
+    solver.SetCycle(cycle);
+
+    LinearSolver::Parameters params(LinearSolver::Parameters::SolverType::Iterative, 100, 1e-4f);
+    solver.Solve(params);
+
+    device->Queue().waitIdle();
+
+    EXPECT_LT(params.OutIterations, 100u);
+    EXPECT_FLOAT_EQ(params.OutError, solver.GetError());
+
+    CheckPressure(size, sim.pressure, data.X, 1e-2f);
+
+    std::cout << "Solved with number of iterations: " << params.OutIterations << std::endl;
+  }
+}
+
+TEST(LinearSolverTests, Multigrid_Coarse_Iterative)
+{
+  // the finest level is solved in the coarse cycle kernel
+  glm::ivec2 size(30);
+
+  FluidSim sim;
+  sim.initialize(1.0f, size.x, size.y);
+  sim.set_boundary(boundary_phi);
+
+  AddParticles(size, sim, boundary_phi);
+
+  sim.add_force(0.01f);
+  sim.compute_phi();
+  sim.extrapolate_phi();
+  sim.apply_projection(0.01f);
+
+  LinearSolver::Data data(*device, size, VMA_MEMORY_USAGE_CPU_ONLY);
+
+  Velocity velocity(*device, size);
+  Texture liquidPhi(*device, size.x, size.y, vk::Format::eR32Sfloat);
+  Texture solidPhi(*device, size.x, size.y, vk::Format::eR32Sfloat);
+  Buffer<glm::ivec2> valid(*device, size.x * size.y, VMA_MEMORY_USAGE_CPU_ONLY);
+
+  SetSolidPhi(*device, size, solidPhi, sim, (float)size.x);
+  SetLiquidPhi(*device, size, liquidPhi, sim, (float)size.x);
+
+  BuildLinearEquation(size, data.Diagonal, data.Lower, data.B, sim);
+
+  Pressure pressure(*device, 0.01f, size, data, velocity, solidPhi, liquidPhi, valid);
+
+  for (auto smoother : {Multigrid::SmootherSolver::Jacobi, Multigrid::SmootherSolver::GaussSeidel})
+  {
+    Multigrid solver(*device, size, 0.01f, 3, smoother);
+    solver.BuildHierarchiesBind(pressure, solidPhi, liquidPhi);
+    solver.BuildHierarchies();
+
+    solver.Bind(data.Diagonal, data.Lower, data.B, data.X);
+
+    LinearSolver::Parameters params(LinearSolver::Parameters::SolverType::Iterative, 100, 1e-4f);
+    solver.Solve(params);
+
+    device->Queue().waitIdle();
+
+    EXPECT_LT(params.OutIterations, 100u);
+    EXPECT_FLOAT_EQ(params.OutError, solver.GetError());
+
+    CheckPressure(size, sim.pressure, data.X, 1e-2f);
+
+    std::cout << "Solved with number of iterations: " << params.OutIterations << std::endl;
+  }
+}
+
+TEST(LinearSolverTests, Capture_Replay)
+{
+  glm::ivec2 size(50);
+
+  FluidSim sim;
+  sim.initialize(1.0f, size.x, size.y);
+  sim.set_boundary(boundary_phi);
+
+  AddParticles(size, sim, boundary_phi);
+
+  sim.add_force(0.01f);
+  sim.compute_phi();
+  sim.extrapolate_phi();
+  sim.apply_projection(0.01f);
+
+  LinearSolver::Data data(*device, size, VMA_MEMORY_USAGE_CPU_ONLY);
+
+  Texture liquidPhi(*device, size.x, size.y, vk::Format::eR32Sfloat, VMA_MEMORY_USAGE_CPU_ONLY);
+  Texture solidPhi(*device, size.x, size.y, vk::Format::eR32Sfloat, VMA_MEMORY_USAGE_CPU_ONLY);
+
+  SetSolidPhi(*device, size, solidPhi, sim, (float)size.x);
+  SetLiquidPhi(*device, size, liquidPhi, sim, (float)size.x);
+
+  BuildLinearEquation(size, data.Diagonal, data.Lower, data.B, sim);
+
+  data.Capture("linear_system.bin", 0.01f, &liquidPhi, &solidPhi);
+  data.Capture("linear_system_nophi.bin");
+
+  auto info = LinearSolver::Data::ReadCaptureInfo("linear_system.bin");
+  EXPECT_EQ(size, info.Size);
+  EXPECT_FLOAT_EQ(0.01f, info.Delta);
+  EXPECT_TRUE(info.LevelSets);
+
+  info = LinearSolver::Data::ReadCaptureInfo("linear_system_nophi.bin");
+  EXPECT_EQ(size, info.Size);
+  EXPECT_FALSE(info.LevelSets);
+
+  LinearSolver::Data replayData(*device, size, VMA_MEMORY_USAGE_CPU_ONLY);
+
+  Texture replayLiquidPhi(
+      *device, size.x, size.y, vk::Format::eR32Sfloat, VMA_MEMORY_USAGE_CPU_ONLY);
+  Texture replaySolidPhi(
+      *device, size.x, size.y, vk::Format::eR32Sfloat, VMA_MEMORY_USAGE_CPU_ONLY);
+
+  replayData.Replay("linear_system.bin", &replayLiquidPhi, &replaySolidPhi);
+
+  std::vector<float> diagonal(size.x * size.y), b(size.x * size.y), phi(size.x * size.y);
+  std::vector<glm::vec2> lower(size.x * size.y);
+
+  CopyTo(data.Diagonal, diagonal);
+  CopyTo(data.Lower, lower);
+  CopyTo(data.B, b);
+
+  CheckBuffer(diagonal, replayData.Diagonal);
+  CheckBuffer(lower, replayData.Lower);
+  CheckBuffer(b, replayData.B);
+
+  liquidPhi.CopyTo(phi);
+  CheckTexture(phi, replayLiquidPhi);
+  solidPhi.CopyTo(phi);
+  CheckTexture(phi, replaySolidPhi);
+
+  // the replayed equations give the same solution
+  Diagonal preconditioner(*device, size);
+
+  LinearSolver::Parameters params(LinearSolver::Parameters::SolverType::Iterative, 1000, 1e-5f);
+  ConjugateGradient solver(*device, size, preconditioner);
+
+  solver.Bind(replayData.Diagonal, replayData.Lower, replayData.B, replayData.X);
+  solver.Solve(params);
+
+  device->Queue().waitIdle();
+
+  CheckPressure(size, sim.pressure, replayData.X, 1e-5f);
+
+  // the equations are replayed at the size they were captured
+  LinearSolver::Data otherData(*device, glm::ivec2(20), VMA_MEMORY_USAGE_CPU_ONLY);
+  EXPECT_THROW(otherData.Replay("linear_system.bin"), std::runtime_error);
+
+  std::remove("linear_system.bin");
+  std::remove("linear_system_nophi.bin");
 }
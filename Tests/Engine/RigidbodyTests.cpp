@@ -12,6 +12,7 @@
 #include <Vortex2D/Engine/Extrapolation.h>
 #include <Vortex2D/Engine/LinearSolver/ConjugateGradient.h>
 #include <Vortex2D/Engine/LinearSolver/Diagonal.h>
+#include <Vortex2D/Engine/LinearSolver/Multigrid.h>
 #include <Vortex2D/Engine/Pressure.h>
 #include <Vortex2D/Engine/Rigidbody.h>
 #include <Vortex2D/Renderer/RenderTexture.h>
@@ -691,6 +692,104 @@ TEST(RigidbodyTests, PressureRotation)
   CheckPressure(size, sim.pressure, data.X, 1e-2f);  // FIXME error is way too high
 }
 
+TEST(RigidbodyTests, MultigridPressureVelocityRotation)
+{
+  glm::ivec2 size(50);
+  glm::vec2 rectangleSize(0.3f, 0.2f);
+
+  FluidSim sim;
+  sim.initialize(1.0f, size.x, size.y);
+  sim.set_boundary(boundary_phi);
+
+  AddParticles(size, sim, boundary_phi);
+
+  // setup rigid body
+  sim.rigidgeom = new Box2DGeometry(rectangleSize.x, rectangleSize.y);
+  sim.rbd = new ::RigidBody(0.4f, *sim.rigidgeom);
+  sim.rbd->setCOM(Vec2f(0.5f, 0.5f));
+  sim.rbd->setAngle(0.0);
+  sim.rbd->setAngularMomentum(0.1f * sim.rbd->getInertiaModulus());
+  sim.rbd->setLinearVelocity(Vec2f(0.1f, 0.0f));
+  ProjectParticles(sim);
+
+  sim.update_rigid_body_grids();
+  sim.add_force(0.01f);
+
+  Velocity velocity(*device, size);
+  RenderTexture solidPhi(*device, size.x, size.y, vk::Format::eR32Sfloat);
+  Texture liquidPhi(*device, size.x, size.y, vk::Format::eR32Sfloat);
+  Buffer<glm::ivec2> valid(*device, size.x * size.y, VMA_MEMORY_USAGE_CPU_ONLY);
+
+  sim.rigid_u_mass = sim.rbd->getMass();
+  sim.rigid_v_mass = sim.rbd->getMass();
+
+  BuildInputs(*device, size, sim, velocity, solidPhi, liquidPhi);
+  SetSolidPhi(*device, size, solidPhi, sim, (float)size.x);
+
+  LinearSolver::Data data(*device, size, VMA_MEMORY_USAGE_CPU_ONLY);
+
+  BuildLinearEquation(size, data.Diagonal, data.Lower, data.B, sim);
+
+  Vortex2D::Fluid::Rectangle rectangle(*device, rectangleSize * glm::vec2(size), false, size.x);
+  Vortex2D::Fluid::RigidBody rigidBody(
+      *device, size, rectangle, Vortex2D::Fluid::RigidBody::Type::eStrong);
+  rigidBody.BindPhi(solidPhi);
+  rigidBody.SetMassData(sim.rbd->getMass(), sim.rbd->getInertiaModulus());
+
+  rigidBody.Anchor = glm::vec2(0.5) * rectangleSize * glm::vec2(size);
+  rigidBody.Position = glm::vec2(0.5) * glm::vec2(size);
+  rigidBody.UpdatePosition();
+
+  rigidBody.RenderPhi();
+
+  Pressure pressure(*device, 0.01f, size, data, velocity, solidPhi, liquidPhi, valid);
+
+  // solve with multigrid
+  Multigrid multigrid(*device, size, 0.01f, 3, Multigrid::SmootherSolver::GaussSeidel);
+  multigrid.BuildHierarchiesBind(pressure, solidPhi, liquidPhi);
+  multigrid.BindRigidbody(0.01f, data.Diagonal, rigidBody);
+  multigrid.Bind(data.Diagonal, data.Lower, data.B, data.X);
+  multigrid.BuildHierarchies();
+
+  std::vector<float> b(size.x * size.y);
+  CopyTo(data.B, b);
+
+  LinearSolver::Parameters multigridParams(
+      LinearSolver::Parameters::SolverType::Iterative, 100, 1e-5f);
+  multigrid.Solve(multigridParams, {&rigidBody});
+
+  device->Handle().waitIdle();
+
+  // the PCG checks the error of the coupled system
+  EXPECT_LT(multigridParams.OutIterations, 100u);
+
+  // the right hand side is left untouched
+  std::vector<float> solvedB(size.x * size.y);
+  CopyTo(data.B, solvedB);
+  EXPECT_EQ(b, solvedB);
+
+  std::cout << "Multigrid solved in " << multigridParams.OutIterations << " iterations. Error "
+            << multigridParams.OutError << std::endl;
+
+  std::vector<float> result(size.x * size.y);
+  CopyTo(data.X, result);
+  std::vector<double> multigridPressure(result.begin(), result.end());
+
+  // solve with conjugate gradient
+  Diagonal preconditioner(*device, size);
+  ConjugateGradient solver(*device, size, preconditioner);
+
+  solver.BindRigidbody(0.01f, data.Diagonal, rigidBody);
+  solver.Bind(data.Diagonal, data.Lower, data.B, data.X);
+
+  LinearSolver::Parameters params(LinearSolver::Parameters::SolverType::Iterative, 1000, 1e-5f);
+  solver.Solve(params, {&rigidBody});
+
+  device->Handle().waitIdle();
+
+  CheckPressure(size, multigridPressure, data.X, 1e-3f);
+}
+
 TEST(RigidbodyTests, VelocityConstrain)
 {
   glm::ivec2 size(50);
@@ -7,6 +7,7 @@
 #include <Vortex2D/Engine/Cfl.h>
 #include <Vortex2D/Engine/Density.h>
 #include <Vortex2D/Engine/Rigidbody.h>
+#include <Vortex2D/Engine/Tiles.h>
 #include <Vortex2D/Engine/World.h>
 #include <gtest/gtest.h>
 #include "VariationalHelpers.h"
@@ -202,6 +203,333 @@ TEST(WorldTests, Velocity)
   CheckVelocity(*device, size, world.GetVelocity(), velocityData);
 }
 
+TEST(WorldTests, ThinVelocity)
+{
+  float dt = 0.01f;
+  glm::vec2 size(256.0f, 16.0f);
+
+  // the multigrid stops coarsening at 64x4
+  Fluid::SmokeWorld world(*device, size, dt, Fluid::Velocity::InterpolationMode::Cubic);
+
+  Renderer::Clear fluidClear({-1.0f, 0.0f, 0.0f, 0.0f});
+  world.RecordLiquidPhi({fluidClear}).Submit();
+
+  Renderer::Rectangle velocity(*device, size);
+  velocity.Colour = {-10.0f, -10.0f, 0.0f, 0.0f};
+
+  world.RecordVelocity({velocity}, Fluid::VelocityOp::Set).Submit();
+
+  auto params = Fluid::IterativeParams(1e-5f);
+  world.Step(params);
+
+  device->Handle().waitIdle();
+
+  float value = 10.0f / size.x;
+  std::vector<glm::vec2> velocityData(size.x * size.y, {-value, -value});
+
+  CheckVelocity(*device, size, world.GetVelocity(), velocityData);
+}
+
+TEST(WorldTests, MatrixFreeVelocity)
+{
+  float dt = 0.01f;
+  glm::vec2 size(256.0f, 256.0f);
+
+  Fluid::SmokeWorld world(*device,
+                          size,
+                          dt,
+                          Fluid::Velocity::InterpolationMode::Cubic,
+                          Fluid::LinearSolver::Matrix::Free);
+
+  Renderer::Clear fluidClear({-1.0f, 0.0f, 0.0f, 0.0f});
+  world.RecordLiquidPhi({fluidClear}).Submit();
+
+  Renderer::Rectangle velocity(*device, size);
+  velocity.Colour = {-10.0f, -10.0f, 0.0f, 0.0f};
+
+  world.RecordVelocity({velocity}, Fluid::VelocityOp::Set).Submit();
+
+  auto params = Fluid::IterativeParams(1e-5f);
+  world.Step(params);
+
+  device->Handle().waitIdle();
+
+  float value = 10.0f / size.x;
+  std::vector<glm::vec2> velocityData(size.x * size.y, {-value, -value});
+
+  CheckVelocity(*device, size, world.GetVelocity(), velocityData);
+}
+
+TEST(WorldTests, BatchSubmit)
+{
+  float dt = 0.01f;
+  glm::vec2 size(256.0f, 256.0f);
+
+  Fluid::SmokeWorld world(*device, size, dt, Fluid::Velocity::InterpolationMode::Cubic);
+  world.SetBatchSubmit(true);
+
+  Renderer::Clear fluidClear({-1.0f, 0.0f, 0.0f, 0.0f});
+  world.RecordLiquidPhi({fluidClear}).Submit();
+
+  Renderer::Rectangle velocity(*device, size);
+  velocity.Colour = {-10.0f, -10.0f, 0.0f, 0.0f};
+
+  world.RecordVelocity({velocity}, Fluid::VelocityOp::Set).Submit();
+
+  auto params = Fluid::IterativeParams(1e-5f);
+  world.Step(params);
+
+  device->Handle().waitIdle();
+
+  float value = 10.0f / size.x;
+  std::vector<glm::vec2> velocityData(size.x * size.y, {-value, -value});
+
+  CheckVelocity(*device, size, world.GetVelocity(), velocityData);
+}
+
+TEST(WorldTests, RigidbodyOutlivesWorld)
+{
+  float dt = 0.01f;
+  glm::vec2 size(64.0f, 64.0f);
+
+  Fluid::Rectangle rectangle(*device, {8.0f, 8.0f});
+  Fluid::RigidBody rigidbody(*device, size, rectangle, Fluid::RigidBody::Type::eWeak);
+  rigidbody.SetMassData(1.0f, 1.0f);
+
+  {
+    Fluid::SmokeWorld world(*device, size, dt, Fluid::Velocity::InterpolationMode::Linear);
+    world.AddRigidbody(rigidbody);
+
+    // pending upload in the world's staging ring
+    rigidbody.SetVelocities({1.0f, 0.0f}, 0.0f);
+  }
+
+  // the staging ring is gone, the velocities are uploaded directly
+  rigidbody.SetVelocities({2.0f, 0.0f}, 0.0f);
+  device->Handle().waitIdle();
+}
+
+TEST(WorldTests, StepAsync)
+{
+  float dt = 0.01f;
+  glm::vec2 size(256.0f, 256.0f);
+
+  Fluid::SmokeWorld world(*device, size, dt, Fluid::Velocity::InterpolationMode::Cubic);
+
+  Renderer::Clear fluidClear({-1.0f, 0.0f, 0.0f, 0.0f});
+  world.RecordLiquidPhi({fluidClear}).Submit();
+
+  Renderer::Rectangle velocity(*device, size);
+  velocity.Colour = {-10.0f, -10.0f, 0.0f, 0.0f};
+
+  world.RecordVelocity({velocity}, Fluid::VelocityOp::Set).Submit();
+
+  // the convergence of the iterative solver is checked on the GPU
+  auto iterativeParams = Fluid::IterativeParams(1e-5f);
+  iterativeParams.WarmStart = true;
+  world.StepAsync(iterativeParams).Wait();
+
+  auto params = Fluid::FixedParams(100);
+  auto handle = world.StepAsync(params);
+  handle.Wait();
+
+  EXPECT_TRUE(handle.Ready());
+
+  float value = 10.0f / size.x;
+  EXPECT_NEAR(1.0f / (value * size.x), handle.GetCFL(), 1e-3f);
+
+  std::vector<glm::vec2> velocityData(size.x * size.y, {-value, -value});
+  CheckVelocity(*device, size, world.GetVelocity(), velocityData);
+}
+
+TEST(WorldTests, Probe)
+{
+  float dt = 0.01f;
+  glm::vec2 size(256.0f, 256.0f);
+
+  Fluid::SmokeWorld world(*device, size, dt, Fluid::Velocity::InterpolationMode::Cubic);
+
+  Renderer::Clear fluidClear({-1.0f, 0.0f, 0.0f, 0.0f});
+  world.RecordLiquidPhi({fluidClear}).Submit();
+
+  Renderer::Rectangle velocity(*device, size);
+  velocity.Colour = {-10.0f, -10.0f, 0.0f, 0.0f};
+
+  world.RecordVelocity({velocity}, Fluid::VelocityOp::Set).Submit();
+
+  Fluid::Density density(*device, size, vk::Format::eR8G8B8A8Unorm);
+  Renderer::Clear densityClear({0.5f, 0.25f, 1.0f, 1.0f});
+  density.Record({densityClear}).Submit();
+
+  auto params = Fluid::IterativeParams(1e-5f);
+  world.Step(params);
+
+  std::vector<glm::vec2> positions = {{10.0f, 10.0f}, {100.5f, 20.25f}, {200.75f, 128.5f}};
+  Renderer::Buffer<glm::vec2> localPositions(
+      *device, positions.size(), VMA_MEMORY_USAGE_CPU_ONLY);
+  Renderer::Buffer<glm::vec2> probePositions(*device, positions.size());
+
+  Renderer::CopyFrom(localPositions, positions);
+  device->Execute([&](vk::CommandBuffer commandBuffer) {
+    probePositions.CopyFrom(commandBuffer, localPositions);
+  });
+
+  Fluid::Probe probe(*device, size, probePositions);
+  world.BindProbe(probe);
+  probe.BindTexture(density);
+  probe.Submit();
+
+  std::vector<Fluid::Probe::Sample> samples(positions.size());
+  probe.Get(samples);
+
+  std::vector<glm::vec4> densitySamples(positions.size());
+  probe.GetTexture(densitySamples);
+
+  for (std::size_t i = 0; i < positions.size(); i++)
+  {
+    EXPECT_NEAR(-10.0f, samples[i].Velocity.x, 1e-3f);
+    EXPECT_NEAR(-10.0f, samples[i].Velocity.y, 1e-3f);
+    EXPECT_NEAR(-1.0f, samples[i].LiquidPhi, 1e-5f);
+
+    EXPECT_NEAR(0.5f, densitySamples[i].x, 1e-2f);
+    EXPECT_NEAR(0.25f, densitySamples[i].y, 1e-2f);
+    EXPECT_NEAR(1.0f, densitySamples[i].z, 1e-2f);
+  }
+}
+
+TEST(WorldTests, Tiles)
+{
+  float dt = 0.01f;
+  glm::vec2 size(256.0f, 256.0f);
+
+  Fluid::SmokeWorld world(*device, size, dt, Fluid::Velocity::InterpolationMode::Cubic);
+  world.EnableTiles();
+  EXPECT_THROW(world.EnableTiles(), std::runtime_error);
+
+  Renderer::Clear fluidClear({-1.0f, 0.0f, 0.0f, 0.0f});
+  world.RecordLiquidPhi({fluidClear}).Submit();
+
+  Renderer::Rectangle velocity(*device, size);
+  velocity.Colour = {-10.0f, -10.0f, 0.0f, 0.0f};
+
+  world.RecordVelocity({velocity}, Fluid::VelocityOp::Set).Submit();
+
+  auto params = Fluid::IterativeParams(1e-5f);
+  world.Step(params);
+
+  device->Handle().waitIdle();
+
+  float value = 10.0f / size.x;
+  std::vector<glm::vec2> velocityData(size.x * size.y, {-value, -value});
+
+  CheckVelocity(*device, size, world.GetVelocity(), velocityData);
+}
+
+std::vector<glm::vec2> WaterPoolVelocity(const glm::ivec2& size, bool tiled)
+{
+  float dt = 0.01f;
+
+  Fluid::WaterWorld world(*device, size, dt, 1, Fluid::Velocity::InterpolationMode::Linear);
+  if (tiled)
+  {
+    world.EnableTiles();
+  }
+
+  // a pool at the bottom left, the rest of the grid is empty
+  Renderer::IntRectangle fluid(*device, glm::vec2(64.0f, 32.0f));
+  fluid.Position = glm::vec2(8.0f, size.y - 40.0f);
+  fluid.Colour = glm::vec4(4);
+  world.RecordParticleCount({fluid}).Submit().Wait();
+
+  Fluid::Rectangle area(*device, glm::vec2(size) - glm::vec2(6.0f), true, 5.0f);
+  area.Position = glm::vec2(3.0f);
+  world.RecordStaticSolidPhi({area}).Submit().Wait();
+
+  Renderer::Rectangle gravity(*device, size);
+  gravity.Colour = {0.0f, 3.0f, 0.0f, 0.0f};
+  auto velocityRender = world.RecordVelocity({gravity}, Fluid::VelocityOp::Add);
+
+  auto params = Fluid::IterativeParams(1e-5f);
+  for (int i = 0; i < 5; i++)
+  {
+    world.SubmitVelocity(velocityRender);
+    world.Step(params);
+  }
+
+  device->Handle().waitIdle();
+
+  Renderer::Texture output(
+      *device, size.x, size.y, vk::Format::eR32G32Sfloat, VMA_MEMORY_USAGE_CPU_ONLY);
+  device->Execute([&](vk::CommandBuffer commandBuffer) {
+    output.CopyFrom(commandBuffer, world.GetVelocity());
+  });
+
+  std::vector<glm::vec2> pixels(size.x * size.y);
+  output.CopyTo(pixels);
+  return pixels;
+}
+
+TEST(WorldTests, TiledWaterPool)
+{
+  glm::ivec2 size(256);
+
+  auto velocity = WaterPoolVelocity(size, false);
+  auto tiledVelocity = WaterPoolVelocity(size, true);
+
+  // the particles are seeded randomly, compare away from the surface
+  for (int i = 16; i < 64; i++)
+  {
+    for (int j = size.y - 32; j < size.y - 16; j++)
+    {
+      auto uv = velocity[i + j * size.x];
+      auto tiledUv = tiledVelocity[i + j * size.x];
+      EXPECT_NEAR(uv.x, tiledUv.x, 1e-3f) << "Mismatch at " << i << "," << j;
+      EXPECT_NEAR(uv.y, tiledUv.y, 1e-3f) << "Mismatch at " << i << "," << j;
+    }
+  }
+}
+
+TEST(TilesTests, ActiveCount)
+{
+  glm::ivec2 size(256);
+
+  Fluid::LevelSet liquidPhi(*device, size);
+  Fluid::LevelSet solidPhi(*device, size);
+
+  // one tile in width and two in height
+  Fluid::Tiles tiles(*device, size, 8);
+  tiles.Bind(liquidPhi, solidPhi);
+
+  auto tileSize = Fluid::Tiles::GetTileSize();
+  auto tileCount = (size + tileSize - glm::ivec2(1)) / tileSize;
+  ASSERT_EQ(tileCount.x * tileCount.y, tiles.GetCount());
+  EXPECT_EQ(tiles.GetCount(), tiles.GetActiveCount());
+
+  Renderer::Clear liquidClear({1.0f, 0.0f, 0.0f, 0.0f});
+  Renderer::Rectangle liquid(*device, glm::vec2(20.0f));
+  liquid.Position = glm::vec2(100.0f);
+  liquid.Colour = glm::vec4(-1.0f);
+  liquidPhi.Record({liquidClear, liquid}).Submit();
+
+  Renderer::Clear solidClear({10000.0f, 0.0f, 0.0f, 0.0f});
+  solidPhi.Record({solidClear}).Submit();
+
+  tiles.Update();
+
+  glm::ivec2 begin = glm::ivec2(100) / tileSize - glm::ivec2(1, 2);
+  glm::ivec2 end = glm::ivec2(119) / tileSize + glm::ivec2(1, 2);
+  glm::ivec2 active = glm::min(end, tileCount - glm::ivec2(1)) - glm::max(begin, glm::ivec2(0));
+  EXPECT_EQ((active.x + 1) * (active.y + 1), tiles.GetActiveCount());
+
+  // the liquid deep inside a solid is not active
+  Renderer::Clear deepSolidClear({-10.0f, 0.0f, 0.0f, 0.0f});
+  solidPhi.Record({deepSolidClear}).Submit();
+
+  tiles.Update();
+
+  EXPECT_EQ(0, tiles.GetActiveCount());
+}
+
 TEST(CflTets, Max)
 {
   glm::ivec2 size(50);
@@ -4,11 +4,18 @@
 //
 
 #include <gtest/gtest.h>
+#include <cstring>
 #include <fstream>
+#include <future>
+#include <sstream>
 
 #include <Vortex2D/Renderer/CommandBuffer.h>
 #include <Vortex2D/Renderer/DescriptorSet.h>
 #include <Vortex2D/Renderer/Pipeline.h>
+#include <Vortex2D/Renderer/Profiler.h>
+#include <Vortex2D/Renderer/StagingRing.h>
+#include <Vortex2D/Renderer/TextureReadback.h>
+#include <Vortex2D/Renderer/ThreadPool.h>
 #include <Vortex2D/Renderer/Timer.h>
 #include <Vortex2D/Renderer/Work.h>
 #include <Vortex2D/SPIRV/Reflection.h>
@@ -49,6 +56,98 @@ TEST(ComputeTests, BufferCopy)
   CheckBuffer(data, outBuffer);
 }
 
+TEST(ComputeTests, SubmitBatch)
+{
+  std::vector<float> data(100, 23.4f);
+  Buffer<float> buffer(*device, data.size());
+  Buffer<float> inBuffer(*device, data.size(), VMA_MEMORY_USAGE_CPU_ONLY);
+  Buffer<float> outBuffer(*device, data.size(), VMA_MEMORY_USAGE_CPU_ONLY);
+
+  CopyFrom(inBuffer, data);
+
+  CommandBuffer firstCopy(*device, false);
+  firstCopy.Record(
+      [&](vk::CommandBuffer commandBuffer) { buffer.CopyFrom(commandBuffer, inBuffer); });
+
+  CommandBuffer secondCopy(*device, false);
+  secondCopy.Record(
+      [&](vk::CommandBuffer commandBuffer) { outBuffer.CopyFrom(commandBuffer, buffer); });
+
+  CommandBuffer wait(*device, true);
+  wait.Record([&](vk::CommandBuffer commandBuffer) { outBuffer.Clear(commandBuffer); });
+
+  {
+    SubmitBatch submitBatch(*device);
+    firstCopy.Submit();
+    secondCopy.Submit();
+  }
+
+  device->Handle().waitIdle();
+  CheckBuffer(data, outBuffer);
+
+  // a synchronised command buffer is batched too, waiting on it submits the
+  // batch
+  {
+    SubmitBatch submitBatch(*device);
+    secondCopy.Submit();
+    wait.Submit().Wait();
+  }
+
+  CheckBuffer(std::vector<float>(data.size(), 0.0f), outBuffer);
+
+  // and it stays in order with the command buffers submitted after it
+  {
+    SubmitBatch submitBatch(*device);
+    wait.Submit();
+    secondCopy.Submit();
+  }
+
+  device->Handle().waitIdle();
+  CheckBuffer(data, outBuffer);
+}
+
+TEST(ComputeTests, FindQueueFamily)
+{
+  std::vector<vk::QueueFamilyProperties> familyProperties(3);
+  familyProperties[0].queueFlags =
+      vk::QueueFlagBits::eGraphics | vk::QueueFlagBits::eCompute | vk::QueueFlagBits::eTransfer;
+  familyProperties[1].queueFlags = vk::QueueFlagBits::eCompute | vk::QueueFlagBits::eTransfer;
+  familyProperties[2].queueFlags = vk::QueueFlagBits::eTransfer;
+
+  EXPECT_EQ(0, FindQueueFamily(familyProperties, vk::QueueFlagBits::eGraphics));
+  EXPECT_EQ(1,
+            FindQueueFamily(
+                familyProperties, vk::QueueFlagBits::eCompute, vk::QueueFlagBits::eGraphics));
+  EXPECT_EQ(2,
+            FindQueueFamily(familyProperties,
+                            vk::QueueFlagBits::eTransfer,
+                            vk::QueueFlagBits::eGraphics | vk::QueueFlagBits::eCompute));
+  EXPECT_EQ(-1,
+            FindQueueFamily(
+                familyProperties, vk::QueueFlagBits::eSparseBinding, vk::QueueFlagBits::eCompute));
+}
+
+TEST(ComputeTests, TransferQueue)
+{
+  std::vector<float> data(100, 23.4f);
+  Buffer<float> inBuffer(*device, data.size(), VMA_MEMORY_USAGE_CPU_ONLY);
+  Buffer<float> outBuffer(*device, data.size(), VMA_MEMORY_USAGE_CPU_ONLY);
+
+  CopyFrom(inBuffer, data);
+
+  // the buffers are only used on the transfer queue, so they need no
+  // ownership transfer
+  CommandBuffer copy(*device, true, QueueType::Transfer);
+  copy.Record([&](vk::CommandBuffer commandBuffer) {
+    auto region = vk::BufferCopy().setSize(data.size() * sizeof(float));
+    commandBuffer.copyBuffer(inBuffer.Handle(), outBuffer.Handle(), region);
+  });
+
+  copy.Submit().Wait();
+
+  CheckBuffer(data, outBuffer);
+}
+
 TEST(ComputeTests, UpdateVectorBuffer)
 {
   int size = 3;
@@ -67,6 +166,70 @@ TEST(ComputeTests, UpdateVectorBuffer)
   EXPECT_EQ(outData, data);
 }
 
+TEST(ComputeTests, StagingRing)
+{
+  Buffer<float> buffer(*device, 4);
+  UniformBuffer<glm::vec2> uniform(*device);
+  Buffer<float> outBuffer(*device, 4, VMA_MEMORY_USAGE_CPU_ONLY);
+  UniformBuffer<glm::vec2> outUniform(*device, VMA_MEMORY_USAGE_CPU_ONLY);
+
+  StagingRing stagingRing(*device, 64);
+
+  std::vector<float> data = {1.0f, 2.0f, 3.0f, 4.0f};
+  stagingRing.Upload(buffer, data.data(), 2 * sizeof(float));
+  stagingRing.Upload(buffer, &data[2], 2 * sizeof(float), 2 * sizeof(float));
+
+  // the second upload of the same range replaces the first
+  stagingRing.Upload(uniform, glm::vec2(5.0f, 6.0f));
+  stagingRing.Upload(uniform, glm::vec2(7.0f, 8.0f));
+
+  EXPECT_EQ(40u, stagingRing.GetUsedSize());
+  EXPECT_THROW(stagingRing.Upload(buffer, data.data(), 3 * sizeof(float)), std::runtime_error);
+
+  stagingRing.Submit();
+
+  EXPECT_EQ(1u, stagingRing.GetFrameIndex());
+  EXPECT_EQ(0u, stagingRing.GetUsedSize());
+
+  device->Execute([&](vk::CommandBuffer commandBuffer) {
+    outBuffer.CopyFrom(commandBuffer, buffer);
+    outUniform.CopyFrom(commandBuffer, uniform);
+  });
+
+  CheckBuffer(data, outBuffer);
+
+  glm::vec2 outData;
+  CopyTo(outUniform, outData);
+  EXPECT_EQ(glm::vec2(7.0f, 8.0f), outData);
+}
+
+TEST(ComputeTests, StagingRingFull)
+{
+  Buffer<float> buffer(*device, 16);
+  Buffer<float> outBuffer(*device, 16, VMA_MEMORY_USAGE_CPU_ONLY);
+
+  // each frame holds two aligned uploads, the frame is submitted when full
+  StagingRing stagingRing(*device, 32, 3);
+
+  std::vector<float> data(16);
+  for (int i = 0; i < 16; i++)
+  {
+    data[i] = static_cast<float>(i);
+    stagingRing.Upload(buffer, &data[i], sizeof(float), i * sizeof(float));
+  }
+
+  EXPECT_EQ(1u, stagingRing.GetFrameIndex());
+
+  stagingRing.Submit();
+
+  device->Execute(
+      [&](vk::CommandBuffer commandBuffer) { outBuffer.CopyFrom(commandBuffer, buffer); });
+
+  CheckBuffer(data, outBuffer);
+
+  EXPECT_THROW(stagingRing.Upload(buffer, data.data(), 64), std::runtime_error);
+}
+
 struct Particle
 {
   alignas(8) glm::vec2 position;
@@ -161,6 +324,83 @@ TEST(ComputeTests, ImageCompute)
   CheckTexture(doubleData, stagingTexture);
 }
 
+TEST(ComputeTests, TextureRegionCopy)
+{
+  Texture stagingTexture(*device, 16, 16, vk::Format::eR32Sfloat, VMA_MEMORY_USAGE_CPU_ONLY);
+  Texture texture(*device, 16, 16, vk::Format::eR32Sfloat);
+  Buffer<float> region(*device, 4 * 3, VMA_MEMORY_USAGE_GPU_TO_CPU);
+
+  std::vector<float> data(16 * 16);
+  for (std::size_t i = 0; i < data.size(); i++)
+  {
+    data[i] = static_cast<float>(i);
+  }
+
+  stagingTexture.CopyFrom(data);
+
+  device->Execute([&](vk::CommandBuffer commandBuffer) {
+    texture.CopyFrom(commandBuffer, stagingTexture);
+    region.CopyFrom(commandBuffer, texture, {2, 5}, {4, 3});
+  });
+
+  std::vector<float> expectedData;
+  for (int j = 0; j < 3; j++)
+  {
+    for (int i = 0; i < 4; i++)
+    {
+      expectedData.push_back(data[(j + 5) * 16 + i + 2]);
+    }
+  }
+
+  std::vector<float> regionData(4 * 3);
+  CopyTo(region, regionData);
+
+  EXPECT_EQ(expectedData, regionData);
+}
+
+TEST(ComputeTests, TextureReadback)
+{
+  Texture stagingTexture(*device, 16, 16, vk::Format::eR32Sfloat, VMA_MEMORY_USAGE_CPU_ONLY);
+  Texture texture(*device, 16, 16, vk::Format::eR32Sfloat);
+
+  std::vector<uint64_t> frames;
+  std::vector<std::vector<float>> frameData;
+  TextureReadback readback(
+      *device,
+      texture,
+      [&](uint64_t frame, const std::vector<uint8_t>& data) {
+        std::vector<float> pixels(16 * 16);
+        ASSERT_EQ(pixels.size() * sizeof(float), data.size());
+        std::memcpy(pixels.data(), data.data(), data.size());
+
+        frames.push_back(frame);
+        frameData.push_back(pixels);
+      },
+      2);
+
+  for (int i = 0; i < 5; i++)
+  {
+    std::vector<float> data(16 * 16, static_cast<float>(i));
+    stagingTexture.CopyFrom(data);
+
+    device->Execute(
+        [&](vk::CommandBuffer commandBuffer) { texture.CopyFrom(commandBuffer, stagingTexture); });
+
+    EXPECT_EQ(static_cast<uint64_t>(i), readback.Submit());
+    EXPECT_LE(readback.GetPendingCount(), 2u);
+  }
+
+  readback.Flush();
+  EXPECT_EQ(0u, readback.GetPendingCount());
+
+  ASSERT_EQ(5u, frames.size());
+  for (int i = 0; i < 5; i++)
+  {
+    EXPECT_EQ(static_cast<uint64_t>(i), frames[i]);
+    EXPECT_EQ(std::vector<float>(16 * 16, static_cast<float>(i)), frameData[i]);
+  }
+}
+
 TEST(ComputeTests, Work)
 {
   Buffer<float> buffer(*device, 16 * 16, VMA_MEMORY_USAGE_CPU_ONLY);
@@ -189,6 +429,114 @@ TEST(ComputeTests, Work)
   CheckBuffer(expectedOutput, buffer);
 }
 
+std::vector<float> CheckerboardOutput(int size)
+{
+  std::vector<float> expectedOutput(size * size);
+  for (int i = 0; i < size; i++)
+  {
+    for (int j = 0; j < size; j++)
+    {
+      expectedOutput[i + j * size] = (i + j) % 2 == 0 ? 1.0f : 0.0f;
+    }
+  }
+
+  return expectedOutput;
+}
+
+TEST(ComputeTests, DeferredWork)
+{
+  Buffer<float> buffer(*device, 16 * 16, VMA_MEMORY_USAGE_CPU_ONLY);
+  Work work(*device,
+            ComputeSize(glm::ivec2(16), glm::ivec2(8)),
+            Work_comp,
+            SpecConst(SpecConstValue(3, 1)),
+            true);
+
+  auto boundWork = work.Bind({buffer});
+  auto created = device->GetPipelineCache().GetStatistics().Created;
+
+  device->Execute([&](vk::CommandBuffer commandBuffer) { boundWork.Record(commandBuffer); });
+
+  EXPECT_EQ(created + 1, device->GetPipelineCache().GetStatistics().Created);
+  CheckBuffer(CheckerboardOutput(16), buffer);
+}
+
+TEST(ComputeTests, PipelinePrewarm)
+{
+  std::vector<std::unique_ptr<Work>> works;
+
+  {
+    PipelinePrewarm prewarm(*device, 4);
+    for (int i = 0; i < 4; i++)
+    {
+      works.push_back(std::make_unique<Work>(*device,
+                                             ComputeSize(glm::ivec2(16), glm::ivec2(2 << i, 2)),
+                                             Work_comp,
+                                             SpecConst(SpecConstValue(3, 1))));
+    }
+
+    prewarm.Wait();
+  }
+
+  for (auto& work : works)
+  {
+    Buffer<float> buffer(*device, 16 * 16, VMA_MEMORY_USAGE_CPU_ONLY);
+    auto boundWork = work->Bind({buffer});
+
+    device->Execute([&](vk::CommandBuffer commandBuffer) { boundWork.Record(commandBuffer); });
+
+    CheckBuffer(CheckerboardOutput(16), buffer);
+  }
+}
+
+TEST(ComputeTests, ParallelPipelines)
+{
+  auto shader = device->GetShaderModule(Work_comp);
+  Reflection reflection(Work_comp);
+
+  PipelineLayout layout = {{reflection}};
+  vk::PipelineLayout pipelineLayout = device->GetLayoutManager().GetPipelineLayout(layout);
+
+  std::vector<std::future<vk::Pipeline>> pipelines;
+  for (int i = 0; i < 8; i++)
+  {
+    pipelines.push_back(std::async(std::launch::async, [&, i] {
+      return device->GetPipelineCache().CreateComputePipeline(
+          shader, pipelineLayout, SpecConst(SpecConstValue(1, 8), SpecConstValue(3, i % 2)));
+    }));
+  }
+
+  std::vector<vk::Pipeline> results;
+  for (auto& pipeline : pipelines)
+  {
+    results.push_back(pipeline.get());
+  }
+
+  for (int i = 2; i < 8; i++)
+  {
+    EXPECT_EQ(results[i % 2], results[i]);
+  }
+
+  EXPECT_NE(results[0], results[1]);
+}
+
+TEST(ComputeTests, ThreadPool)
+{
+  ThreadPool threadPool(4);
+  EXPECT_EQ(4u, threadPool.GetThreadCount());
+
+  std::vector<std::future<int>> results;
+  for (int i = 0; i < 100; i++)
+  {
+    results.push_back(threadPool.Enqueue([i] { return i * i; }));
+  }
+
+  for (int i = 0; i < 100; i++)
+  {
+    EXPECT_EQ(i * i, results[i].get());
+  }
+}
+
 TEST(ComputeTests, WorkIndirect)
 {
   glm::ivec2 size(16, 1);
@@ -403,6 +751,99 @@ TEST(ComputeTests, Timer)
   std::cout << "Elapsed time: " << time << std::endl;
 }
 
+TEST(ComputeTests, Profiler)
+{
+  auto properties = device->GetPhysicalDevice().getProperties();
+  if (!properties.limits.timestampComputeAndGraphics)
+  {
+    return;
+  }
+
+  auto queries = device->GetScopeQueries();
+  ASSERT_NE(nullptr, queries);
+
+  glm::ivec2 size(500);
+
+  Buffer<float> buffer(*device, size.x * size.y);
+  Work work(*device, size, Work_comp);
+
+  // the scopes are timed by the device, the command buffer is recorded before
+  // any profiler exists
+  queries->SetDispatchScopes(true);
+
+  auto boundWork = work.Bind({buffer});
+
+  CommandBuffer cmd(*device);
+  cmd.Record([&](vk::CommandBuffer commandBuffer) {
+    BeginMarker(*device, commandBuffer, {"Outer", {{1.0f, 0.0f, 0.0f, 1.0f}}});
+    boundWork.Record(commandBuffer);
+    buffer.Barrier(
+        commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+    BeginMarker(*device, commandBuffer, {"Inner", {{0.0f, 1.0f, 0.0f, 1.0f}}});
+    boundWork.Record(commandBuffer);
+    EndMarker(*device, commandBuffer);
+    EndMarker(*device, commandBuffer);
+  });
+
+  queries->SetDispatchScopes(false);
+
+  // the recorded commands stay valid once a profiler is destroyed
+  {
+    Profiler profiler(*device, 2);
+    ASSERT_EQ(&profiler, device->GetProfiler());
+    EXPECT_THROW(Profiler(*device, 2), std::runtime_error);
+
+    profiler.BeginFrame("Frame");
+    cmd.Submit();
+    profiler.EndFrame();
+  }
+
+  ASSERT_EQ(nullptr, device->GetProfiler());
+  cmd.Submit().Wait();
+
+  Profiler profiler(*device, 2);
+  for (int i = 0; i < 4; i++)
+  {
+    profiler.BeginFrame("Frame");
+    cmd.Submit();
+    profiler.EndFrame();
+  }
+
+  profiler.Flush();
+
+  auto& frames = profiler.GetFrames();
+  ASSERT_EQ(4u, frames.size());
+  for (uint64_t i = 0; i < frames.size(); i++)
+  {
+    auto& frame = frames[i];
+    EXPECT_EQ("Frame", frame.Name);
+    EXPECT_EQ(i, frame.Index);
+    EXPECT_LE(frame.BeginNs, frame.EndNs);
+
+    std::vector<std::string> names;
+    for (auto& scope : frame.Scopes)
+    {
+      names.push_back(scope.Name);
+      EXPECT_LE(frame.BeginNs, scope.BeginNs);
+      EXPECT_LE(scope.BeginNs, scope.EndNs);
+      EXPECT_LE(scope.EndNs, frame.EndNs);
+    }
+
+    std::vector<std::string> expectedNames = {
+        "Outer", "Outer/Dispatch 0", "Outer/Inner", "Outer/Inner/Dispatch 0"};
+    EXPECT_EQ(expectedNames, names);
+  }
+
+  std::stringstream trace;
+  profiler.WriteTrace(trace);
+  EXPECT_EQ(0u, trace.str().find("{\"traceEvents\":["));
+  EXPECT_NE(std::string::npos, trace.str().find("\"name\":\"Inner\""));
+  EXPECT_NE(std::string::npos, trace.str().find("\"cat\":\"Outer/Inner/Dispatch 0\""));
+
+  profiler.ClearFrames();
+  EXPECT_TRUE(profiler.GetFrames().empty());
+}
+
 TEST(ComputeTests, Reflection)
 {
   Reflection spirv1(Stencil_comp);
@@ -456,3 +897,50 @@ TEST(ComputeTests, Cache)
   EXPECT_EQ(pipelineLayout2, device->GetLayoutManager().GetPipelineLayout(layout2));
   EXPECT_EQ(pipeline2, device->GetPipelineCache().CreateComputePipeline(shader2, pipelineLayout2));
 }
+
+TEST(ComputeTests, PipelineCacheHeader)
+{
+  auto properties = device->GetPhysicalDevice().getProperties();
+
+  uint32_t header[4] = {static_cast<uint32_t>(4 * sizeof(uint32_t) + VK_UUID_SIZE),
+                        static_cast<uint32_t>(vk::PipelineCacheHeaderVersion::eOne),
+                        properties.vendorID,
+                        properties.deviceID};
+
+  std::vector<char> data(sizeof(header) + VK_UUID_SIZE);
+  std::memcpy(data.data(), header, sizeof(header));
+  std::memcpy(data.data() + sizeof(header), properties.pipelineCacheUUID, VK_UUID_SIZE);
+
+  EXPECT_TRUE(IsPipelineCacheCompatible(data, properties));
+  EXPECT_FALSE(IsPipelineCacheCompatible({}, properties));
+  EXPECT_FALSE(
+      IsPipelineCacheCompatible(std::vector<char>(data.begin(), data.end() - 1), properties));
+
+  auto otherDevice = properties;
+  otherDevice.deviceID++;
+  EXPECT_FALSE(IsPipelineCacheCompatible(data, otherDevice));
+
+  auto otherDriver = properties;
+  otherDriver.pipelineCacheUUID[0]++;
+  EXPECT_FALSE(IsPipelineCacheCompatible(data, otherDriver));
+}
+
+TEST(ComputeTests, PipelineCacheFile)
+{
+  auto shader = device->GetShaderModule(Buffer_comp);
+  Reflection reflection(Buffer_comp);
+
+  PipelineLayout layout = {{reflection}};
+  vk::PipelineLayout pipelineLayout = device->GetLayoutManager().GetPipelineLayout(layout);
+  device->GetPipelineCache().CreateComputePipeline(shader, pipelineLayout);
+
+  EXPECT_GT(device->GetPipelineCache().GetStatistics().Created, 0u);
+
+  device->GetPipelineCache().Save("pipeline_cache.bin");
+
+  std::ifstream is("pipeline_cache.bin", std::ios::binary);
+  std::vector<char> data((std::istreambuf_iterator<char>(is)), std::istreambuf_iterator<char>());
+
+  EXPECT_TRUE(IsPipelineCacheCompatible(data, device->GetPhysicalDevice().getProperties()));
+  EXPECT_THROW(device->GetPipelineCache().Save(), std::runtime_error);
+}
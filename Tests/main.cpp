@@ -28,7 +28,7 @@ int main(int argc, char** argv)
 #endif
 
   Vortex2D::Renderer::Instance instance("Tests", {}, debug);
-  Vortex2D::Renderer::Device device_(instance);
+  Vortex2D::Renderer::Device device_(instance, true, {}, true);
 
   device = &device_;
 
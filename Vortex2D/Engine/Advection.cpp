@@ -6,7 +6,9 @@
 #include "Advection.h"
 
 #include <Vortex2D/Engine/Density.h>
+#include <Vortex2D/Engine/Tiles.h>
 #include <Vortex2D/Renderer/Pipeline.h>
+#include <Vortex2D/Renderer/Profiler.h>
 
 #include "vortex2d_generated_spirv.h"
 
@@ -23,12 +25,26 @@ Advection::Advection(const Renderer::Device& device,
     , mDt(dt)
     , mSize(size)
     , mVelocity(velocity)
+    , mDensity(nullptr)
+    , mTiles(nullptr)
+    , mNoTiles(device)
     , mVelocityAdvect(device,
                       size,
                       SPIRV::AdvectVelocity_comp,
                       Renderer::SpecConst(Renderer::SpecConstValue(3, interpolationMode)))
-    , mVelocityAdvectBound(mVelocityAdvect.Bind({velocity, velocity.Output()}))
+    , mVelocityAdvectBound(mVelocityAdvect.Bind({velocity, velocity.Output(), mNoTiles}))
+    , mVelocityAdvectTiled(device,
+                           size,
+                           SPIRV::AdvectVelocity_comp,
+                           Renderer::SpecConst(Renderer::SpecConstValue(3, interpolationMode),
+                                               Renderer::SpecConstValue(10, 1)),
+                           true)
     , mAdvect(device, size, SPIRV::Advect_comp)
+    , mAdvectTiled(device,
+                   size,
+                   SPIRV::Advect_comp,
+                   Renderer::SpecConst(Renderer::SpecConstValue(10, 1)),
+                   true)
     , mAdvectParticles(device,
                        Renderer::ComputeSize::Default1D(),
                        SPIRV::AdvectParticles_comp,
@@ -37,14 +53,7 @@ Advection::Advection(const Renderer::Device& device,
     , mAdvectCmd(device, false)
     , mAdvectParticlesCmd(device, false)
 {
-  mAdvectVelocityCmd.Record([&](vk::CommandBuffer commandBuffer) {
-    commandBuffer.debugMarkerBeginEXT({"Velocity advect", {{0.15f, 0.46f, 0.19f, 1.0f}}},
-                                      mDevice.Loader());
-    mVelocityAdvectBound.PushConstant(commandBuffer, dt);
-    mVelocityAdvectBound.Record(commandBuffer);
-    velocity.CopyBack(commandBuffer);
-    commandBuffer.debugMarkerEndEXT(mDevice.Loader());
-  });
+  RecordAdvectVelocity();
 }
 
 void Advection::AdvectVelocity()
@@ -54,20 +63,16 @@ void Advection::AdvectVelocity()
 
 void Advection::AdvectBind(Density& density)
 {
-  mAdvectBound = mAdvect.Bind({mVelocity, density, density.mFieldBack});
-  mAdvectCmd.Record([&](vk::CommandBuffer commandBuffer) {
-    commandBuffer.debugMarkerBeginEXT({"Density advect", {{0.86f, 0.14f, 0.52f, 1.0f}}},
-                                      mDevice.Loader());
-    mAdvectBound.PushConstant(commandBuffer, mDt);
-    mAdvectBound.Record(commandBuffer);
-    density.mFieldBack.Barrier(commandBuffer,
-                               vk::ImageLayout::eGeneral,
-                               vk::AccessFlagBits::eShaderWrite,
-                               vk::ImageLayout::eGeneral,
-                               vk::AccessFlagBits::eShaderRead);
-    density.CopyFrom(commandBuffer, density.mFieldBack);
-    commandBuffer.debugMarkerEndEXT(mDevice.Loader());
-  });
+  mDensity = &density;
+  mAdvectBound = mAdvect.Bind({mVelocity, density, density.mFieldBack, mNoTiles});
+  if (mTiles)
+  {
+    mAdvectTiledBound =
+        mAdvectTiled.Bind({mVelocity, density, density.mFieldBack, mTiles->GetList()});
+    mAdvectCopyBackBound = mTiles->BindCopy(density.mFieldBack, density);
+  }
+
+  RecordAdvect();
 }
 
 void Advection::Advect()
@@ -78,6 +83,89 @@ void Advection::Advect()
   }
 }
 
+void Advection::TilesBind(Tiles& tiles)
+{
+  mTiles = &tiles;
+  mVelocityAdvectTiledBound =
+      mVelocityAdvectTiled.Bind({mVelocity, mVelocity.Output(), tiles.GetList()});
+  mVelocityCopyBackBound = tiles.BindCopy(mVelocity.Output(), mVelocity);
+  RecordAdvectVelocity();
+
+  if (mDensity)
+  {
+    AdvectBind(*mDensity);
+  }
+}
+
+void Advection::RecordAdvectVelocity()
+{
+  mAdvectVelocityCmd.Record([&](vk::CommandBuffer commandBuffer) {
+    Renderer::BeginMarker(
+        mDevice, commandBuffer, {"Velocity advect", {{0.15f, 0.46f, 0.19f, 1.0f}}});
+    if (mTiles)
+    {
+      // only the active tiles are written and copied back
+      mVelocityAdvectTiledBound.PushConstant(commandBuffer, mDt);
+      mVelocityAdvectTiledBound.RecordIndirect(commandBuffer, mTiles->GetDispatchParams());
+      mVelocity.Output().Barrier(commandBuffer,
+                                 vk::ImageLayout::eGeneral,
+                                 vk::AccessFlagBits::eShaderWrite,
+                                 vk::ImageLayout::eGeneral,
+                                 vk::AccessFlagBits::eShaderRead);
+      mTiles->RecordCopy(commandBuffer, mVelocityCopyBackBound);
+      mVelocity.Barrier(commandBuffer,
+                        vk::ImageLayout::eGeneral,
+                        vk::AccessFlagBits::eShaderWrite,
+                        vk::ImageLayout::eGeneral,
+                        vk::AccessFlagBits::eShaderRead);
+    }
+    else
+    {
+      mVelocityAdvectBound.PushConstant(commandBuffer, mDt);
+      mVelocityAdvectBound.Record(commandBuffer);
+      mVelocity.CopyBack(commandBuffer);
+    }
+    Renderer::EndMarker(mDevice, commandBuffer);
+  });
+}
+
+void Advection::RecordAdvect()
+{
+  mAdvectCmd.Record([&](vk::CommandBuffer commandBuffer) {
+    Renderer::BeginMarker(
+        mDevice, commandBuffer, {"Density advect", {{0.86f, 0.14f, 0.52f, 1.0f}}});
+    if (mTiles)
+    {
+      mAdvectTiledBound.PushConstant(commandBuffer, mDt);
+      mAdvectTiledBound.RecordIndirect(commandBuffer, mTiles->GetDispatchParams());
+    }
+    else
+    {
+      mAdvectBound.PushConstant(commandBuffer, mDt);
+      mAdvectBound.Record(commandBuffer);
+    }
+    mDensity->mFieldBack.Barrier(commandBuffer,
+                                 vk::ImageLayout::eGeneral,
+                                 vk::AccessFlagBits::eShaderWrite,
+                                 vk::ImageLayout::eGeneral,
+                                 vk::AccessFlagBits::eShaderRead);
+    if (mTiles)
+    {
+      mTiles->RecordCopy(commandBuffer, mAdvectCopyBackBound);
+      mDensity->Barrier(commandBuffer,
+                        vk::ImageLayout::eGeneral,
+                        vk::AccessFlagBits::eShaderWrite,
+                        vk::ImageLayout::eGeneral,
+                        vk::AccessFlagBits::eShaderRead);
+    }
+    else
+    {
+      mDensity->CopyFrom(commandBuffer, mDensity->mFieldBack);
+    }
+    Renderer::EndMarker(mDevice, commandBuffer);
+  });
+}
+
 void Advection::AdvectParticleBind(
     Renderer::GenericBuffer& particles,
     Renderer::Texture& levelSet,
@@ -86,13 +174,13 @@ void Advection::AdvectParticleBind(
   mAdvectParticlesBound =
       mAdvectParticles.Bind(mSize, {particles, dispatchParams, mVelocity, levelSet});
   mAdvectParticlesCmd.Record([&](vk::CommandBuffer commandBuffer) {
-    commandBuffer.debugMarkerBeginEXT({"Particle advect", {{0.09f, 0.17f, 0.36f, 1.0f}}},
-                                      mDevice.Loader());
+    Renderer::BeginMarker(
+        mDevice, commandBuffer, {"Particle advect", {{0.09f, 0.17f, 0.36f, 1.0f}}});
     mAdvectParticlesBound.PushConstant(commandBuffer, mDt);
     mAdvectParticlesBound.RecordIndirect(commandBuffer, dispatchParams);
     particles.Barrier(
         commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
-    commandBuffer.debugMarkerEndEXT(mDevice.Loader());
+    Renderer::EndMarker(mDevice, commandBuffer);
   });
 }
 
@@ -17,6 +17,7 @@ namespace Vortex2D
 namespace Fluid
 {
 class Density;
+class Tiles;
 
 /**
  * @brief Advects particles, velocity field or any field using a velocity field.
@@ -70,16 +71,37 @@ public:
    */
   VORTEX2D_API void AdvectParticles();
 
+  /**
+   * @brief Only advect the velocity and density field on the active tiles, the
+   * cells outside of them keep their values.
+   * @param tiles the active tiles
+   */
+  VORTEX2D_API void TilesBind(Tiles& tiles);
+
 private:
+  void RecordAdvectVelocity();
+  void RecordAdvect();
+
   const Renderer::Device& mDevice;
   float mDt;
   glm::ivec2 mSize;
   Velocity& mVelocity;
+  Density* mDensity;
+  Tiles* mTiles;
+
+  // bound in place of the tiles to the untiled works, which don't read them
+  Renderer::Buffer<glm::ivec2> mNoTiles;
 
   Renderer::Work mVelocityAdvect;
   Renderer::Work::Bound mVelocityAdvectBound;
+  Renderer::Work mVelocityAdvectTiled;
+  Renderer::Work::Bound mVelocityAdvectTiledBound;
   Renderer::Work mAdvect;
   Renderer::Work::Bound mAdvectBound;
+  Renderer::Work mAdvectTiled;
+  Renderer::Work::Bound mAdvectTiledBound;
+  Renderer::Work::Bound mVelocityCopyBackBound;
+  Renderer::Work::Bound mAdvectCopyBackBound;
   Renderer::Work mAdvectParticles;
   Renderer::Work::Bound mAdvectParticlesBound;
 
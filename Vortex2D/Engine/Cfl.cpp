@@ -5,6 +5,8 @@
 
 #include "Cfl.h"
 
+#include <Vortex2D/Renderer/Profiler.h>
+
 #include "vortex2d_generated_spirv.h"
 
 namespace Vortex2D
@@ -24,12 +26,12 @@ Cfl::Cfl(const Renderer::Device& device, const glm::ivec2& size, Velocity& veloc
   mVelocityMaxBound = mVelocityMaxWork.Bind({mVelocity, mVelocityMax});
   mReduceVelocityMaxBound = mReduceVelocityMax.Bind(mVelocityMax, mCfl);
   mVelocityMaxCmd.Record([&](vk::CommandBuffer commandBuffer) {
-    commandBuffer.debugMarkerBeginEXT({"CFL", {{0.65f, 0.97f, 0.78f, 1.0f}}}, mDevice.Loader());
+    Renderer::BeginMarker(mDevice, commandBuffer, {"CFL", {{0.65f, 0.97f, 0.78f, 1.0f}}});
 
     mVelocityMaxBound.Record(commandBuffer);
     mReduceVelocityMaxBound.Record(commandBuffer);
 
-    commandBuffer.debugMarkerEndEXT(mDevice.Loader());
+    Renderer::EndMarker(mDevice, commandBuffer);
   });
 }
 
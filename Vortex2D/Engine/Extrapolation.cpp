@@ -4,6 +4,9 @@
 
 #include "Extrapolation.h"
 
+#include <Vortex2D/Engine/Tiles.h>
+#include <Vortex2D/Renderer/Profiler.h>
+
 #include "vortex2d_generated_spirv.h"
 
 namespace Vortex2D
@@ -18,18 +21,25 @@ Extrapolation::Extrapolation(const Renderer::Device& device,
     : mDevice(device)
     , mValid(device, size.x * size.y)
     , mVelocity(velocity)
+    , mSolidPhi(nullptr)
+    , mTiles(nullptr)
+    , mNoTiles(device)
     , mExtrapolateVelocity(device, size, SPIRV::ExtrapolateVelocity_comp)
     , mExtrapolateVelocityBound(
           mExtrapolateVelocity.Bind({valid, mValid, velocity, velocity.Output()}))
     , mExtrapolateVelocityBackBound(
           mExtrapolateVelocity.Bind({mValid, valid, velocity.Output(), velocity}))
     , mConstrainVelocity(device, size, SPIRV::ConstrainVelocity_comp)
+    , mConstrainVelocityTiled(device,
+                              size,
+                              SPIRV::ConstrainVelocity_comp,
+                              Renderer::SpecConst(Renderer::SpecConstValue(10, 1)),
+                              true)
     , mExtrapolateCmd(device, false)
     , mConstrainCmd(device, false)
 {
   mExtrapolateCmd.Record([&, iterations](vk::CommandBuffer commandBuffer) {
-    commandBuffer.debugMarkerBeginEXT({"Extrapolate", {{0.60f, 0.87f, 0.12f, 1.0f}}},
-                                      mDevice.Loader());
+    Renderer::BeginMarker(mDevice, commandBuffer, {"Extrapolate", {{0.60f, 0.87f, 0.12f, 1.0f}}});
     for (int i = 0; i < iterations / 2; i++)
     {
       mExtrapolateVelocityBound.Record(commandBuffer);
@@ -49,7 +59,7 @@ Extrapolation::Extrapolation(const Renderer::Device& device,
       valid.Barrier(
           commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
     }
-    commandBuffer.debugMarkerEndEXT(mDevice.Loader());
+    Renderer::EndMarker(mDevice, commandBuffer);
   });
 }
 
@@ -60,15 +70,16 @@ void Extrapolation::Extrapolate()
 
 void Extrapolation::ConstrainBind(Renderer::Texture& solidPhi)
 {
-  mConstrainVelocityBound = mConstrainVelocity.Bind({solidPhi, mVelocity, mVelocity.Output()});
+  mSolidPhi = &solidPhi;
+  mConstrainVelocityBound =
+      mConstrainVelocity.Bind({solidPhi, mVelocity, mVelocity.Output(), mNoTiles});
+  if (mTiles)
+  {
+    mConstrainVelocityTiledBound =
+        mConstrainVelocityTiled.Bind({solidPhi, mVelocity, mVelocity.Output(), mTiles->GetList()});
+  }
 
-  mConstrainCmd.Record([&](vk::CommandBuffer commandBuffer) {
-    commandBuffer.debugMarkerBeginEXT({"Constrain Velocity", {{0.82f, 0.20f, 0.20f, 1.0f}}},
-                                      mDevice.Loader());
-    mConstrainVelocityBound.Record(commandBuffer);
-    mVelocity.CopyBack(commandBuffer);
-    commandBuffer.debugMarkerEndEXT(mDevice.Loader());
-  });
+  RecordConstrain();
 }
 
 void Extrapolation::ConstrainVelocity()
@@ -76,5 +87,45 @@ void Extrapolation::ConstrainVelocity()
   mConstrainCmd.Submit();
 }
 
+void Extrapolation::TilesBind(Tiles& tiles)
+{
+  mTiles = &tiles;
+  mCopyBackBound = tiles.BindCopy(mVelocity.Output(), mVelocity);
+  if (mSolidPhi)
+  {
+    ConstrainBind(*mSolidPhi);
+  }
+}
+
+void Extrapolation::RecordConstrain()
+{
+  mConstrainCmd.Record([&](vk::CommandBuffer commandBuffer) {
+    Renderer::BeginMarker(
+        mDevice, commandBuffer, {"Constrain Velocity", {{0.82f, 0.20f, 0.20f, 1.0f}}});
+    if (mTiles)
+    {
+      // only the active tiles are written and copied back
+      mConstrainVelocityTiledBound.RecordIndirect(commandBuffer, mTiles->GetDispatchParams());
+      mVelocity.Output().Barrier(commandBuffer,
+                                 vk::ImageLayout::eGeneral,
+                                 vk::AccessFlagBits::eShaderWrite,
+                                 vk::ImageLayout::eGeneral,
+                                 vk::AccessFlagBits::eShaderRead);
+      mTiles->RecordCopy(commandBuffer, mCopyBackBound);
+      mVelocity.Barrier(commandBuffer,
+                        vk::ImageLayout::eGeneral,
+                        vk::AccessFlagBits::eShaderWrite,
+                        vk::ImageLayout::eGeneral,
+                        vk::AccessFlagBits::eShaderRead);
+    }
+    else
+    {
+      mConstrainVelocityBound.Record(commandBuffer);
+      mVelocity.CopyBack(commandBuffer);
+    }
+    Renderer::EndMarker(mDevice, commandBuffer);
+  });
+}
+
 }  // namespace Fluid
 }  // namespace Vortex2D
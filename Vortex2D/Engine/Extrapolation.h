@@ -15,6 +15,8 @@ namespace Vortex2D
 {
 namespace Fluid
 {
+class Tiles;
+
 /**
  * @brief Class to extrapolate values into the neumann and/or dirichlet
  * boundaries
@@ -47,15 +49,32 @@ public:
    */
   VORTEX2D_API void ConstrainVelocity();
 
+  /**
+   * @brief Only constrain the velocity on the active tiles, the cells outside
+   * of them keep their values.
+   * @param tiles the active tiles
+   */
+  VORTEX2D_API void TilesBind(Tiles& tiles);
+
 private:
+  void RecordConstrain();
+
   const Renderer::Device& mDevice;
   Renderer::Buffer<glm::ivec2> mValid;
   Velocity& mVelocity;
+  Renderer::Texture* mSolidPhi;
+  Tiles* mTiles;
+
+  // bound in place of the tiles to the untiled works, which don't read them
+  Renderer::Buffer<glm::ivec2> mNoTiles;
 
   Renderer::Work mExtrapolateVelocity;
   Renderer::Work::Bound mExtrapolateVelocityBound, mExtrapolateVelocityBackBound;
   Renderer::Work mConstrainVelocity;
   Renderer::Work::Bound mConstrainVelocityBound;
+  Renderer::Work mConstrainVelocityTiled;
+  Renderer::Work::Bound mConstrainVelocityTiledBound;
+  Renderer::Work::Bound mCopyBackBound;
 
   Renderer::CommandBuffer mExtrapolateCmd;
   Renderer::CommandBuffer mConstrainCmd;
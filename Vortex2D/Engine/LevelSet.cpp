@@ -6,7 +6,9 @@
 #include "LevelSet.h"
 
 #include <Vortex2D/Engine/Boundaries.h>
+#include <Vortex2D/Engine/Tiles.h>
 #include <Vortex2D/Renderer/CommandBuffer.h>
+#include <Vortex2D/Renderer/Profiler.h>
 
 #include "vortex2d_generated_spirv.h"
 
@@ -19,53 +21,41 @@ LevelSet::LevelSet(const Renderer::Device& device,
                    int reinitializeIterations)
     : Renderer::RenderTexture(device, size.x, size.y, vk::Format::eR32Sfloat)
     , mDevice(device)
+    , mReinitializeIterations(reinitializeIterations)
     , mLevelSet0(device, size.x, size.y, vk::Format::eR32Sfloat)
     , mLevelSetBack(device, size.x, size.y, vk::Format::eR32Sfloat)
+    , mSolidPhi(nullptr)
+    , mTiles(nullptr)
+    , mNoTiles(device)
     , mSampler(Renderer::SamplerBuilder()
                    .AddressMode(vk::SamplerAddressMode::eClampToEdge)
                    .Create(device.Handle()))
     , mExtrapolate(device, size, SPIRV::Extrapolate_comp)
+    , mExtrapolateTiled(device,
+                        size,
+                        SPIRV::Extrapolate_comp,
+                        Renderer::SpecConst(Renderer::SpecConstValue(10, 1)),
+                        true)
     , mRedistance(device, size, SPIRV::Redistance_comp)
-    , mRedistanceFront(
-          mRedistance.Bind({{*mSampler, mLevelSet0}, {*mSampler, *this}, mLevelSetBack}))
-    , mRedistanceBack(
-          mRedistance.Bind({{*mSampler, mLevelSet0}, {*mSampler, mLevelSetBack}, *this}))
+    , mRedistanceFront(mRedistance.Bind(
+          {{*mSampler, mLevelSet0}, {*mSampler, *this}, mLevelSetBack, mNoTiles}))
+    , mRedistanceBack(mRedistance.Bind(
+          {{*mSampler, mLevelSet0}, {*mSampler, mLevelSetBack}, *this, mNoTiles}))
+    , mRedistanceTiled(device,
+                       size,
+                       SPIRV::Redistance_comp,
+                       Renderer::SpecConst(Renderer::SpecConstValue(10, 1)),
+                       true)
     , mShrinkWrap(device, size, SPIRV::ShrinkWrap_comp)
     , mShrinkWrapBound(mShrinkWrap.Bind({{*mSampler, *this}, mLevelSetBack}))
     , mExtrapolateCmd(device, false)
     , mReinitialiseCmd(device, false)
     , mShrinkWrapCmd(device, false)
 {
-  mReinitialiseCmd.Record([&, reinitializeIterations](vk::CommandBuffer commandBuffer) {
-    commandBuffer.debugMarkerBeginEXT({"Reinitialise", {{0.98f, 0.49f, 0.26f, 1.0f}}},
-                                      mDevice.Loader());
-
-    mLevelSet0.CopyFrom(commandBuffer, *this);
-
-    for (int i = 0; i < reinitializeIterations / 2; i++)
-    {
-      mRedistanceFront.PushConstant(commandBuffer, 0.1f);
-      mRedistanceFront.Record(commandBuffer);
-      mLevelSetBack.Barrier(commandBuffer,
-                            vk::ImageLayout::eGeneral,
-                            vk::AccessFlagBits::eShaderWrite,
-                            vk::ImageLayout::eGeneral,
-                            vk::AccessFlagBits::eShaderRead);
-      mRedistanceBack.PushConstant(commandBuffer, 0.1f);
-      mRedistanceBack.Record(commandBuffer);
-      Barrier(commandBuffer,
-              vk::ImageLayout::eGeneral,
-              vk::AccessFlagBits::eShaderWrite,
-              vk::ImageLayout::eGeneral,
-              vk::AccessFlagBits::eShaderRead);
-    }
-
-    commandBuffer.debugMarkerEndEXT(mDevice.Loader());
-  });
+  RecordReinitialise();
 
   mShrinkWrapCmd.Record([&](vk::CommandBuffer commandBuffer) {
-    commandBuffer.debugMarkerBeginEXT({"Shrink Wrap", {{0.36f, 0.71f, 0.38f, 1.0f}}},
-                                      mDevice.Loader());
+    Renderer::BeginMarker(mDevice, commandBuffer, {"Shrink Wrap", {{0.36f, 0.71f, 0.38f, 1.0f}}});
     mShrinkWrapBound.Record(commandBuffer);
     mLevelSetBack.Barrier(commandBuffer,
                           vk::ImageLayout::eGeneral,
@@ -73,21 +63,32 @@ LevelSet::LevelSet(const Renderer::Device& device,
                           vk::ImageLayout::eGeneral,
                           vk::AccessFlagBits::eShaderRead);
     CopyFrom(commandBuffer, mLevelSetBack);
-    commandBuffer.debugMarkerEndEXT(mDevice.Loader());
+    Renderer::EndMarker(mDevice, commandBuffer);
   });
 }
 
 LevelSet::LevelSet(LevelSet&& other)
     : Renderer::RenderTexture(std::move(other))
     , mDevice(other.mDevice)
+    , mReinitializeIterations(other.mReinitializeIterations)
     , mLevelSet0(std::move(other.mLevelSet0))
     , mLevelSetBack(std::move(other.mLevelSetBack))
+    , mSolidPhi(other.mSolidPhi)
+    , mTiles(other.mTiles)
+    , mNoTiles(std::move(other.mNoTiles))
     , mSampler(std::move(other.mSampler))
     , mExtrapolate(std::move(other.mExtrapolate))
     , mExtrapolateBound(std::move(other.mExtrapolateBound))
+    , mExtrapolateTiled(std::move(other.mExtrapolateTiled))
+    , mExtrapolateTiledBound(std::move(other.mExtrapolateTiledBound))
     , mRedistance(std::move(other.mRedistance))
     , mRedistanceFront(std::move(other.mRedistanceFront))
     , mRedistanceBack(std::move(other.mRedistanceBack))
+    , mRedistanceTiled(std::move(other.mRedistanceTiled))
+    , mRedistanceTiledFront(std::move(other.mRedistanceTiledFront))
+    , mRedistanceTiledBack(std::move(other.mRedistanceTiledBack))
+    , mLevelSet0CopyBound(std::move(other.mLevelSet0CopyBound))
+    , mLevelSetBackCopyBound(std::move(other.mLevelSetBackCopyBound))
     , mShrinkWrap(std::move(other.mShrinkWrap))
     , mShrinkWrapBound(std::move(other.mShrinkWrapBound))
     , mExtrapolateCmd(std::move(other.mExtrapolateCmd))
@@ -98,17 +99,112 @@ LevelSet::LevelSet(LevelSet&& other)
 
 void LevelSet::ExtrapolateBind(Renderer::Texture& solidPhi)
 {
-  mExtrapolateBound = mExtrapolate.Bind({solidPhi, *this});
+  mSolidPhi = &solidPhi;
+  mExtrapolateBound = mExtrapolate.Bind({solidPhi, *this, mNoTiles});
+  if (mTiles)
+  {
+    mExtrapolateTiledBound = mExtrapolateTiled.Bind({solidPhi, *this, mTiles->GetList()});
+  }
+
+  RecordExtrapolate();
+}
+
+void LevelSet::TilesBind(Tiles& tiles)
+{
+  mTiles = &tiles;
+  mRedistanceTiledFront = mRedistanceTiled.Bind(
+      {{*mSampler, mLevelSet0}, {*mSampler, *this}, mLevelSetBack, tiles.GetList()});
+  mRedistanceTiledBack = mRedistanceTiled.Bind(
+      {{*mSampler, mLevelSet0}, {*mSampler, mLevelSetBack}, *this, tiles.GetList()});
+  mLevelSet0CopyBound = tiles.BindCopy(*this, mLevelSet0);
+  mLevelSetBackCopyBound = tiles.BindCopy(*this, mLevelSetBack);
+
+  RecordReinitialise();
+  if (mSolidPhi)
+  {
+    ExtrapolateBind(*mSolidPhi);
+  }
+}
+
+void LevelSet::RecordReinitialise()
+{
+  mReinitialiseCmd.Record([&](vk::CommandBuffer commandBuffer) {
+    Renderer::BeginMarker(mDevice, commandBuffer, {"Reinitialise", {{0.98f, 0.49f, 0.26f, 1.0f}}});
+
+    // the redistance reads one cell around the active tiles
+    if (mTiles)
+    {
+      mTiles->RecordCopy(commandBuffer, mLevelSet0CopyBound, 1);
+      mTiles->RecordCopy(commandBuffer, mLevelSetBackCopyBound, 1);
+      mLevelSet0.Barrier(commandBuffer,
+                         vk::ImageLayout::eGeneral,
+                         vk::AccessFlagBits::eShaderWrite,
+                         vk::ImageLayout::eGeneral,
+                         vk::AccessFlagBits::eShaderRead);
+      mLevelSetBack.Barrier(commandBuffer,
+                            vk::ImageLayout::eGeneral,
+                            vk::AccessFlagBits::eShaderWrite,
+                            vk::ImageLayout::eGeneral,
+                            vk::AccessFlagBits::eShaderRead);
+    }
+    else
+    {
+      mLevelSet0.CopyFrom(commandBuffer, *this);
+    }
+
+    auto& front = mTiles ? mRedistanceTiledFront : mRedistanceFront;
+    auto& back = mTiles ? mRedistanceTiledBack : mRedistanceBack;
+    auto record = [&](Renderer::Work::Bound& bound) {
+      bound.PushConstant(commandBuffer, 0.1f);
+      if (mTiles)
+      {
+        bound.RecordIndirect(commandBuffer, mTiles->GetDispatchParams());
+      }
+      else
+      {
+        bound.Record(commandBuffer);
+      }
+    };
+
+    for (int i = 0; i < mReinitializeIterations / 2; i++)
+    {
+      record(front);
+      mLevelSetBack.Barrier(commandBuffer,
+                            vk::ImageLayout::eGeneral,
+                            vk::AccessFlagBits::eShaderWrite,
+                            vk::ImageLayout::eGeneral,
+                            vk::AccessFlagBits::eShaderRead);
+      record(back);
+      Barrier(commandBuffer,
+              vk::ImageLayout::eGeneral,
+              vk::AccessFlagBits::eShaderWrite,
+              vk::ImageLayout::eGeneral,
+              vk::AccessFlagBits::eShaderRead);
+    }
+
+    Renderer::EndMarker(mDevice, commandBuffer);
+  });
+}
+
+void LevelSet::RecordExtrapolate()
+{
   mExtrapolateCmd.Record([&](vk::CommandBuffer commandBuffer) {
-    commandBuffer.debugMarkerBeginEXT({"Extrapolate phi", {{0.53f, 0.09f, 0.16f, 1.0f}}},
-                                      mDevice.Loader());
-    mExtrapolateBound.Record(commandBuffer);
+    Renderer::BeginMarker(
+        mDevice, commandBuffer, {"Extrapolate phi", {{0.53f, 0.09f, 0.16f, 1.0f}}});
+    if (mTiles)
+    {
+      mExtrapolateTiledBound.RecordIndirect(commandBuffer, mTiles->GetDispatchParams());
+    }
+    else
+    {
+      mExtrapolateBound.Record(commandBuffer);
+    }
     Barrier(commandBuffer,
             vk::ImageLayout::eGeneral,
             vk::AccessFlagBits::eShaderWrite,
             vk::ImageLayout::eGeneral,
             vk::AccessFlagBits::eShaderRead);
-    commandBuffer.debugMarkerEndEXT(mDevice.Loader());
+    Renderer::EndMarker(mDevice, commandBuffer);
   });
 }
 
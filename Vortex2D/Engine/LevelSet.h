@@ -6,6 +6,7 @@
 #ifndef LevelSet_h
 #define LevelSet_h
 
+#include <Vortex2D/Renderer/Buffer.h>
 #include <Vortex2D/Renderer/CommandBuffer.h>
 #include <Vortex2D/Renderer/RenderTexture.h>
 #include <Vortex2D/Renderer/Work.h>
@@ -14,6 +15,8 @@ namespace Vortex2D
 {
 namespace Fluid
 {
+class Tiles;
+
 /**
  * @brief A signed distance field, which can be re-initialized. In other words,
  * a level set.
@@ -51,18 +54,41 @@ public:
    */
   VORTEX2D_API void Extrapolate();
 
+  /**
+   * @brief Only reinitialise and extrapolate the level set on the active tiles,
+   * the cells outside of them keep their values.
+   * @param tiles the active tiles
+   */
+  VORTEX2D_API void TilesBind(Tiles& tiles);
+
 private:
+  void RecordReinitialise();
+  void RecordExtrapolate();
+
   const Renderer::Device& mDevice;
+  int mReinitializeIterations;
   Renderer::Texture mLevelSet0;
   Renderer::Texture mLevelSetBack;
+  Renderer::Texture* mSolidPhi;
+  Tiles* mTiles;
+
+  // bound in place of the tiles to the untiled works, which don't read them
+  Renderer::Buffer<glm::ivec2> mNoTiles;
 
   vk::UniqueSampler mSampler;
 
   Renderer::Work mExtrapolate;
   Renderer::Work::Bound mExtrapolateBound;
+  Renderer::Work mExtrapolateTiled;
+  Renderer::Work::Bound mExtrapolateTiledBound;
   Renderer::Work mRedistance;
   Renderer::Work::Bound mRedistanceFront;
   Renderer::Work::Bound mRedistanceBack;
+  Renderer::Work mRedistanceTiled;
+  Renderer::Work::Bound mRedistanceTiledFront;
+  Renderer::Work::Bound mRedistanceTiledBack;
+  Renderer::Work::Bound mLevelSet0CopyBound;
+  Renderer::Work::Bound mLevelSetBackCopyBound;
   Renderer::Work mShrinkWrap;
   Renderer::Work::Bound mShrinkWrapBound;
 
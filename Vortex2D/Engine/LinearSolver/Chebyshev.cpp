@@ -0,0 +1,384 @@
+//
+//  Chebyshev.cpp
+//  Vortex2D
+//
+
+#include "Chebyshev.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+#include "vortex2d_generated_spirv.h"
+
+namespace Vortex2D
+{
+namespace Fluid
+{
+namespace
+{
+// Number of eigenvalues smaller than x of a symmetric tridiagonal matrix,
+// using the Sturm sequence.
+int SturmCount(const std::vector<double>& diagonal,
+               const std::vector<double>& offDiagonal,
+               double x)
+{
+  int count = 0;
+  double q = 1.0;
+  for (std::size_t i = 0; i < diagonal.size(); i++)
+  {
+    double e = i == 0 ? 0.0 : offDiagonal[i - 1];
+    q = diagonal[i] - x - (i == 0 ? 0.0 : e * e / q);
+    if (q == 0.0)
+    {
+      q = 1e-300;
+    }
+    if (q < 0.0)
+    {
+      count++;
+    }
+  }
+
+  return count;
+}
+
+// The k-th smallest eigenvalue of a symmetric tridiagonal matrix, found by
+// bisection inside the Gershgorin bounds.
+double Eigenvalue(const std::vector<double>& diagonal,
+                  const std::vector<double>& offDiagonal,
+                  int k)
+{
+  double low = diagonal[0], high = diagonal[0];
+  for (std::size_t i = 0; i < diagonal.size(); i++)
+  {
+    double radius = (i > 0 ? std::abs(offDiagonal[i - 1]) : 0.0) +
+                    (i < offDiagonal.size() ? std::abs(offDiagonal[i]) : 0.0);
+    low = std::min(low, diagonal[i] - radius);
+    high = std::max(high, diagonal[i] + radius);
+  }
+
+  for (int i = 0; i < 100; i++)
+  {
+    double mid = 0.5 * (low + high);
+    if (SturmCount(diagonal, offDiagonal, mid) > k)
+    {
+      high = mid;
+    }
+    else
+    {
+      low = mid;
+    }
+  }
+
+  return 0.5 * (low + high);
+}
+}  // namespace
+
+Chebyshev::Chebyshev(const Renderer::Device& device, const glm::ivec2& size, int degree)
+    : mDegree(std::max(degree, 1))
+    , mPressure(nullptr)
+    , mError(device, size)
+    , mBackPressure(device, size.x * size.y)
+    , mCoefficients(device, std::max(degree, 1), VMA_MEMORY_USAGE_CPU_TO_GPU)
+    , mChebyshev(device, size, SPIRV::Chebyshev_comp)
+    , mStart(device, size.x * size.y, VMA_MEMORY_USAGE_CPU_TO_GPU)
+    , r(device, size.x * size.y)
+    , z(device, size.x * size.y)
+    , p(device, size.x * size.y)
+    , q(device, size.x * size.y)
+    , inner(device, size.x * size.y)
+    , rho(device, 1)
+    , rhoNew(device, 1)
+    , sigma(device, 1)
+    , alpha(device, 1)
+    , beta(device, 1)
+    , localAlpha(device, 1, VMA_MEMORY_USAGE_GPU_TO_CPU)
+    , localBeta(device, 1, VMA_MEMORY_USAGE_GPU_TO_CPU)
+    , matrixMultiply(device, size, SPIRV::MultiplyMatrix_comp)
+    , diagonal(device, size, SPIRV::Diagonal_comp)
+    , scalarMultiply(device, size, SPIRV::Multiply_comp)
+    , scalarDivision(device, glm::ivec2(1), SPIRV::Divide_comp)
+    , multiplyAdd(device, size, SPIRV::MultiplyAdd_comp)
+    , multiplySub(device, size, SPIRV::MultiplySub_comp)
+    , maskStart(device, size, SPIRV::MaskPressure_comp)
+    , reduceSum(device, size)
+    , reduceSumRhoBound(reduceSum.Bind(inner, rho))
+    , reduceSumSigmaBound(reduceSum.Bind(inner, sigma))
+    , reduceSumRhoNewBound(reduceSum.Bind(inner, rhoNew))
+    , mInitCmd(device, false)
+    , mCycleCmd(device, false)
+    , mEstimateInitCmd(device)
+    , mEstimateStepCmd(device)
+{
+  // random start vector of the lanczos iterations, fixed so the estimation is
+  // deterministic
+  std::mt19937 generator(1);
+  std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+  std::vector<float> start(size.x * size.y);
+  std::generate(start.begin(), start.end(), [&] { return distribution(generator); });
+  Renderer::CopyFrom(mStart, start);
+
+  // bounds for a ratio of 30 of the largest eigenvalue, which is at most 2
+  SetBounds(2.0f / 30.0f, 2.0f);
+}
+
+Chebyshev::~Chebyshev() {}
+
+void Chebyshev::Bind(Renderer::GenericBuffer& d,
+                     Renderer::GenericBuffer& l,
+                     Renderer::GenericBuffer& b,
+                     Renderer::GenericBuffer& pressure)
+{
+  mPressure = &pressure;
+
+  mError.Bind(d, l, b, pressure);
+  mChebyshevFrontBound = mChebyshev.Bind({d, l, b, pressure, mBackPressure, mCoefficients});
+  mChebyshevBackBound = mChebyshev.Bind({d, l, b, mBackPressure, pressure, mCoefficients});
+
+  mInitCmd.Record([&](vk::CommandBuffer commandBuffer) { pressure.Clear(commandBuffer); });
+  mCycleCmd.Record([&](vk::CommandBuffer commandBuffer) { RecordCycle(commandBuffer); });
+
+  matrixMultiplyBound = matrixMultiply.Bind({d, l, p, q});
+  diagonalBound = diagonal.Bind({d, r, z});
+  multiplyZBound = scalarMultiply.Bind({r, z, inner});
+  multiplyQBound = scalarMultiply.Bind({p, q, inner});
+  divideRhoBound = scalarDivision.Bind({rho, sigma, alpha});
+  divideRhoNewBound = scalarDivision.Bind({rhoNew, rho, beta});
+  multiplyAddPBound = multiplyAdd.Bind({z, p, beta, p});
+  multiplySubRBound = multiplySub.Bind({r, q, alpha, r});
+  maskStartBound = maskStart.Bind({d, r});
+
+  mEstimateInitCmd.Record([&](vk::CommandBuffer commandBuffer) {
+    // r = random vector on the cells of the linear system
+    r.CopyFrom(commandBuffer, mStart);
+    maskStartBound.Record(commandBuffer);
+    r.Barrier(commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+
+    // z = D^-1 r
+    z.Clear(commandBuffer);
+    diagonalBound.Record(commandBuffer);
+    z.Barrier(commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+
+    // rho = zTr
+    multiplyZBound.Record(commandBuffer);
+    inner.Barrier(
+        commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+    reduceSumRhoBound.Record(commandBuffer);
+
+    // p = z
+    p.CopyFrom(commandBuffer, z);
+  });
+
+  mEstimateStepCmd.Record([&](vk::CommandBuffer commandBuffer) {
+    // q = Ap
+    q.Clear(commandBuffer);
+    matrixMultiplyBound.Record(commandBuffer);
+    q.Barrier(commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+
+    // alpha = rho / pTq
+    multiplyQBound.Record(commandBuffer);
+    inner.Barrier(
+        commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+    reduceSumSigmaBound.Record(commandBuffer);
+    divideRhoBound.Record(commandBuffer);
+    alpha.Barrier(
+        commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+
+    // r = r - alpha * q
+    multiplySubRBound.Record(commandBuffer);
+    r.Barrier(commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+
+    // z = D^-1 r
+    z.Clear(commandBuffer);
+    diagonalBound.Record(commandBuffer);
+    z.Barrier(commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+
+    // beta = rho_new / rho
+    multiplyZBound.Record(commandBuffer);
+    inner.Barrier(
+        commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+    reduceSumRhoNewBound.Record(commandBuffer);
+    divideRhoNewBound.Record(commandBuffer);
+    beta.Barrier(commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+
+    // p = z + beta * p
+    multiplyAddPBound.Record(commandBuffer);
+    p.Barrier(commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+
+    // rho = rho_new
+    rho.CopyFrom(commandBuffer, rhoNew);
+
+    localAlpha.CopyFrom(commandBuffer, alpha);
+    localBeta.CopyFrom(commandBuffer, beta);
+  });
+}
+
+void Chebyshev::BindRigidbody(float /*delta*/,
+                              Renderer::GenericBuffer& /*d*/,
+                              RigidBody& /*rigidBody*/)
+{
+}
+
+void Chebyshev::EstimateBounds(int steps)
+{
+  assert(mPressure != nullptr);
+
+  // the conjugate gradient coefficients give the lanczos tridiagonal matrix
+  // of the diagonally preconditioned matrix
+  std::vector<double> diagonalT, offDiagonalT;
+  double previousAlpha = 0.0, previousBeta = 0.0;
+
+  mEstimateInitCmd.Submit().Wait();
+  for (int i = 0; i < steps; i++)
+  {
+    mEstimateStepCmd.Submit().Wait();
+
+    float stepAlpha, stepBeta;
+    Renderer::CopyTo(localAlpha, stepAlpha);
+    Renderer::CopyTo(localBeta, stepBeta);
+
+    // breakdown, the krylov space is exhausted
+    if (!(stepAlpha > 0.0f) || !std::isfinite(stepAlpha))
+    {
+      break;
+    }
+
+    if (i > 0)
+    {
+      offDiagonalT.push_back(std::sqrt(previousBeta) / previousAlpha);
+    }
+
+    double value = 1.0 / stepAlpha;
+    if (i > 0)
+    {
+      value += previousBeta / previousAlpha;
+    }
+    diagonalT.push_back(value);
+
+    previousAlpha = stepAlpha;
+    previousBeta = stepBeta;
+
+    if (!(stepBeta > 0.0f) || !std::isfinite(stepBeta))
+    {
+      break;
+    }
+  }
+
+  if (diagonalT.empty())
+  {
+    return;
+  }
+
+  auto minEigenvalue = static_cast<float>(Eigenvalue(diagonalT, offDiagonalT, 0));
+  auto maxEigenvalue = static_cast<float>(
+      Eigenvalue(diagonalT, offDiagonalT, static_cast<int>(diagonalT.size()) - 1));
+
+  // the Ritz values are inside the spectrum, the max bound must not be
+  // underestimated while a too large min bound only slows convergence.
+  maxEigenvalue *= 1.1f;
+  minEigenvalue = std::min(minEigenvalue, 0.5f * maxEigenvalue);
+
+  if (minEigenvalue > 0.0f && std::isfinite(maxEigenvalue))
+  {
+    SetBounds(minEigenvalue, maxEigenvalue);
+  }
+}
+
+void Chebyshev::SetBounds(float minEigenvalue, float maxEigenvalue)
+{
+  if (minEigenvalue <= 0.0f || maxEigenvalue <= minEigenvalue)
+  {
+    throw std::runtime_error("Invalid chebyshev eigenvalue bounds");
+  }
+
+  mBounds = {minEigenvalue, maxEigenvalue};
+
+  // coefficients of the three term recurrence
+  // x_k+1 = x_k + c1 (x_k - x_k-1) + c2 D^-1 (b - A x_k)
+  float centre = 0.5f * (maxEigenvalue + minEigenvalue);
+  float halfWidth = 0.5f * (maxEigenvalue - minEigenvalue);
+  float ratio = centre / halfWidth;
+
+  std::vector<glm::vec2> coefficients(mDegree);
+  coefficients[0] = {0.0f, 1.0f / centre};
+
+  float previous = 1.0f / ratio;
+  for (int i = 1; i < mDegree; i++)
+  {
+    float next = 1.0f / (2.0f * ratio - previous);
+    coefficients[i] = {next * previous, 2.0f * next / halfWidth};
+    previous = next;
+  }
+
+  Renderer::CopyFrom(mCoefficients, coefficients);
+}
+
+glm::vec2 Chebyshev::GetBounds() const
+{
+  return mBounds;
+}
+
+void Chebyshev::Solve(Parameters& params, const std::vector<RigidBody*>& /*rigidbodies*/)
+{
+  params.Reset();
+
+  mInitCmd.Submit();
+
+  if (params.Type == Parameters::SolverType::Iterative)
+  {
+    params.OutError = mError.Submit().Wait().GetError();
+    if (params.OutError <= params.ErrorTolerance)
+    {
+      return;
+    }
+
+    mError.Submit();
+  }
+
+  auto initialError = params.OutError;
+  for (unsigned i = 0; !params.IsFinished(initialError); params.OutIterations = ++i)
+  {
+    mCycleCmd.Submit();
+
+    if (params.Type == Parameters::SolverType::Iterative)
+    {
+      params.OutError = mError.Wait().GetError();
+      mError.Submit();
+    }
+  }
+}
+
+float Chebyshev::GetError()
+{
+  return mError.Submit().Wait().GetError();
+}
+
+void Chebyshev::Record(vk::CommandBuffer commandBuffer)
+{
+  assert(mPressure != nullptr);
+  RecordCycle(commandBuffer);
+}
+
+void Chebyshev::RecordCycle(vk::CommandBuffer commandBuffer)
+{
+  // each step replaces the previous value, alternating between the two buffers
+  mBackPressure.Clear(commandBuffer);
+  for (int i = 0; i < mDegree; i++)
+  {
+    auto& bound = i % 2 == 0 ? mChebyshevFrontBound : mChebyshevBackBound;
+    auto& output = i % 2 == 0 ? static_cast<Renderer::GenericBuffer&>(mBackPressure) : *mPressure;
+
+    bound.PushConstant(commandBuffer, i);
+    bound.Record(commandBuffer);
+    output.Barrier(
+        commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+  }
+
+  if (mDegree % 2 == 1)
+  {
+    mPressure->CopyFrom(commandBuffer, mBackPressure);
+  }
+}
+
+}  // namespace Fluid
+}  // namespace Vortex2D
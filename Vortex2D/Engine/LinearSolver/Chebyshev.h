@@ -0,0 +1,113 @@
+//
+//  Chebyshev.h
+//  Vortex2D
+//
+
+#ifndef Vortex2D_Chebyshev_h
+#define Vortex2D_Chebyshev_h
+
+#include <Vortex2D/Engine/LinearSolver/LinearSolver.h>
+#include <Vortex2D/Engine/LinearSolver/Preconditioner.h>
+#include <Vortex2D/Engine/LinearSolver/Reduce.h>
+#include <Vortex2D/Renderer/CommandBuffer.h>
+#include <Vortex2D/Renderer/Work.h>
+
+namespace Vortex2D
+{
+namespace Fluid
+{
+/**
+ * @brief A Chebyshev polynomial iteration on the diagonally preconditioned
+ * matrix. A cycle applies a polynomial of fixed degree, each step is a single
+ * fused kernel without any inner products. The eigenvalue bounds of the
+ * matrix are estimated with a few conjugate gradient steps.
+ */
+class Chebyshev : public LinearSolver, public Preconditioner
+{
+public:
+  /**
+   * @brief Initialize the solver with a size and the degree of the polynomial
+   * @param device vulkan device
+   * @param size
+   * @param degree number of steps of a cycle
+   */
+  VORTEX2D_API Chebyshev(const Renderer::Device& device, const glm::ivec2& size, int degree = 4);
+
+  VORTEX2D_API ~Chebyshev() override;
+
+  VORTEX2D_API void Bind(Renderer::GenericBuffer& d,
+                         Renderer::GenericBuffer& l,
+                         Renderer::GenericBuffer& b,
+                         Renderer::GenericBuffer& pressure) override;
+
+  VORTEX2D_API void BindRigidbody(float delta,
+                                  Renderer::GenericBuffer& d,
+                                  RigidBody& rigidBody) override;
+
+  /**
+   * @brief Iterative solving of the linear equations in data, one iteration
+   * is a cycle of the polynomial.
+   */
+  VORTEX2D_API void Solve(Parameters& params,
+                          const std::vector<RigidBody*>& rigidbodies = {}) override;
+
+  VORTEX2D_API float GetError() override;
+
+  void Record(vk::CommandBuffer commandBuffer) override;
+
+  /**
+   * @brief Estimate the eigenvalue bounds of the diagonally preconditioned
+   * matrix with steps of conjugate gradient, using their Lanczos tridiagonal
+   * matrix. Needs to be called once the matrix is built, e.g. at the same
+   * time as the multigrid hierarchies are built.
+   * @param steps number of conjugate gradient steps
+   */
+  VORTEX2D_API void EstimateBounds(int steps = 10);
+
+  /**
+   * @brief Set the eigenvalue bounds of the diagonally preconditioned matrix.
+   * The polynomial is only positive on the spectrum if the max bound is not
+   * underestimated.
+   * @param minEigenvalue lower bound
+   * @param maxEigenvalue upper bound
+   */
+  VORTEX2D_API void SetBounds(float minEigenvalue, float maxEigenvalue);
+
+  /**
+   * @brief The eigenvalue bounds used for the polynomial.
+   * @return lower and upper bounds
+   */
+  VORTEX2D_API glm::vec2 GetBounds() const;
+
+private:
+  void RecordCycle(vk::CommandBuffer commandBuffer);
+
+  int mDegree;
+  glm::vec2 mBounds;
+  Renderer::GenericBuffer* mPressure;
+
+  LinearSolver::Error mError;
+
+  Renderer::Buffer<float> mBackPressure;
+  Renderer::Buffer<glm::vec2> mCoefficients;
+  Renderer::Work mChebyshev;
+  Renderer::Work::Bound mChebyshevFrontBound, mChebyshevBackBound;
+
+  Renderer::Buffer<float> mStart, r, z, p, q, inner;
+  Renderer::Buffer<float> rho, rhoNew, sigma, alpha, beta;
+  Renderer::Buffer<float> localAlpha, localBeta;
+  Renderer::Work matrixMultiply, diagonal, scalarMultiply, scalarDivision, multiplyAdd,
+      multiplySub, maskStart;
+  Renderer::Work::Bound matrixMultiplyBound, diagonalBound, multiplyZBound, multiplyQBound,
+      divideRhoBound, divideRhoNewBound, multiplyAddPBound, multiplySubRBound, maskStartBound;
+  ReduceSum reduceSum;
+  ReduceSum::Bound reduceSumRhoBound, reduceSumSigmaBound, reduceSumRhoNewBound;
+
+  Renderer::CommandBuffer mInitCmd, mCycleCmd;
+  Renderer::CommandBuffer mEstimateInitCmd, mEstimateStepCmd;
+};
+
+}  // namespace Fluid
+}  // namespace Vortex2D
+
+#endif
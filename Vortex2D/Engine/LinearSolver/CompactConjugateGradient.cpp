@@ -0,0 +1,281 @@
+//
+//  CompactConjugateGradient.cpp
+//  Vortex2D
+//
+
+#include "CompactConjugateGradient.h"
+
+#include <Vortex2D/Engine/Rigidbody.h>
+#include <Vortex2D/Renderer/Profiler.h>
+
+#include "vortex2d_generated_spirv.h"
+
+namespace Vortex2D
+{
+namespace Fluid
+{
+CompactConjugateGradient::CompactConjugateGradient(const Renderer::Device& device,
+                                                   const glm::ivec2& size)
+    : mDevice(device)
+    , flags(device, size.x * size.y)
+    , indices(device, size.x * size.y)
+    , cells(device, size.x * size.y)
+    , neighbours(device, size.x * size.y)
+    , weights(device, size.x * size.y)
+    , diagonal(device, size.x * size.y)
+    , x(device, size.x * size.y)
+    , r(device, size.x * size.y)
+    , z(device, size.x * size.y)
+    , p(device, size.x * size.y)
+    , q(device, size.x * size.y)
+    , inner(device, size.x * size.y)
+    , sigma(device, 1)
+    , innerSumMax(device, size.x * size.y)
+    , reduced(device, 1)
+    , rho(device, 1)
+    , localReduced(device, 1, VMA_MEMORY_USAGE_GPU_TO_CPU)
+    , localInitialReduced(device, 1, VMA_MEMORY_USAGE_GPU_TO_CPU)
+    , scanParams(device)
+    , elementParams(device)
+    , reduceParams(device)
+    , localParams(device, 1, VMA_MEMORY_USAGE_GPU_TO_CPU)
+    , mark(device, size, SPIRV::CompactMark_comp)
+    , dispatch(device, Renderer::ComputeSize::Default1D(), SPIRV::CompactDispatch_comp)
+    , gather(device, size, SPIRV::CompactGather_comp)
+    , init(device, Renderer::ComputeSize(size.x * size.y), SPIRV::CompactInit_comp)
+    , warmInit(device,
+               Renderer::ComputeSize(size.x * size.y),
+               SPIRV::CompactInit_comp,
+               Renderer::SpecConst(Renderer::SpecConstValue(3, 1)))
+    , residual(device, Renderer::ComputeSize(size.x * size.y), SPIRV::CompactResidual_comp)
+    , multiply(device, Renderer::ComputeSize(size.x * size.y), SPIRV::CompactMultiply_comp)
+    , update(device, Renderer::ComputeSize(size.x * size.y), SPIRV::CompactUpdate_comp)
+    , direction(device, Renderer::ComputeSize(size.x * size.y), SPIRV::CompactDirection_comp)
+    , scatter(device, Renderer::ComputeSize(size.x * size.y), SPIRV::CompactScatter_comp)
+    , dispatchBound(dispatch.Bind({scanParams, elementParams, reduceParams}))
+    , initBound(init.Bind({elementParams, diagonal, r, x, z, p, innerSumMax}))
+    , warmInitBound(warmInit.Bind({elementParams, diagonal, r, x, z, p, innerSumMax}))
+    , residualBound(
+          residual.Bind({elementParams, diagonal, weights, neighbours, x, r, innerSumMax}))
+    , multiplyBound(multiply.Bind({elementParams, diagonal, weights, neighbours, p, q, inner}))
+    , updateBound(update.Bind(
+          {elementParams, diagonal, p, q, x, r, z, innerSumMax, rho, sigma}))
+    , directionBound(direction.Bind({elementParams, z, p, rho, reduced}))
+    , prefixScan(device, size)
+    , prefixScanBound(prefixScan.Bind(flags, indices, scanParams))
+    , reduceSum(device, size)
+    , reduceSumBound(reduceSum.Bind(inner, sigma))
+    , reduceSumMax(device, size)
+    , reduceSumMaxBound(reduceSumMax.Bind(innerSumMax, reduced))
+    , mSolveInit(device, false)
+    , mSolveWarmInit(device, false)
+    , mSolve(device, false)
+    , mSolveEnd(device, false)
+    , mErrorRead(device)
+{
+  mErrorRead.Record([&](vk::CommandBuffer commandBuffer) {
+    localReduced.CopyFrom(commandBuffer, reduced);
+    localParams.CopyFrom(commandBuffer, scanParams);
+  });
+
+  mSolve.Record([&](vk::CommandBuffer commandBuffer) {
+    Renderer::BeginMarker(
+        mDevice, commandBuffer, {"Compact PCG Step", {{0.51f, 0.90f, 0.72f, 1.0f}}});
+
+    // q = Ap, sigma = pTq
+    multiplyBound.RecordIndirect(commandBuffer, elementParams);
+    q.Barrier(commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+    inner.Barrier(commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+    reduceSumBound.RecordIndirect(commandBuffer, reduceParams);
+
+    // alpha = rho / sigma, x = x + alpha * p, r = r - alpha * q, z = M^-1 r
+    updateBound.RecordIndirect(commandBuffer, elementParams);
+    x.Barrier(commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+    r.Barrier(commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+    z.Barrier(commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+    innerSumMax.Barrier(
+        commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+
+    // rho_new = rTz, error = max(|r|)
+    reduceSumMaxBound.RecordIndirect(commandBuffer, reduceParams);
+
+    // p = z + rho_new / rho * p
+    directionBound.RecordIndirect(commandBuffer, elementParams);
+    p.Barrier(commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+
+    // rho = rho_new
+    rho.CopyFrom(commandBuffer, reduced);
+
+    Renderer::EndMarker(mDevice, commandBuffer);
+  });
+}
+
+CompactConjugateGradient::~CompactConjugateGradient() {}
+
+void CompactConjugateGradient::Bind(Renderer::GenericBuffer& d,
+                                    Renderer::GenericBuffer& l,
+                                    Renderer::GenericBuffer& b,
+                                    Renderer::GenericBuffer& pressure)
+{
+  markBound = mark.Bind({d, flags});
+  gatherBound = gather.Bind(
+      {d, l, b, flags, indices, cells, neighbours, weights, diagonal, r, pressure, x});
+  scatterBound = scatter.Bind({elementParams, cells, x, pressure});
+
+  auto recordInit = [&](vk::CommandBuffer commandBuffer, bool warmStart) {
+    Renderer::BeginMarker(
+        mDevice, commandBuffer, {"Compact PCG Init", {{0.63f, 0.04f, 0.66f, 1.0f}}});
+
+    // flag the fluid cells and compute their index in the compacted vectors
+    markBound.Record(commandBuffer);
+    flags.Barrier(commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+    prefixScanBound.Record(commandBuffer);
+    indices.Barrier(
+        commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+    scanParams.Barrier(
+        commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+
+    // size the indirect dispatches on the number of fluid cells
+    dispatchBound.Record(commandBuffer);
+    elementParams.Barrier(
+        commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eIndirectCommandRead);
+    reduceParams.Barrier(
+        commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eIndirectCommandRead);
+
+    // diagonal, neighbours, weights, r = b and x = pressure in compacted form
+    gatherBound.Record(commandBuffer);
+    diagonal.Barrier(
+        commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+    cells.Barrier(commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+    neighbours.Barrier(
+        commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+    weights.Barrier(
+        commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+    r.Barrier(commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+    x.Barrier(commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+
+    if (warmStart)
+    {
+      // r = b - Ax, keeping the error of a zero initial guess
+      residualBound.RecordIndirect(commandBuffer, elementParams);
+      r.Barrier(commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+      innerSumMax.Barrier(
+          commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+      reduceSumMaxBound.RecordIndirect(commandBuffer, reduceParams);
+      localInitialReduced.CopyFrom(commandBuffer, reduced);
+
+      // z = M^-1 r, p = z
+      warmInitBound.RecordIndirect(commandBuffer, elementParams);
+    }
+    else
+    {
+      // x = 0, z = M^-1 r, p = z
+      initBound.RecordIndirect(commandBuffer, elementParams);
+    }
+    x.Barrier(commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+    z.Barrier(commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+    p.Barrier(commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+    innerSumMax.Barrier(
+        commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+
+    // rho = rTz, error = max(|r|)
+    reduceSumMaxBound.RecordIndirect(commandBuffer, reduceParams);
+    rho.CopyFrom(commandBuffer, reduced);
+
+    Renderer::EndMarker(mDevice, commandBuffer);
+  };
+
+  mSolveInit.Record([&](vk::CommandBuffer commandBuffer) { recordInit(commandBuffer, false); });
+  mSolveWarmInit.Record([&](vk::CommandBuffer commandBuffer) { recordInit(commandBuffer, true); });
+
+  mSolveEnd.Record([&](vk::CommandBuffer commandBuffer) {
+    // pressure = x on the fluid cells, 0 elsewhere
+    pressure.Clear(commandBuffer);
+    scatterBound.RecordIndirect(commandBuffer, elementParams);
+    pressure.Barrier(
+        commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+  });
+}
+
+void CompactConjugateGradient::BindRigidbody(float /*delta*/,
+                                             Renderer::GenericBuffer& /*d*/,
+                                             RigidBody& rigidBody)
+{
+  if (rigidBody.GetType() == RigidBody::Type::eStrong)
+  {
+    throw std::runtime_error("Strong coupling not supported for compact conjugate gradient");
+  }
+}
+
+void CompactConjugateGradient::Solve(Parameters& params,
+                                     const std::vector<RigidBody*>& /*rigidbodies*/)
+{
+  params.Reset();
+
+  if (params.WarmStart)
+  {
+    mSolveWarmInit.Submit();
+  }
+  else
+  {
+    mSolveInit.Submit();
+  }
+
+  if (params.Type == Parameters::SolverType::Iterative)
+  {
+    params.OutError = GetError();
+    if (params.OutError <= params.ErrorTolerance)
+    {
+      mSolveEnd.Submit();
+      return;
+    }
+
+    mErrorRead.Submit();
+  }
+
+  // relative tolerance is based on the error of a zero initial guess
+  auto initialError = params.OutError;
+  if (params.WarmStart && params.Type == Parameters::SolverType::Iterative)
+  {
+    glm::vec4 error;
+    Renderer::CopyTo(localInitialReduced, error);
+    initialError = error.z;
+  }
+
+  for (unsigned i = 0; !params.IsFinished(initialError); params.OutIterations = ++i)
+  {
+    mSolve.Submit();
+
+    if (params.Type == Parameters::SolverType::Iterative)
+    {
+      mErrorRead.Wait();
+      glm::vec4 error;
+      Renderer::CopyTo(localReduced, error);
+      params.OutError = error.z;
+      mErrorRead.Submit();
+    }
+  }
+
+  mSolveEnd.Submit();
+}
+
+float CompactConjugateGradient::GetError()
+{
+  mErrorRead.Submit().Wait();
+
+  glm::vec4 error;
+  Renderer::CopyTo(localReduced, error);
+  return error.z;
+}
+
+int CompactConjugateGradient::GetCount()
+{
+  mErrorRead.Submit().Wait();
+
+  Renderer::DispatchParams params(0);
+  Renderer::CopyTo(localParams, params);
+  return static_cast<int>(params.count);
+}
+
+}  // namespace Fluid
+}  // namespace Vortex2D
@@ -0,0 +1,94 @@
+//
+//  CompactConjugateGradient.h
+//  Vortex2D
+//
+
+#ifndef Vortex2D_CompactConjugateGradient_h
+#define Vortex2D_CompactConjugateGradient_h
+
+#include <Vortex2D/Engine/LinearSolver/LinearSolver.h>
+#include <Vortex2D/Engine/LinearSolver/Reduce.h>
+#include <Vortex2D/Engine/PrefixScan.h>
+#include <Vortex2D/Renderer/CommandBuffer.h>
+#include <Vortex2D/Renderer/Work.h>
+
+namespace Vortex2D
+{
+namespace Fluid
+{
+/**
+ * @brief A diagonal preconditioned conjugate gradient solving only the cells
+ * with a non zero diagonal. Those cells are compacted with a prefix scan in
+ * dense vectors and the iterations are dispatched indirectly, so the cost
+ * scales with the number of fluid cells instead of the size of the domain.
+ * Strongly coupled rigidbodies are not supported.
+ */
+class CompactConjugateGradient : public LinearSolver
+{
+public:
+  /**
+   * @brief Initialize the solver with a size
+   * @param device vulkan device
+   * @param size
+   */
+  VORTEX2D_API CompactConjugateGradient(const Renderer::Device& device, const glm::ivec2& size);
+
+  VORTEX2D_API ~CompactConjugateGradient() override;
+
+  VORTEX2D_API void Bind(Renderer::GenericBuffer& d,
+                         Renderer::GenericBuffer& l,
+                         Renderer::GenericBuffer& b,
+                         Renderer::GenericBuffer& pressure) override;
+
+  VORTEX2D_API void BindRigidbody(float delta,
+                                  Renderer::GenericBuffer& d,
+                                  RigidBody& rigidBody) override;
+
+  /**
+   * @brief Solve iteratively solve the linear equations in data. The
+   * compacted system is built from the bound buffers at each solve. With a
+   * warm start, the pressure of the fluid cells is gathered as the initial
+   * guess.
+   */
+  VORTEX2D_API void Solve(Parameters& params,
+                          const std::vector<RigidBody*>& rigidbodies = {}) override;
+
+  VORTEX2D_API float GetError() override;
+
+  /**
+   * @brief The number of cells solved in the last solve.
+   * @return the number of compacted cells
+   */
+  VORTEX2D_API int GetCount();
+
+private:
+  const Renderer::Device& mDevice;
+
+  Renderer::Buffer<int> flags, indices, cells;
+  Renderer::Buffer<glm::ivec4> neighbours;
+  Renderer::Buffer<glm::vec4> weights;
+  Renderer::Buffer<float> diagonal, x, r, z, p, q, inner, sigma;
+  Renderer::Buffer<glm::vec4> innerSumMax, reduced, rho, localReduced, localInitialReduced;
+  Renderer::IndirectBuffer<Renderer::DispatchParams> scanParams, elementParams, reduceParams;
+  Renderer::Buffer<Renderer::DispatchParams> localParams;
+
+  Renderer::Work mark, dispatch, gather, init, warmInit, residual, multiply, update, direction,
+      scatter;
+  Renderer::Work::Bound markBound, dispatchBound, gatherBound, initBound, warmInitBound,
+      residualBound, multiplyBound, updateBound, directionBound, scatterBound;
+
+  PrefixScan prefixScan;
+  PrefixScan::Bound prefixScanBound;
+  ReduceSum reduceSum;
+  ReduceSum::Bound reduceSumBound;
+  ReduceSumMax reduceSumMax;
+  ReduceSumMax::Bound reduceSumMaxBound;
+
+  Renderer::CommandBuffer mSolveInit, mSolveWarmInit, mSolve, mSolveEnd;
+  Renderer::CommandBuffer mErrorRead;
+};
+
+}  // namespace Fluid
+}  // namespace Vortex2D
+
+#endif
@@ -6,6 +6,9 @@
 #include "ConjugateGradient.h"
 
 #include <Vortex2D/Engine/Rigidbody.h>
+#include <Vortex2D/Renderer/Profiler.h>
+
+#include <algorithm>
 
 #include "vortex2d_generated_spirv.h"
 
@@ -18,10 +21,15 @@ ConjugateGradient::ConjugateGradient(const Renderer::Device& device,
                                      Preconditioner& preconditioner)
     : mDevice(device)
     , mPreconditioner(preconditioner)
+    , mPressure(nullptr)
+    , mSolidPhi(nullptr)
+    , mLiquidPhi(nullptr)
+    , mDelta(0.0f)
+    , mBatchIterations(1)
+    , mWorkSize(Renderer::ComputeSize::GetWorkSize(size))
     , r(device, size.x * size.y)
     , s(device, size.x * size.y)
     , z(device, size.x * size.y)
-    , inner(device, size.x * size.y)
     , alpha(device, 1)
     , beta(device, 1)
     , rho(device, 1)
@@ -29,126 +37,290 @@ ConjugateGradient::ConjugateGradient(const Renderer::Device& device,
     , sigma(device, 1)
     , error(device)
     , localError(device, 1, VMA_MEMORY_USAGE_GPU_TO_CPU)
-    , matrixMultiply(device, size, SPIRV::MultiplyMatrix_comp)
+    , initialError(device)
+    , localInitialError(device, 1, VMA_MEMORY_USAGE_GPU_TO_CPU)
+    , errorCheck(device, 1, VMA_MEMORY_USAGE_CPU_TO_GPU)
+    , relativeErrorCheck(device, 1, VMA_MEMORY_USAGE_CPU_TO_GPU)
+    , mRelativeErrorCheck()
+    , iterations(device, 1)
+    , localIterations(device, 1, VMA_MEMORY_USAGE_GPU_TO_CPU)
+    , dispatchParams(device)
+    , matrixMultiply(device,
+                     size,
+                     SPIRV::MultiplyMatrix_comp,
+                     Renderer::SpecConst(Renderer::SpecConstValue(3, 1)))
     , scalarDivision(device, glm::ivec2(1), SPIRV::Divide_comp)
-    , scalarMultiply(device, size, SPIRV::Multiply_comp)
     , multiplyAdd(device, size, SPIRV::MultiplyAdd_comp)
     , multiplySub(device, size, SPIRV::MultiplySub_comp)
-    , reduceSum(device, size)
-    , reduceMax(device, size)
+    , residual(device, size, SPIRV::Residual_comp)
+    , maskPressure(device, size, SPIRV::MaskPressure_comp)
+    , matrixFreeMultiply(device, size, SPIRV::MatrixFreeMultiply_comp, {}, true)
+    , matrixFreeResidual(device, size, SPIRV::MatrixFreeResidual_comp, {}, true)
+    , reduceInner(device, size, {ReduceMultiple::Operation::Sum})
+    , reduceMax(device, size, Reduce::Method::SinglePass)
     , reduceMaxBound(reduceMax.Bind(r, error))
-    , reduceSumRhoBound(reduceSum.Bind(inner, rho))
-    , reduceSumSigmaBound(reduceSum.Bind(inner, sigma))
-    , reduceSumRhoNewBound(reduceSum.Bind(inner, rho_new))
-    , multiplySBound(scalarMultiply.Bind({z, s, inner}))
-    , multiplyZBound(scalarMultiply.Bind({z, r, inner}))
+    , reduceRhoBound(reduceInner.Bind({{z, r}}, rho))
+    , reduceSigmaBound(reduceInner.Bind({{z, s}}, sigma))
+    , reduceRhoNewBound(reduceInner.Bind({{z, r}}, rho_new))
     , divideRhoBound(scalarDivision.Bind({rho, sigma, alpha}))
     , divideRhoNewBound(scalarDivision.Bind({rho_new, rho, beta}))
     , multiplySubRBound(multiplySub.Bind({r, z, alpha, r}))
     , multiplyAddZBound(multiplyAdd.Bind({z, s, beta, s}))
+    , errorCheckWork(device, glm::ivec2(1), SPIRV::ErrorCheck_comp)
+    , errorCheckBound(errorCheckWork.Bind({error, errorCheck, iterations, dispatchParams}))
+    , toleranceScale(device, glm::ivec2(1), SPIRV::Multiply_comp)
+    , toleranceScaleBound(toleranceScale.Bind({error, errorCheck, errorCheck}))
+    , toleranceScaleWarmBound(toleranceScale.Bind({initialError, errorCheck, errorCheck}))
     , mSolveInit(device, false)
+    , mSolveWarmInit(device, false)
     , mSolve(device, false)
+    , mSolveBatch(device)
+    , mSolveAsyncBatch(device, false)
+    , mScaleTolerance(device, false)
+    , mScaleWarmTolerance(device, false)
     , mErrorRead(device)
 {
   mErrorRead.Record(
       [&](vk::CommandBuffer commandBuffer) { localError.CopyFrom(commandBuffer, error); });
+
+  // tolerance = tolerance * initial error, the error after the init of a cold
+  // start is the error of a zero initial guess.
+  auto recordScaleTolerance = [&](vk::CommandBuffer commandBuffer, Renderer::Work::Bound& bound) {
+    errorCheck.CopyFrom(commandBuffer, relativeErrorCheck);
+    bound.Record(commandBuffer);
+    errorCheck.Barrier(
+        commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+  };
+
+  mScaleTolerance.Record([&](vk::CommandBuffer commandBuffer) {
+    recordScaleTolerance(commandBuffer, toleranceScaleBound);
+  });
+
+  mScaleWarmTolerance.Record([&](vk::CommandBuffer commandBuffer) {
+    recordScaleTolerance(commandBuffer, toleranceScaleWarmBound);
+  });
 }
 
 ConjugateGradient::~ConjugateGradient() {}
 
+void ConjugateGradient::BindMatrixFree(float delta,
+                                       Renderer::Texture& solidPhi,
+                                       Renderer::Texture& liquidPhi)
+{
+  mDelta = delta;
+  mSolidPhi = &solidPhi;
+  mLiquidPhi = &liquidPhi;
+}
+
 void ConjugateGradient::Bind(Renderer::GenericBuffer& d,
                              Renderer::GenericBuffer& l,
                              Renderer::GenericBuffer& b,
                              Renderer::GenericBuffer& pressure)
 {
+  if (mLiquidPhi != nullptr && mPreconditioner.ReadsLower())
+  {
+    // throws if the preconditioner can only read the lower matrix
+    mPreconditioner.BindMatrixFree(mDelta, *mSolidPhi, *mLiquidPhi);
+  }
+
+  mPressure = &pressure;
   mPreconditioner.Bind(d, l, r, z);
 
-  matrixMultiplyBound = matrixMultiply.Bind({d, l, s, z});
+  if (mLiquidPhi != nullptr)
+  {
+    matrixMultiplyBound = matrixFreeMultiply.Bind({*mLiquidPhi, *mSolidPhi, s, z});
+    residualBound = matrixFreeResidual.Bind({*mLiquidPhi, *mSolidPhi, pressure, b, r});
+  }
+  else
+  {
+    matrixMultiplyBound = matrixMultiply.Bind({d, l, s, z});
+    residualBound = residual.Bind({pressure, d, l, b, r});
+  }
+
   multiplyAddPBound = multiplyAdd.Bind({pressure, s, alpha, pressure});
+  maskPressureBound = maskPressure.Bind({d, pressure});
+  reduceMaxInitialBound = reduceMax.Bind(b, initialError);
 
   mSolveInit.Record([&](vk::CommandBuffer commandBuffer) {
-    commandBuffer.debugMarkerBeginEXT({"PCG Init", {{0.63f, 0.04f, 0.66f, 1.0f}}},
-                                      mDevice.Loader());
+    RecordInit(commandBuffer, b, pressure, false);
+  });
+
+  mSolveWarmInit.Record([&](vk::CommandBuffer commandBuffer) {
+    RecordInit(commandBuffer, b, pressure, true);
+  });
+
+  mSolve.Record([&](vk::CommandBuffer commandBuffer) { RecordSolve(commandBuffer, nullptr); });
 
-    // r = b
-    r.CopyFrom(commandBuffer, b);
+  RecordSolveBatch();
+}
+
+void ConjugateGradient::RecordInit(vk::CommandBuffer commandBuffer,
+                                   Renderer::GenericBuffer& b,
+                                   Renderer::GenericBuffer& pressure,
+                                   bool warmStart)
+{
+  Renderer::BeginMarker(mDevice, commandBuffer, {"PCG Init", {{0.63f, 0.04f, 0.66f, 1.0f}}});
+
+  // r = b
+  r.CopyFrom(commandBuffer, b);
 
-    // calculate error
-    reduceMaxBound.Record(commandBuffer);
+  if (warmStart)
+  {
+    // error with p = 0, used for the relative tolerance
+    reduceMaxInitialBound.Record(commandBuffer);
+    localInitialError.CopyFrom(commandBuffer, initialError);
+
+    // p = 0 outside of the linear system
+    maskPressureBound.Record(commandBuffer);
+    pressure.Barrier(
+        commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
 
+    // r = b - Ap
+    PushDelta(commandBuffer, residualBound);
+    residualBound.Record(commandBuffer);
+    r.Barrier(commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+  }
+  else
+  {
     // p = 0
     pressure.Clear(commandBuffer);
+  }
 
-    // z = M^-1 r
-    z.Clear(commandBuffer);
-    mPreconditioner.Record(commandBuffer);
-    z.Barrier(commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+  // calculate error
+  reduceMaxBound.Record(commandBuffer);
 
-    // s = z
-    s.CopyFrom(commandBuffer, z);
+  // i = 0
+  iterations.Clear(commandBuffer);
 
-    // rho = zTr
-    multiplyZBound.Record(commandBuffer);
-    inner.Barrier(commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
-    reduceSumRhoBound.Record(commandBuffer);
-    z.Clear(commandBuffer);
+  // z = M^-1 r
+  z.Clear(commandBuffer);
+  mPreconditioner.Record(commandBuffer);
+  z.Barrier(commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
 
-    commandBuffer.debugMarkerEndEXT(mDevice.Loader());
-  });
+  // s = z
+  s.CopyFrom(commandBuffer, z);
 
-  mSolve.Record([&](vk::CommandBuffer commandBuffer) {
-    commandBuffer.debugMarkerBeginEXT({"PCG Step", {{0.51f, 0.90f, 0.72f, 1.0f}}},
-                                      mDevice.Loader());
+  // rho = zTr, multiplied and reduced in a single pass
+  reduceRhoBound.Record(commandBuffer);
+  z.Clear(commandBuffer);
 
-    // z = As
-    matrixMultiplyBound.Record(commandBuffer);
-    z.Barrier(commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+  Renderer::EndMarker(mDevice, commandBuffer);
+}
 
-    // sigma = zTs
-    multiplySBound.Record(commandBuffer);
-    inner.Barrier(commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
-    reduceSumSigmaBound.Record(commandBuffer);
+void ConjugateGradient::SetBatchIterations(unsigned batchIterations)
+{
+  mBatchIterations = std::max(batchIterations, 1u);
+  if (mPressure != nullptr)
+  {
+    RecordSolveBatch();
+  }
+}
 
-    // alpha = rho / sigma
-    divideRhoBound.Record(commandBuffer);
-    alpha.Barrier(commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+void ConjugateGradient::RecordSolve(
+    vk::CommandBuffer commandBuffer,
+    Renderer::IndirectBuffer<Renderer::DispatchParams>* indirectParams)
+{
+  // when dispatch params are given, the dispatches are empty once the solver
+  // has converged.
+  auto record = [&](Renderer::Work::Bound& bound) {
+    if (indirectParams != nullptr)
+    {
+      bound.RecordIndirect(commandBuffer, *indirectParams);
+    }
+    else
+    {
+      bound.Record(commandBuffer);
+    }
+  };
 
-    // p = p + alpha * s
-    multiplyAddPBound.Record(commandBuffer);
-    pressure.Barrier(
-        commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+  Renderer::BeginMarker(mDevice, commandBuffer, {"PCG Step", {{0.51f, 0.90f, 0.72f, 1.0f}}});
 
-    // r = r - alpha * z
-    multiplySubRBound.Record(commandBuffer);
-    r.Barrier(commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+  // z = z + As, where z holds the rigidbody pressure
+  PushDelta(commandBuffer, matrixMultiplyBound);
+  record(matrixMultiplyBound);
+  z.Barrier(commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+
+  // sigma = zTs
+  reduceSigmaBound.Record(commandBuffer);
+
+  // alpha = rho / sigma
+  divideRhoBound.Record(commandBuffer);
+  alpha.Barrier(commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+
+  // p = p + alpha * s
+  record(multiplyAddPBound);
+  mPressure->Barrier(
+      commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
 
-    // calculate max error
-    reduceMaxBound.Record(commandBuffer);
+  // r = r - alpha * z
+  record(multiplySubRBound);
+  r.Barrier(commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
 
-    // z = M^-1 r
-    z.Clear(commandBuffer);
-    mPreconditioner.Record(commandBuffer);
-    z.Barrier(commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+  // calculate max error
+  reduceMaxBound.Record(commandBuffer);
 
-    // rho_new = zTr
-    multiplyZBound.Record(commandBuffer);
-    inner.Barrier(commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
-    reduceSumRhoNewBound.Record(commandBuffer);
+  // z = M^-1 r
+  z.Clear(commandBuffer);
+  mPreconditioner.Record(commandBuffer);
+  z.Barrier(commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
 
-    // beta = rho_new / rho
-    divideRhoNewBound.Record(commandBuffer);
-    beta.Barrier(commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+  // rho_new = zTr
+  reduceRhoNewBound.Record(commandBuffer);
 
-    // s = z + beta * s
-    multiplyAddZBound.Record(commandBuffer);
-    z.Clear(commandBuffer);
-    s.Barrier(commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+  // beta = rho_new / rho
+  divideRhoNewBound.Record(commandBuffer);
+  beta.Barrier(commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+
+  // s = z + beta * s
+  record(multiplyAddZBound);
+  z.Clear(commandBuffer);
+  s.Barrier(commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+
+  // rho = rho_new
+  rho.CopyFrom(commandBuffer, rho_new);
+
+  Renderer::EndMarker(mDevice, commandBuffer);
+}
+
+void ConjugateGradient::RecordSolveBatch()
+{
+  auto recordIterations = [&](vk::CommandBuffer commandBuffer) {
+    for (unsigned i = 0; i < mBatchIterations; i++)
+    {
+      // check error and set dispatch params of this iteration
+      dispatchParams.Barrier(commandBuffer,
+                             vk::AccessFlagBits::eIndirectCommandRead,
+                             vk::AccessFlagBits::eShaderWrite);
+      errorCheckBound.PushConstant(commandBuffer, mWorkSize.x, mWorkSize.y);
+      errorCheckBound.Record(commandBuffer);
+      dispatchParams.Barrier(commandBuffer,
+                             vk::AccessFlagBits::eShaderWrite,
+                             vk::AccessFlagBits::eIndirectCommandRead);
+      iterations.Barrier(
+          commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+
+      RecordSolve(commandBuffer, &dispatchParams);
+    }
+  };
 
-    // rho = rho_new
-    rho.CopyFrom(commandBuffer, rho_new);
+  mSolveBatch.Record([&](vk::CommandBuffer commandBuffer) {
+    recordIterations(commandBuffer);
 
-    commandBuffer.debugMarkerEndEXT(mDevice.Loader());
+    localError.CopyFrom(commandBuffer, error);
+    localIterations.CopyFrom(commandBuffer, iterations);
   });
+
+  // not synchronised, so it can be submitted several times without waiting
+  mSolveAsyncBatch.Record(recordIterations);
+}
+
+void ConjugateGradient::PushDelta(vk::CommandBuffer commandBuffer, Renderer::Work::Bound& bound)
+{
+  // the matrix free kernels scale the coefficients by delta
+  if (mLiquidPhi != nullptr)
+  {
+    bound.PushConstant(commandBuffer, mDelta);
+  }
 }
 
 void ConjugateGradient::BindRigidbody(float delta, Renderer::GenericBuffer& d, RigidBody& rigidBody)
@@ -160,7 +332,25 @@ void ConjugateGradient::Solve(Parameters& params, const std::vector<RigidBody*>&
 {
   params.Reset();
 
-  mSolveInit.Submit();
+  // strongly coupled rigidbodies need to be updated between each iteration
+  bool hasStrongRigidbody =
+      std::any_of(rigidbodies.begin(), rigidbodies.end(), [](RigidBody* rigidbody) {
+        return rigidbody->GetType() == RigidBody::Type::eStrong;
+      });
+
+  // the initial residual doesn't include the rigidbody contributions, so we
+  // start from zero with strongly coupled rigidbodies.
+  // The initial error of the warm start is read back with the first error
+  // read, so neither init is waited on.
+  bool warmStart = params.WarmStart && !hasStrongRigidbody;
+  if (warmStart)
+  {
+    mSolveWarmInit.Submit();
+  }
+  else
+  {
+    mSolveInit.Submit();
+  }
 
   if (params.Type == Parameters::SolverType::Iterative)
   {
@@ -172,10 +362,32 @@ void ConjugateGradient::Solve(Parameters& params, const std::vector<RigidBody*>&
       return;
     }
 
+    // relative tolerance is based on the error of a zero initial guess
+    float initialError = params.OutError;
+    if (warmStart)
+    {
+      Renderer::CopyTo(localInitialError, initialError);
+    }
+
+    if (mBatchIterations > 1 && !hasStrongRigidbody)
+    {
+      SolveBatch(params, initialError);
+      return;
+    }
+
     mErrorRead.Submit();
+    SolveIterations(params, initialError, rigidbodies);
   }
+  else
+  {
+    SolveIterations(params, params.OutError, rigidbodies);
+  }
+}
 
-  auto initialError = params.OutError;
+void ConjugateGradient::SolveIterations(Parameters& params,
+                                        float initialError,
+                                        const std::vector<RigidBody*>& rigidbodies)
+{
   for (unsigned i = 0; !params.IsFinished(initialError); params.OutIterations = ++i)
   {
     for (auto& rigidbody : rigidbodies)
@@ -194,6 +406,79 @@ void ConjugateGradient::Solve(Parameters& params, const std::vector<RigidBody*>&
   }
 }
 
+void ConjugateGradient::SolveBatch(Parameters& params, float initialError)
+{
+  Renderer::CopyFrom(errorCheck, ErrorCheck::Make(params, initialError));
+
+  while (!params.IsFinished(initialError))
+  {
+    mSolveBatch.Submit().Wait();
+
+    uint32_t outIterations;
+    Renderer::CopyTo(localError, params.OutError);
+    Renderer::CopyTo(localIterations, outIterations);
+
+    // the GPU stopped iterating, e.g. the error is not a number
+    if (outIterations == params.OutIterations)
+    {
+      break;
+    }
+
+    params.OutIterations = outIterations;
+  }
+}
+
+void ConjugateGradient::SolveAsync(Parameters& params, const std::vector<RigidBody*>& rigidbodies)
+{
+  if (params.Type == Parameters::SolverType::Fixed)
+  {
+    // the fixed number of iterations is submitted without waiting
+    Solve(params, rigidbodies);
+    return;
+  }
+
+  if (params.Iterations == 0)
+  {
+    throw std::runtime_error("Asynchronous solve requires a maximum number of iterations");
+  }
+
+  if (std::any_of(rigidbodies.begin(), rigidbodies.end(), [](RigidBody* rigidbody) {
+        return rigidbody->GetType() == RigidBody::Type::eStrong;
+      }))
+  {
+    throw std::runtime_error("Asynchronous solve doesn't support strongly coupled rigidbodies");
+  }
+
+  params.Reset();
+
+  // scaled by the initial error on the GPU, only written when changed as the
+  // previous solve can still read it.
+  auto check = ErrorCheck::Make(params, 1.0f);
+  if (check.tolerance != mRelativeErrorCheck.tolerance ||
+      check.maxIterations != mRelativeErrorCheck.maxIterations)
+  {
+    mRelativeErrorCheck = check;
+    Renderer::CopyFrom(relativeErrorCheck, check);
+  }
+
+  if (params.WarmStart)
+  {
+    mSolveWarmInit.Submit();
+    mScaleWarmTolerance.Submit();
+  }
+  else
+  {
+    mSolveInit.Submit();
+    mScaleTolerance.Submit();
+  }
+
+  unsigned batches = (params.Iterations + mBatchIterations - 1) / mBatchIterations;
+  for (unsigned i = 0; i < batches; i++)
+  {
+    mSolveAsyncBatch.Submit();
+  }
+}
+
 float ConjugateGradient::GetError()
 {
     mErrorRead.Submit().Wait();
@@ -36,6 +36,21 @@ public:
 
   VORTEX2D_API ~ConjugateGradient() override;
 
+  /**
+   * @brief Use a matrix free multiplication, the coefficients of the matrix
+   * are computed from the level sets instead of being read from the diagonal
+   * and lower matrix. Needs to be called before @ref Bind. The lower matrix
+   * is then not read at all and can be left unallocated, see
+   * LinearSolver::Matrix::Free. @ref Bind forwards the level sets to the
+   * preconditioner, and throws if it can only read the lower matrix.
+   * @param delta solver delta
+   * @param solidPhi solid level set
+   * @param liquidPhi liquid level set
+   */
+  VORTEX2D_API void BindMatrixFree(float delta,
+                                   Renderer::Texture& solidPhi,
+                                   Renderer::Texture& liquidPhi);
+
   VORTEX2D_API void Bind(Renderer::GenericBuffer& d,
                          Renderer::GenericBuffer& l,
                          Renderer::GenericBuffer& b,
@@ -50,27 +65,83 @@ public:
   VORTEX2D_API void Solve(Parameters& params,
                           const std::vector<RigidBody*>& rigidbodies = {}) override;
 
+  /**
+   * @brief Submit the solve without waiting on the GPU. When solving
+   * iteratively, the convergence is checked on the GPU as with
+   * @ref SetBatchIterations and enough batches are submitted to reach the
+   * maximum number of iterations, the dispatches of the iterations after
+   * convergence are empty. The tolerance relative to the initial error is
+   * computed on the GPU as well. The output error and iterations of the
+   * parameters are not set, see @ref GetError. The parameters can't change
+   * until the previous solve has finished. Throws if the iterative solve has
+   * no maximum number of iterations or with strongly coupled rigidbodies.
+   * @param params solver parameters
+   * @param rigidbodies the rigidbodies coupled with the fluid
+   */
+  VORTEX2D_API void SolveAsync(Parameters& params, const std::vector<RigidBody*>& rigidbodies = {});
+
   VORTEX2D_API float GetError() override;
 
+  /**
+   * @brief Set the number of iterations recorded in a single submission when
+   * solving iteratively. The convergence check is done on the GPU and the
+   * error is only read back once per batch. A value of 1 reads back the error
+   * after each iteration.
+   * @param batchIterations number of iterations per submission
+   */
+  VORTEX2D_API void SetBatchIterations(unsigned batchIterations);
+
 private:
+  void RecordInit(vk::CommandBuffer commandBuffer,
+                  Renderer::GenericBuffer& b,
+                  Renderer::GenericBuffer& pressure,
+                  bool warmStart);
+  void RecordSolve(vk::CommandBuffer commandBuffer,
+                   Renderer::IndirectBuffer<Renderer::DispatchParams>* indirectParams);
+  void RecordSolveBatch();
+  void SolveIterations(Parameters& params,
+                       float initialError,
+                       const std::vector<RigidBody*>& rigidbodies);
+  void SolveBatch(Parameters& params, float initialError);
+  void PushDelta(vk::CommandBuffer commandBuffer, Renderer::Work::Bound& bound);
+
   const Renderer::Device& mDevice;
   Preconditioner& mPreconditioner;
+  Renderer::GenericBuffer* mPressure;
+  Renderer::Texture* mSolidPhi;
+  Renderer::Texture* mLiquidPhi;
+  float mDelta;
+  unsigned mBatchIterations;
+  glm::ivec2 mWorkSize;
 
-  Renderer::Buffer<float> r, s, z, inner, alpha, beta, rho, rho_new, sigma;
-  Renderer::Buffer<float> error, localError;
-  Renderer::Work matrixMultiply, scalarDivision, scalarMultiply, multiplyAdd, multiplySub;
-  ReduceSum reduceSum;
+  Renderer::Buffer<float> r, s, z, alpha, beta;
+  // the inner products are reduced in the x component
+  Renderer::Buffer<glm::vec4> rho, rho_new, sigma;
+  Renderer::Buffer<float> error, localError, initialError, localInitialError;
+  Renderer::Buffer<ErrorCheck> errorCheck, relativeErrorCheck;
+  ErrorCheck mRelativeErrorCheck;
+  Renderer::Buffer<uint32_t> iterations, localIterations;
+  Renderer::IndirectBuffer<Renderer::DispatchParams> dispatchParams;
+  Renderer::Work matrixMultiply, scalarDivision, multiplyAdd, multiplySub;
+  Renderer::Work residual, maskPressure;
+  Renderer::Work matrixFreeMultiply, matrixFreeResidual;
+  ReduceMultiple reduceInner;
   ReduceMax reduceMax;
 
-  ReduceMax::Bound reduceMaxBound;
-  ReduceSum::Bound reduceSumRhoBound, reduceSumSigmaBound, reduceSumRhoNewBound;
-  Renderer::Work::Bound multiplySBound, multiplyZBound;
+  Reduce::Bound reduceMaxBound, reduceMaxInitialBound;
+  Reduce::Bound reduceRhoBound, reduceSigmaBound, reduceRhoNewBound;
   Renderer::Work::Bound matrixMultiplyBound;
   Renderer::Work::Bound divideRhoBound;
   Renderer::Work::Bound divideRhoNewBound;
   Renderer::Work::Bound multiplyAddPBound, multiplySubRBound, multiplyAddZBound;
+  Renderer::Work::Bound residualBound, maskPressureBound;
+  Renderer::Work errorCheckWork;
+  Renderer::Work::Bound errorCheckBound;
+  Renderer::Work toleranceScale;
+  Renderer::Work::Bound toleranceScaleBound, toleranceScaleWarmBound;
 
-  Renderer::CommandBuffer mSolveInit, mSolve;
+  Renderer::CommandBuffer mSolveInit, mSolveWarmInit, mSolve, mSolveBatch, mSolveAsyncBatch;
+  Renderer::CommandBuffer mScaleTolerance, mScaleWarmTolerance;
   Renderer::CommandBuffer mErrorRead;
 };
 
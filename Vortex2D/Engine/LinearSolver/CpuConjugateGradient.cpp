@@ -0,0 +1,387 @@
+//
+//  CpuConjugateGradient.cpp
+//  Vortex2D
+//
+
+#include "CpuConjugateGradient.h"
+#include "CpuKernels.h"
+
+#include <Vortex2D/Engine/Rigidbody.h>
+
+#include <algorithm>
+#include <cmath>
+#include <future>
+
+namespace Vortex2D
+{
+namespace Fluid
+{
+namespace
+{
+// modified incomplete Cholesky parameters, see Bridson's "Fluid Simulation
+// for Computer Graphics"
+const float tuning = 0.97f;
+const float safety = 0.25f;
+
+// minimum number of rows of a strip, thinner strips weaken the preconditioner
+const int minStripRows = 16;
+}  // namespace
+
+CpuConjugateGradient::HostData::HostData(const glm::ivec2& size)
+    : Diagonal(size.x * size.y), Lower(size.x * size.y), B(size.x * size.y), X(size.x * size.y)
+{
+}
+
+CpuConjugateGradient::CpuConjugateGradient(const Renderer::Device& device,
+                                           const glm::ivec2& size,
+                                           unsigned threadCount)
+    : mDevice(device)
+    , mSize(size)
+    , mThreadPool(threadCount)
+    , mDiagonal(nullptr)
+    , mLower(nullptr)
+    , mB(nullptr)
+    , mX(nullptr)
+    , mLocalDiagonal(device, size.x * size.y, VMA_MEMORY_USAGE_CPU_ONLY)
+    , mLocalLower(device, size.x * size.y, VMA_MEMORY_USAGE_CPU_ONLY)
+    , mLocalB(device, size.x * size.y, VMA_MEMORY_USAGE_CPU_ONLY)
+    , mLocalX(device, size.x * size.y, VMA_MEMORY_USAGE_CPU_ONLY)
+    , mData(size)
+    , mD(size.x * size.y)
+    , mLowerX(size.x * size.y)
+    , mLowerY(size.x * size.y)
+    , mPrecon(size.x * size.y)
+    , mR(size.x * size.y)
+    , mZ(size.x * size.y)
+    , mP(size.x * size.y)
+    , mQ(size.x * size.y)
+    , mError(0.0f)
+{
+  // the border cells are not solved, the interior rows are split in strips
+  int rows = std::max(size.y - 2, 0);
+  int stripCount = std::min<int>(mThreadPool.GetThreadCount(), rows / minStripRows);
+  stripCount = std::max(stripCount, rows > 0 ? 1 : 0);
+
+  for (int i = 0; i < stripCount; i++)
+  {
+    mStrips.push_back({1 + i * rows / stripCount, 1 + (i + 1) * rows / stripCount});
+  }
+}
+
+CpuConjugateGradient::~CpuConjugateGradient() {}
+
+void CpuConjugateGradient::Bind(Renderer::GenericBuffer& d,
+                                Renderer::GenericBuffer& l,
+                                Renderer::GenericBuffer& b,
+                                Renderer::GenericBuffer& x)
+{
+  mDiagonal = &d;
+  mLower = &l;
+  mB = &b;
+  mX = &x;
+}
+
+void CpuConjugateGradient::BindRigidbody(float /*delta*/,
+                                         Renderer::GenericBuffer& /*d*/,
+                                         RigidBody& rigidBody)
+{
+  if (rigidBody.GetType() == RigidBody::Type::eStrong)
+  {
+    throw std::runtime_error("Strong coupling not supported for CPU conjugate gradient");
+  }
+}
+
+void CpuConjugateGradient::Solve(Parameters& params,
+                                 const std::vector<RigidBody*>& /*rigidbodies*/)
+{
+  if (mX == nullptr)
+  {
+    throw std::runtime_error("Linear equations not bound");
+  }
+
+  mDevice.Execute([&](vk::CommandBuffer commandBuffer) {
+    mLocalDiagonal.CopyFrom(commandBuffer, *mDiagonal);
+    mLocalLower.CopyFrom(commandBuffer, *mLower);
+    mLocalB.CopyFrom(commandBuffer, *mB);
+    mLocalX.CopyFrom(commandBuffer, *mX);
+  });
+
+  Renderer::CopyTo(mLocalDiagonal, mData.Diagonal);
+  Renderer::CopyTo(mLocalLower, mData.Lower);
+  Renderer::CopyTo(mLocalB, mData.B);
+  Renderer::CopyTo(mLocalX, mData.X);
+
+  Solve(mData, params);
+
+  Renderer::CopyFrom(mLocalX, mData.X);
+  mDevice.Execute([&](vk::CommandBuffer commandBuffer) { mX->CopyFrom(commandBuffer, mLocalX); });
+}
+
+template <typename Function>
+void CpuConjugateGradient::ParallelFor(Function function)
+{
+  std::vector<std::future<void>> futures;
+  for (std::size_t i = 0; i < mStrips.size(); i++)
+  {
+    futures.push_back(mThreadPool.Enqueue([&, i] { function(i, mStrips[i]); }));
+  }
+
+  for (auto& future : futures)
+  {
+    future.get();
+  }
+}
+
+void CpuConjugateGradient::Factor(const Strip& strip)
+{
+  int width = mSize.x;
+  for (int j = strip.Begin; j < strip.End; j++)
+  {
+    for (int i = 1; i < width - 1; i++)
+    {
+      int index = i + j * width;
+      float diagonal = mD[index];
+      if (diagonal == 0.0f)
+      {
+        mPrecon[index] = 0.0f;
+        continue;
+      }
+
+      // the coefficients with the cells of the other strips are dropped
+      float leftPrecon = mPrecon[index - 1];
+      float bottomPrecon = j > strip.Begin ? mPrecon[index - width] : 0.0f;
+      float left = mLowerX[index] * leftPrecon;
+      float bottom = mLowerY[index] * bottomPrecon;
+      float leftUp = j < strip.End - 1 ? mLowerY[index - 1 + width] : 0.0f;
+      float bottomRight = mLowerX[index - width + 1];
+
+      float e = diagonal - left * left - bottom * bottom -
+                tuning * (left * leftUp * leftPrecon + bottom * bottomRight * bottomPrecon);
+
+      if (e < safety * diagonal)
+      {
+        e = diagonal;
+      }
+
+      mPrecon[index] = 1.0f / std::sqrt(e);
+    }
+  }
+}
+
+void CpuConjugateGradient::Precondition(const Strip& strip)
+{
+  int width = mSize.x;
+
+  // solve L q = r
+  for (int j = strip.Begin; j < strip.End; j++)
+  {
+    for (int i = 1; i < width - 1; i++)
+    {
+      int index = i + j * width;
+      if (mD[index] == 0.0f)
+      {
+        mQ[index] = 0.0f;
+        continue;
+      }
+
+      float t = mR[index] - mLowerX[index] * mPrecon[index - 1] * mQ[index - 1];
+      if (j > strip.Begin)
+      {
+        t -= mLowerY[index] * mPrecon[index - width] * mQ[index - width];
+      }
+
+      mQ[index] = t * mPrecon[index];
+    }
+  }
+
+  // solve L^T z = q
+  for (int j = strip.End - 1; j >= strip.Begin; j--)
+  {
+    for (int i = width - 2; i >= 1; i--)
+    {
+      int index = i + j * width;
+      if (mD[index] == 0.0f)
+      {
+        mZ[index] = 0.0f;
+        continue;
+      }
+
+      float t = mQ[index] - mLowerX[index + 1] * mPrecon[index] * mZ[index + 1];
+      if (j < strip.End - 1)
+      {
+        t -= mLowerY[index + width] * mPrecon[index] * mZ[index + width];
+      }
+
+      mZ[index] = t * mPrecon[index];
+    }
+  }
+}
+
+void CpuConjugateGradient::Solve(HostData& data, Parameters& params)
+{
+  std::size_t count = mSize.x * mSize.y;
+  if (data.Diagonal.size() != count || data.Lower.size() != count || data.B.size() != count ||
+      data.X.size() != count)
+  {
+    throw std::runtime_error("Linear equations of a different size");
+  }
+
+  params.Reset();
+
+  int width = mSize.x;
+  std::vector<float> partialSums(mStrips.size()), partialMaxs(mStrips.size());
+
+  // rows of the strip without the border cells
+  auto forRows = [&](const Strip& strip, auto function) {
+    for (int j = strip.Begin; j < strip.End; j++)
+    {
+      function(1 + j * width, width - 1 + j * width);
+    }
+  };
+
+  auto totalSum = [&] {
+    double total = 0.0;
+    for (float partialSum : partialSums)
+      total += partialSum;
+    return static_cast<float>(total);
+  };
+
+  auto totalMax = [&] { return *std::max_element(partialMaxs.begin(), partialMaxs.end()); };
+
+  if (mStrips.empty())
+  {
+    return;
+  }
+
+  for (std::size_t i = 0; i < count; i++)
+  {
+    mD[i] = data.Diagonal[i];
+    mLowerX[i] = data.Lower[i].x;
+    mLowerY[i] = data.Lower[i].y;
+  }
+
+  if (!params.WarmStart)
+  {
+    std::fill(data.X.begin(), data.X.end(), 0.0f);
+  }
+
+  float* x = data.X.data();
+  const float* b = data.B.data();
+
+  // r = b - A x, error with a zero initial guess for the relative tolerance
+  ParallelFor([&](std::size_t index, const Strip& strip) {
+    Factor(strip);
+
+    partialMaxs[index] = 0.0f;
+    forRows(strip, [&](int begin, int end) {
+      CpuKernels::MultiplyDot(
+          mD.data(), mLowerX.data(), mLowerY.data(), x, mQ.data(), begin, end, width);
+      for (int i = begin; i < end; i++)
+      {
+        mR[i] = b[i] - mQ[i];
+      }
+      partialMaxs[index] =
+          std::max(partialMaxs[index], CpuKernels::MaxAbs(b, begin, end));
+    });
+  });
+
+  float initialError = totalMax();
+
+  ParallelFor([&](std::size_t index, const Strip& strip) {
+    partialMaxs[index] = 0.0f;
+    forRows(strip, [&](int begin, int end) {
+      partialMaxs[index] =
+          std::max(partialMaxs[index], CpuKernels::MaxAbs(mR.data(), begin, end));
+    });
+  });
+
+  mError = totalMax();
+
+  if (params.Type == Parameters::SolverType::Iterative)
+  {
+    params.OutError = mError;
+    if (params.OutError <= params.ErrorTolerance)
+    {
+      return;
+    }
+  }
+  else
+  {
+    initialError = 0.0f;
+  }
+
+  // z = M r, p = z, sigma = z . r
+  ParallelFor([&](std::size_t index, const Strip& strip) {
+    Precondition(strip);
+
+    partialSums[index] = 0.0f;
+    forRows(strip, [&](int begin, int end) {
+      std::copy(mZ.begin() + begin, mZ.begin() + end, mP.begin() + begin);
+      partialSums[index] += CpuKernels::Dot(mZ.data(), mR.data(), begin, end);
+    });
+  });
+
+  float sigma = totalSum();
+
+  for (unsigned i = 0; !params.IsFinished(initialError); params.OutIterations = ++i)
+  {
+    // q = A p
+    ParallelFor([&](std::size_t index, const Strip& strip) {
+      partialSums[index] = 0.0f;
+      forRows(strip, [&](int begin, int end) {
+        partialSums[index] += CpuKernels::MultiplyDot(
+            mD.data(), mLowerX.data(), mLowerY.data(), mP.data(), mQ.data(), begin, end, width);
+      });
+    });
+
+    float pq = totalSum();
+    if (pq == 0.0f || !std::isfinite(pq))
+    {
+      break;
+    }
+
+    float alpha = sigma / pq;
+
+    // x += alpha p, r -= alpha q, z = M r
+    ParallelFor([&](std::size_t index, const Strip& strip) {
+      partialMaxs[index] = 0.0f;
+      forRows(strip, [&](int begin, int end) {
+        partialMaxs[index] =
+            std::max(partialMaxs[index],
+                     CpuKernels::Update(x, mR.data(), mP.data(), mQ.data(), alpha, begin, end));
+      });
+
+      Precondition(strip);
+
+      partialSums[index] = 0.0f;
+      forRows(strip, [&](int begin, int end) {
+        partialSums[index] += CpuKernels::Dot(mZ.data(), mR.data(), begin, end);
+      });
+    });
+
+    mError = totalMax();
+    if (params.Type == Parameters::SolverType::Iterative)
+    {
+      params.OutError = mError;
+    }
+
+    float sigmaNew = totalSum();
+    float beta = sigmaNew / sigma;
+    sigma = sigmaNew;
+
+    // p = z + beta p
+    ParallelFor([&](std::size_t /*index*/, const Strip& strip) {
+      forRows(strip, [&](int begin, int end) {
+        CpuKernels::Direction(mZ.data(), beta, mP.data(), begin, end);
+      });
+    });
+  }
+}
+
+float CpuConjugateGradient::GetError()
+{
+  return mError;
+}
+
+}  // namespace Fluid
+}  // namespace Vortex2D
@@ -0,0 +1,122 @@
+//
+//  CpuConjugateGradient.h
+//  Vortex2D
+//
+
+#ifndef Vortex2D_CpuConjugateGradient_h
+#define Vortex2D_CpuConjugateGradient_h
+
+#include <Vortex2D/Engine/LinearSolver/LinearSolver.h>
+#include <Vortex2D/Renderer/Buffer.h>
+#include <Vortex2D/Renderer/ThreadPool.h>
+
+#include <thread>
+#include <vector>
+
+namespace Vortex2D
+{
+namespace Fluid
+{
+/**
+ * @brief A preconditioned conjugate gradient solver running on the CPU, with a
+ * modified incomplete Cholesky preconditioner. It reads the same diagonal,
+ * lower matrix and right hand side as the GPU solvers, either from the bound
+ * buffers, which are copied to the host and back for each solve, or directly
+ * from host copies of the linear equations.
+ *
+ * The grid is split in strips of rows solved by a pool of threads, the
+ * preconditioner being factored independently on each strip. The vector
+ * operations are vectorised with AVX2 when compiled with it, see the
+ * VORTEX2D_ENABLE_AVX2 option.
+ */
+class CpuConjugateGradient : public LinearSolver
+{
+public:
+  /**
+   * @brief Host copy of the linear equations.
+   */
+  struct HostData
+  {
+    VORTEX2D_API HostData(const glm::ivec2& size);
+
+    std::vector<float> Diagonal;
+    std::vector<glm::vec2> Lower;
+    std::vector<float> B;
+    std::vector<float> X;
+  };
+
+  /**
+   * @brief Initialize the solver with a size and number of threads
+   * @param device vulkan device, used to copy the bound buffers
+   * @param size of the linear equations
+   * @param threadCount number of threads solving the equations
+   */
+  VORTEX2D_API CpuConjugateGradient(const Renderer::Device& device,
+                                    const glm::ivec2& size,
+                                    unsigned threadCount = std::thread::hardware_concurrency());
+
+  VORTEX2D_API ~CpuConjugateGradient() override;
+
+  VORTEX2D_API void Bind(Renderer::GenericBuffer& d,
+                         Renderer::GenericBuffer& l,
+                         Renderer::GenericBuffer& b,
+                         Renderer::GenericBuffer& x) override;
+
+  VORTEX2D_API void BindRigidbody(float delta,
+                                  Renderer::GenericBuffer& d,
+                                  RigidBody& rigidBody) override;
+
+  /**
+   * @brief Copy the bound buffers to the host, solve and copy the unknowns
+   * back. Blocking.
+   */
+  VORTEX2D_API void Solve(Parameters& params,
+                          const std::vector<RigidBody*>& rigidbodies = {}) override;
+
+  /**
+   * @brief Solve the host copy of the linear equations, the unknowns are
+   * updated in place.
+   * @param data the linear equations of the size of the solver
+   * @param params solver iteration/error parameters
+   */
+  VORTEX2D_API void Solve(HostData& data, Parameters& params);
+
+  VORTEX2D_API float GetError() override;
+
+private:
+  struct Strip
+  {
+    int Begin;
+    int End;
+  };
+
+  template <typename Function>
+  void ParallelFor(Function function);
+
+  void Factor(const Strip& strip);
+  void Precondition(const Strip& strip);
+
+  const Renderer::Device& mDevice;
+  glm::ivec2 mSize;
+  Renderer::ThreadPool mThreadPool;
+  std::vector<Strip> mStrips;
+
+  Renderer::GenericBuffer* mDiagonal;
+  Renderer::GenericBuffer* mLower;
+  Renderer::GenericBuffer* mB;
+  Renderer::GenericBuffer* mX;
+  Renderer::Buffer<float> mLocalDiagonal;
+  Renderer::Buffer<glm::vec2> mLocalLower;
+  Renderer::Buffer<float> mLocalB;
+  Renderer::Buffer<float> mLocalX;
+  HostData mData;
+
+  std::vector<float> mD, mLowerX, mLowerY, mPrecon;
+  std::vector<float> mR, mZ, mP, mQ;
+  float mError;
+};
+
+}  // namespace Fluid
+}  // namespace Vortex2D
+
+#endif
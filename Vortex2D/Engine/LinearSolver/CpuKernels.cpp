@@ -0,0 +1,181 @@
+//
+//  CpuKernels.cpp
+//  Vortex2D
+//
+
+#include "CpuKernels.h"
+
+// only the intrinsics are included, this file is compiled with the AVX2 flags
+// and must not instantiate inline code shared with the other files
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace Vortex2D
+{
+namespace Fluid
+{
+namespace CpuKernels
+{
+namespace
+{
+#if defined(__AVX2__)
+inline __m256 MultiplyAdd(__m256 a, __m256 b, __m256 c)
+{
+#if defined(__FMA__)
+  return _mm256_fmadd_ps(a, b, c);
+#else
+  return _mm256_add_ps(_mm256_mul_ps(a, b), c);
+#endif
+}
+
+inline float HorizontalSum(__m256 v)
+{
+  __m128 sum = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+  sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+  sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+  return _mm_cvtss_f32(sum);
+}
+
+inline float HorizontalMax(__m256 v)
+{
+  __m128 max = _mm_max_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+  max = _mm_max_ps(max, _mm_movehl_ps(max, max));
+  max = _mm_max_ss(max, _mm_shuffle_ps(max, max, 1));
+  return _mm_cvtss_f32(max);
+}
+
+inline __m256 Abs(__m256 v)
+{
+  return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), v);
+}
+#endif
+
+inline float Abs(float v)
+{
+  return v < 0.0f ? -v : v;
+}
+
+inline float Max(float a, float b)
+{
+  return a < b ? b : a;
+}
+}  // namespace
+
+float MultiplyDot(const float* d,
+                  const float* lowerX,
+                  const float* lowerY,
+                  const float* p,
+                  float* z,
+                  int begin,
+                  int end,
+                  int width)
+{
+  float sum = 0.0f;
+  int i = begin;
+#if defined(__AVX2__)
+  __m256 sum8 = _mm256_setzero_ps();
+  for (; i + 8 <= end; i += 8)
+  {
+    __m256 p8 = _mm256_loadu_ps(p + i);
+    __m256 z8 = _mm256_mul_ps(_mm256_loadu_ps(d + i), p8);
+    z8 = MultiplyAdd(_mm256_loadu_ps(lowerX + i), _mm256_loadu_ps(p + i - 1), z8);
+    z8 = MultiplyAdd(_mm256_loadu_ps(lowerX + i + 1), _mm256_loadu_ps(p + i + 1), z8);
+    z8 = MultiplyAdd(_mm256_loadu_ps(lowerY + i), _mm256_loadu_ps(p + i - width), z8);
+    z8 = MultiplyAdd(_mm256_loadu_ps(lowerY + i + width), _mm256_loadu_ps(p + i + width), z8);
+    _mm256_storeu_ps(z + i, z8);
+    sum8 = MultiplyAdd(z8, p8, sum8);
+  }
+  sum = HorizontalSum(sum8);
+#endif
+  for (; i < end; i++)
+  {
+    z[i] = d[i] * p[i] + lowerX[i] * p[i - 1] + lowerX[i + 1] * p[i + 1] +
+           lowerY[i] * p[i - width] + lowerY[i + width] * p[i + width];
+    sum += z[i] * p[i];
+  }
+  return sum;
+}
+
+float Update(float* x, float* r, const float* p, const float* q, float alpha, int begin, int end)
+{
+  float max = 0.0f;
+  int i = begin;
+#if defined(__AVX2__)
+  __m256 alpha8 = _mm256_set1_ps(alpha);
+  __m256 minusAlpha8 = _mm256_set1_ps(-alpha);
+  __m256 max8 = _mm256_setzero_ps();
+  for (; i + 8 <= end; i += 8)
+  {
+    _mm256_storeu_ps(x + i, MultiplyAdd(alpha8, _mm256_loadu_ps(p + i), _mm256_loadu_ps(x + i)));
+    __m256 r8 = MultiplyAdd(minusAlpha8, _mm256_loadu_ps(q + i), _mm256_loadu_ps(r + i));
+    _mm256_storeu_ps(r + i, r8);
+    max8 = _mm256_max_ps(max8, Abs(r8));
+  }
+  max = HorizontalMax(max8);
+#endif
+  for (; i < end; i++)
+  {
+    x[i] += alpha * p[i];
+    r[i] -= alpha * q[i];
+    max = Max(max, Abs(r[i]));
+  }
+  return max;
+}
+
+float Dot(const float* a, const float* b, int begin, int end)
+{
+  float sum = 0.0f;
+  int i = begin;
+#if defined(__AVX2__)
+  __m256 sum8 = _mm256_setzero_ps();
+  for (; i + 8 <= end; i += 8)
+  {
+    sum8 = MultiplyAdd(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), sum8);
+  }
+  sum = HorizontalSum(sum8);
+#endif
+  for (; i < end; i++)
+  {
+    sum += a[i] * b[i];
+  }
+  return sum;
+}
+
+float MaxAbs(const float* a, int begin, int end)
+{
+  float max = 0.0f;
+  int i = begin;
+#if defined(__AVX2__)
+  __m256 max8 = _mm256_setzero_ps();
+  for (; i + 8 <= end; i += 8)
+  {
+    max8 = _mm256_max_ps(max8, Abs(_mm256_loadu_ps(a + i)));
+  }
+  max = HorizontalMax(max8);
+#endif
+  for (; i < end; i++)
+  {
+    max = Max(max, Abs(a[i]));
+  }
+  return max;
+}
+
+void Direction(const float* z, float beta, float* p, int begin, int end)
+{
+  int i = begin;
+#if defined(__AVX2__)
+  __m256 beta8 = _mm256_set1_ps(beta);
+  for (; i + 8 <= end; i += 8)
+  {
+    _mm256_storeu_ps(p + i, MultiplyAdd(beta8, _mm256_loadu_ps(p + i), _mm256_loadu_ps(z + i)));
+  }
+#endif
+  for (; i < end; i++)
+  {
+    p[i] = z[i] + beta * p[i];
+  }
+}
+}  // namespace CpuKernels
+}  // namespace Fluid
+}  // namespace Vortex2D
@@ -0,0 +1,46 @@
+//
+//  CpuKernels.h
+//  Vortex2D
+//
+
+#ifndef Vortex2D_CpuKernels_h
+#define Vortex2D_CpuKernels_h
+
+namespace Vortex2D
+{
+namespace Fluid
+{
+/**
+ * @brief The vectorised loops of the CPU solver, on a range [begin, end) of
+ * the grid. They are in their own file, which is the only one compiled with
+ * AVX2, so this header must stay free of inline code.
+ */
+namespace CpuKernels
+{
+// z = A p in a row, returns the dot product of z and p
+float MultiplyDot(const float* d,
+                  const float* lowerX,
+                  const float* lowerY,
+                  const float* p,
+                  float* z,
+                  int begin,
+                  int end,
+                  int width);
+
+// x += alpha p and r -= alpha q, returns the max of |r|
+float Update(float* x, float* r, const float* p, const float* q, float alpha, int begin, int end);
+
+// returns the dot product of a and b
+float Dot(const float* a, const float* b, int begin, int end);
+
+// returns the max of |a|
+float MaxAbs(const float* a, int begin, int end);
+
+// p = z + beta p
+void Direction(const float* z, float beta, float* p, int begin, int end);
+
+}  // namespace CpuKernels
+}  // namespace Fluid
+}  // namespace Vortex2D
+
+#endif
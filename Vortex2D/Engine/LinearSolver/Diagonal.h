@@ -31,6 +31,8 @@ public:
 
   void Record(vk::CommandBuffer) override;
 
+  bool ReadsLower() const override { return false; }
+
 private:
   Renderer::Work mDiagonal;
   Renderer::Work::Bound mDiagonalBound;
@@ -13,11 +13,25 @@ namespace Vortex2D
 {
 namespace Fluid
 {
-GaussSeidel::GaussSeidel(const Renderer::Device& device, const glm::ivec2& size)
+GaussSeidel::GaussSeidel(const Renderer::Device& device,
+                         const glm::ivec2& size,
+                         Precision precision)
     : mW(2.0f / (1.0f + std::sin(glm::pi<float>() / std::sqrt((float)(size.x * size.y)))))
     , mPreconditionerIterations(1)
+    , mDelta(0.0f)
+    , mSolidPhi(nullptr)
+    , mLiquidPhi(nullptr)
     , mError(device, size)
-    , mGaussSeidel(device, Renderer::MakeCheckerboardComputeSize(size), SPIRV::GaussSeidel_comp)
+    , mGaussSeidel(device,
+                   Renderer::MakeCheckerboardComputeSize(size),
+                   SPIRV::GaussSeidel_comp,
+                   Renderer::SpecConst(
+                       Renderer::SpecConstValue(3, precision == Precision::Half ? 1 : 0)))
+    , mMatrixFreeGaussSeidel(device,
+                             Renderer::MakeCheckerboardComputeSize(size),
+                             SPIRV::MatrixFreeGaussSeidel_comp,
+                             {},
+                             true)
     , mInitCmd(device, false)
     , mGaussSeidelCmd(device, false)
 {
@@ -35,6 +49,15 @@ void GaussSeidel::SetPreconditionerIterations(int iterations)
   mPreconditionerIterations = iterations;
 }
 
+void GaussSeidel::BindMatrixFree(float delta,
+                                 Renderer::Texture& solidPhi,
+                                 Renderer::Texture& liquidPhi)
+{
+  mDelta = delta;
+  mSolidPhi = &solidPhi;
+  mLiquidPhi = &liquidPhi;
+}
+
 void GaussSeidel::Bind(Renderer::GenericBuffer& d,
                        Renderer::GenericBuffer& l,
                        Renderer::GenericBuffer& div,
@@ -42,8 +65,16 @@ void GaussSeidel::Bind(Renderer::GenericBuffer& d,
 {
   mPressure = &pressure;
 
-  mError.Bind(d, l, div, pressure);
-  mGaussSeidelBound = mGaussSeidel.Bind({pressure, d, l, div});
+  if (mLiquidPhi != nullptr)
+  {
+    mError.BindMatrixFree(mDelta, *mSolidPhi, *mLiquidPhi, div, pressure);
+    mGaussSeidelBound = mMatrixFreeGaussSeidel.Bind({*mLiquidPhi, *mSolidPhi, pressure, d, div});
+  }
+  else
+  {
+    mError.Bind(d, l, div, pressure);
+    mGaussSeidelBound = mGaussSeidel.Bind({pressure, d, l, div});
+  }
 
   mInitCmd.Record([&](vk::CommandBuffer commandBuffer) { pressure.Clear(commandBuffer); });
   mGaussSeidelCmd.Record([&](vk::CommandBuffer commandBuffer) { Record(commandBuffer, 1); });
@@ -98,14 +129,47 @@ void GaussSeidel::Record(vk::CommandBuffer commandBuffer)
 
 void GaussSeidel::Record(vk::CommandBuffer commandBuffer, int iterations)
 {
+  Record(commandBuffer, iterations, nullptr);
+}
+
+void GaussSeidel::RecordIndirect(vk::CommandBuffer commandBuffer,
+                                 Renderer::IndirectBuffer<Renderer::DispatchParams>& dispatchParams)
+{
+  assert(mPressure != nullptr);
+  Record(commandBuffer, mPreconditionerIterations, &dispatchParams);
+}
+
+void GaussSeidel::Record(vk::CommandBuffer commandBuffer,
+                         int iterations,
+                         Renderer::IndirectBuffer<Renderer::DispatchParams>* dispatchParams)
+{
+  auto record = [&](int red) {
+    // the matrix free kernel scales the coefficients by delta
+    if (mLiquidPhi != nullptr)
+    {
+      mGaussSeidelBound.PushConstant(commandBuffer, mW, red, mDelta);
+    }
+    else
+    {
+      mGaussSeidelBound.PushConstant(commandBuffer, mW, red);
+    }
+
+    if (dispatchParams != nullptr)
+    {
+      mGaussSeidelBound.RecordIndirect(commandBuffer, *dispatchParams);
+    }
+    else
+    {
+      mGaussSeidelBound.Record(commandBuffer);
+    }
+  };
+
   for (int i = 0; i < iterations; ++i)
   {
-    mGaussSeidelBound.PushConstant(commandBuffer, mW, 1);
-    mGaussSeidelBound.Record(commandBuffer);
+    record(1);
     mPressure->Barrier(
         commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
-    mGaussSeidelBound.PushConstant(commandBuffer, mW, 0);
-    mGaussSeidelBound.Record(commandBuffer);
+    record(0);
     mPressure->Barrier(
         commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
   }
@@ -120,8 +184,14 @@ Renderer::ComputeSize MakeLocalSize(const glm::ivec2& size)
   return computeSize;
 }
 
-LocalGaussSeidel::LocalGaussSeidel(const Renderer::Device& device, const glm::ivec2& size)
-    : mLocalGaussSeidel(device, MakeLocalSize(size), SPIRV::LocalGaussSeidel_comp)
+LocalGaussSeidel::LocalGaussSeidel(const Renderer::Device& device,
+                                   const glm::ivec2& size,
+                                   LinearSolver::Precision precision)
+    : mLocalGaussSeidel(device,
+                        MakeLocalSize(size),
+                        SPIRV::LocalGaussSeidel_comp,
+                        Renderer::SpecConst(Renderer::SpecConstValue(
+                            3, precision == LinearSolver::Precision::Half ? 1 : 0)))
 {
   // TODO check size is within local size
 }
@@ -22,7 +22,9 @@ namespace Fluid
 class GaussSeidel : public LinearSolver, public Preconditioner
 {
 public:
-  VORTEX2D_API GaussSeidel(const Renderer::Device& device, const glm::ivec2& size);
+  VORTEX2D_API GaussSeidel(const Renderer::Device& device,
+                           const glm::ivec2& size,
+                           Precision precision = Precision::Full);
   VORTEX2D_API ~GaussSeidel() override;
 
   VORTEX2D_API void Bind(Renderer::GenericBuffer& d,
@@ -30,6 +32,10 @@ public:
                          Renderer::GenericBuffer& b,
                          Renderer::GenericBuffer& pressure) override;
 
+  VORTEX2D_API void BindMatrixFree(float delta,
+                                   Renderer::Texture& solidPhi,
+                                   Renderer::Texture& liquidPhi) override;
+
   VORTEX2D_API void BindRigidbody(float delta,
                                   Renderer::GenericBuffer& d,
                                   RigidBody& rigidBody) override;
@@ -51,6 +57,11 @@ public:
    */
   void Record(vk::CommandBuffer commandBuffer, int iterations);
 
+  void RecordIndirect(vk::CommandBuffer commandBuffer,
+                      Renderer::IndirectBuffer<Renderer::DispatchParams>& dispatchParams) override;
+
+  bool ReadsLower() const override { return mLiquidPhi == nullptr; }
+
   /**
    * @brief Set the w factor of the GS iterations : x_new = w * x_new + (1-w) *
    * x_old
@@ -65,12 +76,21 @@ public:
   VORTEX2D_API void SetPreconditionerIterations(int iterations);
 
 private:
+  void Record(vk::CommandBuffer commandBuffer,
+              int iterations,
+              Renderer::IndirectBuffer<Renderer::DispatchParams>* dispatchParams);
+
   float mW;
   int mPreconditionerIterations;
 
+  float mDelta;
+  Renderer::Texture* mSolidPhi;
+  Renderer::Texture* mLiquidPhi;
+
   LinearSolver::Error mError;
 
   Renderer::Work mGaussSeidel;
+  Renderer::Work mMatrixFreeGaussSeidel;
   Renderer::Work::Bound mGaussSeidelBound;
 
   Renderer::CommandBuffer mInitCmd;
@@ -78,6 +98,14 @@ private:
   Renderer::GenericBuffer* mPressure;
 };
 
+/**
+ * @brief Create a ComputeSize of a single (16,16) work group for the domain
+ * size.
+ * @param size the domain size
+ * @return calculate ComputeSize
+ */
+VORTEX2D_API Renderer::ComputeSize MakeLocalSize(const glm::ivec2& size);
+
 /**
  * @brief A version of the gauss seidel that can only be applied on sizes
  * (16,16) or smaller.
@@ -85,7 +113,10 @@ private:
 class LocalGaussSeidel : public Preconditioner
 {
 public:
-  VORTEX2D_API LocalGaussSeidel(const Renderer::Device& device, const glm::ivec2& size);
+  VORTEX2D_API LocalGaussSeidel(
+      const Renderer::Device& device,
+      const glm::ivec2& size,
+      LinearSolver::Precision precision = LinearSolver::Precision::Full);
   VORTEX2D_API ~LocalGaussSeidel() override;
 
   void VORTEX2D_API Bind(Renderer::GenericBuffer& d,
@@ -13,11 +13,21 @@ namespace Vortex2D
 {
 namespace Fluid
 {
-Jacobi::Jacobi(const Renderer::Device& device, const glm::ivec2& size)
+Jacobi::Jacobi(const Renderer::Device& device,
+               const glm::ivec2& size,
+               LinearSolver::Precision precision)
     : mW(1.0f)
     , mPreconditionerIterations(1)
+    , mDelta(0.0f)
+    , mSolidPhi(nullptr)
+    , mLiquidPhi(nullptr)
     , mBackPressure(device, size.x * size.y)
-    , mJacobi(device, size, SPIRV::DampedJacobi_comp)
+    , mJacobi(device,
+              size,
+              SPIRV::DampedJacobi_comp,
+              Renderer::SpecConst(
+                  Renderer::SpecConstValue(3, precision == LinearSolver::Precision::Half ? 1 : 0)))
+    , mMatrixFreeJacobi(device, size, SPIRV::MatrixFreeJacobi_comp, {}, true)
 {
 }
 
@@ -31,14 +41,31 @@ void Jacobi::SetPreconditionerIterations(int iterations)
   mPreconditionerIterations = iterations;
 }
 
+void Jacobi::BindMatrixFree(float delta, Renderer::Texture& solidPhi, Renderer::Texture& liquidPhi)
+{
+  mDelta = delta;
+  mSolidPhi = &solidPhi;
+  mLiquidPhi = &liquidPhi;
+}
+
 void Jacobi::Bind(Renderer::GenericBuffer& d,
                   Renderer::GenericBuffer& l,
                   Renderer::GenericBuffer& div,
                   Renderer::GenericBuffer& pressure)
 {
   mPressure = &pressure;
-  mJacobiFrontBound = mJacobi.Bind({pressure, mBackPressure, d, l, div});
-  mJacobiBackBound = mJacobi.Bind({mBackPressure, pressure, d, l, div});
+  if (mLiquidPhi != nullptr)
+  {
+    mJacobiFrontBound =
+        mMatrixFreeJacobi.Bind({*mLiquidPhi, *mSolidPhi, pressure, mBackPressure, d, div});
+    mJacobiBackBound =
+        mMatrixFreeJacobi.Bind({*mLiquidPhi, *mSolidPhi, mBackPressure, pressure, d, div});
+  }
+  else
+  {
+    mJacobiFrontBound = mJacobi.Bind({pressure, mBackPressure, d, l, div});
+    mJacobiBackBound = mJacobi.Bind({mBackPressure, pressure, d, l, div});
+  }
 }
 
 void Jacobi::Record(vk::CommandBuffer commandBuffer)
@@ -49,16 +76,49 @@ void Jacobi::Record(vk::CommandBuffer commandBuffer)
 
 void Jacobi::Record(vk::CommandBuffer commandBuffer, int iterations)
 {
+  Record(commandBuffer, iterations, nullptr);
+}
+
+void Jacobi::RecordIndirect(vk::CommandBuffer commandBuffer,
+                            Renderer::IndirectBuffer<Renderer::DispatchParams>& dispatchParams)
+{
+  assert(mPressure != nullptr);
+  Record(commandBuffer, mPreconditionerIterations, &dispatchParams);
+}
+
+void Jacobi::Record(vk::CommandBuffer commandBuffer,
+                    int iterations,
+                    Renderer::IndirectBuffer<Renderer::DispatchParams>* dispatchParams)
+{
+  auto record = [&](Renderer::Work::Bound& bound) {
+    // the matrix free kernel scales the coefficients by delta
+    if (mLiquidPhi != nullptr)
+    {
+      bound.PushConstant(commandBuffer, mW, mDelta);
+    }
+    else
+    {
+      bound.PushConstant(commandBuffer, mW);
+    }
+
+    if (dispatchParams != nullptr)
+    {
+      bound.RecordIndirect(commandBuffer, *dispatchParams);
+    }
+    else
+    {
+      bound.Record(commandBuffer);
+    }
+  };
+
   mBackPressure.Clear(commandBuffer);
 
   for (int i = 0; i < iterations; i++)
   {
-    mJacobiFrontBound.PushConstant(commandBuffer, mW);
-    mJacobiFrontBound.Record(commandBuffer);
+    record(mJacobiFrontBound);
     mBackPressure.Barrier(
         commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
-    mJacobiBackBound.PushConstant(commandBuffer, mW);
-    mJacobiBackBound.Record(commandBuffer);
+    record(mJacobiBackBound);
     mPressure->Barrier(
         commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
   }
@@ -23,38 +23,59 @@ namespace Fluid
 class Jacobi : public Preconditioner
 {
 public:
-  Jacobi(const Renderer::Device& device, const glm::ivec2& size);
+  VORTEX2D_API Jacobi(const Renderer::Device& device,
+                      const glm::ivec2& size,
+                      LinearSolver::Precision precision = LinearSolver::Precision::Full);
 
-  void Bind(Renderer::GenericBuffer& d,
-            Renderer::GenericBuffer& l,
-            Renderer::GenericBuffer& b,
-            Renderer::GenericBuffer& pressure) override;
+  VORTEX2D_API void Bind(Renderer::GenericBuffer& d,
+                         Renderer::GenericBuffer& l,
+                         Renderer::GenericBuffer& b,
+                         Renderer::GenericBuffer& pressure) override;
 
-  void Record(vk::CommandBuffer commandBuffer) override;
+  VORTEX2D_API void BindMatrixFree(float delta,
+                                   Renderer::Texture& solidPhi,
+                                   Renderer::Texture& liquidPhi) override;
 
-  void Record(vk::CommandBuffer commandBuffer, int iterations);
+  VORTEX2D_API void Record(vk::CommandBuffer commandBuffer) override;
+
+  VORTEX2D_API void Record(vk::CommandBuffer commandBuffer, int iterations);
+
+  VORTEX2D_API void RecordIndirect(
+      vk::CommandBuffer commandBuffer,
+      Renderer::IndirectBuffer<Renderer::DispatchParams>& dispatchParams) override;
+
+  bool ReadsLower() const override { return mLiquidPhi == nullptr; }
 
   /**
    * @brief Set the w factor of the GS iterations : x_new = w * x_new + (1-w) *
    * x_old
    * @param w
    */
-  void SetW(float w);
+  VORTEX2D_API void SetW(float w);
 
   /**
    * @brief set number of iterations to be used when GS is a preconditioner
    * @param iterations
    */
-  void SetPreconditionerIterations(int iterations);
+  VORTEX2D_API void SetPreconditionerIterations(int iterations);
 
 private:
+  void Record(vk::CommandBuffer commandBuffer,
+              int iterations,
+              Renderer::IndirectBuffer<Renderer::DispatchParams>* dispatchParams);
+
   float mW;
   int mPreconditionerIterations;
 
+  float mDelta;
+  Renderer::Texture* mSolidPhi;
+  Renderer::Texture* mLiquidPhi;
+
   Renderer::GenericBuffer* mPressure;
   Renderer::Buffer<float> mBackPressure;
 
   Renderer::Work mJacobi;
+  Renderer::Work mMatrixFreeJacobi;
   Renderer::Work::Bound mJacobiFrontBound;
   Renderer::Work::Bound mJacobiBackBound;
 };
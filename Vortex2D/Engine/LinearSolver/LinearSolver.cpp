@@ -5,16 +5,122 @@
 
 #include "LinearSolver.h"
 
+#include <Vortex2D/Renderer/Profiler.h>
+
+#include <cstring>
+#include <fstream>
+#include <limits>
+
 #include "vortex2d_generated_spirv.h"
 
 namespace Vortex2D
 {
 namespace Fluid
 {
+namespace
+{
+const char captureMagic[4] = {'V', '2', 'L', 'S'};
+const uint32_t captureVersion = 1;
+
+template <typename T>
+void ReadBuffer(const Renderer::Device& device, Renderer::Buffer<T>& buffer, std::vector<T>& data)
+{
+  Renderer::Buffer<T> localBuffer(device, data.size(), VMA_MEMORY_USAGE_CPU_ONLY);
+  device.Execute(
+      [&](vk::CommandBuffer commandBuffer) { localBuffer.CopyFrom(commandBuffer, buffer); });
+  Renderer::CopyTo(localBuffer, data);
+}
+
+template <typename T>
+void WriteBuffer(const Renderer::Device& device,
+                 Renderer::Buffer<T>& buffer,
+                 const std::vector<T>& data)
+{
+  Renderer::Buffer<T> localBuffer(device, data.size(), VMA_MEMORY_USAGE_CPU_ONLY);
+  Renderer::CopyFrom(localBuffer, data);
+  device.Execute(
+      [&](vk::CommandBuffer commandBuffer) { buffer.CopyFrom(commandBuffer, localBuffer); });
+}
+
+void ReadTexture(const Renderer::Device& device,
+                 Renderer::Texture& texture,
+                 std::vector<float>& data)
+{
+  Renderer::Texture localTexture(device,
+                                 texture.GetWidth(),
+                                 texture.GetHeight(),
+                                 vk::Format::eR32Sfloat,
+                                 VMA_MEMORY_USAGE_CPU_ONLY);
+  device.Execute(
+      [&](vk::CommandBuffer commandBuffer) { localTexture.CopyFrom(commandBuffer, texture); });
+  localTexture.CopyTo(data);
+}
+
+void WriteTexture(const Renderer::Device& device,
+                  Renderer::Texture& texture,
+                  const std::vector<float>& data)
+{
+  Renderer::Texture localTexture(device,
+                                 texture.GetWidth(),
+                                 texture.GetHeight(),
+                                 vk::Format::eR32Sfloat,
+                                 VMA_MEMORY_USAGE_CPU_ONLY);
+  localTexture.CopyFrom(data);
+  device.Execute(
+      [&](vk::CommandBuffer commandBuffer) { texture.CopyFrom(commandBuffer, localTexture); });
+}
+
+template <typename T>
+void Write(std::ostream& stream, const T& value)
+{
+  stream.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+void Read(std::istream& stream, T& value)
+{
+  if (!stream.read(reinterpret_cast<char*>(&value), sizeof(T)))
+    throw std::runtime_error("Invalid capture file");
+}
+
+template <typename T>
+void Write(std::ostream& stream, const std::vector<T>& data)
+{
+  stream.write(reinterpret_cast<const char*>(data.data()), sizeof(T) * data.size());
+}
+
+template <typename T>
+void Read(std::istream& stream, std::vector<T>& data)
+{
+  if (!stream.read(reinterpret_cast<char*>(data.data()), sizeof(T) * data.size()))
+    throw std::runtime_error("Invalid capture file");
+}
+
+LinearSolver::Data::CaptureInfo ReadHeader(std::istream& stream)
+{
+  char magic[4];
+  uint32_t version, levelSets;
+  LinearSolver::Data::CaptureInfo info;
+
+  Read(stream, magic);
+  Read(stream, version);
+  if (std::memcmp(magic, captureMagic, sizeof(magic)) != 0 || version != captureVersion)
+    throw std::runtime_error("Invalid capture file");
+
+  Read(stream, info.Size);
+  Read(stream, info.Delta);
+  Read(stream, levelSets);
+  info.LevelSets = levelSets != 0;
+
+  return info;
+}
+}  // namespace
+
 LinearSolver::Parameters::Parameters(SolverType type, unsigned iterations, float errorTolerance)
     : Type(type)
     , Iterations(iterations)
     , ErrorTolerance(errorTolerance)
+    , WarmStart(false)
     , OutIterations(0)
     , OutError(0.0f)
 {
@@ -22,11 +128,15 @@ LinearSolver::Parameters::Parameters(SolverType type, unsigned iterations, float
 
 LinearSolver::Data::Data(const Renderer::Device& device,
                          const glm::ivec2& size,
-                         VmaMemoryUsage memoryUsage)
+                         VmaMemoryUsage memoryUsage,
+                         Matrix matrix)
     : Diagonal(device, size.x * size.y, memoryUsage)
-    , Lower(device, size.x * size.y, memoryUsage)
+    , Lower(device, matrix == Matrix::Explicit ? size.x * size.y : 1, memoryUsage)
     , B(device, size.x * size.y, memoryUsage)
     , X(device, size.x * size.y, memoryUsage)
+    , mDevice(&device)
+    , mSize(size)
+    , mMatrix(matrix)
 {
   device.Execute([&](vk::CommandBuffer commandBuffer) {
     Diagonal.Clear(commandBuffer);
@@ -36,6 +146,102 @@ LinearSolver::Data::Data(const Renderer::Device& device,
   });
 }
 
+void LinearSolver::Data::Capture(const std::string& filename,
+                                 float delta,
+                                 Renderer::Texture* liquidPhi,
+                                 Renderer::Texture* solidPhi)
+{
+  if (mMatrix != Matrix::Explicit)
+    throw std::runtime_error("Cannot capture matrix free equations");
+
+  if ((liquidPhi == nullptr) != (solidPhi == nullptr))
+    throw std::runtime_error("Both level sets need to be captured");
+
+  std::size_t count = mSize.x * mSize.y;
+  std::vector<float> diagonal(count), b(count);
+  std::vector<glm::vec2> lower(count);
+
+  ReadBuffer(*mDevice, Diagonal, diagonal);
+  ReadBuffer(*mDevice, Lower, lower);
+  ReadBuffer(*mDevice, B, b);
+
+  std::ofstream file(filename, std::ios::binary);
+  if (!file.is_open())
+    throw std::runtime_error("Couldn't open capture file: " + filename);
+
+  Write(file, captureMagic);
+  Write(file, captureVersion);
+  Write(file, mSize);
+  Write(file, delta);
+  Write(file, static_cast<uint32_t>(liquidPhi != nullptr));
+
+  Write(file, diagonal);
+  Write(file, lower);
+  Write(file, b);
+
+  if (liquidPhi != nullptr)
+  {
+    std::vector<float> phi(count);
+    ReadTexture(*mDevice, *liquidPhi, phi);
+    Write(file, phi);
+    ReadTexture(*mDevice, *solidPhi, phi);
+    Write(file, phi);
+  }
+
+  if (!file)
+    throw std::runtime_error("Couldn't write capture file: " + filename);
+}
+
+void LinearSolver::Data::Replay(const std::string& filename,
+                                Renderer::Texture* liquidPhi,
+                                Renderer::Texture* solidPhi)
+{
+  if (mMatrix != Matrix::Explicit)
+    throw std::runtime_error("Cannot replay in matrix free equations");
+
+  std::ifstream file(filename, std::ios::binary);
+  if (!file.is_open())
+    throw std::runtime_error("Couldn't open capture file: " + filename);
+
+  auto info = ReadHeader(file);
+  if (info.Size != mSize)
+    throw std::runtime_error("Captured equations of a different size");
+
+  std::size_t count = mSize.x * mSize.y;
+  std::vector<float> diagonal(count), b(count);
+  std::vector<glm::vec2> lower(count);
+
+  Read(file, diagonal);
+  Read(file, lower);
+  Read(file, b);
+
+  WriteBuffer(*mDevice, Diagonal, diagonal);
+  WriteBuffer(*mDevice, Lower, lower);
+  WriteBuffer(*mDevice, B, b);
+  mDevice->Execute([&](vk::CommandBuffer commandBuffer) { X.Clear(commandBuffer); });
+
+  if (info.LevelSets)
+  {
+    std::vector<float> phi(count);
+    Read(file, phi);
+    if (liquidPhi != nullptr)
+      WriteTexture(*mDevice, *liquidPhi, phi);
+
+    Read(file, phi);
+    if (solidPhi != nullptr)
+      WriteTexture(*mDevice, *solidPhi, phi);
+  }
+}
+
+LinearSolver::Data::CaptureInfo LinearSolver::Data::ReadCaptureInfo(const std::string& filename)
+{
+  std::ifstream file(filename, std::ios::binary);
+  if (!file.is_open())
+    throw std::runtime_error("Couldn't open capture file: " + filename);
+
+  return ReadHeader(file);
+}
+
 LinearSolver::DebugData::DebugData(const Renderer::Device& device, const glm::ivec2& size)
     : Diagonal(device, size.x, size.y, vk::Format::eR32Sfloat)
     , Lower(device, size.x, size.y, vk::Format::eR32G32Sfloat)
@@ -60,10 +266,10 @@ LinearSolver::DebugCopy::DebugCopy(const Renderer::Device& device,
     , mCopy(device, false)
 {
   mCopy.Record([&](vk::CommandBuffer commandBuffer) {
-    commandBuffer.debugMarkerBeginEXT({"Debug data copy", {{0.30f, 0.01f, 0.19f, 1.0f}}},
-                                      device.Loader());
+    Renderer::BeginMarker(
+        device, commandBuffer, {"Debug data copy", {{0.30f, 0.01f, 0.19f, 1.0f}}});
     mDebugDataCopyBound.Record(commandBuffer);
-    commandBuffer.debugMarkerEndEXT(device.Loader());
+    Renderer::EndMarker(device, commandBuffer);
   });
 }
 
@@ -95,6 +301,24 @@ void LinearSolver::Parameters::Reset()
   OutIterations = 0;
 }
 
+LinearSolver::ErrorCheck LinearSolver::ErrorCheck::Make(const Parameters& params,
+                                                        float initialError)
+{
+  ErrorCheck check;
+  if (params.Iterations > 0)
+  {
+    check.tolerance = params.ErrorTolerance * initialError;
+    check.maxIterations = params.Iterations;
+  }
+  else
+  {
+    check.tolerance = params.ErrorTolerance;
+    check.maxIterations = std::numeric_limits<uint32_t>::max();
+  }
+
+  return check;
+}
+
 LinearSolver::Parameters FixedParams(unsigned iterations)
 {
   return LinearSolver::Parameters(LinearSolver::Parameters::SolverType::Fixed, iterations);
@@ -110,7 +334,10 @@ LinearSolver::Error::Error(const Renderer::Device& device, const glm::ivec2& siz
     : mResidual(device, size.x * size.y)
     , mError(device)
     , mLocalError(device, 1, VMA_MEMORY_USAGE_GPU_TO_CPU)
+    , mDelta(0.0f)
+    , mMatrixFree(false)
     , mResidualWork(device, size, SPIRV::Residual_comp)
+    , mMatrixFreeResidualWork(device, size, SPIRV::MatrixFreeResidual_comp, {}, true)
     , mReduceMax(device, size)
     , mReduceMaxBound(mReduceMax.Bind(mResidual, mError))
     , mErrorCmd(device)
@@ -122,19 +349,46 @@ void LinearSolver::Error::Bind(Renderer::GenericBuffer& d,
                                Renderer::GenericBuffer& div,
                                Renderer::GenericBuffer& pressure)
 {
+  mMatrixFree = false;
   mResidualBound = mResidualWork.Bind({pressure, d, l, div, mResidual});
 
-  mErrorCmd.Record([&](vk::CommandBuffer commandBuffer) {
-    mResidualBound.Record(commandBuffer);
-    mResidual.Barrier(
-        commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+  mErrorCmd.Record([&](vk::CommandBuffer commandBuffer) { Record(commandBuffer); });
+}
 
-    mReduceMaxBound.Record(commandBuffer);
-    mError.Barrier(
-        commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+void LinearSolver::Error::BindMatrixFree(float delta,
+                                         Renderer::Texture& solidPhi,
+                                         Renderer::Texture& liquidPhi,
+                                         Renderer::GenericBuffer& div,
+                                         Renderer::GenericBuffer& pressure)
+{
+  mDelta = delta;
+  mMatrixFree = true;
+  mResidualBound =
+      mMatrixFreeResidualWork.Bind({liquidPhi, solidPhi, pressure, div, mResidual});
 
-    mLocalError.CopyFrom(commandBuffer, mError);
-  });
+  mErrorCmd.Record([&](vk::CommandBuffer commandBuffer) { Record(commandBuffer); });
+}
+
+void LinearSolver::Error::Record(vk::CommandBuffer commandBuffer)
+{
+  if (mMatrixFree)
+  {
+    mResidualBound.PushConstant(commandBuffer, mDelta);
+  }
+
+  mResidualBound.Record(commandBuffer);
+  mResidual.Barrier(
+      commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+
+  mReduceMaxBound.Record(commandBuffer);
+  mError.Barrier(commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+
+  mLocalError.CopyFrom(commandBuffer, mError);
+}
+
+Renderer::Buffer<float>& LinearSolver::Error::GetDeviceError()
+{
+  return mError;
 }
 
 LinearSolver::Error& LinearSolver::Error::Submit()
@@ -13,6 +13,8 @@
 
 #include <Vortex2D/Engine/LinearSolver/Reduce.h>
 
+#include <string>
+
 namespace Vortex2D
 {
 namespace Fluid
@@ -62,23 +64,126 @@ struct LinearSolver
     SolverType Type;
     unsigned Iterations;
     float ErrorTolerance;
+
+    /**
+     * @brief Start from the current value of the unknowns instead of zero.
+     * The relative error tolerance is still relative to the error of a zero
+     * initial guess, so fewer iterations are needed to reach it.
+     */
+    bool WarmStart;
+
     unsigned OutIterations;
     float OutError;
   };
 
+  /**
+   * @brief Storage precision of the matrix of the linear equations. With half
+   * precision, the lower matrix is stored as two packed halfs. The diagonal,
+   * right hand side and unknowns stay in full precision: they are stored per
+   * cell and neighbouring cells are written concurrently, so they can't be
+   * packed in pairs.
+   */
+  enum class Precision
+  {
+    Full,
+    Half,
+  };
+
+  /**
+   * @brief Storage of the matrix of the linear equations. A matrix free
+   * system only stores the diagonal, the other coefficients are computed on
+   * the fly from the level sets.
+   */
+  enum class Matrix
+  {
+    Explicit,
+    Free,
+  };
+
+  /**
+   * @brief Convergence criteria read on the GPU by the error check kernel,
+   * which counts the iterations and sets the indirect dispatches of the next
+   * iteration, empty once converged.
+   */
+  struct ErrorCheck
+  {
+    /**
+     * @brief The criteria of the parameters, the tolerance is relative to the
+     * initial error if the number of iterations is limited.
+     * @param params solver iteration/error parameters
+     * @param initialError the error of a zero initial guess
+     */
+    VORTEX2D_API static ErrorCheck Make(const Parameters& params, float initialError);
+
+    alignas(4) float tolerance;
+    alignas(4) uint32_t maxIterations;
+  };
+
   /**
    * @brief The various parts of linear equations.
    */
   struct Data
   {
+    /**
+     * @brief Allocate the linear equations. With a matrix free system, the
+     * lower matrix has a single element and cannot be used.
+     */
     VORTEX2D_API Data(const Renderer::Device& device,
                       const glm::ivec2& size,
-                      VmaMemoryUsage memoryUsage = VMA_MEMORY_USAGE_GPU_ONLY);
+                      VmaMemoryUsage memoryUsage = VMA_MEMORY_USAGE_GPU_ONLY,
+                      Matrix matrix = Matrix::Explicit);
+
+    /**
+     * @brief Header of a captured linear equations file.
+     */
+    struct CaptureInfo
+    {
+      glm::ivec2 Size;
+      float Delta;
+      bool LevelSets;
+    };
+
+    /**
+     * @brief Write the diagonal, lower matrix and right hand side to a binary
+     * file, to replay the equations offline. The time step and level sets the
+     * equations were built with can be added, they are needed to replay with
+     * the multigrid preconditioner. Blocking.
+     * @param filename file to write to
+     * @param delta time step of the equations
+     * @param liquidPhi optional liquid level set
+     * @param solidPhi optional solid level set
+     */
+    VORTEX2D_API void Capture(const std::string& filename,
+                              float delta = 0.0f,
+                              Renderer::Texture* liquidPhi = nullptr,
+                              Renderer::Texture* solidPhi = nullptr);
+
+    /**
+     * @brief Read the equations written with @ref Capture, of the same size.
+     * The unknowns are cleared. Blocking.
+     * @param filename file to read from
+     * @param liquidPhi optional liquid level set, set if it was captured
+     * @param solidPhi optional solid level set, set if it was captured
+     */
+    VORTEX2D_API void Replay(const std::string& filename,
+                             Renderer::Texture* liquidPhi = nullptr,
+                             Renderer::Texture* solidPhi = nullptr);
+
+    /**
+     * @brief Read the header of a file written with @ref Capture.
+     * @param filename file to read from
+     */
+    VORTEX2D_API static CaptureInfo ReadCaptureInfo(const std::string& filename);
 
     Renderer::Buffer<float> Diagonal;
     Renderer::Buffer<glm::vec2> Lower;
     Renderer::Buffer<float> B;
     Renderer::Buffer<float> X;
+
+  private:
+    const Renderer::Device* mDevice;
+    glm::ivec2 mSize;
+    Matrix mMatrix;
   };
 
   /**
@@ -168,12 +273,40 @@ struct LinearSolver
                            Renderer::GenericBuffer& div,
                            Renderer::GenericBuffer& pressure);
 
+    /**
+     * @brief Bind the linear system, computing the matrix from the level sets
+     * instead of reading the diagonal and lower matrix.
+     * @param delta solver delta
+     * @param solidPhi solid level set
+     * @param liquidPhi liquid level set
+     * @param b the right hand side
+     * @param x the unknowns
+     */
+    VORTEX2D_API void BindMatrixFree(float delta,
+                                     Renderer::Texture& solidPhi,
+                                     Renderer::Texture& liquidPhi,
+                                     Renderer::GenericBuffer& div,
+                                     Renderer::GenericBuffer& pressure);
+
     /**
      * Submit the error calculation.
      * @return this.
      */
     VORTEX2D_API Error& Submit();
 
+    /**
+     * @brief Record the error calculation and its read back in a command
+     * buffer.
+     * @param commandBuffer the command buffer to record into.
+     */
+    VORTEX2D_API void Record(vk::CommandBuffer commandBuffer);
+
+    /**
+     * @brief The maximum error on the device, as read by the error check
+     * kernel.
+     */
+    VORTEX2D_API Renderer::Buffer<float>& GetDeviceError();
+
     /**
      * @brief Wait for error to be calculated.
      * @return this.
@@ -190,7 +323,11 @@ struct LinearSolver
     Renderer::Buffer<float> mResidual;
     Renderer::Buffer<float> mError, mLocalError;
 
+    float mDelta;
+    bool mMatrixFree;
+
     Renderer::Work mResidualWork;
+    Renderer::Work mMatrixFreeResidualWork;
     Renderer::Work::Bound mResidualBound;
 
     ReduceMax mReduceMax;
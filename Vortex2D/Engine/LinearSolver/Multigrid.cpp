@@ -5,7 +5,13 @@
 
 #include "Multigrid.h"
 
+#include <Vortex2D/Engine/LinearSolver/ConjugateGradient.h>
 #include <Vortex2D/Engine/Pressure.h>
+#include <Vortex2D/Engine/Rigidbody.h>
+#include <Vortex2D/Renderer/Profiler.h>
+
+#include <algorithm>
+#include <limits>
 
 #include "vortex2d_generated_spirv.h"
 
@@ -13,18 +19,79 @@ namespace Vortex2D
 {
 namespace Fluid
 {
+/**
+ * @brief Solver used with strongly coupled rigidbodies. Their term can't be
+ * applied at each smoothing step, so the coupled system is solved with a PCG
+ * preconditioned by a V-cycle. The cycles are bound to the separate buffers
+ * rhs and x, so b and the pressure are left to the PCG.
+ */
+struct Multigrid::Coupling : Preconditioner
+{
+  Coupling(const Renderer::Device& device, const glm::ivec2& size, Multigrid& parent)
+      : rhs(device, size.x * size.y)
+      , x(device, size.x * size.y)
+      , multigrid(parent)
+      , solver(device, size, *this)
+      , setRhs(device, false)
+      , copyX(device, false)
+  {
+  }
+
+  void Bind(Renderer::GenericBuffer& /*d*/,
+            Renderer::GenericBuffer& /*l*/,
+            Renderer::GenericBuffer& b,
+            Renderer::GenericBuffer& pressure) override
+  {
+    residual = &b;
+    result = &pressure;
+  }
+
+  void Record(vk::CommandBuffer commandBuffer) override
+  {
+    rhs.CopyFrom(commandBuffer, *residual);
+    multigrid.Record(commandBuffer);
+    result->CopyFrom(commandBuffer, x);
+  }
+
+  bool ReadsLower() const override { return multigrid.ReadsLower(); }
+
+  // without strongly coupled rigidbodies, the cycles solve on copies of b and
+  // the pressure
+  void BindCycles(Renderer::GenericBuffer& b, Renderer::GenericBuffer& pressure)
+  {
+    setRhs.Record([&](vk::CommandBuffer commandBuffer) {
+      rhs.CopyFrom(commandBuffer, b);
+      x.CopyFrom(commandBuffer, pressure);
+    });
+    copyX.Record([&](vk::CommandBuffer commandBuffer) { pressure.CopyFrom(commandBuffer, x); });
+  }
+
+  Renderer::Buffer<float> rhs, x;
+  Multigrid& multigrid;
+  ConjugateGradient solver;
+  Renderer::GenericBuffer* residual = nullptr;
+  Renderer::GenericBuffer* result = nullptr;
+  Renderer::CommandBuffer setRhs, copyX;
+};
+
+// the coarsest level is solved in a single work group
+const int max_coarse_size = 16;
+const int min_size = 3;
+const int max_coarse_iterations = 64;
+
 Depth::Depth(const glm::ivec2& size)
 {
   auto s = size;
   mDepths.push_back(s);
 
-  const float min_size = 16.0f;
-  while (s.x > min_size && s.y > min_size)
+  while (s.x > max_coarse_size || s.y > max_coarse_size)
   {
-    if (s.x % 2 != 0 || s.y % 2 != 0)
-      throw std::runtime_error("Invalid multigrid size");
+    // thin domains stop coarsening before the short side gets too small
+    auto coarse = (s + glm::ivec2(1)) / glm::ivec2(2);
+    if (coarse.x < min_size || coarse.y < min_size)
+      break;
 
-    s = s / glm::ivec2(2);
+    s = coarse;
     mDepths.push_back(s);
   }
 }
@@ -40,14 +107,20 @@ glm::ivec2 Depth::GetDepthSize(std::size_t i) const
   return mDepths[i];
 }
 
+bool Depth::IsCoarsestLocal() const
+{
+  return mDepths.back().x <= max_coarse_size && mDepths.back().y <= max_coarse_size;
+}
+
 std::unique_ptr<Preconditioner> MakeSmoother(const Renderer::Device& device,
                                              glm::ivec2 size,
                                              Multigrid::SmootherSolver smoother,
-                                             int numSmoothingIterations)
+                                             int numSmoothingIterations,
+                                             LinearSolver::Precision precision)
 {
   if (smoother == Multigrid::SmootherSolver::Jacobi)
   {
-    auto solver = std::make_unique<Jacobi>(device, size);
+    auto solver = std::make_unique<Jacobi>(device, size, precision);
     solver->SetPreconditionerIterations(numSmoothingIterations);
     solver->SetW(2.0f / 3.0f);
 
@@ -55,7 +128,7 @@ std::unique_ptr<Preconditioner> MakeSmoother(const Renderer::Device& device,
   }
   else if (smoother == Multigrid::SmootherSolver::GaussSeidel)
   {
-    auto solver = std::make_unique<GaussSeidel>(device, size);
+    auto solver = std::make_unique<GaussSeidel>(device, size, precision);
     solver->SetPreconditionerIterations(numSmoothingIterations);
     solver->SetW(2.0f / 3.0f);
 
@@ -69,72 +142,338 @@ Multigrid::Multigrid(const Renderer::Device& device,
                      const glm::ivec2& size,
                      float delta,
                      int numSmoothingIterations,
-                     SmootherSolver smoother)
+                     SmootherSolver smoother,
+                     Precision precision)
     : mDevice(device)
     , mDepth(size)
     , mDelta(delta)
     , mNumSmoothingIterations(numSmoothingIterations)
+    , mSmootherSolver(smoother)
+    , mPrecision(precision)
+    , mCycle(CycleType::V)
     , mResidualWork(device, size, SPIRV::Residual_comp)
+    , mCoarseResidualWork(
+          device,
+          size,
+          SPIRV::Residual_comp,
+          Renderer::SpecConst(Renderer::SpecConstValue(3, precision == Precision::Half ? 1 : 0)))
+    , mMatrixFreeResidualWork(device, size, SPIRV::MatrixFreeResidual_comp, {}, true)
+    , mMaskPressureWork(device, size, SPIRV::MaskPressure_comp)
     , mTransfer(device)
     , mPhiScaleWork(device, size, SPIRV::PhiScale_comp)
-    , mSmoother(device, mDepth.GetDepthSize(mDepth.GetMaxDepth()))
+    , mSmoother(device,
+                mDepth.GetDepthSize(mDepth.GetMaxDepth()),
+                mDepth.GetMaxDepth() == 0 ? Precision::Full : precision)
+    , mCoarseCycleWork(
+          device,
+          MakeLocalSize(mDepth.GetDepthSize(std::max(mDepth.GetMaxDepth() - 1, 0))),
+          SPIRV::CoarseCycle_comp,
+          Renderer::SpecConst(
+              Renderer::SpecConstValue(
+                  3, precision == Precision::Half && mDepth.GetMaxDepth() > 1 ? 1 : 0),
+              Renderer::SpecConstValue(4, precision == Precision::Half ? 1 : 0)))
     , mBuildHierarchies(device, false)
     , mFullCycleSolver(device, false)
-    , mVCycleSolver(device, false)
+    , mCycleSolver(device, false)
+    , mWarmStart(device, false)
     , mError(device, size)
+    , mReduceMax(device, size)
+    , mInitialError(device)
+    , mLocalInitialError(device, 1, VMA_MEMORY_USAGE_GPU_TO_CPU)
+    , mInitialErrorRead(device)
+    , mBatchIterations(4)
+    , mErrorCheck(device, 1, VMA_MEMORY_USAGE_CPU_TO_GPU)
+    , mIterations(device, 1)
+    , mIterationsCopy(device, 1)
+    , mLocalIterations(device, 1, VMA_MEMORY_USAGE_GPU_TO_CPU)
+    , mDispatchParams(device)
+    , mSmootherDispatchParams(device)
+    , mErrorCheckWork(device, glm::ivec2(1), SPIRV::ErrorCheck_comp)
+    , mCycleBatch(device)
 {
   for (int i = 1; i <= mDepth.GetMaxDepth(); i++)
   {
     auto s = mDepth.GetDepthSize(i);
-    mDatas.emplace_back(device, s);
+    // with half precision, the lower matrix is only stored packed
+    mDatas.emplace_back(device,
+                        s,
+                        VMA_MEMORY_USAGE_GPU_ONLY,
+                        precision == Precision::Half ? LinearSolver::Matrix::Free
+                                                     : LinearSolver::Matrix::Explicit);
 
     mSolidPhis.emplace_back(device, s);
     mLiquidPhis.emplace_back(device, s);
+
+    if (precision == Precision::Half)
+    {
+      mHalfLowers.emplace_back(device, s.x * s.y);
+    }
   }
 
   for (int i = 0; i < mDepth.GetMaxDepth(); i++)
   {
     auto s = mDepth.GetDepthSize(i);
     mResiduals.emplace_back(device, s.x * s.y);
-    mSmoothers.emplace_back(MakeSmoother(device, s, smoother, numSmoothingIterations));
+    // the finest level is always in full precision
+    auto levelPrecision = i == 0 ? Precision::Full : precision;
+    mSmoothers.emplace_back(
+        MakeSmoother(device, s, smoother, numSmoothingIterations, levelPrecision));
+  }
+
+  if (!mDepth.IsCoarsestLocal())
+  {
+    // the coarsest level of a thin domain is only approximately solved
+    auto s = mDepth.GetDepthSize(mDepth.GetMaxDepth());
+    auto levelPrecision = mDepth.GetMaxDepth() == 0 ? Precision::Full : precision;
+    mCoarseSmoother = MakeSmoother(device,
+                                   s,
+                                   smoother,
+                                   std::min(2 * std::max(s.x, s.y), max_coarse_iterations),
+                                   levelPrecision);
   }
 
   int depth = mDepth.GetMaxDepth() - 1;
-  mSmoother.Bind(mDatas[depth].Diagonal, mDatas[depth].Lower, mDatas[depth].B, mDatas[depth].X);
+  if (depth >= 0)
+  {
+    CoarsestBind(
+        mDatas[depth].Diagonal, CycleLower(depth), mDatas[depth].B, mDatas[depth].X);
+  }
   mResidualWorkBound.resize(mDepth.GetMaxDepth() + 1);
 }
 
 Multigrid::~Multigrid() {}
 
+void Multigrid::BindMatrixFree(float delta,
+                               Renderer::Texture& solidPhi,
+                               Renderer::Texture& liquidPhi)
+{
+  if (mDepth.GetMaxDepth() == 0)
+  {
+    throw std::runtime_error("Matrix free multigrid requires a coarser level");
+  }
+
+  mMatrixFreeDelta = delta;
+  mSolidPhi = &solidPhi;
+  mLiquidPhi = &liquidPhi;
+
+  mSmoothers[0]->BindMatrixFree(delta, solidPhi, liquidPhi);
+  if (mCoupling)
+  {
+    mCoupling->solver.BindMatrixFree(delta, solidPhi, liquidPhi);
+  }
+}
+
 void Multigrid::Bind(Renderer::GenericBuffer& d,
                      Renderer::GenericBuffer& l,
                      Renderer::GenericBuffer& b,
                      Renderer::GenericBuffer& pressure)
 
 {
+  mDiagonal = &d;
+  mLower = &l;
   mPressure = &pressure;
+  mB = &b;
 
-  mResidualWorkBound[0] = mResidualWork.Bind({pressure, d, l, b, mResiduals[0]});
-  mSmoothers[0]->Bind(d, l, b, pressure);
+  // with rigidbodies, the cycles solve on separate buffers
+  Renderer::GenericBuffer& rhs = mCoupling ? mCoupling->rhs : b;
+  Renderer::GenericBuffer& x = mCoupling ? mCoupling->x : pressure;
+  mX = &x;
 
-  auto s = mDepth.GetDepthSize(0);
-  mTransfer.RestrictBind(0, s, mResiduals[0], d, mDatas[0].B, mDatas[0].Diagonal);
-  mTransfer.ProlongateBind(0, s, pressure, d, mDatas[0].X, mDatas[0].Diagonal);
+  if (mDepth.GetMaxDepth() == 0)
+  {
+    // the finest level is also the coarsest
+    CoarsestBind(d, l, rhs, x);
+  }
+  else
+  {
+    if (mLiquidPhi != nullptr)
+    {
+      mResidualWorkBound[0] =
+          mMatrixFreeResidualWork.Bind({*mLiquidPhi, *mSolidPhi, x, rhs, mResiduals[0]});
+    }
+    else
+    {
+      mResidualWorkBound[0] = mResidualWork.Bind({x, d, l, rhs, mResiduals[0]});
+    }
+    mSmoothers[0]->Bind(d, l, rhs, x);
+
+    if (FusesCoarseCycle(0))
+    {
+      mCoarseX = &x;
+      mCoarseCycleWorkBound =
+          mCoarseCycleWork.Bind({d, l, rhs, x, mDatas[0].Diagonal, CycleLower(0)});
+    }
+
+    auto s = mDepth.GetDepthSize(0);
+    mTransfer.RestrictBind(0, s, mResiduals[0], d, mDatas[0].B, mDatas[0].Diagonal);
+    mTransfer.ProlongateBind(0, s, x, d, mDatas[0].X, mDatas[0].Diagonal);
+  }
 
   mFullCycleSolver.Record([&](vk::CommandBuffer commandBuffer) {
-    pressure.Clear(commandBuffer);
+    mIterations.Clear(commandBuffer);
+    x.Clear(commandBuffer);
     RecordFullCycle(commandBuffer);
   });
 
-  mVCycleSolver.Record([&](vk::CommandBuffer commandBuffer) { RecordVCycle(commandBuffer, 0); });
+  mCycleSolver.Record(
+      [&](vk::CommandBuffer commandBuffer) { RecordCycle(commandBuffer, 0, mCycle); });
+
+  mMaskPressureWorkBound = mMaskPressureWork.Bind({d, x});
+  mWarmStart.Record([&](vk::CommandBuffer commandBuffer) {
+    mIterations.Clear(commandBuffer);
+    mMaskPressureWorkBound.Record(commandBuffer);
+    x.Barrier(commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+  });
+
+  if (mLiquidPhi != nullptr)
+  {
+    mError.BindMatrixFree(mMatrixFreeDelta, *mSolidPhi, *mLiquidPhi, rhs, x);
+  }
+  else
+  {
+    mError.Bind(d, l, rhs, x);
+  }
+
+  if (CanBatch())
+  {
+    mErrorCheckBound = mErrorCheckWork.Bind(
+        {mError.GetDeviceError(), mErrorCheck, mIterations, mDispatchParams});
+    mSmootherErrorCheckBound = mErrorCheckWork.Bind(
+        {mError.GetDeviceError(), mErrorCheck, mIterationsCopy, mSmootherDispatchParams});
+    RecordCycleBatch();
+  }
+
+  // error of a zero initial guess
+  mReduceMaxBound = mReduceMax.Bind(rhs, mInitialError);
+  mInitialErrorRead.Record([&](vk::CommandBuffer commandBuffer) {
+    mReduceMaxBound.Record(commandBuffer);
+    mLocalInitialError.CopyFrom(commandBuffer, mInitialError);
+  });
+
+  // the PCG records the cycles, so they are bound first
+  if (mCoupling)
+  {
+    mCoupling->BindCycles(b, pressure);
+    mCoupling->solver.Bind(d, l, b, pressure);
+  }
+}
+
+void Multigrid::SetCycle(CycleType cycle)
+{
+  mCycle = cycle;
+  if (mPressure != nullptr)
+  {
+    mCycleSolver.Record(
+        [&](vk::CommandBuffer commandBuffer) { RecordCycle(commandBuffer, 0, mCycle); });
+
+    if (CanBatch())
+    {
+      RecordCycleBatch();
+    }
+  }
+}
+
+void Multigrid::SetBatchIterations(unsigned batchIterations)
+{
+  mBatchIterations = std::max(batchIterations, 1u);
+  if (mPressure != nullptr && CanBatch())
+  {
+    RecordCycleBatch();
+  }
+}
 
-  mError.Bind(d, l, b, pressure);
+bool Multigrid::CanBatch() const
+{
+  // the finest level needs to be smoothed by itself, not by the coarsest
+  // solve or the fused coarse cycle
+  int maxDepth = mDepth.GetMaxDepth();
+  return maxDepth > 1 || (maxDepth == 1 && !FusesCoarseCycle(0));
+}
+
+bool Multigrid::FusesCoarseCycle(int depth) const
+{
+  // the fused cycle reads the lower matrix, so a matrix free finest level is
+  // smoothed separately
+  return depth == mDepth.GetMaxDepth() - 1 && mDepth.IsCoarsestLocal() &&
+         (depth > 0 || mLiquidPhi == nullptr);
+}
+
+void Multigrid::RecordResidual(vk::CommandBuffer commandBuffer,
+                               int depth,
+                               Renderer::IndirectBuffer<Renderer::DispatchParams>* dispatchParams)
+{
+  // the matrix free kernel scales the coefficients by delta
+  if (depth == 0 && mLiquidPhi != nullptr)
+  {
+    mResidualWorkBound[0].PushConstant(commandBuffer, mMatrixFreeDelta);
+  }
+
+  if (dispatchParams != nullptr)
+  {
+    mResidualWorkBound[depth].RecordIndirect(commandBuffer, *dispatchParams);
+  }
+  else
+  {
+    mResidualWorkBound[depth].Record(commandBuffer);
+  }
+  mResiduals[depth].Barrier(
+      commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+}
+
+void Multigrid::RecordCycleBatch()
+{
+  auto size = mDepth.GetDepthSize(0);
+  auto workSize = Renderer::ComputeSize::GetWorkSize(size);
+  auto smootherWorkSize = mSmootherSolver == SmootherSolver::GaussSeidel
+                              ? Renderer::MakeCheckerboardComputeSize(size).WorkSize
+                              : workSize;
+
+  mCycleBatch.Record([&, workSize, smootherWorkSize](vk::CommandBuffer commandBuffer) {
+    mError.Record(commandBuffer);
+
+    for (unsigned i = 0; i < mBatchIterations; i++)
+    {
+      // check error and set dispatch params of this cycle, the smoother check
+      // reads a copy of the iterations so both checks agree
+      mIterationsCopy.CopyFrom(commandBuffer, mIterations);
+      mDispatchParams.Barrier(commandBuffer,
+                              vk::AccessFlagBits::eIndirectCommandRead,
+                              vk::AccessFlagBits::eShaderWrite);
+      mSmootherDispatchParams.Barrier(commandBuffer,
+                                      vk::AccessFlagBits::eIndirectCommandRead,
+                                      vk::AccessFlagBits::eShaderWrite);
+      mErrorCheckBound.PushConstant(commandBuffer, workSize.x, workSize.y);
+      mErrorCheckBound.Record(commandBuffer);
+      mSmootherErrorCheckBound.PushConstant(commandBuffer, smootherWorkSize.x, smootherWorkSize.y);
+      mSmootherErrorCheckBound.Record(commandBuffer);
+      mDispatchParams.Barrier(commandBuffer,
+                              vk::AccessFlagBits::eShaderWrite,
+                              vk::AccessFlagBits::eIndirectCommandRead);
+      mSmootherDispatchParams.Barrier(commandBuffer,
+                                      vk::AccessFlagBits::eShaderWrite,
+                                      vk::AccessFlagBits::eIndirectCommandRead);
+      mIterations.Barrier(
+          commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+
+      // the coarser levels still run, but nothing is prolongated once
+      // converged
+      RecordCycle(commandBuffer, 0, mCycle, &mDispatchParams, &mSmootherDispatchParams);
+      mError.Record(commandBuffer);
+    }
+
+    mLocalIterations.CopyFrom(commandBuffer, mIterations);
+  });
 }
 
 void Multigrid::BuildHierarchiesBind(Pressure& pressure,
                                      Renderer::Texture& solidPhi,
                                      Renderer::Texture& liquidPhi)
 {
+  if (mDepth.GetMaxDepth() == 0)
+  {
+    return;
+  }
+
   auto s = mDepth.GetDepthSize(1);
   mLiquidPhiScaleWorkBound.push_back(mPhiScaleWork.Bind(s, {liquidPhi, mLiquidPhis[0]}));
   mSolidPhiScaleWorkBound.push_back(mPhiScaleWork.Bind(s, {solidPhi, mSolidPhis[0]}));
@@ -142,8 +481,8 @@ void Multigrid::BuildHierarchiesBind(Pressure& pressure,
   RecursiveBind(pressure, 1);
 
   mBuildHierarchies.Record([&](vk::CommandBuffer commandBuffer) {
-    commandBuffer.debugMarkerBeginEXT({"Build hierarchies", {{0.36f, 0.85f, 0.55f, 1.0f}}},
-                                      mDevice.Loader());
+    Renderer::BeginMarker(
+        mDevice, commandBuffer, {"Build hierarchies", {{0.36f, 0.85f, 0.55f, 1.0f}}});
     for (int i = 0; i < mDepth.GetMaxDepth(); i++)
     {
       mLiquidPhiScaleWorkBound[i].Record(commandBuffer);
@@ -159,24 +498,20 @@ void Multigrid::BuildHierarchiesBind(Pressure& pressure,
                             vk::AccessFlagBits::eShaderWrite,
                             vk::ImageLayout::eGeneral,
                             vk::AccessFlagBits::eShaderRead);
+    }
 
+    // the matrices are built once all level sets are scaled
+    for (int i = 0; i < mDepth.GetMaxDepth(); i++)
+    {
       mMatrixBuildBound[i].PushConstant(commandBuffer, mDelta);
       mMatrixBuildBound[i].Record(commandBuffer);
       mDatas[i].Diagonal.Barrier(
           commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
-      mDatas[i].Lower.Barrier(
+      CycleLower(i).Barrier(
           commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
       mDatas[i].B.Clear(commandBuffer);
     }
-
-    int maxDepth = mDepth.GetMaxDepth();
-    mMatrixBuildBound[maxDepth - 1].PushConstant(commandBuffer, mDelta);
-    mMatrixBuildBound[maxDepth - 1].Record(commandBuffer);
-    mDatas[maxDepth - 1].Diagonal.Barrier(
-        commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
-    mDatas[maxDepth - 1].Lower.Barrier(
-        commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
-    commandBuffer.debugMarkerEndEXT(mDevice.Loader());
+    Renderer::EndMarker(mDevice, commandBuffer);
   });
 }
 
@@ -192,12 +527,12 @@ void Multigrid::RecursiveBind(Pressure& pressure, std::size_t depth)
     mSolidPhiScaleWorkBound.push_back(
         mPhiScaleWork.Bind(s1, {mSolidPhis[depth - 1], mSolidPhis[depth]}));
 
-    mResidualWorkBound[depth] = mResidualWork.Bind(s0,
-                                                   {mDatas[depth - 1].X,
-                                                    mDatas[depth - 1].Diagonal,
-                                                    mDatas[depth - 1].Lower,
-                                                    mDatas[depth - 1].B,
-                                                    mResiduals[depth]});
+    mResidualWorkBound[depth] = mCoarseResidualWork.Bind(s0,
+                                                         {mDatas[depth - 1].X,
+                                                          mDatas[depth - 1].Diagonal,
+                                                          CycleLower(depth - 1),
+                                                          mDatas[depth - 1].B,
+                                                          mResiduals[depth]});
 
     mTransfer.RestrictBind(depth,
                            s0,
@@ -214,111 +549,312 @@ void Multigrid::RecursiveBind(Pressure& pressure, std::size_t depth)
                              mDatas[depth].Diagonal);
 
     mSmoothers[depth]->Bind(mDatas[depth - 1].Diagonal,
-                            mDatas[depth - 1].Lower,
+                            CycleLower(depth - 1),
                             mDatas[depth - 1].B,
                             mDatas[depth - 1].X);
 
+    if (FusesCoarseCycle(static_cast<int>(depth)))
+    {
+      mCoarseX = &mDatas[depth - 1].X;
+      mCoarseCycleWorkBound = mCoarseCycleWork.Bind({mDatas[depth - 1].Diagonal,
+                                                     CycleLower(depth - 1),
+                                                     mDatas[depth - 1].B,
+                                                     mDatas[depth - 1].X,
+                                                     mDatas[depth].Diagonal,
+                                                     CycleLower(depth)});
+    }
+
     RecursiveBind(pressure, depth + 1);
   }
 
   mMatrixBuildBound.push_back(pressure.BindMatrixBuild(s0,
                                                        mDatas[depth - 1].Diagonal,
-                                                       mDatas[depth - 1].Lower,
+                                                       CycleLower(depth - 1),
                                                        mLiquidPhis[depth - 1],
-                                                       mSolidPhis[depth - 1]));
+                                                       mSolidPhis[depth - 1],
+                                                       mPrecision));
+}
+
+Renderer::GenericBuffer& Multigrid::CycleLower(std::size_t i)
+{
+  if (mPrecision == Precision::Half)
+  {
+    return mHalfLowers[i];
+  }
+
+  return mDatas[i].Lower;
 }
 
 void Multigrid::BuildHierarchies()
 {
-  mBuildHierarchies.Submit();
+  if (mBuildHierarchies)
+  {
+    mBuildHierarchies.Submit();
+  }
 }
 
-void Multigrid::Smoother(vk::CommandBuffer commandBuffer, int n)
+void Multigrid::CoarsestBind(Renderer::GenericBuffer& d,
+                             Renderer::GenericBuffer& l,
+                             Renderer::GenericBuffer& b,
+                             Renderer::GenericBuffer& x)
 {
-  mSmoothers[n]->Record(commandBuffer);
+  if (mCoarseSmoother)
+  {
+    mCoarseSmoother->Bind(d, l, b, x);
+  }
+  else
+  {
+    mSmoother.Bind(d, l, b, x);
+  }
+}
+
+void Multigrid::RecordCoarsest(vk::CommandBuffer commandBuffer)
+{
+  if (mCoarseSmoother)
+  {
+    mCoarseSmoother->Record(commandBuffer);
+  }
+  else
+  {
+    mSmoother.Record(commandBuffer);
+  }
+}
+
+void Multigrid::Smoother(vk::CommandBuffer commandBuffer,
+                         int n,
+                         Renderer::IndirectBuffer<Renderer::DispatchParams>* dispatchParams)
+{
+  if (dispatchParams != nullptr)
+  {
+    mSmoothers[n]->RecordIndirect(commandBuffer, *dispatchParams);
+  }
+  else
+  {
+    mSmoothers[n]->Record(commandBuffer);
+  }
 }
 
 void Multigrid::Record(vk::CommandBuffer commandBuffer)
 {
-  commandBuffer.debugMarkerBeginEXT({"Multigrid", {{0.48f, 0.25f, 0.19f, 1.0f}}}, mDevice.Loader());
+  Renderer::BeginMarker(mDevice, commandBuffer, {"Multigrid", {{0.48f, 0.25f, 0.19f, 1.0f}}});
 
-  assert(mPressure != nullptr);
-  mPressure->Clear(commandBuffer);
+  assert(mX != nullptr);
+  mX->Clear(commandBuffer);
 
-  RecordVCycle(commandBuffer, 0);
+  RecordCycle(commandBuffer, 0, CycleType::V);
 
-  commandBuffer.debugMarkerEndEXT(mDevice.Loader());
+  Renderer::EndMarker(mDevice, commandBuffer);
 }
 
-void Multigrid::BindRigidbody(float /*delta*/, Renderer::GenericBuffer& /*d*/, RigidBody& rigidBody)
+void Multigrid::BindRigidbody(float delta, Renderer::GenericBuffer& d, RigidBody& rigidBody)
 {
-  if (rigidBody.GetType() == RigidBody::Type::eStrong)
+  if (!mCoupling)
   {
-    throw std::runtime_error("Strong coupling not supported for multigrid solver");
+    mCoupling = std::make_unique<Coupling>(mDevice, mDepth.GetDepthSize(0), *this);
+    if (mLiquidPhi != nullptr)
+    {
+      mCoupling->solver.BindMatrixFree(mMatrixFreeDelta, *mSolidPhi, *mLiquidPhi);
+    }
+
+    if (mPressure != nullptr)
+    {
+      // bind again to solve on the coupling buffers
+      Bind(*mDiagonal, *mLower, *mB, *mPressure);
+    }
   }
+
+  mCoupling->solver.BindRigidbody(delta, d, rigidBody);
 }
 
-void Multigrid::Solve(Parameters& params, const std::vector<RigidBody*>& /*rigidBodies*/)
+void Multigrid::Solve(Parameters& params, const std::vector<RigidBody*>& rigidBodies)
 {
   params.Reset();
-  mFullCycleSolver.Submit();
-  for (int i = 0; i < params.Iterations; i++)
+
+  bool hasStrongRigidbody =
+      std::any_of(rigidBodies.begin(), rigidBodies.end(), [](RigidBody* rigidBody) {
+        return rigidBody->GetType() == RigidBody::Type::eStrong;
+      });
+
+  if (hasStrongRigidbody)
+  {
+    if (!mCoupling)
+    {
+      throw std::runtime_error("Rigidbody not bound to multigrid solver");
+    }
+
+    mCoupling->solver.Solve(params, rigidBodies);
+  }
+  else if (mCoupling)
+  {
+    mCoupling->setRhs.Submit();
+    SolveCycles(params);
+    mCoupling->copyX.Submit();
+  }
+  else
+  {
+    SolveCycles(params);
+  }
+}
+
+void Multigrid::SolveCycles(Parameters& params)
+{
+  float initialError = 0.0f;
+  if (params.Type == Parameters::SolverType::Iterative)
+  {
+    mInitialErrorRead.Submit().Wait();
+    Renderer::CopyTo(mLocalInitialError, initialError);
+  }
+
+  if (params.WarmStart)
+  {
+    mWarmStart.Submit();
+  }
+  else
+  {
+    mFullCycleSolver.Submit();
+  }
+
+  if (params.Type == Parameters::SolverType::Iterative && mBatchIterations > 1 && CanBatch())
+  {
+    SolveBatch(params, initialError);
+    return;
+  }
+
+  if (params.Type == Parameters::SolverType::Iterative)
   {
-    mVCycleSolver.Submit();
+    params.OutError = mError.Submit().Wait().GetError();
+  }
+
+  for (unsigned i = 0; !params.IsFinished(initialError); params.OutIterations = ++i)
+  {
+    mCycleSolver.Submit();
+
+    if (params.Type == Parameters::SolverType::Iterative)
+    {
+      params.OutError = mError.Submit().Wait().GetError();
+    }
+  }
+}
+
+void Multigrid::SolveBatch(Parameters& params, float initialError)
+{
+  Renderer::CopyFrom(mErrorCheck, ErrorCheck::Make(params, initialError));
+
+  // the first batch also computes the error of the initial cycle
+  params.OutError = std::numeric_limits<float>::max();
+  params.OutIterations = 0;
+  while (!params.IsFinished(initialError))
+  {
+    mCycleBatch.Submit().Wait();
+
+    uint32_t outIterations;
+    params.OutError = mError.GetError();
+    Renderer::CopyTo(mLocalIterations, outIterations);
+
+    // the GPU stopped iterating, e.g. the error is not a number
+    if (outIterations == params.OutIterations)
+    {
+      break;
+    }
+
+    params.OutIterations = outIterations;
   }
 }
 
 float Multigrid::GetError()
 {
+  if (mCoupling)
+  {
+    mCoupling->setRhs.Submit();
+  }
+
   return mError.Submit().Wait().GetError();
 }
 
-void Multigrid::RecordVCycle(vk::CommandBuffer commandBuffer, int depth)
+void Multigrid::RecordCycle(
+    vk::CommandBuffer commandBuffer,
+    int depth,
+    CycleType cycle,
+    Renderer::IndirectBuffer<Renderer::DispatchParams>* dispatchParams,
+    Renderer::IndirectBuffer<Renderer::DispatchParams>* smootherDispatchParams)
 {
   if (depth == mDepth.GetMaxDepth())
   {
-    mSmoother.Record(commandBuffer);
+    RecordCoarsest(commandBuffer);
+  }
+  else if (FusesCoarseCycle(depth))
+  {
+    RecordCoarseCycle(commandBuffer);
   }
   else
   {
-    Smoother(commandBuffer, depth);
+    // only the finest level is given dispatch params
+    Smoother(commandBuffer, depth, smootherDispatchParams);
 
-    mResidualWorkBound[depth].Record(commandBuffer);
-    mResiduals[depth].Barrier(
-        commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+    RecordResidual(commandBuffer, depth, dispatchParams);
 
     mTransfer.Restrict(commandBuffer, depth);
 
     mDatas[depth].X.Clear(commandBuffer);
 
-    RecordVCycle(commandBuffer, depth + 1);
+    RecordCycle(commandBuffer, depth + 1, cycle);
 
-    mTransfer.Prolongate(commandBuffer, depth);
+    // the coarsest level is solved directly, no need to visit it twice
+    if (depth + 1 < mDepth.GetMaxDepth())
+    {
+      if (cycle == CycleType::W)
+      {
+        RecordCycle(commandBuffer, depth + 1, CycleType::W);
+      }
+      else if (cycle == CycleType::F)
+      {
+        RecordCycle(commandBuffer, depth + 1, CycleType::V);
+      }
+    }
 
-    Smoother(commandBuffer, depth);
+    mTransfer.Prolongate(commandBuffer, depth, dispatchParams);
+
+    Smoother(commandBuffer, depth, smootherDispatchParams);
   }
 }
 
-void Multigrid::RecordFullCycle(vk::CommandBuffer commandBuffer)
+void Multigrid::RecordCoarseCycle(vk::CommandBuffer commandBuffer)
 {
-  mResidualWorkBound[0].Record(commandBuffer);
-  mResiduals[0].Barrier(
+  assert(mCoarseX != nullptr);
+
+  // smoothing, residual, restriction, coarsest solve and prolongation at once
+  int jacobi = mSmootherSolver == SmootherSolver::Jacobi ? 1 : 0;
+  mCoarseCycleWorkBound.PushConstant(commandBuffer, mNumSmoothingIterations, 2.0f / 3.0f, jacobi);
+  mCoarseCycleWorkBound.Record(commandBuffer);
+  mCoarseX->Barrier(
       commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+}
 
-  for (int i = 0; i < mDepth.GetMaxDepth() - 1; i++)
+void Multigrid::RecordFullCycle(vk::CommandBuffer commandBuffer)
+{
+  int maxDepth = mDepth.GetMaxDepth();
+  if (maxDepth > 0)
+  {
+    RecordResidual(commandBuffer, 0);
+  }
+
+  for (int i = 0; i < maxDepth; i++)
   {
     mTransfer.Restrict(commandBuffer, i);
-    mResiduals[i + 1].CopyFrom(commandBuffer, mDatas[i].B);
+    mDatas[i].X.Clear(commandBuffer);
+
+    if (i + 1 < maxDepth)
+    {
+      mResiduals[i + 1].CopyFrom(commandBuffer, mDatas[i].B);
+    }
   }
 
-  int depth = mDepth.GetMaxDepth() - 1;
-  mDatas[depth].X.Clear(commandBuffer);
-  mSmoother.Record(commandBuffer);
+  RecordCoarsest(commandBuffer);
 
-  for (int i = depth; i >= 0; i--)
+  for (int i = maxDepth - 1; i >= 0; i--)
   {
-    mTransfer.Prolongate(commandBuffer, depth);
-    RecordVCycle(commandBuffer, i);
+    mTransfer.Prolongate(commandBuffer, i);
+    RecordCycle(commandBuffer, i, CycleType::V);
   }
 }
 
@@ -22,7 +22,10 @@ namespace Vortex2D
 namespace Fluid
 {
 /**
- * @brief Contains the sizes of the multigrid hierarchy.
+ * @brief Contains the sizes of the multigrid hierarchy. Each level is half the
+ * size of the previous one, rounded up, until it fits in 16x16. Thin domains
+ * stop coarsening before a side gets smaller than 3, their coarsest level can
+ * then be larger than 16x16.
  */
 class Depth
 {
@@ -31,20 +34,25 @@ public:
    * @brief Initialize with the finest size.
    * @param size the base size.
    */
-  Depth(const glm::ivec2& size);
+  VORTEX2D_API Depth(const glm::ivec2& size);
 
   /**
    * @brief The calculated depth of the multigrid.
    * @return the depth.
    */
-  int GetMaxDepth() const;
+  VORTEX2D_API int GetMaxDepth() const;
 
   /**
    * @brief Gets the depth for a given level
    * @param i the level
    * @return the size
    */
-  glm::ivec2 GetDepthSize(std::size_t i) const;
+  VORTEX2D_API glm::ivec2 GetDepthSize(std::size_t i) const;
+
+  /**
+   * @brief If the coarsest level fits in 16x16, i.e. in a single work group.
+   */
+  VORTEX2D_API bool IsCoarsestLocal() const;
 
 private:
   std::vector<glm::ivec2> mDepths;
@@ -56,7 +64,11 @@ class Pressure;
  * @brief Multigrid preconditioner. It creates a hierarchy of twice as small set
  * of linear equations. It applies a few iterations of jacobi on each level and
  * transfers the error on the level above. It then copies the error down, adds
- * to the current solution and apply a few more iterations of jacobi.
+ * to the current solution and apply a few more iterations of jacobi. The cycle
+ * of the two coarsest levels is done in a single dispatch using shared memory.
+ * Only those two levels are fused: the finer levels use one dispatch per
+ * smoothing step and transfer, and the fused cycle is skipped when the coarsest
+ * level doesn't fit in a single work group.
  */
 class Multigrid : public LinearSolver, public Preconditioner
 {
@@ -67,17 +79,32 @@ public:
     GaussSeidel,
   };
 
+  /**
+   * @brief Type of cycle used when solving with multigrid.
+   */
+  enum class CycleType
+  {
+    V,
+    W,
+    F,
+  };
+
   /**
    * @brief Initialize multigrid for given size and delta.
    * @param device vulkan device
    * @param size of the linear equations
    * @param delta timestep delta
+   * @param numSmoothingIterations number of smoothing iterations on each level
+   * @param smoother type of smoother
+   * @param precision storage precision of the lower matrices of the coarser
+   * levels, their diagonals stay in full precision
    */
   VORTEX2D_API Multigrid(const Renderer::Device& device,
                          const glm::ivec2& size,
                          float delta,
                          int numSmoothingIterations = 3,
-                         SmootherSolver smoother = SmootherSolver::Jacobi);
+                         SmootherSolver smoother = SmootherSolver::Jacobi,
+                         Precision precision = Precision::Full);
 
   VORTEX2D_API ~Multigrid() override;
 
@@ -86,6 +113,22 @@ public:
                          Renderer::GenericBuffer& b,
                          Renderer::GenericBuffer& x) override;
 
+  /**
+   * @brief Compute the off-diagonals of the finest level from the level sets,
+   * the lower matrix of the finest level is then not read. The coarser levels
+   * are still built explicitly by @ref BuildHierarchies and the two coarsest
+   * levels are not fused when the finest is one of them. Needs to be called
+   * before @ref Bind and throws if there are no coarser levels.
+   * @param delta solver delta
+   * @param solidPhi solid level set
+   * @param liquidPhi liquid level set
+   */
+  VORTEX2D_API void BindMatrixFree(float delta,
+                                   Renderer::Texture& solidPhi,
+                                   Renderer::Texture& liquidPhi) override;
+
+  bool ReadsLower() const override { return mLiquidPhi == nullptr; }
+
   /**
    * @brief Bind the level sets from which the hierarchy is built.
    * @param pressure The current linear equations
@@ -107,41 +150,108 @@ public:
   void BindRigidbody(float delta, Renderer::GenericBuffer& d, RigidBody& rigidBody) override;
 
   /**
-   * @brief Solves the linear equations
+   * @brief Solves the linear equations with a full multigrid cycle followed by
+   * cycles until the error tolerance or the number of iterations is reached.
+   * The number of cycles is set in the out iterations of the parameters.
+   * With strongly coupled rigidbodies, the system is solved with a PCG
+   * preconditioned by a V-cycle instead, the out iterations and out error are
+   * then those of the PCG. The right hand side is not modified.
    * @param params solver iteration/error parameters
    * @param rigidBodies rigidbody to include in solver's matrix
    */
   VORTEX2D_API void Solve(Parameters& params,
                           const std::vector<RigidBody*>& rigidBodies = {}) override;
 
+  /**
+   * @brief Set the type of cycle used when solving. When used as a
+   * preconditioner, a V-cycle is always used.
+   * @param cycle the cycle type
+   */
+  VORTEX2D_API void SetCycle(CycleType cycle);
+
+  /**
+   * @brief Set the number of cycles recorded in a single submission when
+   * solving iteratively. The convergence check is done on the GPU, the
+   * dispatches of the finest level are empty once converged and the error is
+   * only read back once per batch. A value of 1 reads back the error after
+   * each cycle, as do hierarchies with less than two coarser levels.
+   * @param batchIterations number of cycles per submission, 4 by default
+   */
+  VORTEX2D_API void SetBatchIterations(unsigned batchIterations);
+
   /**
    * @return the max error
    */
   VORTEX2D_API float GetError() override;
 
 private:
-  void Smoother(vk::CommandBuffer commandBuffer, int n);
+  void Smoother(vk::CommandBuffer commandBuffer,
+                int n,
+                Renderer::IndirectBuffer<Renderer::DispatchParams>* dispatchParams = nullptr);
 
   void RecursiveBind(Pressure& pressure, std::size_t depth);
 
-  void RecordVCycle(vk::CommandBuffer commandBuffer, int depth);
+  Renderer::GenericBuffer& CycleLower(std::size_t i);
+
+  bool FusesCoarseCycle(int depth) const;
+
+  void RecordResidual(vk::CommandBuffer commandBuffer,
+                      int depth,
+                      Renderer::IndirectBuffer<Renderer::DispatchParams>* dispatchParams = nullptr);
+
+  void RecordCycle(
+      vk::CommandBuffer commandBuffer,
+      int depth,
+      CycleType cycle,
+      Renderer::IndirectBuffer<Renderer::DispatchParams>* dispatchParams = nullptr,
+      Renderer::IndirectBuffer<Renderer::DispatchParams>* smootherDispatchParams = nullptr);
+  void RecordCycleBatch();
+  bool CanBatch() const;
+  void RecordCoarseCycle(vk::CommandBuffer commandBuffer);
+  void CoarsestBind(Renderer::GenericBuffer& d,
+                    Renderer::GenericBuffer& l,
+                    Renderer::GenericBuffer& b,
+                    Renderer::GenericBuffer& x);
+  void RecordCoarsest(vk::CommandBuffer commandBuffer);
+
+  void SolveCycles(Parameters& params);
+  void SolveBatch(Parameters& params, float initialError);
   void RecordFullCycle(vk::CommandBuffer commandBuffer);
 
   const Renderer::Device& mDevice;
   Depth mDepth;
   float mDelta;
   int mNumSmoothingIterations;
+  SmootherSolver mSmootherSolver;
+  Precision mPrecision;
+  CycleType mCycle;
 
-  Renderer::Work mResidualWork;
+  Renderer::Work mResidualWork, mCoarseResidualWork, mMatrixFreeResidualWork;
   std::vector<Renderer::Work::Bound> mResidualWorkBound;
 
+  Renderer::Work mMaskPressureWork;
+  Renderer::Work::Bound mMaskPressureWorkBound;
+
   Transfer mTransfer;
 
+  Renderer::GenericBuffer* mDiagonal = nullptr;
+  Renderer::GenericBuffer* mLower = nullptr;
   Renderer::GenericBuffer* mPressure = nullptr;
+  Renderer::GenericBuffer* mB = nullptr;
+  Renderer::GenericBuffer* mX = nullptr;
+
+  // level sets of the finest level when it is matrix free
+  float mMatrixFreeDelta = 0.0f;
+  Renderer::Texture* mSolidPhi = nullptr;
+  Renderer::Texture* mLiquidPhi = nullptr;
 
   // mDatas[0]  is level 1
   std::vector<LinearSolver::Data> mDatas;
 
+  // mHalfLowers[0] is level 1, only used with half precision in place of the
+  // lower matrices of mDatas
+  std::vector<Renderer::Buffer<uint32_t>> mHalfLowers;
+
   // mResiduals[0] is level 0
   std::vector<Renderer::Buffer<float>> mResiduals;
 
@@ -158,11 +268,36 @@ private:
   // mSmoothers[0] is level 0
   std::vector<std::unique_ptr<Preconditioner>> mSmoothers;
   LocalGaussSeidel mSmoother;
+  // smoother of the coarsest level when it doesn't fit in a work group
+  std::unique_ptr<Preconditioner> mCoarseSmoother;
+
+  // cycle of the two coarsest levels in a single work group
+  Renderer::Work mCoarseCycleWork;
+  Renderer::Work::Bound mCoarseCycleWorkBound;
+  Renderer::GenericBuffer* mCoarseX = nullptr;
 
   Renderer::CommandBuffer mBuildHierarchies;
-  Renderer::CommandBuffer mFullCycleSolver, mVCycleSolver;
+  Renderer::CommandBuffer mFullCycleSolver, mCycleSolver, mWarmStart;
 
   LinearSolver::Error mError;
+
+  ReduceMax mReduceMax;
+  ReduceMax::Bound mReduceMaxBound;
+  Renderer::Buffer<float> mInitialError, mLocalInitialError;
+  Renderer::CommandBuffer mInitialErrorRead;
+
+  // cycles checking their convergence on the GPU, the finest level is
+  // dispatched indirectly, the smoother params have the smoother work size
+  unsigned mBatchIterations;
+  Renderer::Buffer<ErrorCheck> mErrorCheck;
+  Renderer::Buffer<uint32_t> mIterations, mIterationsCopy, mLocalIterations;
+  Renderer::IndirectBuffer<Renderer::DispatchParams> mDispatchParams, mSmootherDispatchParams;
+  Renderer::Work mErrorCheckWork;
+  Renderer::Work::Bound mErrorCheckBound, mSmootherErrorCheckBound;
+  Renderer::CommandBuffer mCycleBatch;
+
+  struct Coupling;
+  std::unique_ptr<Coupling> mCoupling;
 };
 
 }  // namespace Fluid
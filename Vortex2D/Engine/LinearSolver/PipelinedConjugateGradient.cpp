@@ -0,0 +1,174 @@
+//
+//  PipelinedConjugateGradient.cpp
+//  Vortex2D
+//
+
+#include "PipelinedConjugateGradient.h"
+
+#include <Vortex2D/Engine/Rigidbody.h>
+#include <Vortex2D/Renderer/Profiler.h>
+
+#include "vortex2d_generated_spirv.h"
+
+namespace Vortex2D
+{
+namespace Fluid
+{
+PipelinedConjugateGradient::PipelinedConjugateGradient(const Renderer::Device& device,
+                                                       const glm::ivec2& size,
+                                                       Preconditioner& preconditioner)
+    : mDevice(device)
+    , mPreconditioner(preconditioner)
+    , r(device, size.x * size.y)
+    , u(device, size.x * size.y)
+    , w(device, size.x * size.y)
+    , p(device, size.x * size.y)
+    , s(device, size.x * size.y)
+    , scalars(device, 3)
+    , reduced(device, 1)
+    , error(device)
+    , localError(device, 1, VMA_MEMORY_USAGE_GPU_TO_CPU)
+    , update(device, size, SPIRV::PipelinedUpdate_comp)
+    , multiply(device, size, SPIRV::PipelinedMultiply_comp)
+    , scalarUpdate(device, glm::ivec2(1), SPIRV::PipelinedScalars_comp)
+    , reduceMultiple(device,
+                     size,
+                     {ReduceMultiple::Operation::Sum,
+                      ReduceMultiple::Operation::Sum,
+                      ReduceMultiple::Operation::Max})
+    , reduceMultipleBound(reduceMultiple.Bind({{r, u}, {w, u}, {r, r}}, reduced))
+    , scalarUpdateBound(scalarUpdate.Bind({reduced, scalars, error}))
+    , mSolveInit(device, false)
+    , mSolve(device, false)
+    , mErrorRead(device)
+{
+  mErrorRead.Record(
+      [&](vk::CommandBuffer commandBuffer) { localError.CopyFrom(commandBuffer, error); });
+}
+
+PipelinedConjugateGradient::~PipelinedConjugateGradient() {}
+
+void PipelinedConjugateGradient::Bind(Renderer::GenericBuffer& d,
+                                      Renderer::GenericBuffer& l,
+                                      Renderer::GenericBuffer& b,
+                                      Renderer::GenericBuffer& pressure)
+{
+  mPreconditioner.Bind(d, l, r, u);
+
+  multiplyBound = multiply.Bind({d, l, u, w});
+  updateBound = update.Bind({u, w, p, s, pressure, r, scalars});
+
+  mSolveInit.Record([&](vk::CommandBuffer commandBuffer) {
+    Renderer::BeginMarker(
+        mDevice, commandBuffer, {"Pipelined PCG Init", {{0.63f, 0.04f, 0.66f, 1.0f}}});
+
+    // r = b
+    r.CopyFrom(commandBuffer, b);
+
+    // x = 0, p = 0, s = 0
+    pressure.Clear(commandBuffer);
+    p.Clear(commandBuffer);
+    s.Clear(commandBuffer);
+
+    // gamma = rTu, delta = wTu, alpha = gamma / delta, beta = 0
+    RecordMultiplyReduce(commandBuffer, 1);
+
+    Renderer::EndMarker(mDevice, commandBuffer);
+  });
+
+  mSolve.Record([&](vk::CommandBuffer commandBuffer) {
+    Renderer::BeginMarker(
+        mDevice, commandBuffer, {"Pipelined PCG Step", {{0.51f, 0.90f, 0.72f, 1.0f}}});
+
+    // p = u + beta * p, s = w + beta * s
+    // x = x + alpha * p, r = r - alpha * s
+    updateBound.Record(commandBuffer);
+    r.Barrier(commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+    p.Barrier(commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+    s.Barrier(commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+    pressure.Barrier(
+        commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+
+    // gamma = rTu, delta = wTu
+    // beta = gamma / gamma_old, alpha = gamma / (delta - beta * gamma / alpha_old)
+    RecordMultiplyReduce(commandBuffer, 0);
+
+    Renderer::EndMarker(mDevice, commandBuffer);
+  });
+}
+
+void PipelinedConjugateGradient::RecordMultiplyReduce(vk::CommandBuffer commandBuffer, int init)
+{
+  // u = M^-1 r
+  u.Clear(commandBuffer);
+  mPreconditioner.Record(commandBuffer);
+  u.Barrier(commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+
+  // w = Au
+  multiplyBound.Record(commandBuffer);
+  w.Barrier(commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+
+  // (r, u), (w, u) and |r| in a single pass reduction
+  reduceMultipleBound.Record(commandBuffer);
+
+  scalarUpdateBound.PushConstant(commandBuffer, init);
+  scalarUpdateBound.Record(commandBuffer);
+  scalars.Barrier(commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+  error.Barrier(commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+}
+
+void PipelinedConjugateGradient::BindRigidbody(float /*delta*/,
+                                               Renderer::GenericBuffer& /*d*/,
+                                               RigidBody& rigidBody)
+{
+  if (rigidBody.GetType() == RigidBody::Type::eStrong)
+  {
+    throw std::runtime_error("Strong coupling not supported for pipelined conjugate gradient");
+  }
+}
+
+void PipelinedConjugateGradient::Solve(Parameters& params,
+                                       const std::vector<RigidBody*>& /*rigidbodies*/)
+{
+  params.Reset();
+
+  mSolveInit.Submit();
+
+  if (params.Type == Parameters::SolverType::Iterative)
+  {
+    mErrorRead.Submit().Wait();
+
+    Renderer::CopyTo(localError, params.OutError);
+    if (params.OutError <= params.ErrorTolerance)
+    {
+      return;
+    }
+
+    mErrorRead.Submit();
+  }
+
+  auto initialError = params.OutError;
+  for (unsigned i = 0; !params.IsFinished(initialError); params.OutIterations = ++i)
+  {
+    mSolve.Submit();
+
+    if (params.Type == Parameters::SolverType::Iterative)
+    {
+      mErrorRead.Wait();
+      Renderer::CopyTo(localError, params.OutError);
+      mErrorRead.Submit();
+    }
+  }
+}
+
+float PipelinedConjugateGradient::GetError()
+{
+  mErrorRead.Submit().Wait();
+
+  float error;
+  Renderer::CopyTo(localError, error);
+  return error;
+}
+
+}  // namespace Fluid
+}  // namespace Vortex2D
@@ -0,0 +1,80 @@
+//
+//  PipelinedConjugateGradient.h
+//  Vortex2D
+//
+
+#ifndef Vortex2D_PipelinedConjugateGradient_h
+#define Vortex2D_PipelinedConjugateGradient_h
+
+#include <Vortex2D/Engine/LinearSolver/LinearSolver.h>
+#include <Vortex2D/Engine/LinearSolver/Preconditioner.h>
+#include <Vortex2D/Engine/LinearSolver/Reduce.h>
+#include <Vortex2D/Renderer/CommandBuffer.h>
+#include <Vortex2D/Renderer/Work.h>
+
+namespace Vortex2D
+{
+namespace Fluid
+{
+/**
+ * @brief A pipelined (Chronopoulos-Gear) variant of the preconditioned
+ * conjugate gradient. The vector updates are fused in a single kernel and a
+ * single pass reduction per iteration gives both inner products and the max
+ * error.
+ * Strongly coupled rigidbodies are not supported.
+ */
+class PipelinedConjugateGradient : public LinearSolver
+{
+public:
+  /**
+   * @brief Initialize the solver with a size and preconditioner
+   * @param device vulkan device
+   * @param size
+   * @param preconditioner
+   */
+  VORTEX2D_API PipelinedConjugateGradient(const Renderer::Device& device,
+                                          const glm::ivec2& size,
+                                          Preconditioner& preconditioner);
+
+  VORTEX2D_API ~PipelinedConjugateGradient() override;
+
+  VORTEX2D_API void Bind(Renderer::GenericBuffer& d,
+                         Renderer::GenericBuffer& l,
+                         Renderer::GenericBuffer& b,
+                         Renderer::GenericBuffer& pressure) override;
+
+  VORTEX2D_API void BindRigidbody(float delta,
+                                  Renderer::GenericBuffer& d,
+                                  RigidBody& rigidBody) override;
+
+  /**
+   * @brief Solve iteratively solve the linear equations in data
+   */
+  VORTEX2D_API void Solve(Parameters& params,
+                          const std::vector<RigidBody*>& rigidbodies = {}) override;
+
+  VORTEX2D_API float GetError() override;
+
+private:
+  void RecordMultiplyReduce(vk::CommandBuffer commandBuffer, int init);
+
+  const Renderer::Device& mDevice;
+  Preconditioner& mPreconditioner;
+
+  Renderer::Buffer<float> r, u, w, p, s, scalars;
+  Renderer::Buffer<glm::vec4> reduced;
+  Renderer::Buffer<float> error, localError;
+  Renderer::Work update, multiply, scalarUpdate;
+  ReduceMultiple reduceMultiple;
+
+  Reduce::Bound reduceMultipleBound;
+  Renderer::Work::Bound updateBound, multiplyBound, scalarUpdateBound;
+
+  Renderer::CommandBuffer mSolveInit, mSolve;
+  Renderer::CommandBuffer mErrorRead;
+};
+
+}  // namespace Fluid
+}  // namespace Vortex2D
+
+#endif
@@ -10,6 +10,8 @@
 #include <Vortex2D/Renderer/Texture.h>
 #include <Vortex2D/Renderer/Work.h>
 
+#include <stdexcept>
+
 namespace Vortex2D
 {
 namespace Fluid
@@ -38,6 +40,41 @@ struct Preconditioner
    * @param commandBuffer the command buffer to record into.
    */
   virtual void Record(vk::CommandBuffer commandBuffer) = 0;
+
+  /**
+   * @brief Record the preconditioner with indirect dispatches, which are empty
+   * once a solver has converged on the GPU. Only the multigrid smoothers
+   * support it.
+   * @param commandBuffer the command buffer to record into.
+   * @param dispatchParams the dispatch parameters, of the work size of the
+   * preconditioner kernels.
+   */
+  virtual void RecordIndirect(vk::CommandBuffer /*commandBuffer*/,
+                              Renderer::IndirectBuffer<Renderer::DispatchParams>& /*dispatchParams*/)
+  {
+    throw std::runtime_error("Indirect record not supported");
+  }
+
+  /**
+   * @brief Compute the off-diagonals of the matrix from the level sets instead
+   * of reading the lower matrix. Needs to be called before @ref Bind. Only the
+   * diagonal, jacobi, gauss-seidel and multigrid preconditioners support it.
+   * @param delta solver delta
+   * @param solidPhi solid level set
+   * @param liquidPhi liquid level set
+   */
+  virtual void BindMatrixFree(float /*delta*/,
+                              Renderer::Texture& /*solidPhi*/,
+                              Renderer::Texture& /*liquidPhi*/)
+  {
+    throw std::runtime_error("Preconditioner requires an explicit matrix");
+  }
+
+  /**
+   * @brief If the preconditioner reads the lower matrix, it then can't be
+   * used with a matrix free system unless @ref BindMatrixFree was called.
+   */
+  virtual bool ReadsLower() const { return true; }
 };
 
 }  // namespace Fluid
@@ -8,6 +8,8 @@
 #include <Vortex2D/Renderer/DescriptorSet.h>
 #include <Vortex2D/Renderer/Work.h>
 
+#include <algorithm>
+
 #include "vortex2d_generated_spirv.h"
 
 namespace Vortex2D
@@ -27,15 +29,95 @@ Renderer::ComputeSize MakeComputeSize(int size)
 
   return computeSize;
 }
+
+const Renderer::SpirvBinary& SinglePassSpirv(const Renderer::Device& device,
+                                             const Renderer::SpirvBinary& subgroupSpirv,
+                                             const Renderer::SpirvBinary& spirv)
+{
+  return device.HasSubgroupArithmetic() ? subgroupSpirv : spirv;
+}
+
+Renderer::SpecConstInfo MakeSpecConst(Reduce::Method method, int components, int maxMask)
+{
+  if (method == Reduce::Method::SinglePass)
+  {
+    return Renderer::SpecConst(Renderer::SpecConstValue(3, components),
+                               Renderer::SpecConstValue(4, maxMask));
+  }
+
+  return {};
+}
+
+int MakeMaxMask(const std::vector<ReduceMultiple::Operation>& operations)
+{
+  int maxMask = 0;
+  for (std::size_t i = 0; i < operations.size(); i++)
+  {
+    if (operations[i] == ReduceMultiple::Operation::Max)
+    {
+      maxMask |= 1 << i;
+    }
+  }
+
+  return maxMask;
+}
+
+Renderer::CommandBuffer::CommandFn MakeSinglePassBarrier(vk::Buffer output,
+                                                         vk::Buffer partials,
+                                                         vk::Buffer counter)
+{
+  // the partial results and counter are re-used by the next dispatch
+  return [=](vk::CommandBuffer commandBuffer) {
+    Renderer::BufferBarrier(
+        output, commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+    Renderer::BufferBarrier(partials,
+                            commandBuffer,
+                            vk::AccessFlagBits::eShaderWrite,
+                            vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite);
+    Renderer::BufferBarrier(counter,
+                            commandBuffer,
+                            vk::AccessFlagBits::eShaderWrite,
+                            vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite);
+  };
+}
 }  // namespace
 
 Reduce::Reduce(const Renderer::Device& device,
                const Renderer::SpirvBinary& spirv,
                const glm::ivec2& size,
-               std::size_t typeSize)
-    : mSize(size.x * size.y), mReduce(device, Renderer::ComputeSize::Default1D(), spirv)
+               std::size_t typeSize,
+               Method method,
+               int components,
+               int maxMask)
+    : mSize(size.x * size.y)
+    , mMethod(method)
+    , mReduce(device,
+              Renderer::ComputeSize::Default1D(),
+              method == Method::SinglePass ? SinglePassSpirv(device,
+                                                             SPIRV::ReduceSinglePassSubgroup_comp,
+                                                             SPIRV::ReduceSinglePass_comp)
+                                           : spirv,
+              MakeSpecConst(method, components, maxMask))
 {
   auto computeSize = MakeComputeSize(mSize);
+  if (mMethod == Method::SinglePass)
+  {
+    // partial result of each work group and counter of finished work groups
+    mBuffers.emplace_back(device,
+                          vk::BufferUsageFlagBits::eStorageBuffer,
+                          VMA_MEMORY_USAGE_GPU_ONLY,
+                          sizeof(glm::vec4) * computeSize.WorkSize.x);
+    mBuffers.emplace_back(device,
+                          vk::BufferUsageFlagBits::eStorageBuffer,
+                          VMA_MEMORY_USAGE_GPU_ONLY,
+                          sizeof(uint32_t));
+
+    // the counter is reset by the last work group of each dispatch
+    Renderer::GenericBuffer& counter = mBuffers.back();
+    device.Execute([&](vk::CommandBuffer commandBuffer) { counter.Clear(commandBuffer); });
+    return;
+  }
+
   while (computeSize.WorkSize.x > 1)
   {
     mBuffers.emplace_back(device,
@@ -51,6 +133,17 @@ Reduce::Reduce(const Renderer::Device& device,
 
 Reduce::Bound Reduce::Bind(Renderer::GenericBuffer& input, Renderer::GenericBuffer& output)
 {
+  if (mMethod == Method::SinglePass)
+  {
+    std::vector<Renderer::Work::Bound> bounds;
+    bounds.emplace_back(
+        mReduce.Bind(MakeComputeSize(mSize), {input, output, mBuffers[0], mBuffers[1]}));
+
+    auto bufferBarrier =
+        MakeSinglePassBarrier(output.Handle(), mBuffers[0].Handle(), mBuffers[1].Handle());
+    return Bound(mSize, [](vk::CommandBuffer) {}, {bufferBarrier}, std::move(bounds));
+  }
+
   std::vector<Renderer::GenericBuffer*> buffers;
   buffers.push_back(&input);
   for (auto& buffer : mBuffers)
@@ -75,13 +168,25 @@ Reduce::Bound Reduce::Bind(Renderer::GenericBuffer& input, Renderer::GenericBuff
     });
   }
 
-  return Bound(mSize, bufferBarriers, std::move(bounds));
+  // blocks of the first pass which are not dispatched indirectly are zero
+  Renderer::CommandBuffer::CommandFn bufferClear = [](vk::CommandBuffer) {};
+  if (!mBuffers.empty())
+  {
+    Renderer::GenericBuffer* buffer = &mBuffers[0];
+    bufferClear = [=](vk::CommandBuffer commandBuffer) { buffer->Clear(commandBuffer); };
+  }
+
+  return Bound(mSize, bufferClear, bufferBarriers, std::move(bounds));
 }
 
 Reduce::Bound::Bound(int size,
+                     const Renderer::CommandBuffer::CommandFn& bufferClear,
                      const std::vector<Renderer::CommandBuffer::CommandFn>& bufferBarriers,
                      std::vector<Renderer::Work::Bound>&& bounds)
-    : mSize(size), mBufferBarriers(bufferBarriers), mBounds(std::move(bounds))
+    : mSize(size)
+    , mBufferClear(bufferClear)
+    , mBufferBarriers(bufferBarriers)
+    , mBounds(std::move(bounds))
 {
 }
 
@@ -99,8 +204,28 @@ void Reduce::Bound::Record(vk::CommandBuffer commandBuffer)
   }
 }
 
-ReduceSum::ReduceSum(const Renderer::Device& device, const glm::ivec2& size)
-    : Reduce(device, SPIRV::Sum_comp, size, sizeof(float))
+void Reduce::Bound::RecordIndirect(
+    vk::CommandBuffer commandBuffer,
+    Renderer::IndirectBuffer<Renderer::DispatchParams>& dispatchParams)
+{
+  mBufferClear(commandBuffer);
+
+  for (std::size_t i = 0; i < mBounds.size(); i++)
+  {
+    if (i == 0)
+    {
+      mBounds[i].RecordIndirect(commandBuffer, dispatchParams);
+    }
+    else
+    {
+      mBounds[i].Record(commandBuffer);
+    }
+    mBufferBarriers[i](commandBuffer);
+  }
+}
+
+ReduceSum::ReduceSum(const Renderer::Device& device, const glm::ivec2& size, Method method)
+    : Reduce(device, SPIRV::Sum_comp, size, sizeof(float), method, 1, 0)
 {
 }
 
@@ -111,14 +236,70 @@ struct J
   alignas(4) float angular;
 };
 
-ReduceJ::ReduceJ(const Renderer::Device& device, const glm::ivec2& size)
-    : Reduce(device, SPIRV::SumJ_comp, size, sizeof(J))
+ReduceJ::ReduceJ(const Renderer::Device& device, const glm::ivec2& size, Method method)
+    : Reduce(device, SPIRV::SumJ_comp, size, sizeof(J), method, 4, 0)
+{
+}
+
+ReduceMax::ReduceMax(const Renderer::Device& device, const glm::ivec2& size, Method method)
+    : Reduce(device, SPIRV::Max_comp, size, sizeof(float), method, 1, 1)
+{
+}
+
+ReduceSumMax::ReduceSumMax(const Renderer::Device& device, const glm::ivec2& size, Method method)
+    : Reduce(device, SPIRV::SumMax_comp, size, sizeof(glm::vec4), method, 4, 4)
+{
+}
+
+ReduceMultiple::ReduceMultiple(const Renderer::Device& device,
+                               const glm::ivec2& size,
+                               const std::vector<Operation>& operations)
+    : mSize(size.x * size.y)
+    , mCount(operations.size())
+    , mReduce(device,
+              Renderer::ComputeSize::Default1D(),
+              SinglePassSpirv(device,
+                              SPIRV::ReduceMultipleSubgroup_comp,
+                              SPIRV::ReduceMultiple_comp),
+              Renderer::SpecConst(Renderer::SpecConstValue(3, static_cast<int>(mCount)),
+                                  Renderer::SpecConstValue(4, MakeMaxMask(operations))))
+    , mPartials(device, MakeComputeSize(mSize).WorkSize.x)
+    , mCounter(device)
 {
+  if (operations.empty() || operations.size() > 4)
+  {
+    throw std::runtime_error("Reduce multiple requires between 1 and 4 operations");
+  }
+
+  // the counter is reset by the last work group of each dispatch
+  device.Execute([&](vk::CommandBuffer commandBuffer) { mCounter.Clear(commandBuffer); });
 }
 
-ReduceMax::ReduceMax(const Renderer::Device& device, const glm::ivec2& size)
-    : Reduce(device, SPIRV::Max_comp, size, sizeof(float))
+Reduce::Bound ReduceMultiple::Bind(const std::vector<Input>& inputs,
+                                   Renderer::GenericBuffer& output)
 {
+  if (inputs.size() != mCount)
+  {
+    throw std::runtime_error("Number of inputs different from number of operations");
+  }
+
+  // the inputs of unused operations are bound to the last input
+  std::vector<Renderer::BindingInput> bindingInputs;
+  for (std::size_t i = 0; i < 4; i++)
+  {
+    auto& input = inputs[std::min(i, inputs.size() - 1)];
+    bindingInputs.emplace_back(input.a);
+    bindingInputs.emplace_back(input.b);
+  }
+  bindingInputs.emplace_back(output);
+  bindingInputs.emplace_back(mPartials);
+  bindingInputs.emplace_back(mCounter);
+
+  std::vector<Renderer::Work::Bound> bounds;
+  bounds.emplace_back(mReduce.Bind(MakeComputeSize(mSize), bindingInputs));
+
+  auto bufferBarrier = MakeSinglePassBarrier(output.Handle(), mPartials.Handle(), mCounter.Handle());
+  return Reduce::Bound(mSize, [](vk::CommandBuffer) {}, {bufferBarrier}, std::move(bounds));
 }
 
 }  // namespace Fluid
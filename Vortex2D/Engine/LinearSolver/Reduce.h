@@ -20,6 +20,24 @@ namespace Fluid
 class Reduce
 {
 public:
+  /**
+   * @brief How the reduction is dispatched.
+   */
+  enum class Method
+  {
+    /**
+     * @brief A chain of dispatches, each reducing its input by the size of a
+     * work group.
+     */
+    Recursive,
+    /**
+     * @brief A single dispatch, the last work group to finish reduces the
+     * results of the others. Uses subgroup operations when the device
+     * supports them.
+     */
+    SinglePass
+  };
+
   virtual ~Reduce() {}
 
   /**
@@ -36,14 +54,28 @@ public:
      */
     VORTEX2D_API void Record(vk::CommandBuffer commandBuffer);
 
+    /**
+     * @brief Record the reduce operation, with the first pass dispatched
+     * with the parameters. Only the blocks of the input that are dispatched
+     * are reduced, the dispatch must have at least one work group.
+     * @param commandBuffer the command buffer to record into.
+     * @param dispatchParams the indirect buffer containing the parameters.
+     */
+    VORTEX2D_API void RecordIndirect(
+        vk::CommandBuffer commandBuffer,
+        Renderer::IndirectBuffer<Renderer::DispatchParams>& dispatchParams);
+
     friend class Reduce;
+    friend class ReduceMultiple;
 
   private:
     Bound(int size,
+          const Renderer::CommandBuffer::CommandFn& bufferClear,
           const std::vector<Renderer::CommandBuffer::CommandFn>& bufferBarriers,
           std::vector<Renderer::Work::Bound>&& bounds);
 
     int mSize;
+    Renderer::CommandBuffer::CommandFn mBufferClear;
     std::vector<Renderer::CommandBuffer::CommandFn> mBufferBarriers;
     std::vector<Renderer::Work::Bound> mBounds;
   };
@@ -60,10 +92,14 @@ protected:
   Reduce(const Renderer::Device& device,
          const Renderer::SpirvBinary& spirv,
          const glm::ivec2& size,
-         std::size_t typeSize);
+         std::size_t typeSize,
+         Method method = Method::Recursive,
+         int components = 1,
+         int maxMask = 0);
 
 private:
   int mSize;
+  Method mMethod;
   Renderer::Work mReduce;
   std::vector<Renderer::GenericBuffer> mBuffers;
 };
@@ -78,8 +114,11 @@ public:
    * @brief Initialize reduce with device and 2d size
    * @param device
    * @param size
+   * @param method recursive or single pass reduction
    */
-  VORTEX2D_API ReduceSum(const Renderer::Device& device, const glm::ivec2& size);
+  VORTEX2D_API ReduceSum(const Renderer::Device& device,
+                         const glm::ivec2& size,
+                         Method method = Method::Recursive);
 };
 
 /**
@@ -93,8 +132,11 @@ public:
    * @brief Initialize reduce with device and 2d size
    * @param device
    * @param size
+   * @param method recursive or single pass reduction
    */
-  VORTEX2D_API ReduceJ(const Renderer::Device& device, const glm::ivec2& size);
+  VORTEX2D_API ReduceJ(const Renderer::Device& device,
+                       const glm::ivec2& size,
+                       Method method = Method::Recursive);
 };
 
 /**
@@ -107,8 +149,88 @@ public:
    * @brief Initialize reduce with device and 2d size
    * @param device
    * @param size
+   * @param method recursive or single pass reduction
    */
-  VORTEX2D_API ReduceMax(const Renderer::Device& device, const glm::ivec2& size);
+  VORTEX2D_API ReduceMax(const Renderer::Device& device,
+                         const glm::ivec2& size,
+                         Method method = Method::Recursive);
+};
+
+/**
+ * @brief Reduce operation on a vec4: x and y are summed, z is the max. This
+ * computes two inner products and a max error in a single reduction.
+ */
+class ReduceSumMax : public Reduce
+{
+public:
+  /**
+   * @brief Initialize reduce with device and 2d size
+   * @param device
+   * @param size
+   * @param method recursive or single pass reduction
+   */
+  VORTEX2D_API ReduceSumMax(const Renderer::Device& device,
+                            const glm::ivec2& size,
+                            Method method = Method::Recursive);
+};
+
+/**
+ * @brief Reduce of up to 4 operations in a single pass, the results are stored
+ * in a vec4. For example two inner products and a max error can be computed
+ * with one dispatch.
+ */
+class ReduceMultiple
+{
+public:
+  /**
+   * @brief The operation of a component of the result.
+   */
+  enum class Operation
+  {
+    /**
+     * @brief Inner product of the two inputs, i.e. sum of a * b.
+     */
+    Sum,
+    /**
+     * @brief Max of the absolute of the first input, the second is ignored.
+     */
+    Max
+  };
+
+  /**
+   * @brief The two inputs of an operation.
+   */
+  struct Input
+  {
+    Renderer::GenericBuffer& a;
+    Renderer::GenericBuffer& b;
+  };
+
+  /**
+   * @brief Initialize reduce with device, 2d size and the operations.
+   * @param device
+   * @param size
+   * @param operations between 1 and 4 operations
+   */
+  VORTEX2D_API ReduceMultiple(const Renderer::Device& device,
+                              const glm::ivec2& size,
+                              const std::vector<Operation>& operations);
+
+  /**
+   * @brief Bind the reduce operation.
+   * @param inputs the inputs of each operation, in the same order
+   * @param output buffer of a vec4
+   * @return a bound object that can be recorded in a command buffer.
+   */
+  VORTEX2D_API Reduce::Bound Bind(const std::vector<Input>& inputs,
+                                  Renderer::GenericBuffer& output);
+
+private:
+  int mSize;
+  std::size_t mCount;
+  Renderer::Work mReduce;
+  Renderer::Buffer<glm::vec4> mPartials;
+  Renderer::Buffer<uint32_t> mCounter;
 };
 
 }  // namespace Fluid
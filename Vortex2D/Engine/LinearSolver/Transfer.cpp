@@ -47,20 +47,31 @@ void Transfer::RestrictBind(std::size_t level,
   {
     mRestrictBound.resize(level + 1);
     mRestrictBuffer.resize(level + 1);
+    mRestrictSize.resize(level + 1);
   }
 
-  glm::ivec2 coarseSize = fineSize / glm::ivec2(2);
+  glm::ivec2 coarseSize = (fineSize + glm::ivec2(1)) / glm::ivec2(2);
 
   mRestrictBound[level] =
       mRestrictWork.Bind(coarseSize, {fineDiagonal, fine, coarseDiagonal, coarse});
   mRestrictBuffer[level] = &coarse;
+  mRestrictSize[level] = fineSize;
 }
 
-void Transfer::Prolongate(vk::CommandBuffer commandBuffer, std::size_t level)
+void Transfer::Prolongate(vk::CommandBuffer commandBuffer,
+                          std::size_t level,
+                          Renderer::IndirectBuffer<Renderer::DispatchParams>* dispatchParams)
 {
   assert(level < mProlongateBound.size());
 
-  mProlongateBound[level].Record(commandBuffer);
+  if (dispatchParams != nullptr)
+  {
+    mProlongateBound[level].RecordIndirect(commandBuffer, *dispatchParams);
+  }
+  else
+  {
+    mProlongateBound[level].Record(commandBuffer);
+  }
   mProlongateBuffer[level]->Barrier(
       commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
 }
@@ -69,6 +80,8 @@ void Transfer::Restrict(vk::CommandBuffer commandBuffer, std::size_t level)
 {
   assert(level < mRestrictBound.size());
 
+  mRestrictBound[level].PushConstant(
+      commandBuffer, mRestrictSize[level].x, mRestrictSize[level].y);
   mRestrictBound[level].Record(commandBuffer);
   mRestrictBuffer[level]->Barrier(
       commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
@@ -36,7 +36,7 @@ public:
    * fineSize
    * @param coarse the coarse level set
    * @param coarseDiagonal the diagonal of the linear equation matrix at size
-   * half of @p fineSize
+   * half of @p fineSize, rounded up
    */
   VORTEX2D_API void ProlongateBind(std::size_t level,
                                    const glm::ivec2& fineSize,
@@ -55,7 +55,7 @@ public:
    * fineSize
    * @param coarse the coarse level set
    * @param coarseDiagonal the diagonal of the linear equation matrix at size
-   * half of @p fineSize
+   * half of @p fineSize, rounded up
    */
   VORTEX2D_API void RestrictBind(std::size_t level,
                                  const glm::ivec2& fineSize,
@@ -69,8 +69,13 @@ public:
    * specified index.
    * @param commandBuffer command buffer to record into.
    * @param level index of bound level sets.
+   * @param dispatchParams optional indirect dispatch parameters, of the work
+   * size of the fine level.
    */
-  VORTEX2D_API void Prolongate(vk::CommandBuffer commandBuffer, std::size_t level);
+  VORTEX2D_API void Prolongate(
+      vk::CommandBuffer commandBuffer,
+      std::size_t level,
+      Renderer::IndirectBuffer<Renderer::DispatchParams>* dispatchParams = nullptr);
 
   /**
    * @brief Restrict the level set, using the bound level sets at the specified
@@ -89,6 +94,7 @@ private:
   Renderer::Work mRestrictWork;
   std::vector<Renderer::Work::Bound> mRestrictBound;
   std::vector<Renderer::GenericBuffer*> mRestrictBuffer;
+  std::vector<glm::ivec2> mRestrictSize;
 };
 
 }  // namespace Fluid
@@ -6,6 +6,7 @@
 #include "Particles.h"
 
 #include <Vortex2D/Engine/LevelSet.h>
+#include <Vortex2D/Renderer/Profiler.h>
 
 #include <random>
 #include "vortex2d_generated_spirv.h"
@@ -93,8 +94,8 @@ ParticleCount::ParticleCount(const Renderer::Device& device,
   // 8) copy new particles to particles
 
   mScanWork.Record([&](vk::CommandBuffer commandBuffer) {
-    commandBuffer.debugMarkerBeginEXT({"Particle count", {{0.14f, 0.39f, 0.12f, 1.0f}}},
-                                      mDevice.Loader());
+    Renderer::BeginMarker(
+        mDevice, commandBuffer, {"Particle count", {{0.14f, 0.39f, 0.12f, 1.0f}}});
     mDelta.CopyFrom(commandBuffer, *this);
     Clear(commandBuffer, std::array<int, 4>{0, 0, 0, 0});
     mParticleCountBound.RecordIndirect(commandBuffer, mDispatchParams);
@@ -104,10 +105,9 @@ ParticleCount::ParticleCount(const Renderer::Device& device,
     mDelta.Barrier(
         commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
     mCount.CopyFrom(commandBuffer, mDelta);
-    commandBuffer.debugMarkerEndEXT(mDevice.Loader());
+    Renderer::EndMarker(mDevice, commandBuffer);
 
-    commandBuffer.debugMarkerBeginEXT({"Particle scan", {{0.59f, 0.20f, 0.35f, 1.0f}}},
-                                      mDevice.Loader());
+    Renderer::BeginMarker(mDevice, commandBuffer, {"Particle scan", {{0.59f, 0.20f, 0.35f, 1.0f}}});
     mPrefixScanBound.Record(commandBuffer);
     mParticleBucketBound.RecordIndirect(commandBuffer, mDispatchParams);
     mNewParticles.Barrier(
@@ -117,7 +117,7 @@ ParticleCount::ParticleCount(const Renderer::Device& device,
         commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
     particles.CopyFrom(commandBuffer, mNewParticles);
     mDispatchParams.CopyFrom(commandBuffer, mNewDispatchParams);
-    commandBuffer.debugMarkerEndEXT(mDevice.Loader());
+    Renderer::EndMarker(mDevice, commandBuffer);
   });
 
   mDispatchCountWork.Record([&](vk::CommandBuffer commandBuffer) {
@@ -157,8 +157,7 @@ void ParticleCount::LevelSetBind(LevelSet& levelSet)
   // TODO should shrink wrap wholes and redistance
   mParticlePhiBound = mParticlePhiWork.Bind({mCount, mParticles, mIndex, levelSet});
   mParticlePhi.Record([&](vk::CommandBuffer commandBuffer) {
-    commandBuffer.debugMarkerBeginEXT({"Particle phi", {{0.86f, 0.72f, 0.29f, 1.0f}}},
-                                      mDevice.Loader());
+    Renderer::BeginMarker(mDevice, commandBuffer, {"Particle phi", {{0.86f, 0.72f, 0.29f, 1.0f}}});
     levelSet.Clear(commandBuffer, std::array<float, 4>{3.0f, 0.0f, 0.0f, 0.0f});
     mParticlePhiBound.Record(commandBuffer);
     levelSet.Barrier(commandBuffer,
@@ -166,7 +165,7 @@ void ParticleCount::LevelSetBind(LevelSet& levelSet)
                      vk::AccessFlagBits::eShaderWrite,
                      vk::ImageLayout::eGeneral,
                      vk::AccessFlagBits::eShaderRead);
-    commandBuffer.debugMarkerEndEXT(mDevice.Loader());
+    Renderer::EndMarker(mDevice, commandBuffer);
   });
 }
 
@@ -179,24 +178,24 @@ void ParticleCount::VelocitiesBind(Velocity& velocity, Renderer::GenericBuffer&
 {
   mParticleToGridBound = mParticleToGridWork.Bind({mCount, mParticles, mIndex, velocity, valid});
   mParticleToGrid.Record([&](vk::CommandBuffer commandBuffer) {
-    commandBuffer.debugMarkerBeginEXT({"Particle to grid", {{0.71f, 0.15f, 0.48f, 1.0f}}},
-                                      mDevice.Loader());
+    Renderer::BeginMarker(
+        mDevice, commandBuffer, {"Particle to grid", {{0.71f, 0.15f, 0.48f, 1.0f}}});
     valid.Clear(commandBuffer);
     mParticleToGridBound.Record(commandBuffer);
     valid.Barrier(commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
-    commandBuffer.debugMarkerEndEXT(mDevice.Loader());
+    Renderer::EndMarker(mDevice, commandBuffer);
   });
 
   mParticleFromGridBound =
       mParticleFromGridWork.Bind({mParticles, mDispatchParams, velocity, velocity.D()});
   mParticleFromGrid.Record([&](vk::CommandBuffer commandBuffer) {
-    commandBuffer.debugMarkerBeginEXT({"Particle from grid", {{0.35f, 0.11f, 0.87f, 1.0f}}},
-                                      mDevice.Loader());
+    Renderer::BeginMarker(
+        mDevice, commandBuffer, {"Particle from grid", {{0.35f, 0.11f, 0.87f, 1.0f}}});
     mParticleFromGridBound.PushConstant(commandBuffer, mSize.x, mSize.y, mAlpha);
     mParticleFromGridBound.RecordIndirect(commandBuffer, mDispatchParams);
     mParticles.Barrier(
         commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
-    commandBuffer.debugMarkerEndEXT(mDevice.Loader());
+    Renderer::EndMarker(mDevice, commandBuffer);
   });
 }
 
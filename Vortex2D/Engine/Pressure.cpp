@@ -5,7 +5,9 @@
 
 #include "Pressure.h"
 
+#include <Vortex2D/Engine/Tiles.h>
 #include <Vortex2D/Renderer/Pipeline.h>
+#include <Vortex2D/Renderer/Profiler.h>
 
 #include "vortex2d_generated_spirv.h"
 
@@ -20,51 +22,76 @@ Pressure::Pressure(const Renderer::Device& device,
                    Velocity& velocity,
                    Renderer::Texture& solidPhi,
                    Renderer::Texture& liquidPhi,
-                   Renderer::GenericBuffer& valid)
+                   Renderer::GenericBuffer& valid,
+                   LinearSolver::Matrix matrix)
     : mDevice(device)
+    , mDt(dt)
     , mData(data)
-    , mBuildMatrix(device, size, SPIRV::BuildMatrix_comp)
+    , mVelocity(velocity)
+    , mSolidPhi(solidPhi)
+    , mLiquidPhi(liquidPhi)
+    , mValid(valid)
+    , mMatrix(matrix)
+    , mTiles(nullptr)
+    , mNoTiles(device)
+    , mBuildMatrix(device,
+                   size,
+                   SPIRV::BuildMatrix_comp,
+                   Renderer::SpecConst(Renderer::SpecConstValue(
+                       3, matrix == LinearSolver::Matrix::Explicit ? 1 : 0)))
     , mBuildMatrixBound(mBuildMatrix.Bind({data.Diagonal, data.Lower, liquidPhi, solidPhi}))
+    , mBuildHalfMatrix(device,
+                       size,
+                       SPIRV::BuildMatrix_comp,
+                       Renderer::SpecConst(Renderer::SpecConstValue(3, 1),
+                                           Renderer::SpecConstValue(4, 1)),
+                       true)
+    , mBuildExplicitMatrix(device,
+                           size,
+                           SPIRV::BuildMatrix_comp,
+                           Renderer::SpecConst(Renderer::SpecConstValue(3, 1)),
+                           true)
     , mBuildDiv(device, size, SPIRV::BuildDiv_comp)
-    , mBuildDivBound(mBuildDiv.Bind({data.B, data.Diagonal, liquidPhi, solidPhi, velocity}))
+    , mBuildDivBound(
+          mBuildDiv.Bind({data.B, data.Diagonal, liquidPhi, solidPhi, velocity, mNoTiles}))
+    , mBuildDivTiled(device,
+                     size,
+                     SPIRV::BuildDiv_comp,
+                     Renderer::SpecConst(Renderer::SpecConstValue(10, 1)),
+                     true)
     , mProject(device, size, SPIRV::Project_comp)
-    , mProjectBound(
-          mProject.Bind({data.X, liquidPhi, solidPhi, velocity, velocity.Output(), valid}))
+    , mProjectBound(mProject.Bind(
+          {data.X, liquidPhi, solidPhi, velocity, velocity.Output(), valid, mNoTiles}))
+    , mProjectTiled(device,
+                    size,
+                    SPIRV::Project_comp,
+                    Renderer::SpecConst(Renderer::SpecConstValue(10, 1)),
+                    true)
     , mBuildEquationCmd(device, false)
     , mProjectCmd(device, false)
 {
-  mBuildEquationCmd.Record([&](vk::CommandBuffer commandBuffer) {
-    commandBuffer.debugMarkerBeginEXT({"Build equations", {{0.02f, 0.68f, 0.84f, 1.0f}}},
-                                      mDevice.Loader());
-    mBuildMatrixBound.PushConstant(commandBuffer, dt);
-    mBuildMatrixBound.Record(commandBuffer);
-    data.Diagonal.Barrier(
-        commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
-    data.Lower.Barrier(
-        commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
-    mBuildDivBound.Record(commandBuffer);
-    data.B.Barrier(
-        commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
-    commandBuffer.debugMarkerEndEXT(mDevice.Loader());
-  });
-
-  mProjectCmd.Record([&](vk::CommandBuffer commandBuffer) {
-    commandBuffer.debugMarkerBeginEXT({"Pressure", {{0.45f, 0.47f, 0.75f, 1.0f}}},
-                                      mDevice.Loader());
-    valid.Clear(commandBuffer);
-    mProjectBound.PushConstant(commandBuffer, dt);
-    mProjectBound.Record(commandBuffer);
-    velocity.CopyBack(commandBuffer);
-    commandBuffer.debugMarkerEndEXT(mDevice.Loader());
-  });
+  RecordBuildEquation();
+  RecordProject();
 }
 
 Renderer::Work::Bound Pressure::BindMatrixBuild(const glm::ivec2& size,
                                                 Renderer::GenericBuffer& diagonal,
                                                 Renderer::GenericBuffer& lower,
                                                 Renderer::Texture& liquidPhi,
-                                                Renderer::Texture& solidPhi)
+                                                Renderer::Texture& solidPhi,
+                                                LinearSolver::Precision precision)
 {
+  if (precision == LinearSolver::Precision::Half)
+  {
+    return mBuildHalfMatrix.Bind(size, {diagonal, lower, liquidPhi, solidPhi});
+  }
+
+  // e.g. the multigrid hierarchy of a matrix free system
+  if (mMatrix != LinearSolver::Matrix::Explicit)
+  {
+    return mBuildExplicitMatrix.Bind(size, {diagonal, lower, liquidPhi, solidPhi});
+  }
+
   return mBuildMatrix.Bind(size, {diagonal, lower, liquidPhi, solidPhi});
 }
 
@@ -78,5 +105,89 @@ void Pressure::ApplyPressure()
   mProjectCmd.Submit();
 }
 
+void Pressure::TilesBind(Tiles& tiles)
+{
+  mTiles = &tiles;
+  mBuildDivTiledBound = mBuildDivTiled.Bind(
+      {mData.B, mData.Diagonal, mLiquidPhi, mSolidPhi, mVelocity, tiles.GetList()});
+  mProjectTiledBound = mProjectTiled.Bind({mData.X,
+                                           mLiquidPhi,
+                                           mSolidPhi,
+                                           mVelocity,
+                                           mVelocity.Output(),
+                                           mValid,
+                                           tiles.GetList()});
+  mClearDivBound = tiles.BindClear(mData.B);
+  mClearValidBound = tiles.BindClear(mValid);
+  mCopyBackBound = tiles.BindCopy(mVelocity.Output(), mVelocity);
+
+  RecordBuildEquation();
+  RecordProject();
+}
+
+void Pressure::RecordBuildEquation()
+{
+  mBuildEquationCmd.Record([&](vk::CommandBuffer commandBuffer) {
+    Renderer::BeginMarker(
+        mDevice, commandBuffer, {"Build equations", {{0.02f, 0.68f, 0.84f, 1.0f}}});
+    mBuildMatrixBound.PushConstant(commandBuffer, mDt);
+    mBuildMatrixBound.Record(commandBuffer);
+    mData.Diagonal.Barrier(
+        commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+    mData.Lower.Barrier(
+        commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+    if (mTiles)
+    {
+      // the divergence is zero outside of the active tiles
+      mTiles->RecordClear(commandBuffer, mClearDivBound);
+      mData.B.Barrier(
+          commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderWrite);
+      mBuildDivTiledBound.RecordIndirect(commandBuffer, mTiles->GetDispatchParams());
+    }
+    else
+    {
+      mBuildDivBound.Record(commandBuffer);
+    }
+    mData.B.Barrier(
+        commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+    Renderer::EndMarker(mDevice, commandBuffer);
+  });
+}
+
+void Pressure::RecordProject()
+{
+  mProjectCmd.Record([&](vk::CommandBuffer commandBuffer) {
+    Renderer::BeginMarker(mDevice, commandBuffer, {"Pressure", {{0.45f, 0.47f, 0.75f, 1.0f}}});
+    if (mTiles)
+    {
+      // only the active tiles are written and copied back
+      mTiles->RecordClear(commandBuffer, mClearValidBound);
+      mValid.Barrier(
+          commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderWrite);
+      mProjectTiledBound.PushConstant(commandBuffer, mDt);
+      mProjectTiledBound.RecordIndirect(commandBuffer, mTiles->GetDispatchParams());
+      mVelocity.Output().Barrier(commandBuffer,
+                                 vk::ImageLayout::eGeneral,
+                                 vk::AccessFlagBits::eShaderWrite,
+                                 vk::ImageLayout::eGeneral,
+                                 vk::AccessFlagBits::eShaderRead);
+      mTiles->RecordCopy(commandBuffer, mCopyBackBound);
+      mVelocity.Barrier(commandBuffer,
+                        vk::ImageLayout::eGeneral,
+                        vk::AccessFlagBits::eShaderWrite,
+                        vk::ImageLayout::eGeneral,
+                        vk::AccessFlagBits::eShaderRead);
+    }
+    else
+    {
+      mValid.Clear(commandBuffer);
+      mProjectBound.PushConstant(commandBuffer, mDt);
+      mProjectBound.Record(commandBuffer);
+      mVelocity.CopyBack(commandBuffer);
+    }
+    Renderer::EndMarker(mDevice, commandBuffer);
+  });
+}
+
 }  // namespace Fluid
 }  // namespace Vortex2D
@@ -18,6 +18,8 @@ namespace Vortex2D
 {
 namespace Fluid
 {
+class Tiles;
+
 /**
  * @brief build the linear equation and compute the divergence from the
  * resulting solution.
@@ -25,6 +27,11 @@ namespace Fluid
 class Pressure
 {
 public:
+  /**
+   * @brief Initialize the linear equations building and the projection.
+   * @param matrix with a matrix free system, only the diagonal is built and
+   * the solver computes the other coefficients from the level sets.
+   */
   VORTEX2D_API Pressure(const Renderer::Device& device,
                         float dt,
                         const glm::ivec2& size,
@@ -32,7 +39,8 @@ public:
                         Velocity& velocity,
                         Renderer::Texture& solidPhi,
                         Renderer::Texture& liquidPhi,
-                        Renderer::GenericBuffer& valid);
+                        Renderer::GenericBuffer& valid,
+                        LinearSolver::Matrix matrix = LinearSolver::Matrix::Explicit);
 
   /**
    * @brief Bind the various buffes for the linear system Ax = b
@@ -41,13 +49,18 @@ public:
    * @param lower lower matrix of A
    * @param liquidPhi liquid level set
    * @param solidPhi solid level set
-   * @return
+   * @param precision with half precision, the lower matrix is written as two
+   * packed halfs
+   * @return the bound matrix build, the lower matrix is always written even
+   * if the system of this pressure is matrix free
    */
-  Renderer::Work::Bound BindMatrixBuild(const glm::ivec2& size,
-                                        Renderer::GenericBuffer& diagonal,
-                                        Renderer::GenericBuffer& lower,
-                                        Renderer::Texture& liquidPhi,
-                                        Renderer::Texture& solidPhi);
+  Renderer::Work::Bound BindMatrixBuild(
+      const glm::ivec2& size,
+      Renderer::GenericBuffer& diagonal,
+      Renderer::GenericBuffer& lower,
+      Renderer::Texture& liquidPhi,
+      Renderer::Texture& solidPhi,
+      LinearSolver::Precision precision = LinearSolver::Precision::Full);
 
   /**
    * @brief Build the matrix A and right hand side b.
@@ -60,15 +73,46 @@ public:
    */
   VORTEX2D_API void ApplyPressure();
 
+  /**
+   * @brief Only build the right hand side b and apply the pressure on the
+   * active tiles. b is zero outside of them and the velocity keeps its
+   * values. The matrix A is still built on the whole grid.
+   * @param tiles the active tiles
+   */
+  VORTEX2D_API void TilesBind(Tiles& tiles);
+
 private:
+  void RecordBuildEquation();
+  void RecordProject();
+
   const Renderer::Device& mDevice;
+  float mDt;
   LinearSolver::Data& mData;
+  Velocity& mVelocity;
+  Renderer::Texture& mSolidPhi;
+  Renderer::Texture& mLiquidPhi;
+  Renderer::GenericBuffer& mValid;
+  LinearSolver::Matrix mMatrix;
+  Tiles* mTiles;
+
+  // bound in place of the tiles to the untiled works, which don't read them
+  Renderer::Buffer<glm::ivec2> mNoTiles;
+
   Renderer::Work mBuildMatrix;
   Renderer::Work::Bound mBuildMatrixBound;
+  Renderer::Work mBuildHalfMatrix;
+  Renderer::Work mBuildExplicitMatrix;
   Renderer::Work mBuildDiv;
   Renderer::Work::Bound mBuildDivBound;
+  Renderer::Work mBuildDivTiled;
+  Renderer::Work::Bound mBuildDivTiledBound;
   Renderer::Work mProject;
   Renderer::Work::Bound mProjectBound;
+  Renderer::Work mProjectTiled;
+  Renderer::Work::Bound mProjectTiledBound;
+  Renderer::Work::Bound mClearDivBound;
+  Renderer::Work::Bound mClearValidBound;
+  Renderer::Work::Bound mCopyBackBound;
   Renderer::CommandBuffer mBuildEquationCmd;
   Renderer::CommandBuffer mProjectCmd;
 };
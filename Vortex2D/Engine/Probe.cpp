@@ -0,0 +1,103 @@
+//
+//  Probe.cpp
+//  Vortex2D
+//
+
+#include "Probe.h"
+
+#include "vortex2d_generated_spirv.h"
+
+namespace Vortex2D
+{
+namespace Fluid
+{
+Probe::Probe(const Renderer::Device& device,
+             const glm::ivec2& size,
+             Renderer::Buffer<glm::vec2>& positions)
+    : mCount(static_cast<int>(positions.Size() / sizeof(glm::vec2)))
+    , mSize(size)
+    , mPositions(positions)
+    , mSampler(Renderer::SamplerBuilder()
+                   .AddressMode(vk::SamplerAddressMode::eClampToEdge)
+                   .Filter(vk::Filter::eLinear)
+                   .Create(device.Handle()))
+    , mSamples(device, mCount)
+    , mLocalSamples(device, mCount, VMA_MEMORY_USAGE_GPU_TO_CPU)
+    , mTextureSamples(device, mCount)
+    , mLocalTextureSamples(device, mCount, VMA_MEMORY_USAGE_GPU_TO_CPU)
+    , mProbe(device, Renderer::ComputeSize(mCount), SPIRV::Probe_comp)
+    , mProbeTexture(device, Renderer::ComputeSize(mCount), SPIRV::ProbeTexture_comp)
+    , mProbeCmd(device, true)
+    , mFieldsBound(false)
+    , mTextureBound(false)
+{
+}
+
+void Probe::Bind(Velocity& velocity,
+                 Renderer::Texture& liquidPhi,
+                 Renderer::GenericBuffer& pressure)
+{
+  mProbeBound = mProbe.Bind({mPositions, velocity, liquidPhi, pressure, mSamples});
+  mFieldsBound = true;
+  Record();
+}
+
+void Probe::BindTexture(Renderer::Texture& texture)
+{
+  mProbeTextureBound = mProbeTexture.Bind({mPositions, {*mSampler, texture}, mTextureSamples});
+  mTextureBound = true;
+  Record();
+}
+
+void Probe::Record()
+{
+  mProbeCmd.Record([&](vk::CommandBuffer commandBuffer) {
+    if (mFieldsBound)
+    {
+      mProbeBound.PushConstant(commandBuffer, mSize.x, mSize.y);
+      mProbeBound.Record(commandBuffer);
+      mLocalSamples.CopyFrom(commandBuffer, mSamples);
+    }
+
+    if (mTextureBound)
+    {
+      mProbeTextureBound.Record(commandBuffer);
+      mLocalTextureSamples.CopyFrom(commandBuffer, mTextureSamples);
+    }
+  });
+}
+
+void Probe::Submit()
+{
+  if (!mProbeCmd)
+  {
+    throw std::runtime_error("No fields bound to the probe");
+  }
+
+  mProbeCmd.Submit();
+}
+
+void Probe::Get(std::vector<Sample>& samples)
+{
+  if (!mFieldsBound)
+  {
+    throw std::runtime_error("No fields bound to the probe");
+  }
+
+  mProbeCmd.Wait();
+  Renderer::CopyTo(mLocalSamples, samples);
+}
+
+void Probe::GetTexture(std::vector<glm::vec4>& samples)
+{
+  if (!mTextureBound)
+  {
+    throw std::runtime_error("No texture bound to the probe");
+  }
+
+  mProbeCmd.Wait();
+  Renderer::CopyTo(mLocalTextureSamples, samples);
+}
+
+}  // namespace Fluid
+}  // namespace Vortex2D
@@ -0,0 +1,105 @@
+//
+//  Probe.h
+//  Vortex2D
+//
+
+#ifndef Vortex2D_Probe_h
+#define Vortex2D_Probe_h
+
+#include <Vortex2D/Engine/Velocity.h>
+#include <Vortex2D/Renderer/Buffer.h>
+#include <Vortex2D/Renderer/CommandBuffer.h>
+#include <Vortex2D/Renderer/Texture.h>
+#include <Vortex2D/Renderer/Work.h>
+
+namespace Vortex2D
+{
+namespace Fluid
+{
+/**
+ * @brief Samples the fields of the simulation at a list of positions and reads
+ * back only the samples. The velocity, liquid level set and pressure are
+ * interpolated bilinearly in a single dispatch. A texture, e.g. a @ref
+ * Density, can be sampled in addition. The positions are in grid coordinates,
+ * the centre of the cells being at integer positions.
+ */
+class Probe
+{
+public:
+  /**
+   * @brief The fields at one position.
+   */
+  struct Sample
+  {
+    alignas(8) glm::vec2 Velocity;
+    alignas(4) float LiquidPhi;
+    alignas(4) float Pressure;
+  };
+
+  /**
+   * @brief Initialize the probe for a list of positions.
+   * @param device vulkan device
+   * @param size size of the grid
+   * @param positions device buffer with the positions, can be updated between
+   * submissions
+   */
+  VORTEX2D_API Probe(const Renderer::Device& device,
+                     const glm::ivec2& size,
+                     Renderer::Buffer<glm::vec2>& positions);
+
+  /**
+   * @brief Bind the fields to sample.
+   * @param velocity the velocity field
+   * @param liquidPhi the liquid level set
+   * @param pressure the pressure buffer, i.e. the solution of the linear
+   * solver
+   */
+  VORTEX2D_API void Bind(Velocity& velocity,
+                         Renderer::Texture& liquidPhi,
+                         Renderer::GenericBuffer& pressure);
+
+  /**
+   * @brief Bind a texture to sample in addition to the fields. Its format
+   * needs to support linear filtering.
+   * @param texture the texture to sample, e.g. a density
+   */
+  VORTEX2D_API void BindTexture(Renderer::Texture& texture);
+
+  /**
+   * @brief Sample the bound fields and copy the samples back. Non-blocking.
+   */
+  VORTEX2D_API void Submit();
+
+  /**
+   * @brief Wait for the last submission and get the samples of the fields.
+   * Blocking.
+   * @param samples vector of the size of the positions
+   */
+  VORTEX2D_API void Get(std::vector<Sample>& samples);
+
+  /**
+   * @brief Wait for the last submission and get the samples of the texture.
+   * Blocking.
+   * @param samples vector of the size of the positions
+   */
+  VORTEX2D_API void GetTexture(std::vector<glm::vec4>& samples);
+
+private:
+  void Record();
+
+  int mCount;
+  glm::ivec2 mSize;
+  Renderer::Buffer<glm::vec2>& mPositions;
+  vk::UniqueSampler mSampler;
+  Renderer::Buffer<Sample> mSamples, mLocalSamples;
+  Renderer::Buffer<glm::vec4> mTextureSamples, mLocalTextureSamples;
+  Renderer::Work mProbe, mProbeTexture;
+  Renderer::Work::Bound mProbeBound, mProbeTextureBound;
+  Renderer::CommandBuffer mProbeCmd;
+  bool mFieldsBound, mTextureBound;
+};
+
+}  // namespace Fluid
+}  // namespace Vortex2D
+
+#endif
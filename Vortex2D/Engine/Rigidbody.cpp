@@ -6,6 +6,7 @@
 #include "Rigidbody.h"
 #include <Vortex2D/Engine/Boundaries.h>
 #include <Vortex2D/Renderer/CommandBuffer.h>
+#include <Vortex2D/Renderer/Profiler.h>
 #include <Vortex2D/SPIRV/Reflection.h>
 
 #include "vortex2d_generated_spirv.h"
@@ -31,6 +32,7 @@ RigidBody::RigidBody(const Renderer::Device& device,
     , mLocalForce(device, 1, VMA_MEMORY_USAGE_GPU_TO_CPU)
     , mCenter(device, VMA_MEMORY_USAGE_CPU_TO_GPU)
     , mLocalVelocity(device, VMA_MEMORY_USAGE_CPU_ONLY)
+    , mStagingRing(nullptr)
     , mClear({1000.0f, 0.0f, 0.0f, 0.0f})
     , mDiv(device, size, SPIRV::BuildRigidbodyDiv_comp)
     , mConstrain(device, size, SPIRV::ConstrainRigidbodyVelocity_comp)
@@ -70,10 +72,21 @@ void RigidBody::SetVelocities(const glm::vec2& velocity, float angularVelocity)
 {
   Velocity v{velocity / glm::vec2(mSize), angularVelocity};
 
+  if (mStagingRing != nullptr)
+  {
+    mStagingRing->Upload(mVelocity, v);
+    return;
+  }
+
   Renderer::CopyFrom(mLocalVelocity, v);
   mVelocityCmd.Submit();
 }
 
+void RigidBody::SetStagingRing(Renderer::StagingRing* stagingRing)
+{
+  mStagingRing = stagingRing;
+}
+
 RigidBody::Velocity RigidBody::GetForces()
 {
   mForceCmd.Wait();
@@ -108,11 +121,11 @@ void RigidBody::BindDiv(Renderer::GenericBuffer& div, Renderer::GenericBuffer& d
 {
   mDivBound = mDiv.Bind({div, diagonal, mPhi, mVelocity, mCenter});
   mDivCmd.Record([&](vk::CommandBuffer commandBuffer) {
-    commandBuffer.debugMarkerBeginEXT({"Rigidbody build equation", {{0.90f, 0.27f, 0.28f, 1.0f}}},
-                                      mDevice.Loader());
+    Renderer::BeginMarker(
+        mDevice, commandBuffer, {"Rigidbody build equation", {{0.90f, 0.27f, 0.28f, 1.0f}}});
     mDivBound.Record(commandBuffer);
     div.Barrier(commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
-    commandBuffer.debugMarkerEndEXT(mDevice.Loader());
+    Renderer::EndMarker(mDevice, commandBuffer);
   });
 }
 
@@ -120,11 +133,11 @@ void RigidBody::BindVelocityConstrain(Fluid::Velocity& velocity)
 {
   mConstrainBound = mConstrain.Bind({velocity, velocity.Output(), mPhi, mVelocity, mCenter});
   mConstrainCmd.Record([&](vk::CommandBuffer commandBuffer) {
-    commandBuffer.debugMarkerBeginEXT({"Rigidbody constrain", {{0.29f, 0.36f, 0.21f, 1.0f}}},
-                                      mDevice.Loader());
+    Renderer::BeginMarker(
+        mDevice, commandBuffer, {"Rigidbody constrain", {{0.29f, 0.36f, 0.21f, 1.0f}}});
     mConstrainBound.Record(commandBuffer);
     velocity.CopyBack(commandBuffer);
-    commandBuffer.debugMarkerEndEXT(mDevice.Loader());
+    Renderer::EndMarker(mDevice, commandBuffer);
   });
 }
 
@@ -133,14 +146,14 @@ void RigidBody::BindForce(Renderer::GenericBuffer& diagonal, Renderer::GenericBu
   mForceBound = mForceWork.Bind({diagonal, mPhi, pressure, mForce, mCenter});
   mLocalSumBound = mSum.Bind(mForce, mLocalForce);
   mForceCmd.Record([&](vk::CommandBuffer commandBuffer) {
-    commandBuffer.debugMarkerBeginEXT({"Rigidbody force", {{0.70f, 0.59f, 0.63f, 1.0f}}},
-                                      mDevice.Loader());
+    Renderer::BeginMarker(
+        mDevice, commandBuffer, {"Rigidbody force", {{0.70f, 0.59f, 0.63f, 1.0f}}});
     mForce.Clear(commandBuffer);
     mForceBound.Record(commandBuffer);
     mForce.Barrier(
         commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
     mLocalSumBound.Record(commandBuffer);
-    commandBuffer.debugMarkerEndEXT(mDevice.Loader());
+    Renderer::EndMarker(mDevice, commandBuffer);
   });
 }
 
@@ -153,8 +166,8 @@ void RigidBody::BindPressure(float delta,
   mPressureBound = mPressureWork.Bind({d, mPhi, mReducedForce, z, mCenter});
   mSumBound = mSum.Bind(mForce, mReducedForce);
   mPressureCmd.Record([&](vk::CommandBuffer commandBuffer) {
-    commandBuffer.debugMarkerBeginEXT({"Rigidbody pressure", {{0.70f, 0.59f, 0.63f, 1.0f}}},
-                                      mDevice.Loader());
+    Renderer::BeginMarker(
+        mDevice, commandBuffer, {"Rigidbody pressure", {{0.70f, 0.59f, 0.63f, 1.0f}}});
     mForce.Clear(commandBuffer);
     mPressureForceBound.Record(commandBuffer);
     mForce.Barrier(
@@ -163,7 +176,7 @@ void RigidBody::BindPressure(float delta,
     mPressureBound.PushConstant(commandBuffer, delta, mMass, mInertia);
     mPressureBound.Record(commandBuffer);
     z.Barrier(commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
-    commandBuffer.debugMarkerEndEXT(mDevice.Loader());
+    Renderer::EndMarker(mDevice, commandBuffer);
   });
 }
 
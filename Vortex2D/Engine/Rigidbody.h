@@ -14,6 +14,7 @@
 #include <Vortex2D/Renderer/Pipeline.h>
 #include <Vortex2D/Renderer/RenderTexture.h>
 #include <Vortex2D/Renderer/Shapes.h>
+#include <Vortex2D/Renderer/StagingRing.h>
 #include <Vortex2D/Renderer/Transformable.h>
 #include <Vortex2D/Renderer/Work.h>
 
@@ -87,6 +88,13 @@ public:
    */
   VORTEX2D_API void SetVelocities(const glm::vec2& velocity, float angularVelocity);
 
+  /**
+   * @brief Upload the velocities with a staging ring instead of submitting a
+   * copy each time they are set. They are copied when the ring is submitted.
+   * @param stagingRing the staging ring, or null to copy them immediately
+   */
+  VORTEX2D_API void SetStagingRing(Renderer::StagingRing* stagingRing);
+
   /**
    * @brief Upload the transform matrix to the GPU.
    */
@@ -192,6 +200,7 @@ private:
   Renderer::Buffer<Velocity> mForce, mReducedForce, mLocalForce;
   Renderer::UniformBuffer<glm::vec2> mCenter;
   Renderer::UniformBuffer<Velocity> mLocalVelocity;
+  Renderer::StagingRing* mStagingRing;
 
   Renderer::Clear mClear;
   Renderer::RenderCommand mLocalPhiRender, mPhiRender;
@@ -0,0 +1,218 @@
+//
+//  Tiles.cpp
+//  Vortex2D
+//
+
+#include "Tiles.h"
+
+#include <Vortex2D/Renderer/Profiler.h>
+
+#include <string>
+#include <tuple>
+
+#include "vortex2d_generated_spirv.h"
+
+namespace Vortex2D
+{
+namespace Fluid
+{
+Tiles::Tiles(const Renderer::Device& device, const glm::ivec2& size, int halo)
+    : mDevice(device)
+    , mSize(size)
+    , mTileCount(Renderer::ComputeSize::GetWorkSize(size))
+    , mHalo((glm::ivec2(halo) + GetTileSize() - glm::ivec2(1)) / GetTileSize())
+    , mFlags(device, mTileCount.x * mTileCount.y)
+    , mDilatedFlags(device, mTileCount.x * mTileCount.y)
+    , mIndices(device, mTileCount.x * mTileCount.y)
+    , mList(device, mTileCount.x * mTileCount.y)
+    , mPreviousList(device, mTileCount.x * mTileCount.y)
+    , mScanParams(device)
+    , mDispatchParams(device)
+    , mPreviousDispatchParams(device)
+    , mLocalDispatchParams(device, 1, VMA_MEMORY_USAGE_GPU_TO_CPU)
+    , mMarkWork(device, size, SPIRV::TileMark_comp)
+    , mDilateWork(device, mTileCount, SPIRV::TileDilate_comp)
+    , mDilateBound(mDilateWork.Bind({mFlags, mDilatedFlags}))
+    , mListWork(device, mTileCount, SPIRV::TileList_comp)
+    , mListBound(mListWork.Bind({mScanParams, mDilatedFlags, mIndices, mList, mDispatchParams}))
+    , mCopyR32Work(device, size, SPIRV::TileCopyR32_comp, {}, true)
+    , mCopyRG32Work(device, size, SPIRV::TileCopyRG32_comp, {}, true)
+    , mCopyRGBA8Work(device, size, SPIRV::TileCopyRGBA8_comp, {}, true)
+    , mPrefixScan(device, mTileCount)
+    , mPrefixScanBound(mPrefixScan.Bind(mDilatedFlags, mIndices, mScanParams))
+    , mUpdateCmd(device, false)
+    , mActiveCountCmd(device)
+{
+  // the active tiles are dispatched with one work group each
+  auto maxCount = device.GetPhysicalDevice().getProperties().limits.maxComputeWorkGroupCount[0];
+  if (static_cast<uint32_t>(GetCount()) > maxCount)
+  {
+    throw std::runtime_error("Too many tiles for an indirect dispatch: " +
+                             std::to_string(GetCount()) + " > " + std::to_string(maxCount));
+  }
+
+  // all the tiles are active until the first update
+  std::vector<glm::ivec2> tiles;
+  for (int j = 0; j < mTileCount.y; j++)
+  {
+    for (int i = 0; i < mTileCount.x; i++)
+    {
+      tiles.emplace_back(i, j);
+    }
+  }
+
+  Renderer::DispatchParams params(GetCount());
+  params.workSize = vk::DispatchIndirectCommand(static_cast<uint32_t>(GetCount()), 1, 1);
+
+  Renderer::Buffer<glm::ivec2> localList(device, tiles.size(), VMA_MEMORY_USAGE_CPU_ONLY);
+  Renderer::Buffer<Renderer::DispatchParams> localParams(device, 1, VMA_MEMORY_USAGE_CPU_ONLY);
+  Renderer::CopyFrom(localList, tiles);
+  Renderer::CopyFrom(localParams, params);
+
+  device.Execute([&](vk::CommandBuffer commandBuffer) {
+    mList.CopyFrom(commandBuffer, localList);
+    mPreviousList.CopyFrom(commandBuffer, localList);
+    mDispatchParams.CopyFrom(commandBuffer, localParams);
+    mPreviousDispatchParams.CopyFrom(commandBuffer, localParams);
+  });
+
+  mActiveCountCmd.Record([&](vk::CommandBuffer commandBuffer) {
+    mLocalDispatchParams.CopyFrom(commandBuffer, mDispatchParams);
+  });
+}
+
+void Tiles::Bind(Renderer::Texture& liquidPhi, Renderer::Texture& solidPhi)
+{
+  mMarkBound = mMarkWork.Bind({liquidPhi, solidPhi, mFlags});
+
+  mUpdateCmd.Record([&](vk::CommandBuffer commandBuffer) {
+    Renderer::BeginMarker(mDevice, commandBuffer, {"Tiles", {{0.93f, 0.72f, 0.15f, 1.0f}}});
+
+    // keep the tiles active so far, to clear them
+    mPreviousList.CopyFrom(commandBuffer, mList);
+    mPreviousDispatchParams.CopyFrom(commandBuffer, mDispatchParams);
+    mPreviousDispatchParams.Barrier(
+        commandBuffer, vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eIndirectCommandRead);
+
+    // flag the tiles with liquid not deep inside a solid
+    mFlags.Clear(commandBuffer);
+    mMarkBound.Record(commandBuffer);
+    mFlags.Barrier(
+        commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+
+    // grow them by the halo
+    mDilateBound.PushConstant(commandBuffer, mHalo);
+    mDilateBound.Record(commandBuffer);
+    mDilatedFlags.Barrier(
+        commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+
+    // compact the active tiles in a list and size the indirect dispatch on it
+    mPrefixScanBound.Record(commandBuffer);
+    mListBound.Record(commandBuffer);
+    mList.Barrier(commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+    mDispatchParams.Barrier(
+        commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eIndirectCommandRead);
+
+    Renderer::EndMarker(mDevice, commandBuffer);
+  });
+}
+
+void Tiles::Update()
+{
+  if (mUpdateCmd)
+  {
+    mUpdateCmd.Submit();
+  }
+}
+
+Renderer::GenericBuffer& Tiles::GetList()
+{
+  return mList;
+}
+
+Renderer::IndirectBuffer<Renderer::DispatchParams>& Tiles::GetDispatchParams()
+{
+  return mDispatchParams;
+}
+
+Renderer::Work::Bound Tiles::BindCopy(Renderer::Texture& src, Renderer::Texture& dst)
+{
+  if (src.GetWidth() != static_cast<uint32_t>(mSize.x) ||
+      src.GetHeight() != static_cast<uint32_t>(mSize.y) || src.GetFormat() != dst.GetFormat())
+  {
+    throw std::runtime_error("Invalid textures to copy tiles");
+  }
+
+  switch (src.GetFormat())
+  {
+    case vk::Format::eR32Sfloat:
+      return mCopyR32Work.Bind({src, dst, mList});
+    case vk::Format::eR32G32Sfloat:
+      return mCopyRG32Work.Bind({src, dst, mList});
+    case vk::Format::eR8G8B8A8Unorm:
+      return mCopyRGBA8Work.Bind({src, dst, mList});
+    default:
+      throw std::runtime_error("Unsupported format to copy tiles");
+  }
+}
+
+void Tiles::RecordCopy(vk::CommandBuffer commandBuffer, Renderer::Work::Bound& copy, int border)
+{
+  copy.PushConstant(commandBuffer, border);
+  copy.RecordIndirect(commandBuffer, mDispatchParams);
+}
+
+Renderer::Work::Bound Tiles::BindClear(Renderer::GenericBuffer& buffer)
+{
+  auto cellSize = static_cast<vk::DeviceSize>(mSize.x) * mSize.y * sizeof(uint32_t);
+  if (buffer.Size() == 0 || buffer.Size() % cellSize != 0)
+  {
+    throw std::runtime_error("Invalid buffer to clear tiles");
+  }
+
+  // one work per number of values per cell
+  auto components = static_cast<int>(buffer.Size() / cellSize);
+  auto it = mClearWorks.find(components);
+  if (it == mClearWorks.end())
+  {
+    it = mClearWorks
+             .emplace(std::piecewise_construct,
+                      std::forward_as_tuple(components),
+                      std::forward_as_tuple(
+                          mDevice,
+                          mSize,
+                          SPIRV::TileClear_comp,
+                          Renderer::SpecConst(Renderer::SpecConstValue(3, components)),
+                          true))
+             .first;
+  }
+
+  return it->second.Bind({buffer, mPreviousList});
+}
+
+void Tiles::RecordClear(vk::CommandBuffer commandBuffer, Renderer::Work::Bound& clear)
+{
+  clear.RecordIndirect(commandBuffer, mPreviousDispatchParams);
+}
+
+int Tiles::GetActiveCount()
+{
+  mActiveCountCmd.Submit().Wait();
+
+  Renderer::DispatchParams params(0);
+  Renderer::CopyTo(mLocalDispatchParams, params);
+  return static_cast<int>(params.count);
+}
+
+int Tiles::GetCount() const
+{
+  return mTileCount.x * mTileCount.y;
+}
+
+glm::ivec2 Tiles::GetTileSize()
+{
+  return Renderer::ComputeSize::GetLocalSize2D();
+}
+
+}  // namespace Fluid
+}  // namespace Vortex2D
@@ -0,0 +1,152 @@
+//
+//  Tiles.h
+//  Vortex2D
+//
+
+#ifndef Vortex2D_Tiles_h
+#define Vortex2D_Tiles_h
+
+#include <Vortex2D/Engine/PrefixScan.h>
+#include <Vortex2D/Renderer/Buffer.h>
+#include <Vortex2D/Renderer/CommandBuffer.h>
+#include <Vortex2D/Renderer/Texture.h>
+#include <Vortex2D/Renderer/Work.h>
+#include <map>
+
+namespace Vortex2D
+{
+namespace Fluid
+{
+/**
+ * @brief Splits the grid in tiles of the size of the work groups and keeps the
+ * list of active tiles, i.e. the tiles containing liquid not deep inside a
+ * solid, grown by a halo. The kernels bound to it with their tiled variant are
+ * dispatched indirectly with one work group per active tile, the cells outside
+ * the active tiles are left untouched.
+ */
+class Tiles
+{
+public:
+  /**
+   * @brief Initialize the tiles with all the tiles active. Throws if there
+   * are more tiles than work groups in an indirect dispatch.
+   * @param device vulkan device
+   * @param size size of the grid
+   * @param halo number of cells the active tiles are grown by, it needs to
+   * cover the distance the liquid moves in a step.
+   */
+  VORTEX2D_API Tiles(const Renderer::Device& device, const glm::ivec2& size, int halo = 8);
+
+  /**
+   * @brief Bind the level sets the active tiles are computed from.
+   * @param liquidPhi liquid level set
+   * @param solidPhi solid level set
+   */
+  VORTEX2D_API void Bind(Renderer::Texture& liquidPhi, Renderer::Texture& solidPhi);
+
+  /**
+   * @brief Compute the list of active tiles from the bound level sets.
+   * Asynchronous operation.
+   */
+  VORTEX2D_API void Update();
+
+  /**
+   * @brief The list of active tiles, as tile coordinates.
+   */
+  VORTEX2D_API Renderer::GenericBuffer& GetList();
+
+  /**
+   * @brief The indirect dispatch parameters, one work group per active tile.
+   */
+  VORTEX2D_API Renderer::IndirectBuffer<Renderer::DispatchParams>& GetDispatchParams();
+
+  /**
+   * @brief Bind a copy of the active tiles of a texture, the other cells of
+   * the destination are left untouched.
+   * @param src texture to copy from, of the size of the grid and of format
+   * R32 float, R32G32 float or R8G8B8A8 unorm
+   * @param dst texture to copy to, of the same size and format
+   * @return the bound copy, recorded with @ref RecordCopy
+   */
+  VORTEX2D_API Renderer::Work::Bound BindCopy(Renderer::Texture& src, Renderer::Texture& dst);
+
+  /**
+   * @brief Record a bound copy, the caller adds the barriers.
+   * @param commandBuffer command buffer being recorded
+   * @param copy bound copy
+   * @param border number of cells the active tiles are grown by
+   */
+  VORTEX2D_API void RecordCopy(vk::CommandBuffer commandBuffer,
+                               Renderer::Work::Bound& copy,
+                               int border = 0);
+
+  /**
+   * @brief Bind a clear of the tiles active before the last update. A kernel
+   * writing a buffer only on the active tiles clears it before, so no value
+   * is left on the tiles which are no longer active.
+   * @param buffer buffer with one or more 32 bits values per cell of the grid
+   * @return the bound clear, recorded with @ref RecordClear
+   */
+  VORTEX2D_API Renderer::Work::Bound BindClear(Renderer::GenericBuffer& buffer);
+
+  /**
+   * @brief Record a bound clear, the caller adds the barriers.
+   * @param commandBuffer command buffer being recorded
+   * @param clear bound clear
+   */
+  VORTEX2D_API void RecordClear(vk::CommandBuffer commandBuffer, Renderer::Work::Bound& clear);
+
+  /**
+   * @brief Number of active tiles. Blocking.
+   * @return number of active tiles
+   */
+  VORTEX2D_API int GetActiveCount();
+
+  /**
+   * @brief Number of tiles of the grid.
+   */
+  VORTEX2D_API int GetCount() const;
+
+  /**
+   * @brief Size of a tile, which is the local size of the 2D kernels.
+   */
+  VORTEX2D_API static glm::ivec2 GetTileSize();
+
+private:
+  const Renderer::Device& mDevice;
+  glm::ivec2 mSize;
+  glm::ivec2 mTileCount;
+  glm::ivec2 mHalo;
+
+  Renderer::Buffer<int> mFlags;
+  Renderer::Buffer<int> mDilatedFlags;
+  Renderer::Buffer<int> mIndices;
+  Renderer::Buffer<glm::ivec2> mList;
+  Renderer::Buffer<glm::ivec2> mPreviousList;
+  Renderer::IndirectBuffer<Renderer::DispatchParams> mScanParams;
+  Renderer::IndirectBuffer<Renderer::DispatchParams> mDispatchParams;
+  Renderer::IndirectBuffer<Renderer::DispatchParams> mPreviousDispatchParams;
+  Renderer::Buffer<Renderer::DispatchParams> mLocalDispatchParams;
+
+  Renderer::Work mMarkWork;
+  Renderer::Work::Bound mMarkBound;
+  Renderer::Work mDilateWork;
+  Renderer::Work::Bound mDilateBound;
+  Renderer::Work mListWork;
+  Renderer::Work::Bound mListBound;
+  Renderer::Work mCopyR32Work;
+  Renderer::Work mCopyRG32Work;
+  Renderer::Work mCopyRGBA8Work;
+  std::map<int, Renderer::Work> mClearWorks;
+
+  PrefixScan mPrefixScan;
+  PrefixScan::Bound mPrefixScanBound;
+
+  Renderer::CommandBuffer mUpdateCmd;
+  Renderer::CommandBuffer mActiveCountCmd;
+};
+
+}  // namespace Fluid
+}  // namespace Vortex2D
+
+#endif
@@ -5,6 +5,8 @@
 
 #include "Velocity.h"
 
+#include <Vortex2D/Renderer/Profiler.h>
+
 #include "vortex2d_generated_spirv.h"
 
 namespace Vortex2D
@@ -25,8 +27,7 @@ Velocity::Velocity(const Renderer::Device& device, const glm::ivec2& size)
       [&](vk::CommandBuffer commandBuffer) { mDVelocity.CopyFrom(commandBuffer, *this); });
 
   mVelocityDiffCmd.Record([&](vk::CommandBuffer commandBuffer) {
-    commandBuffer.debugMarkerBeginEXT({"Velocity diff", {{0.32f, 0.60f, 0.67f, 1.0f}}},
-                                      mDevice.Loader());
+    Renderer::BeginMarker(mDevice, commandBuffer, {"Velocity diff", {{0.32f, 0.60f, 0.67f, 1.0f}}});
     mVelocityDiffBound.Record(commandBuffer);
     mOutputVelocity.Barrier(commandBuffer,
                             vk::ImageLayout::eGeneral,
@@ -34,7 +35,7 @@ Velocity::Velocity(const Renderer::Device& device, const glm::ivec2& size)
                             vk::ImageLayout::eGeneral,
                             vk::AccessFlagBits::eShaderRead);
     mDVelocity.CopyFrom(commandBuffer, mOutputVelocity);
-    commandBuffer.debugMarkerEndEXT(mDevice.Loader());
+    Renderer::EndMarker(mDevice, commandBuffer);
   });
 }
 
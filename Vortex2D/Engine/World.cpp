@@ -5,6 +5,8 @@
 
 #include "World.h"
 
+#include <Vortex2D/Renderer/Profiler.h>
+
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/gtx/transform.hpp>
 
@@ -21,40 +23,28 @@ void ForAll(std::vector<Class*>& elements, void (Class::*f)())
   }
 }
 
-uint32_t NextPowerOfTwo(uint32_t n)
-{
-  --n;
-
-  n |= n >> 1;
-  n |= n >> 2;
-  n |= n >> 4;
-  n |= n >> 8;
-  n |= n >> 16;
-
-  return n + 1;
-}
-
-glm::ivec2 NextPowerOfTwo(const glm::ivec2& s)
-{
-  return {NextPowerOfTwo(s.x), NextPowerOfTwo(s.y)};
-}
-
 World::World(const Renderer::Device& device,
              const glm::ivec2& size,
              float dt,
              int numSubSteps,
-             Velocity::InterpolationMode interpolationMode)
+             Velocity::InterpolationMode interpolationMode,
+             LinearSolver::Matrix matrix)
     : mDevice(device)
     , mSize(size)
     , mDelta(dt / numSubSteps)
     , mNumSubSteps(numSubSteps)
-    , mSolverSize(NextPowerOfTwo(size))
-    , mPreconditioner(device, mSolverSize, mDelta)
-    , mLinearSolver(device, mSolverSize, mPreconditioner)
-    , mData(device, mSolverSize)
+    , mBatchSubmit(false)
+    , mStepPending(false)
+    , mSolveAsync(false)
+    , mPreconditioner(device, size, mDelta)
+    , mLinearSolver(device, size, mPreconditioner)
 #if !defined(NDEBUG)
-    , mDebugData(device, mSolverSize)
-    , mDebugDataCopy(device, mSolverSize, mData, mDebugData)
+    // the debug copy reads the lower matrix, it then stays zero when matrix free
+    , mData(device, size)
+    , mDebugData(device, size)
+    , mDebugDataCopy(device, size, mData, mDebugData)
+#else
+    , mData(device, size, VMA_MEMORY_USAGE_GPU_ONLY, matrix)
 #endif
     , mVelocity(device, size)
     , mLiquidPhi(device, size)
@@ -64,16 +54,19 @@ World::World(const Renderer::Device& device,
     , mAdvection(device, size, mDelta, mVelocity, interpolationMode)
     , mProjection(device,
                   mDelta,
-                  mSolverSize,
+                  size,
                   mData,
                   mVelocity,
                   mDynamicSolidPhi,
                   mLiquidPhi,
-                  mValid)
+                  mValid,
+                  matrix)
     , mExtrapolation(device, size, mValid, mVelocity)
     , mCopySolidPhi(device, false)
+    , mStepComplete(device, true)
     , mRigidBodySolver(nullptr)
     , mCfl(device, size, mVelocity)
+    , mStagingRing(device, 4096, numSubSteps + 2)
 {
   mExtrapolation.ConstrainBind(mDynamicSolidPhi);
   mLiquidPhi.ExtrapolateBind(mDynamicSolidPhi);
@@ -82,7 +75,14 @@ World::World(const Renderer::Device& device,
     mDynamicSolidPhi.CopyFrom(commandBuffer, mStaticSolidPhi);
   });
 
+  // submitted last, the queue is in order so its fence signals the whole step
+  mStepComplete.Record([](vk::CommandBuffer) {});
+
   mPreconditioner.BuildHierarchiesBind(mProjection, mDynamicSolidPhi, mLiquidPhi);
+  if (matrix == LinearSolver::Matrix::Free)
+  {
+    mLinearSolver.BindMatrixFree(mDelta, mDynamicSolidPhi, mLiquidPhi);
+  }
   mLinearSolver.Bind(mData.Diagonal, mData.Lower, mData.B, mData.X);
 
   mDevice.Execute([&](vk::CommandBuffer commandBuffer) {
@@ -90,14 +90,91 @@ World::World(const Renderer::Device& device,
   });
 }
 
+World::~World()
+{
+  mStagingRing.Submit();
+  for (auto* rigidbody : mRigidbodies)
+  {
+    rigidbody->SetStagingRing(nullptr);
+  }
+}
+
 void World::Step(LinearSolver::Parameters& params)
 {
+  FinishStep();
+
+  // velocities set on the rigidbodies since the last step
+  mStagingRing.Submit();
+
+  mSolveAsync = false;
   for (int i = 0; i < mNumSubSteps; i++)
   {
-    Substep(params);
+    if (mBatchSubmit)
+    {
+      Renderer::SubmitBatch submitBatch(mDevice);
+      ProfiledSubstep(params);
+      StepRigidBodies();
+    }
+    else
+    {
+      ProfiledSubstep(params);
+      StepRigidBodies();
+    }
   }
 }
 
+StepHandle World::StepAsync(LinearSolver::Parameters& params)
+{
+  FinishStep();
+
+  // velocities set on the rigidbodies since the last step
+  mStagingRing.Submit();
+
+  mSolveAsync = true;
+  for (int i = 0; i < mNumSubSteps; i++)
+  {
+    Renderer::SubmitBatch submitBatch(mDevice);
+    if (i > 0)
+    {
+      StepRigidBodies();
+    }
+
+    ProfiledSubstep(params);
+
+    if (i == mNumSubSteps - 1)
+    {
+      mCfl.Compute();
+      mStepComplete.Submit();
+    }
+  }
+
+  mStepPending = true;
+  return StepHandle(mStepComplete, mCfl);
+}
+
+void World::SetBatchSubmit(bool batch)
+{
+  mBatchSubmit = batch;
+}
+
+void World::EnableTiles(int halo)
+{
+  if (mTiles)
+  {
+    throw std::runtime_error("Tiles already enabled");
+  }
+
+  FinishStep();
+
+  mTiles.reset(new Tiles(mDevice, mSize, halo));
+  mTiles->Bind(mLiquidPhi, mStaticSolidPhi);
+
+  mLiquidPhi.TilesBind(*mTiles);
+  mAdvection.TilesBind(*mTiles);
+  mProjection.TilesBind(*mTiles);
+  mExtrapolation.TilesBind(*mTiles);
+}
+
 Renderer::RenderCommand World::RecordVelocity(Renderer::RenderTarget::DrawableList drawables,
                                               VelocityOp op)
 {
@@ -139,6 +216,17 @@ DistanceField World::SolidDistanceField()
   return {mDevice, mDynamicSolidPhi};
 }
 
+void World::BindProbe(Probe& probe)
+{
+  probe.Bind(mVelocity, mLiquidPhi, mData.X);
+}
+
+void World::CaptureLinearSystem(const std::string& filename)
+{
+  FinishStep();
+  mData.Capture(filename, mDelta, &mLiquidPhi, &mDynamicSolidPhi);
+}
+
 void World::AddRigidbody(RigidBody& rigidbody)
 {
   rigidbody.BindPhi(mDynamicSolidPhi);
@@ -146,12 +234,16 @@ void World::AddRigidbody(RigidBody& rigidbody)
   rigidbody.BindVelocityConstrain(mVelocity);
   mLinearSolver.BindRigidbody(mDelta, mData.Diagonal, rigidbody);
   rigidbody.BindForce(mData.Diagonal, mData.X);
+  rigidbody.SetStagingRing(&mStagingRing);
 
   mRigidbodies.push_back(&rigidbody);
 }
 
 void World::RemoveRigidBody(RigidBody& rigidbody)
 {
+  mStagingRing.Submit();
+  rigidbody.SetStagingRing(nullptr);
+
   mRigidbodies.erase(std::remove(mRigidbodies.begin(), mRigidbodies.end(), &rigidbody),
                      mRigidbodies.end());
 }
@@ -173,10 +265,48 @@ void World::StepRigidBodies()
 
   // Set Velocities to fluid rigid bodies
   ForAll(mRigidbodies, &RigidBody::ApplyVelocities);
+  mStagingRing.Submit();
+}
+
+void World::ProfiledSubstep(LinearSolver::Parameters& params)
+{
+  auto profiler = mDevice.GetProfiler();
+  if (profiler)
+    profiler->BeginFrame("Substep");
+
+  Substep(params);
+
+  if (profiler)
+    profiler->EndFrame();
+}
+
+void World::Solve(LinearSolver::Parameters& params)
+{
+  if (mSolveAsync)
+  {
+    mLinearSolver.SolveAsync(params, mRigidbodies);
+  }
+  else
+  {
+    mLinearSolver.Solve(params, mRigidbodies);
+  }
+}
+
+void World::FinishStep()
+{
+  if (mStepPending)
+  {
+    mStepComplete.Wait();
+    mStepPending = false;
+
+    StepRigidBodies();
+  }
 }
 
 float World::GetCFL()
 {
+  FinishStep();
+
   mCfl.Compute();
   return mCfl.Get();
 }
@@ -186,11 +316,33 @@ Renderer::Texture& World::GetVelocity()
   return mVelocity;
 }
 
+StepHandle::StepHandle(Renderer::CommandBuffer& stepComplete, Cfl& cfl)
+    : mStepComplete(&stepComplete), mCfl(&cfl)
+{
+}
+
+bool StepHandle::Ready() const
+{
+  return mStepComplete->Ready();
+}
+
+void StepHandle::Wait() const
+{
+  mStepComplete->Wait();
+}
+
+float StepHandle::GetCFL() const
+{
+  Wait();
+  return mCfl->Get();
+}
+
 SmokeWorld::SmokeWorld(const Renderer::Device& device,
                        const glm::ivec2& size,
                        float dt,
-                       Velocity::InterpolationMode interpolationMode)
-    : World(device, size, dt, 1, interpolationMode)
+                       Velocity::InterpolationMode interpolationMode,
+                       LinearSolver::Matrix matrix)
+    : World(device, size, dt, 1, interpolationMode, matrix)
 {
 }
 
@@ -206,6 +358,11 @@ void SmokeWorld::Substep(LinearSolver::Parameters& params)
 
   mCopySolidPhi.Submit();
 
+  if (mTiles)
+  {
+    mTiles->Update();
+  }
+
   ForAll(mRigidbodies, &RigidBody::RenderPhi);
   ForAll(mRigidbodies, &RigidBody::UpdatePosition);
 
@@ -215,7 +372,7 @@ void SmokeWorld::Substep(LinearSolver::Parameters& params)
 
   ForAll(mRigidbodies, &RigidBody::Div);
 
-  mLinearSolver.Solve(params, mRigidbodies);
+  Solve(params);
   mProjection.ApplyPressure();
 
 #if !defined(NDEBUG)
@@ -231,8 +388,6 @@ void SmokeWorld::Substep(LinearSolver::Parameters& params)
 
   mAdvection.AdvectVelocity();
   mAdvection.Advect();
-
-  StepRigidBodies();
 }
 
 void SmokeWorld::FieldBind(Density& density)
@@ -244,8 +399,9 @@ WaterWorld::WaterWorld(const Renderer::Device& device,
                        const glm::ivec2& size,
                        float dt,
                        int numSubSteps,
-                       Velocity::InterpolationMode interpolationMode)
-    : World(device, size, dt, numSubSteps, interpolationMode)
+                       Velocity::InterpolationMode interpolationMode,
+                       LinearSolver::Matrix matrix)
+    : World(device, size, dt, numSubSteps, interpolationMode, matrix)
     , mParticles(device,
                  vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eVertexBuffer,
                  VMA_MEMORY_USAGE_GPU_ONLY,
@@ -299,7 +455,7 @@ void WaterWorld::Substep(LinearSolver::Parameters& params)
 
   // 5)
   mProjection.BuildLinearEquation();
-  mLinearSolver.Solve(params, mRigidbodies);
+  Solve(params);
   mProjection.ApplyPressure();
 
 #if !defined(NDEBUG)
@@ -319,9 +475,6 @@ void WaterWorld::Substep(LinearSolver::Parameters& params)
 
   // 7)
   mAdvection.AdvectParticles();
-
-  // 8)
-  StepRigidBodies();
 }
 
 Renderer::RenderCommand WaterWorld::RecordParticleCount(
@@ -334,6 +487,12 @@ void WaterWorld::ParticlePhi()
 {
   mParticleCount.Scan();
   mParticleCount.Phi();
+
+  if (mTiles)
+  {
+    mTiles->Update();
+  }
+
   mLiquidPhi.Reinitialise();
 }
 
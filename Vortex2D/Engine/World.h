@@ -21,7 +21,9 @@
 #include <Vortex2D/Engine/LinearSolver/Multigrid.h>
 #include <Vortex2D/Engine/Particles.h>
 #include <Vortex2D/Engine/Pressure.h>
+#include <Vortex2D/Engine/Probe.h>
 #include <Vortex2D/Engine/Rigidbody.h>
+#include <Vortex2D/Engine/Tiles.h>
 #include <Vortex2D/Engine/Velocity.h>
 
 #include <functional>
@@ -41,6 +43,40 @@ enum class VelocityOp
   Set
 };
 
+/**
+ * @brief Handle of a step submitted with @ref World::StepAsync, it refers to
+ * the last step submitted and is valid as long as the world is. The results
+ * read back from the step, e.g. the CFL number or the forces of the
+ * rigidbodies with @ref RigidBody::GetForces, are available once it is ready.
+ */
+class StepHandle
+{
+public:
+  /**
+   * @brief Check if the step has finished on the GPU. Non-blocking.
+   */
+  VORTEX2D_API bool Ready() const;
+
+  /**
+   * @brief Wait for the step to finish on the GPU.
+   */
+  VORTEX2D_API void Wait() const;
+
+  /**
+   * @brief The CFL number of the velocity at the end of the step. Blocking.
+   * @return CFL number
+   */
+  VORTEX2D_API float GetCFL() const;
+
+  friend class World;
+
+private:
+  StepHandle(Renderer::CommandBuffer& stepComplete, Cfl& cfl);
+
+  Renderer::CommandBuffer* mStepComplete;
+  Cfl* mCfl;
+};
+
 /**
  * @brief The main class of the framework. Each instance manages a grid and this
  * class is used to set forces, define boundaries, solve the incompressbility
@@ -56,19 +92,66 @@ public:
    * @param dt timestamp of the simulation, e.g. 0.016 for 60FPS simulations.
    * @param numSubSteps the number of sub-steps to perform per step call.
    * Reduces loss of fluid.
+   * @param interpolationMode interpolation of the advection
+   * @param matrix with LinearSolver::Matrix::Free, the lower matrix of the
+   * pressure equations is not stored and the solver computes it from the level
+   * sets
    */
   World(const Renderer::Device& device,
         const glm::ivec2& size,
         float dt,
         int numSubSteps = 1,
-        Velocity::InterpolationMode interpolationMode = Velocity::InterpolationMode::Linear);
-  virtual ~World() = default;
+        Velocity::InterpolationMode interpolationMode = Velocity::InterpolationMode::Linear,
+        LinearSolver::Matrix matrix = LinearSolver::Matrix::Explicit);
+  /**
+   * @brief Flushes the pending rigidbody uploads and detaches the staging ring
+   * from the rigidbodies still added, they can outlive the world.
+   */
+  VORTEX2D_API virtual ~World();
 
   /**
-   * @brief Perform one step of the simulation.
+   * @brief Perform one step of the simulation. If a @ref Renderer::Profiler
+   * is attached to the device, each sub-step is timed as a frame.
    */
   VORTEX2D_API void Step(LinearSolver::Parameters& params);
 
+  /**
+   * @brief Batch the submissions of each sub-step. The stages which are not
+   * waited on are submitted together with a single queue submission, the
+   * queue is only submitted separately for the control of the linear solver
+   * iterations. Disabled by default.
+   * @param batch enable or disable batching
+   */
+  VORTEX2D_API void SetBatchSubmit(bool batch);
+
+  /**
+   * @brief Only run the advection, extrapolation, reinitialisation of the
+   * liquid level set and pressure kernels on the active tiles, i.e. the tiles
+   * with liquid which are not deep inside the static solids, grown by a halo.
+   * The active tiles are updated each sub-step, so the cost of a step scales
+   * with the liquid instead of the grid. The cells outside the active tiles
+   * keep their values. Can only be enabled once.
+   * @param halo number of cells the active tiles are grown by, it needs to
+   * cover the distance the liquid moves in a sub-step.
+   */
+  VORTEX2D_API void EnableTiles(int halo = 8);
+
+  /**
+   * @brief Submit one step of the simulation without waiting for the GPU.
+   * The step is submitted with a single queue submission per sub-step. An
+   * iterative linear solver checks its convergence on the GPU and runs up to
+   * its maximum number of iterations, see @ref ConjugateGradient::SolveAsync,
+   * its output error and iterations are not set. When profiling, each
+   * sub-step ends with an additional submission.
+   * The rigidbody solver of the last sub-step is stepped when the next step
+   * starts. With several sub-steps and rigidbodies, the rigidbody solver of
+   * the other sub-steps reads back their forces, so the step waits for the
+   * GPU at the end of each sub-step but the last.
+   * @param params parameters of the linear solver
+   * @return a handle to wait on the step and get its results
+   */
+  VORTEX2D_API StepHandle StepAsync(LinearSolver::Parameters& params);
+
   /**
    * @brief Record drawables to the velocity field. The colour (r,g) will be
    * used as the velocity (x, y)
@@ -119,6 +202,22 @@ public:
    */
   VORTEX2D_API DistanceField SolidDistanceField();
 
+  /**
+   * @brief Bind a probe to the velocity, liquid level set and pressure of the
+   * world. The probe can be submitted after a step to sample them.
+   * @param probe
+   */
+  VORTEX2D_API void BindProbe(Probe& probe);
+
+  /**
+   * @brief Write the linear equations of the last pressure solve, with the
+   * level sets they were built from, to a file which can be replayed with
+   * @ref LinearSolver::Data::Replay. The rigidbodies coupled to the solver are
+   * not captured. Blocking.
+   * @param filename file to write to
+   */
+  VORTEX2D_API void CaptureLinearSystem(const std::string& filename);
+
   /**
    * @brief Add a rigibody to the solver
    * @param rigidbody
@@ -151,14 +250,19 @@ public:
 
 protected:
   void StepRigidBodies();
+  void FinishStep();
+  void ProfiledSubstep(LinearSolver::Parameters& params);
+  void Solve(LinearSolver::Parameters& params);
   virtual void Substep(LinearSolver::Parameters& params) = 0;
 
   const Renderer::Device& mDevice;
   glm::ivec2 mSize;
   float mDelta;
   int mNumSubSteps;
+  bool mBatchSubmit;
+  bool mStepPending;
+  bool mSolveAsync;
 
-  glm::ivec2 mSolverSize;
   Multigrid mPreconditioner;
   ConjugateGradient mLinearSolver;
 
@@ -180,13 +284,20 @@ protected:
   Pressure mProjection;
   Extrapolation mExtrapolation;
 
+  std::unique_ptr<Tiles> mTiles;
+
   Renderer::CommandBuffer mCopySolidPhi;
+  Renderer::CommandBuffer mStepComplete;
 
   std::vector<RigidBody*> mRigidbodies;
   RigidBodySolver* mRigidBodySolver;
   std::vector<Renderer::RenderCommand*> mVelocities;
 
   Cfl mCfl;
+
+  // submitted once per step and once per sub-step at most, it has enough
+  // frames to never wait on the copies of the step in flight
+  Renderer::StagingRing mStagingRing;
 };
 
 /**
@@ -199,7 +310,8 @@ public:
   VORTEX2D_API SmokeWorld(const Renderer::Device& device,
                           const glm::ivec2& size,
                           float dt,
-                          Velocity::InterpolationMode interpolationMode);
+                          Velocity::InterpolationMode interpolationMode,
+                          LinearSolver::Matrix matrix = LinearSolver::Matrix::Explicit);
   VORTEX2D_API ~SmokeWorld() override;
 
   /**
@@ -222,7 +334,8 @@ public:
                           const glm::ivec2& size,
                           float dt,
                           int numSubSteps,
-                          Velocity::InterpolationMode interpolationMode);
+                          Velocity::InterpolationMode interpolationMode,
+                          LinearSolver::Matrix matrix = LinearSolver::Matrix::Explicit);
   VORTEX2D_API ~WaterWorld() override;
 
   /**
@@ -58,6 +58,8 @@ GenericBuffer::~GenericBuffer()
 GenericBuffer::GenericBuffer(GenericBuffer&& other)
     : mDevice(other.mDevice)
     , mSize(other.mSize)
+    , mUsageFlags(other.mUsageFlags)
+    , mMemoryUsage(other.mMemoryUsage)
     , mBuffer(other.mBuffer)
     , mAllocation(other.mAllocation)
     , mAllocationInfo(other.mAllocationInfo)
@@ -77,6 +79,12 @@ void GenericBuffer::Create()
   VkBufferCreateInfo vkBufferInfo = bufferInfo;
   VmaAllocationCreateInfo allocInfo = {};
   allocInfo.usage = mMemoryUsage;
+  // host visible memory is mapped once for the lifetime of the buffer
+  if (mMemoryUsage != VMA_MEMORY_USAGE_GPU_ONLY)
+  {
+    allocInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+  }
+
   if (vmaCreateBuffer(mDevice.Allocator(),
                       &vkBufferInfo,
                       &allocInfo,
@@ -132,9 +140,26 @@ void GenericBuffer::CopyFrom(vk::CommandBuffer commandBuffer, GenericBuffer& src
 
 void GenericBuffer::CopyFrom(vk::CommandBuffer commandBuffer, Texture& srcTexture)
 {
-  auto textureSize =
-      srcTexture.GetWidth() * srcTexture.GetHeight() * GetBytesPerPixel(srcTexture.GetFormat());
-  if (textureSize != mSize)
+  CopyFrom(commandBuffer,
+           srcTexture,
+           glm::ivec2(0),
+           glm::ivec2(srcTexture.GetWidth(), srcTexture.GetHeight()));
+}
+
+void GenericBuffer::CopyFrom(vk::CommandBuffer commandBuffer,
+                             Texture& srcTexture,
+                             const glm::ivec2& offset,
+                             const glm::ivec2& extent)
+{
+  if (offset.x < 0 || offset.y < 0 || extent.x <= 0 || extent.y <= 0 ||
+      offset.x + extent.x > static_cast<int>(srcTexture.GetWidth()) ||
+      offset.y + extent.y > static_cast<int>(srcTexture.GetHeight()))
+  {
+    throw std::runtime_error("Region outside of the texture");
+  }
+
+  auto regionSize = extent.x * extent.y * GetBytesPerPixel(srcTexture.GetFormat());
+  if (regionSize != mSize)
   {
     throw std::runtime_error("Cannot copy texture of different sizes");
   }
@@ -147,7 +172,9 @@ void GenericBuffer::CopyFrom(vk::CommandBuffer commandBuffer, Texture& srcTextur
 
   auto info = vk::BufferImageCopy()
                   .setImageSubresource({vk::ImageAspectFlagBits::eColor, 0, 0, 1})
-                  .setImageExtent({srcTexture.GetWidth(), srcTexture.GetHeight(), 1});
+                  .setImageOffset({offset.x, offset.y, 0})
+                  .setImageExtent(
+                      {static_cast<uint32_t>(extent.x), static_cast<uint32_t>(extent.y), 1});
 
   commandBuffer.copyImageToBuffer(
       srcTexture.mImage, vk::ImageLayout::eTransferSrcOptimal, mBuffer, info);
@@ -177,50 +204,32 @@ void GenericBuffer::Clear(vk::CommandBuffer commandBuffer)
 
 void GenericBuffer::CopyFrom(uint32_t offset, const void* data, uint32_t size)
 {
-  // TODO use always mapped functionality of VMA
-
-  VkMemoryPropertyFlags memFlags;
-  vmaGetMemoryTypeProperties(mDevice.Allocator(), mAllocationInfo.memoryType, &memFlags);
-  if ((memFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) == 0)
+  if (mAllocationInfo.pMappedData == nullptr)
     throw std::runtime_error("Not visible buffer");
 
-  void* pData;
-  if (vmaMapMemory(mDevice.Allocator(), mAllocation, &pData) != VK_SUCCESS)
-    throw std::runtime_error("Cannot map buffer");
-
-  std::memcpy((uint8_t*)pData + offset, data, size);
+  std::memcpy((uint8_t*)mAllocationInfo.pMappedData + offset, data, size);
 
+  VkMemoryPropertyFlags memFlags;
+  vmaGetMemoryTypeProperties(mDevice.Allocator(), mAllocationInfo.memoryType, &memFlags);
   if ((memFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) == 0)
   {
-    vmaFlushAllocation(
-        mDevice.Allocator(), mAllocation, mAllocationInfo.offset, mAllocationInfo.size);
+    vmaFlushAllocation(mDevice.Allocator(), mAllocation, offset, size);
   }
-
-  vmaUnmapMemory(mDevice.Allocator(), mAllocation);
 }
 
 void GenericBuffer::CopyTo(uint32_t offset, void* data, uint32_t size)
 {
-  // TODO use always mapped functionality of VMA
+  if (mAllocationInfo.pMappedData == nullptr)
+    throw std::runtime_error("Not visible buffer");
 
   VkMemoryPropertyFlags memFlags;
   vmaGetMemoryTypeProperties(mDevice.Allocator(), mAllocationInfo.memoryType, &memFlags);
-  if ((memFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) == 0)
-    throw std::runtime_error("Not visible buffer");
-
-  void* pData;
-  if (vmaMapMemory(mDevice.Allocator(), mAllocation, &pData) != VK_SUCCESS)
-    throw std::runtime_error("Cannot map buffer");
-
   if ((memFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) == 0)
   {
-    vmaInvalidateAllocation(
-        mDevice.Allocator(), mAllocation, mAllocationInfo.offset, mAllocationInfo.size);
+    vmaInvalidateAllocation(mDevice.Allocator(), mAllocation, offset, size);
   }
 
-  std::memcpy(data, (uint8_t*)pData + offset, size);
-
-  vmaUnmapMemory(mDevice.Allocator(), mAllocation);
+  std::memcpy(data, (const uint8_t*)mAllocationInfo.pMappedData + offset, size);
 }
 
 }  // namespace Renderer
@@ -45,6 +45,19 @@ public:
    */
   VORTEX2D_API void CopyFrom(vk::CommandBuffer commandBuffer, Texture& srcTexture);
 
+  /**
+   * @brief Copy a region of a texture to this buffer, row by row without
+   * padding.
+   * @param commandBuffer command buffer to run the copy on.
+   * @param srcTexture the source texture
+   * @param offset top left corner of the region in the texture
+   * @param extent size of the region
+   */
+  VORTEX2D_API void CopyFrom(vk::CommandBuffer commandBuffer,
+                             Texture& srcTexture,
+                             const glm::ivec2& offset,
+                             const glm::ivec2& extent);
+
   /**
    * @brief The vulkan handle
    */
@@ -9,6 +9,8 @@
 #include <Vortex2D/Renderer/Drawable.h>
 #include <Vortex2D/Renderer/RenderTarget.h>
 
+#include <algorithm>
+
 namespace Vortex2D
 {
 namespace Renderer
@@ -19,11 +21,12 @@ const uint32_t zero = 0;
 
 }
 
-CommandBuffer::CommandBuffer(const Device& device, bool synchronise)
+CommandBuffer::CommandBuffer(const Device& device, bool synchronise, QueueType queueType)
     : mDevice(device)
     , mSynchronise(synchronise)
+    , mQueueType(queueType)
     , mRecorded(false)
-    , mCommandBuffer(device.CreateCommandBuffer())
+    , mCommandBuffer(device.CreateCommandBuffer(queueType))
     , mFence(device.Handle().createFenceUnique({vk::FenceCreateFlagBits::eSignaled}))
 {
 }
@@ -33,13 +36,14 @@ CommandBuffer::~CommandBuffer()
   if (mCommandBuffer != vk::CommandBuffer(nullptr))
   {
     Wait().Reset();
-    mDevice.FreeCommandBuffer(mCommandBuffer);
+    mDevice.FreeCommandBuffer(mCommandBuffer, mQueueType);
   }
 }
 
 CommandBuffer::CommandBuffer(CommandBuffer&& other)
     : mDevice(other.mDevice)
     , mSynchronise(other.mSynchronise)
+    , mQueueType(other.mQueueType)
     , mRecorded(other.mRecorded)
     , mCommandBuffer(other.mCommandBuffer)
     , mFence(std::move(other.mFence))
@@ -52,6 +56,7 @@ CommandBuffer& CommandBuffer::operator=(CommandBuffer&& other)
 {
   assert(mDevice.Handle() == other.mDevice.Handle());
   mSynchronise = other.mSynchronise;
+  mQueueType = other.mQueueType;
   mRecorded = other.mRecorded;
   mCommandBuffer = other.mCommandBuffer;
   mFence = std::move(other.mFence);
@@ -108,12 +113,24 @@ CommandBuffer& CommandBuffer::Wait()
 {
   if (mSynchronise)
   {
+    SubmitBatch::FlushPending(mDevice, mCommandBuffer);
     mDevice.Handle().waitForFences({*mFence}, true, UINT64_MAX);
   }
 
   return *this;
 }
 
+bool CommandBuffer::Ready() const
+{
+  if (mSynchronise)
+  {
+    SubmitBatch::FlushPending(mDevice, mCommandBuffer);
+    return mDevice.Handle().getFenceStatus(*mFence) == vk::Result::eSuccess;
+  }
+
+  return true;
+}
+
 CommandBuffer& CommandBuffer::Reset()
 {
   if (mSynchronise)
@@ -130,6 +147,24 @@ CommandBuffer& CommandBuffer::Submit(const std::initializer_list<vk::Semaphore>&
   if (!mRecorded)
     throw std::runtime_error("Submitting a command that wasn't recorded");
 
+  auto submitBatch = mDevice.mSubmitBatch;
+  if (submitBatch != nullptr)
+  {
+    // the fence is only reset once the batch has submitted it
+    if (mSynchronise)
+    {
+      SubmitBatch::FlushPending(mDevice, mCommandBuffer);
+      Reset();
+    }
+
+    submitBatch->Add(mDevice.Queue(mQueueType),
+                     mCommandBuffer,
+                     mSynchronise ? *mFence : vk::Fence(),
+                     waitSemaphores,
+                     signalSemaphores);
+    return *this;
+  }
+
   Reset();
 
   std::vector<vk::PipelineStageFlags> waitStages(waitSemaphores.size(),
@@ -146,11 +181,11 @@ CommandBuffer& CommandBuffer::Submit(const std::initializer_list<vk::Semaphore>&
 
   if (mSynchronise)
   {
-    mDevice.Queue().submit({submitInfo}, *mFence);
+    mDevice.Queue(mQueueType).submit({submitInfo}, *mFence);
   }
   else
   {
-    mDevice.Queue().submit({submitInfo}, nullptr);
+    mDevice.Queue(mQueueType).submit({submitInfo}, nullptr);
   }
 
   return *this;
@@ -161,6 +196,126 @@ CommandBuffer::operator bool() const
   return mRecorded;
 }
 
+SubmitBatch::SubmitBatch(const Device& device) : mDevice(device), mPrevious(device.mSubmitBatch)
+{
+  mDevice.mSubmitBatch = this;
+}
+
+SubmitBatch::~SubmitBatch()
+{
+  Flush();
+  mDevice.mSubmitBatch = mPrevious;
+}
+
+void SubmitBatch::Add(vk::Queue queue,
+                      vk::CommandBuffer commandBuffer,
+                      vk::Fence fence,
+                      const std::initializer_list<vk::Semaphore>& waitSemaphores,
+                      const std::initializer_list<vk::Semaphore>& signalSemaphores)
+{
+  mSubmissions.push_back({queue, commandBuffer, fence, waitSemaphores, signalSemaphores});
+}
+
+void SubmitBatch::FlushPending(const Device& device, vk::CommandBuffer commandBuffer)
+{
+  bool pending = false;
+  std::vector<SubmitBatch*> batches;
+  for (auto* batch = device.mSubmitBatch; batch != nullptr; batch = batch->mPrevious)
+  {
+    batches.push_back(batch);
+    pending = pending || std::any_of(batch->mSubmissions.begin(),
+                                     batch->mSubmissions.end(),
+                                     [&](const Submission& submission) {
+                                       return submission.Command == commandBuffer;
+                                     });
+  }
+
+  if (!pending)
+  {
+    return;
+  }
+
+  // the outer batches have the older submissions
+  for (auto it = batches.rbegin(); it != batches.rend(); ++it)
+  {
+    (*it)->Flush();
+  }
+}
+
+void SubmitBatch::Flush()
+{
+  if (mSubmissions.empty())
+  {
+    return;
+  }
+
+  std::size_t waitCount = 0;
+  for (auto& submission : mSubmissions)
+  {
+    waitCount = std::max(waitCount, submission.WaitSemaphores.size());
+  }
+
+  // pointers to the command buffers must stay valid until the submit
+  std::vector<vk::CommandBuffer> commandBuffers;
+  commandBuffers.reserve(mSubmissions.size());
+  std::vector<vk::PipelineStageFlags> waitStages(waitCount,
+                                                 vk::PipelineStageFlagBits::eAllCommands);
+  std::vector<vk::SubmitInfo> submitInfos;
+  vk::Queue queue = mSubmissions.front().Queue;
+
+  for (auto& submission : mSubmissions)
+  {
+    // submit what was gathered so far when changing queue
+    if (submission.Queue != queue)
+    {
+      if (!submitInfos.empty())
+      {
+        queue.submit(submitInfos, nullptr);
+        submitInfos.clear();
+      }
+      queue = submission.Queue;
+    }
+
+    commandBuffers.push_back(submission.Command);
+
+    // a submission is merged with the previous one if nothing is waited on
+    // between them
+    if (!submitInfos.empty() && submission.WaitSemaphores.empty() &&
+        submitInfos.back().signalSemaphoreCount == 0)
+    {
+      auto& submitInfo = submitInfos.back();
+      submitInfo.setCommandBufferCount(submitInfo.commandBufferCount + 1)
+          .setSignalSemaphoreCount(static_cast<uint32_t>(submission.SignalSemaphores.size()))
+          .setPSignalSemaphores(submission.SignalSemaphores.data());
+    }
+    else
+    {
+      submitInfos.push_back(
+          vk::SubmitInfo()
+              .setCommandBufferCount(1)
+              .setPCommandBuffers(&commandBuffers.back())
+              .setWaitSemaphoreCount(static_cast<uint32_t>(submission.WaitSemaphores.size()))
+              .setPWaitSemaphores(submission.WaitSemaphores.data())
+              .setSignalSemaphoreCount(static_cast<uint32_t>(submission.SignalSemaphores.size()))
+              .setPSignalSemaphores(submission.SignalSemaphores.data())
+              .setPWaitDstStageMask(waitStages.data()));
+    }
+
+    // the fence signals once everything gathered so far has completed
+    if (submission.Fence)
+    {
+      queue.submit(submitInfos, submission.Fence);
+      submitInfos.clear();
+    }
+  }
+
+  if (!submitInfos.empty())
+  {
+    queue.submit(submitInfos, nullptr);
+  }
+  mSubmissions.clear();
+}
+
 RenderCommand::RenderCommand(RenderCommand&& other)
     : mRenderTarget(other.mRenderTarget)
     , mCmds(std::move(other.mCmds))
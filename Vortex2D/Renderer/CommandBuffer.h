@@ -33,8 +33,11 @@ public:
    * @param device vulkan device
    * @param synchronise flag to determine if the command buffer can be waited
    * on.
+   * @param queueType the queue the command buffer is submitted to
    */
-  VORTEX2D_API explicit CommandBuffer(const Device& device, bool synchronise = true);
+  VORTEX2D_API explicit CommandBuffer(const Device& device,
+                                      bool synchronise = true,
+                                      QueueType queueType = QueueType::Main);
   VORTEX2D_API ~CommandBuffer();
 
   VORTEX2D_API CommandBuffer(CommandBuffer&&);
@@ -63,17 +66,26 @@ public:
 
   /**
    * @brief Wait for the command submit to finish. Does nothing if the
-   * synchronise flag was false.
+   * synchronise flag was false. If the submission was deferred by a @ref
+   * SubmitBatch, the batch is submitted first.
    */
   VORTEX2D_API CommandBuffer& Wait();
 
+  /**
+   * @brief Check if the command submit has finished, without waiting. Always
+   * true if the synchronise flag was false. If the submission was deferred by
+   * a @ref SubmitBatch, the batch is submitted first.
+   */
+  VORTEX2D_API bool Ready() const;
+
   /**
    * @brief Reset the command buffer so it can be recorded again.
    */
   VORTEX2D_API CommandBuffer& Reset();
 
   /**
-   * @brief submit the command buffer
+   * @brief submit the command buffer. If a @ref SubmitBatch is alive, it is
+   * added to the batch.
    */
   VORTEX2D_API CommandBuffer& Submit(
       const std::initializer_list<vk::Semaphore>& waitSemaphores = {},
@@ -88,11 +100,68 @@ public:
 private:
   const Device& mDevice;
   bool mSynchronise;
+  QueueType mQueueType;
   bool mRecorded;
   vk::CommandBuffer mCommandBuffer;
   vk::UniqueFence mFence;
 };
 
+/**
+ * @brief Groups the submissions of command buffers in a single queue
+ * submission. While the batch is alive, the command buffers are not submitted
+ * but added to the batch, which is submitted in order when it is destroyed.
+ * Submissions without semaphores are merged, with one queue submission per run
+ * of command buffers on the same queue. A synchronised command buffer ends its
+ * queue submission, which signals its fence. Waiting on a synchronised command
+ * buffer of the batch submits the batch first.
+ */
+class SubmitBatch
+{
+public:
+  /**
+   * @brief Start batching the submissions on the device.
+   * @param device vulkan device
+   */
+  VORTEX2D_API explicit SubmitBatch(const Device& device);
+
+  /**
+   * @brief Submit the remaining command buffers and stop batching.
+   */
+  VORTEX2D_API ~SubmitBatch();
+
+  SubmitBatch(SubmitBatch&&) = delete;
+  SubmitBatch& operator=(SubmitBatch&&) = delete;
+
+  /**
+   * @brief Submit the batched command buffers with a single queue submission.
+   */
+  VORTEX2D_API void Flush();
+
+  friend class CommandBuffer;
+
+private:
+  struct Submission
+  {
+    vk::Queue Queue;
+    vk::CommandBuffer Command;
+    vk::Fence Fence;
+    std::vector<vk::Semaphore> WaitSemaphores;
+    std::vector<vk::Semaphore> SignalSemaphores;
+  };
+
+  void Add(vk::Queue queue,
+           vk::CommandBuffer commandBuffer,
+           vk::Fence fence,
+           const std::initializer_list<vk::Semaphore>& waitSemaphores,
+           const std::initializer_list<vk::Semaphore>& signalSemaphores);
+
+  static void FlushPending(const Device& device, vk::CommandBuffer commandBuffer);
+
+  const Device& mDevice;
+  SubmitBatch* mPrevious;
+  std::vector<Submission> mSubmissions;
+};
+
 /**
  * @brief A special command buffer that has been recorded by a @ref
  * RenderTarget. It can be used to submit the rendering. The object has to stay
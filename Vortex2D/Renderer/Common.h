@@ -26,4 +26,25 @@
 #define VORTEX2D_API
 #endif
 
+namespace Vortex2D
+{
+namespace Renderer
+{
+/**
+ * @brief The queues of the device. The compute and transfer queues are from
+ * dedicated families when the device has them, otherwise they are other queues
+ * of the main family, or the main queue itself. The uploads, the simulation
+ * and the rendering are all on the main queue, the other queues are for the
+ * command buffers created with their type.
+ */
+enum class QueueType
+{
+  Main,
+  Compute,
+  Transfer,
+};
+
+}  // namespace Renderer
+}  // namespace Vortex2D
+
 #endif
@@ -53,6 +53,8 @@ void LayoutManager::CreateDescriptorPool(int size)
 
 vk::DescriptorSetLayout LayoutManager::GetDescriptorSetLayout(const PipelineLayout& layout)
 {
+  std::lock_guard<std::recursive_mutex> lock(mMutex);
+
   auto it = std::find_if(
       mDescriptorSetLayouts.begin(),
       mDescriptorSetLayouts.end(),
@@ -86,6 +88,8 @@ vk::DescriptorSetLayout LayoutManager::GetDescriptorSetLayout(const PipelineLayo
 
 vk::PipelineLayout LayoutManager::GetPipelineLayout(const PipelineLayout& layout)
 {
+  std::lock_guard<std::recursive_mutex> lock(mMutex);
+
   auto it = std::find_if(
       mPipelineLayouts.begin(), mPipelineLayouts.end(), [&](const auto& pipelineLayout) {
         return std::get<0>(pipelineLayout) == layout;
@@ -125,6 +129,8 @@ vk::PipelineLayout LayoutManager::GetPipelineLayout(const PipelineLayout& layout
 
 DescriptorSet LayoutManager::MakeDescriptorSet(const PipelineLayout& layout)
 {
+  std::lock_guard<std::recursive_mutex> lock(mMutex);
+
   vk::DescriptorSetLayout descriptorSetlayouts[] = {GetDescriptorSetLayout(layout)};
 
   auto descriptorSetInfo = vk::DescriptorSetAllocateInfo()
@@ -12,6 +12,7 @@
 
 #include <Vortex2D/Utils/mapbox/variant.hpp>
 #include <map>
+#include <mutex>
 
 namespace Vortex2D
 {
@@ -60,7 +61,8 @@ struct DescriptorSet
 };
 
 /**
- * @brief Caches and creates layouts and bindings
+ * @brief Caches and creates layouts and bindings. Can be used from several
+ * threads.
  */
 class LayoutManager
 {
@@ -98,6 +100,7 @@ public:
 
 private:
   const Device& mDevice;
+  std::recursive_mutex mMutex;
   vk::UniqueDescriptorPool mDescriptorPool;
   std::vector<std::tuple<PipelineLayout, vk::UniqueDescriptorSetLayout>> mDescriptorSetLayouts;
   std::vector<std::tuple<PipelineLayout, vk::UniquePipelineLayout>> mPipelineLayouts;
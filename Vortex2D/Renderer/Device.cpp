@@ -9,6 +9,7 @@
 #include <iostream>
 
 #include <Vortex2D/Renderer/Instance.h>
+#include <Vortex2D/Renderer/Profiler.h>
 
 #define VMA_IMPLEMENTATION
 #include <Vortex2D/Utils/vk_mem_alloc.h>
@@ -42,8 +43,29 @@ int ComputeFamilyIndex(vk::PhysicalDevice physicalDevice, vk::SurfaceKHR surface
 
   return index;
 }
+
+std::size_t QueueIndex(QueueType queueType)
+{
+  return static_cast<std::size_t>(queueType);
+}
 }  // namespace
 
+int FindQueueFamily(const std::vector<vk::QueueFamilyProperties>& familyProperties,
+                    vk::QueueFlags required,
+                    vk::QueueFlags excluded)
+{
+  for (std::size_t i = 0; i < familyProperties.size(); i++)
+  {
+    const auto& property = familyProperties[i];
+    if ((property.queueFlags & required) == required && !(property.queueFlags & excluded))
+    {
+      return static_cast<int>(i);
+    }
+  }
+
+  return -1;
+}
+
 void DynamicDispatcher::vkCmdDebugMarkerBeginEXT(
     VkCommandBuffer commandBuffer,
     const VkDebugMarkerMarkerInfoEXT* pMarkerInfo) const
@@ -62,27 +84,84 @@ void DynamicDispatcher::vkCmdDebugMarkerEndEXT(VkCommandBuffer commandBuffer) co
   }
 }
 
-Device::Device(const Instance& instance, bool validation)
-    : Device(instance, ComputeFamilyIndex(instance.GetPhysicalDevice()), false, validation)
+Device::Device(const Instance& instance,
+               bool validation,
+               const std::string& pipelineCacheFile,
+               bool timestamps)
+    : Device(instance,
+             ComputeFamilyIndex(instance.GetPhysicalDevice()),
+             false,
+             validation,
+             pipelineCacheFile,
+             timestamps)
 {
 }
 
-Device::Device(const Instance& instance, vk::SurfaceKHR surface, bool validation)
-    : Device(instance, ComputeFamilyIndex(instance.GetPhysicalDevice(), surface), true, validation)
+Device::Device(const Instance& instance,
+               vk::SurfaceKHR surface,
+               bool validation,
+               const std::string& pipelineCacheFile,
+               bool timestamps)
+    : Device(instance,
+             ComputeFamilyIndex(instance.GetPhysicalDevice(), surface),
+             true,
+             validation,
+             pipelineCacheFile,
+             timestamps)
 {
 }
 
-Device::Device(const Instance& instance, int familyIndex, bool surface, bool validation)
+Device::Device(const Instance& instance,
+               int familyIndex,
+               bool surface,
+               bool validation,
+               const std::string& pipelineCacheFile,
+               bool timestamps)
     : mPhysicalDevice(instance.GetPhysicalDevice())
-    , mFamilyIndex(familyIndex)
     , mLayoutManager(*this)
     , mPipelineCache(*this)
+    , mSubmitBatch(nullptr)
+    , mProfiler(nullptr)
 {
-  float queuePriority = 1.0f;
-  auto deviceQueueInfo = vk::DeviceQueueCreateInfo()
-                             .setQueueFamilyIndex(familyIndex)
-                             .setQueueCount(1)
-                             .setPQueuePriorities(&queuePriority);
+  // use the dedicated compute and transfer families if there are any
+  const auto& familyProperties = mPhysicalDevice.getQueueFamilyProperties();
+  int computeFamilyIndex = FindQueueFamily(
+      familyProperties, vk::QueueFlagBits::eCompute, vk::QueueFlagBits::eGraphics);
+  int transferFamilyIndex = FindQueueFamily(familyProperties,
+                                            vk::QueueFlagBits::eTransfer,
+                                            vk::QueueFlagBits::eGraphics |
+                                                vk::QueueFlagBits::eCompute);
+
+  mFamilyIndices = {familyIndex,
+                    computeFamilyIndex == -1 ? familyIndex : computeFamilyIndex,
+                    transferFamilyIndex == -1 ? familyIndex : transferFamilyIndex};
+
+  // take a different queue of the family for each type, or share the last one
+  std::map<int, uint32_t> queueCounts;
+  std::array<uint32_t, 3> queueIndices;
+  for (std::size_t i = 0; i < mFamilyIndices.size(); i++)
+  {
+    int family = mFamilyIndices[i];
+    uint32_t& count = queueCounts[family];
+    if (count < familyProperties[family].queueCount)
+    {
+      queueIndices[i] = count++;
+    }
+    else
+    {
+      queueIndices[i] = count - 1;
+    }
+  }
+
+  std::vector<float> queuePriorities(mFamilyIndices.size(), 1.0f);
+  std::vector<vk::DeviceQueueCreateInfo> deviceQueueInfos;
+  for (auto& queueCount : queueCounts)
+  {
+    deviceQueueInfos.push_back(vk::DeviceQueueCreateInfo()
+                                   .setQueueFamilyIndex(queueCount.first)
+                                   .setQueueCount(queueCount.second)
+                                   .setPQueuePriorities(queuePriorities.data()));
+  }
 
   std::vector<const char*> deviceExtensions;
   std::vector<const char*> validationLayers;
@@ -109,11 +188,19 @@ Device::Device(const Instance& instance, int familyIndex, bool surface, bool val
     }
   }
 
+  // report the pipeline cache hits
+  bool creationFeedback = false;
+  if (HasExtension(VK_EXT_PIPELINE_CREATION_FEEDBACK_EXTENSION_NAME, availableExtensions))
+  {
+    deviceExtensions.push_back(VK_EXT_PIPELINE_CREATION_FEEDBACK_EXTENSION_NAME);
+    creationFeedback = true;
+  }
+
   // create queue
   auto deviceFeatures = vk::PhysicalDeviceFeatures().setShaderStorageImageExtendedFormats(true);
   auto deviceInfo = vk::DeviceCreateInfo()
-                        .setQueueCreateInfoCount(1)
-                        .setPQueueCreateInfos(&deviceQueueInfo)
+                        .setQueueCreateInfoCount((uint32_t)deviceQueueInfos.size())
+                        .setPQueueCreateInfos(deviceQueueInfos.data())
                         .setPEnabledFeatures(&deviceFeatures)
                         .setEnabledExtensionCount((uint32_t)deviceExtensions.size())
                         .setPpEnabledExtensionNames(deviceExtensions.data())
@@ -121,7 +208,25 @@ Device::Device(const Instance& instance, int familyIndex, bool surface, bool val
                         .setPpEnabledLayerNames(validationLayers.data());
 
   mDevice = mPhysicalDevice.createDeviceUnique(deviceInfo);
-  mQueue = mDevice->getQueue(familyIndex, 0);
+  for (std::size_t i = 0; i < mFamilyIndices.size(); i++)
+  {
+    mQueues[i] = mDevice->getQueue(mFamilyIndices[i], queueIndices[i]);
+  }
+
+  // subgroup operations are core in vulkan 1.1, which both the instance and
+  // the device need to support
+  mSubgroupArithmetic = false;
+  if (instance.GetApiVersion() >= VK_API_VERSION_1_1 &&
+      mPhysicalDevice.getProperties().apiVersion >= VK_API_VERSION_1_1)
+  {
+    auto subgroupProperties = vk::PhysicalDeviceSubgroupProperties();
+    auto properties = vk::PhysicalDeviceProperties2().setPNext(&subgroupProperties);
+    mPhysicalDevice.getProperties2(&properties);
+
+    mSubgroupArithmetic =
+        (subgroupProperties.supportedOperations & vk::SubgroupFeatureFlagBits::eArithmetic) &&
+        (subgroupProperties.supportedStages & vk::ShaderStageFlagBits::eCompute);
+  }
 
   // load marker ext
   if (HasExtension(VK_EXT_DEBUG_MARKER_EXTENSION_NAME, availableExtensions))
@@ -132,11 +237,14 @@ Device::Device(const Instance& instance, int familyIndex, bool surface, bool val
         (PFN_vkCmdDebugMarkerEndEXT)vkGetDeviceProcAddr(*mDevice, "vkCmdDebugMarkerEndEXT");
   }
 
-  // create command pool
-  auto commandPoolInfo = vk::CommandPoolCreateInfo()
-                             .setQueueFamilyIndex(familyIndex)
-                             .setFlags(vk::CommandPoolCreateFlagBits::eResetCommandBuffer);
-  mCommandPool = mDevice->createCommandPoolUnique(commandPoolInfo);
+  // create a command pool per family
+  for (auto& queueCount : queueCounts)
+  {
+    auto commandPoolInfo = vk::CommandPoolCreateInfo()
+                               .setQueueFamilyIndex(queueCount.first)
+                               .setFlags(vk::CommandPoolCreateFlagBits::eResetCommandBuffer);
+    mCommandPools[queueCount.first] = mDevice->createCommandPoolUnique(commandPoolInfo);
+  }
 
   // create alllocator
   VmaAllocatorCreateInfo allocatorInfo = {};
@@ -150,8 +258,13 @@ Device::Device(const Instance& instance, int familyIndex, bool surface, bool val
 
   // create objects depending on device
   mLayoutManager.CreateDescriptorPool();
-  mPipelineCache.CreateCache();
+  mPipelineCache.CreateCache(pipelineCacheFile, creationFeedback);
   mCommandBuffer = std::make_unique<CommandBuffer>(*this, true);
+
+  if (timestamps && familyProperties[familyIndex].timestampValidBits != 0)
+  {
+    mScopeQueries = std::make_unique<ScopeQueries>(*this, 1024);
+  }
 }
 
 Device::~Device()
@@ -164,9 +277,9 @@ vk::Device Device::Handle() const
   return *mDevice;
 }
 
-vk::Queue Device::Queue() const
+vk::Queue Device::Queue(QueueType queueType) const
 {
-  return mQueue;
+  return mQueues[QueueIndex(queueType)];
 }
 
 const DynamicDispatcher& Device::Loader() const
@@ -184,29 +297,46 @@ PipelineCache& Device::GetPipelineCache() const
   return mPipelineCache;
 }
 
+ScopeQueries* Device::GetScopeQueries() const
+{
+  return mScopeQueries.get();
+}
+
+Profiler* Device::GetProfiler() const
+{
+  return mProfiler;
+}
+
 vk::PhysicalDevice Device::GetPhysicalDevice() const
 {
   return mPhysicalDevice;
 }
 
-int Device::GetFamilyIndex() const
+int Device::GetFamilyIndex(QueueType queueType) const
 {
-  return mFamilyIndex;
+  return mFamilyIndices[QueueIndex(queueType)];
 }
 
-vk::CommandBuffer Device::CreateCommandBuffer() const
+bool Device::HasSubgroupArithmetic() const
 {
+  return mSubgroupArithmetic;
+}
+
+vk::CommandBuffer Device::CreateCommandBuffer(QueueType queueType) const
+{
+  auto& commandPool = mCommandPools.at(GetFamilyIndex(queueType));
   auto commandBufferInfo = vk::CommandBufferAllocateInfo()
                                .setCommandBufferCount(1)
-                               .setCommandPool(*mCommandPool)
+                               .setCommandPool(*commandPool)
                                .setLevel(vk::CommandBufferLevel::ePrimary);
 
   return mDevice->allocateCommandBuffers(commandBufferInfo).at(0);
 }
 
-void Device::FreeCommandBuffer(vk::CommandBuffer commandBuffer) const
+void Device::FreeCommandBuffer(vk::CommandBuffer commandBuffer, QueueType queueType) const
 {
-  mDevice->freeCommandBuffers(*mCommandPool, {commandBuffer});
+  auto& commandPool = mCommandPools.at(GetFamilyIndex(queueType));
+  mDevice->freeCommandBuffers(*commandPool, {commandBuffer});
 }
 
 void Device::Execute(CommandBuffer::CommandFn commandFn) const
@@ -221,6 +351,8 @@ VmaAllocator Device::Allocator() const
 
 vk::ShaderModule Device::GetShaderModule(const SpirvBinary& spirv) const
 {
+  std::lock_guard<std::mutex> lock(mShadersMutex);
+
   auto it = mShaders.find(spirv.data());
   if (it != mShaders.end())
   {
@@ -12,12 +12,17 @@
 #include <Vortex2D/Renderer/Instance.h>
 #include <Vortex2D/Renderer/Pipeline.h>
 #include <Vortex2D/Utils/vk_mem_alloc.h>
+#include <array>
 #include <map>
+#include <mutex>
 
 namespace Vortex2D
 {
 namespace Renderer
 {
+class Profiler;
+class ScopeQueries;
+
 /**
  * @brief A binary SPIRV shader, to be feed to vulkan.
  */
@@ -53,6 +58,18 @@ struct DynamicDispatcher
   PFN_vkCmdDebugMarkerEndEXT mVkCmdDebugMarkerEndEXT = nullptr;
 };
 
+/**
+ * @brief Find the first queue family which has all the required flags and
+ * none of the excluded flags.
+ * @param familyProperties the queue families of a physical device
+ * @param required flags the family must have
+ * @param excluded flags the family must not have
+ * @return the index of the family, or -1 if there are none
+ */
+VORTEX2D_API int FindQueueFamily(const std::vector<vk::QueueFamilyProperties>& familyProperties,
+                                 vk::QueueFlags required,
+                                 vk::QueueFlags excluded = {});
+
 /**
  * @brief Encapsulation around the vulkan device. Allows to create command
  * buffers, layout, bindings, memory and shaders.
@@ -60,9 +77,31 @@ struct DynamicDispatcher
 class Device
 {
 public:
-  VORTEX2D_API Device(const Instance& instance, bool validation = true);
-  VORTEX2D_API Device(const Instance& instance, vk::SurfaceKHR surface, bool validation = true);
-  VORTEX2D_API Device(const Instance& instance, int familyIndex, bool surface, bool validation);
+  /**
+   * @brief Creates the device, the pipeline cache is loaded from the file if
+   * it is compatible with the device, and saved to it when the device is
+   * destroyed.
+   * @param instance vulkan instance
+   * @param validation enable the validation layers
+   * @param pipelineCacheFile path of the pipeline cache file, or empty
+   * @param timestamps time the debug marker regions, see @ref ScopeQueries,
+   * needed to create a @ref Profiler
+   */
+  VORTEX2D_API Device(const Instance& instance,
+                      bool validation = true,
+                      const std::string& pipelineCacheFile = {},
+                      bool timestamps = false);
+  VORTEX2D_API Device(const Instance& instance,
+                      vk::SurfaceKHR surface,
+                      bool validation = true,
+                      const std::string& pipelineCacheFile = {},
+                      bool timestamps = false);
+  VORTEX2D_API Device(const Instance& instance,
+                      int familyIndex,
+                      bool surface,
+                      bool validation,
+                      const std::string& pipelineCacheFile = {},
+                      bool timestamps = false);
   VORTEX2D_API ~Device();
 
   Device(Device&&) = delete;
@@ -70,14 +109,21 @@ public:
 
   // Vulkan handles and helpers
   VORTEX2D_API vk::Device Handle() const;
-  VORTEX2D_API vk::Queue Queue() const;
+  VORTEX2D_API vk::Queue Queue(QueueType queueType = QueueType::Main) const;
   VORTEX2D_API const DynamicDispatcher& Loader() const;
   VORTEX2D_API vk::PhysicalDevice GetPhysicalDevice() const;
-  VORTEX2D_API int GetFamilyIndex() const;
+  VORTEX2D_API int GetFamilyIndex(QueueType queueType = QueueType::Main) const;
+
+  /**
+   * @brief If the device supports the arithmetic subgroup operations in
+   * compute shaders.
+   */
+  VORTEX2D_API bool HasSubgroupArithmetic() const;
 
   // Command buffer functions
-  VORTEX2D_API vk::CommandBuffer CreateCommandBuffer() const;
-  VORTEX2D_API void FreeCommandBuffer(vk::CommandBuffer commandBuffer) const;
+  VORTEX2D_API vk::CommandBuffer CreateCommandBuffer(QueueType queueType = QueueType::Main) const;
+  VORTEX2D_API void FreeCommandBuffer(vk::CommandBuffer commandBuffer,
+                                      QueueType queueType = QueueType::Main) const;
   VORTEX2D_API void Execute(CommandBuffer::CommandFn commandFn) const;
 
   // Memory allocator
@@ -86,20 +132,40 @@ public:
   VORTEX2D_API PipelineCache& GetPipelineCache() const;
   VORTEX2D_API vk::ShaderModule GetShaderModule(const SpirvBinary& spirv) const;
 
+  /**
+   * @brief The timestamp queries of the debug marker regions, or null if the
+   * device was created without timestamps or does not support them.
+   */
+  VORTEX2D_API ScopeQueries* GetScopeQueries() const;
+
+  /**
+   * @brief The profiler attached to the device, or null.
+   */
+  VORTEX2D_API Profiler* GetProfiler() const;
+
 private:
   vk::PhysicalDevice mPhysicalDevice;
   DynamicDispatcher mLoader;
-  int mFamilyIndex;
+  std::array<int, 3> mFamilyIndices;
+  bool mSubgroupArithmetic;
   vk::UniqueDevice mDevice;
-  vk::Queue mQueue;
-  vk::UniqueCommandPool mCommandPool;
+  std::array<vk::Queue, 3> mQueues;
+  std::map<int, vk::UniqueCommandPool> mCommandPools;
   vk::UniqueDescriptorPool mDescriptorPool;
   VmaAllocator mAllocator;
 
   mutable std::unique_ptr<CommandBuffer> mCommandBuffer;
+  mutable std::mutex mShadersMutex;
   mutable std::map<const uint32_t*, vk::UniqueShaderModule> mShaders;
   mutable LayoutManager mLayoutManager;
   mutable PipelineCache mPipelineCache;
+  mutable SubmitBatch* mSubmitBatch;
+  std::unique_ptr<ScopeQueries> mScopeQueries;
+  mutable Profiler* mProfiler;
+
+  friend class CommandBuffer;
+  friend class SubmitBatch;
+  friend class Profiler;
 };
 
 }  // namespace Renderer
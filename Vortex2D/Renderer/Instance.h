@@ -31,7 +31,14 @@ public:
   VORTEX2D_API vk::PhysicalDevice GetPhysicalDevice() const;
   VORTEX2D_API vk::Instance GetInstance() const;
 
+  /**
+   * @brief The vulkan version the instance was created with, 1.1 or 1.0 if
+   * 1.1 isn't available.
+   */
+  VORTEX2D_API uint32_t GetApiVersion() const;
+
 private:
+  uint32_t mApiVersion;
   vk::UniqueInstance mInstance;
   vk::DispatchLoaderDynamic mLoader;
   vk::PhysicalDevice mPhysicalDevice;
@@ -6,6 +6,11 @@
 #include "Pipeline.h"
 #include <Vortex2D/Renderer/Device.h>
 #include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <random>
 
 namespace Vortex2D
 {
@@ -93,17 +98,143 @@ bool operator==(const SpecConstInfo& left, const SpecConstInfo& right)
   return left.data == right.data && left.mapEntries == right.mapEntries;
 }
 
-PipelineCache::PipelineCache(const Device& device) : mDevice(device) {}
+bool IsPipelineCacheCompatible(const std::vector<char>& data,
+                               const vk::PhysicalDeviceProperties& properties)
+{
+  // header version one: length, version, vendor id, device id and uuid
+  const std::size_t headerSize = 4 * sizeof(uint32_t) + VK_UUID_SIZE;
+  if (data.size() < headerSize)
+  {
+    return false;
+  }
+
+  uint32_t header[4];
+  std::memcpy(header, data.data(), sizeof(header));
+
+  return header[0] >= headerSize && header[0] <= data.size() &&
+         header[1] == static_cast<uint32_t>(vk::PipelineCacheHeaderVersion::eOne) &&
+         header[2] == properties.vendorID && header[3] == properties.deviceID &&
+         std::memcmp(data.data() + sizeof(header), properties.pipelineCacheUUID, VK_UUID_SIZE) ==
+             0;
+}
 
-void PipelineCache::CreateCache()
+PipelineCache::PipelineCache(const Device& device)
+    : mDevice(device), mCreationFeedback(false), mPrewarm(nullptr)
 {
+}
+
+PipelineCache::~PipelineCache()
+{
+  if (mCache && !mFile.empty())
+  {
+    // destructors cannot throw, a failed save leaves the previous file intact
+    // and the errors are reported by calling Save explicitly
+    try
+    {
+      Save();
+    }
+    catch (const std::exception&)
+    {
+    }
+  }
+}
+
+void PipelineCache::CreateCache(const std::string& file, bool creationFeedback)
+{
+  mFile = file;
+  mCreationFeedback = creationFeedback;
+
+  std::vector<char> data;
+  if (!mFile.empty())
+  {
+    std::ifstream is(mFile, std::ios::binary);
+    data.assign(std::istreambuf_iterator<char>(is), std::istreambuf_iterator<char>());
+  }
+
+  // a cache from another device or driver is ignored
   auto info = vk::PipelineCacheCreateInfo();
+  if (IsPipelineCacheCompatible(data, mDevice.GetPhysicalDevice().getProperties()))
+  {
+    info.setInitialDataSize(data.size()).setPInitialData(data.data());
+    mStatistics.Loaded = true;
+  }
+
   mCache = mDevice.Handle().createPipelineCacheUnique(info);
 }
 
+void PipelineCache::Save()
+{
+  if (mFile.empty())
+  {
+    throw std::runtime_error("Pipeline cache created without a file");
+  }
+
+  Save(mFile);
+}
+
+void PipelineCache::Save(const std::string& file)
+{
+  auto data = mDevice.Handle().getPipelineCacheData(*mCache);
+
+  // write to a temporary file next to the destination and rename it over, so
+  // an interrupted save or a concurrent reader never sees a truncated cache
+  auto tmpFile = file + "." + std::to_string(std::random_device{}()) + ".tmp";
+  {
+    std::ofstream os(tmpFile, std::ios::binary | std::ios::trunc);
+    if (!os)
+    {
+      throw std::runtime_error("Cannot open pipeline cache file " + tmpFile);
+    }
+
+    os.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+    os.close();
+    if (!os)
+    {
+      std::remove(tmpFile.c_str());
+      throw std::runtime_error("Cannot write pipeline cache file " + tmpFile);
+    }
+  }
+
+  // rename does not replace an existing file on Windows
+  if (std::rename(tmpFile.c_str(), file.c_str()) != 0)
+  {
+    std::remove(file.c_str());
+    if (std::rename(tmpFile.c_str(), file.c_str()) != 0)
+    {
+      std::remove(tmpFile.c_str());
+      throw std::runtime_error("Cannot replace pipeline cache file " + file);
+    }
+  }
+}
+
+PipelineCache::Statistics PipelineCache::GetStatistics() const
+{
+  std::lock_guard<std::mutex> lock(mMutex);
+  return mStatistics;
+}
+
+void PipelineCache::Report(const vk::PipelineCreationFeedbackEXT& feedback)
+{
+  mStatistics.Created++;
+
+  if (mCreationFeedback && (feedback.flags & vk::PipelineCreationFeedbackFlagBitsEXT::eValid))
+  {
+    if (feedback.flags & vk::PipelineCreationFeedbackFlagBitsEXT::eApplicationPipelineCacheHit)
+    {
+      mStatistics.Hits++;
+    }
+    else
+    {
+      mStatistics.Misses++;
+    }
+  }
+}
+
 vk::Pipeline PipelineCache::CreateGraphicsPipeline(const GraphicsPipeline& graphics,
                                                    const RenderState& renderState)
 {
+  std::lock_guard<std::mutex> lock(mMutex);
+
   auto it = std::find_if(mGraphicsPipelines.begin(),
                          mGraphicsPipelines.end(),
                          [&](const GraphicsPipelineCache& pipeline) {
@@ -159,9 +290,22 @@ vk::Pipeline PipelineCache::CreateGraphicsPipeline(const GraphicsPipeline& graph
                           .setPViewportState(&viewPortState)
                           .setPDynamicState(&dynamicState);
 
+  vk::PipelineCreationFeedbackEXT feedback;
+  std::vector<vk::PipelineCreationFeedbackEXT> stageFeedbacks(graphics.mShaderStages.size());
+  auto feedbackInfo =
+      vk::PipelineCreationFeedbackCreateInfoEXT()
+          .setPPipelineCreationFeedback(&feedback)
+          .setPipelineStageCreationFeedbackCount((uint32_t)stageFeedbacks.size())
+          .setPPipelineStageCreationFeedbacks(stageFeedbacks.data());
+  if (mCreationFeedback)
+  {
+    pipelineInfo.setPNext(&feedbackInfo);
+  }
+
   GraphicsPipelineCache pipeline = {
       renderState, graphics, mDevice.Handle().createGraphicsPipelineUnique(*mCache, pipelineInfo)};
   mGraphicsPipelines.push_back(std::move(pipeline));
+  Report(feedback);
   return *mGraphicsPipelines.back().Pipeline;
 }
 
@@ -169,6 +313,17 @@ vk::Pipeline PipelineCache::CreateComputePipeline(vk::ShaderModule shader,
                                                   vk::PipelineLayout layout,
                                                   SpecConstInfo specConstInfo)
 {
+  return CreateComputePipelineAsync(shader, layout, specConstInfo, false).get();
+}
+
+std::shared_future<vk::Pipeline> PipelineCache::CreateComputePipelineAsync(
+    vk::ShaderModule shader,
+    vk::PipelineLayout layout,
+    SpecConstInfo specConstInfo,
+    bool deferred)
+{
+  std::unique_lock<std::mutex> lock(mMutex);
+
   auto it = std::find_if(mComputePipelines.begin(),
                          mComputePipelines.end(),
                          [&](const ComputePipelineCache& pipeline) {
@@ -178,9 +333,48 @@ vk::Pipeline PipelineCache::CreateComputePipeline(vk::ShaderModule shader,
 
   if (it != mComputePipelines.end())
   {
-    return *it->Pipeline;
+    return it->Pipeline;
   }
 
+  auto createPipeline = [this, shader, layout, specConstInfo]() {
+    return MakeComputePipeline(shader, layout, specConstInfo);
+  };
+
+  // the pipeline is cached before being created, so other threads wait on it
+  // instead of creating it again
+  if (deferred)
+  {
+    auto pipeline = std::async(std::launch::deferred, createPipeline).share();
+    mComputePipelines.push_back({shader, layout, specConstInfo, pipeline});
+    return pipeline;
+  }
+  else if (mPrewarm != nullptr)
+  {
+    auto pipeline = mPrewarm->mThreadPool.Enqueue(createPipeline).share();
+    mComputePipelines.push_back({shader, layout, specConstInfo, pipeline});
+    mPrewarm->mPipelines.push_back(pipeline);
+    return pipeline;
+  }
+  else
+  {
+    std::packaged_task<vk::Pipeline()> task(createPipeline);
+    auto pipeline = task.get_future().share();
+    mComputePipelines.push_back({shader, layout, specConstInfo, pipeline});
+
+    lock.unlock();
+    task();
+    pipeline.get();
+    return pipeline;
+  }
+}
+
+vk::Pipeline PipelineCache::MakeComputePipeline(vk::ShaderModule shader,
+                                                vk::PipelineLayout layout,
+                                                SpecConstInfo specConstInfo)
+{
+  // the copy points to the data of the original
+  Detail::InsertSpecConst(specConstInfo);
+
   auto stageInfo = vk::PipelineShaderStageCreateInfo()
                        .setModule(shader)
                        .setPName("main")
@@ -189,12 +383,65 @@ vk::Pipeline PipelineCache::CreateComputePipeline(vk::ShaderModule shader,
 
   auto pipelineInfo = vk::ComputePipelineCreateInfo().setStage(stageInfo).setLayout(layout);
 
-  mComputePipelines.push_back(
-      {shader,
-       layout,
-       specConstInfo,
-       mDevice.Handle().createComputePipelineUnique(*mCache, pipelineInfo)});
-  return *mComputePipelines.back().Pipeline;
+  vk::PipelineCreationFeedbackEXT feedback, stageFeedback;
+  auto feedbackInfo = vk::PipelineCreationFeedbackCreateInfoEXT()
+                          .setPPipelineCreationFeedback(&feedback)
+                          .setPipelineStageCreationFeedbackCount(1)
+                          .setPPipelineStageCreationFeedbacks(&stageFeedback);
+  if (mCreationFeedback)
+  {
+    pipelineInfo.setPNext(&feedbackInfo);
+  }
+
+  // the vulkan pipeline cache is internally synchronised
+  auto pipeline = mDevice.Handle().createComputePipelineUnique(*mCache, pipelineInfo);
+  auto handle = *pipeline;
+
+  std::lock_guard<std::mutex> lock(mMutex);
+  mPipelines.push_back(std::move(pipeline));
+  Report(feedback);
+  return handle;
+}
+
+PipelinePrewarm::PipelinePrewarm(const Device& device, unsigned threadCount)
+    : mDevice(device), mPrevious(nullptr), mThreadPool(threadCount)
+{
+  auto& pipelineCache = mDevice.GetPipelineCache();
+
+  std::lock_guard<std::mutex> lock(pipelineCache.mMutex);
+  mPrevious = pipelineCache.mPrewarm;
+  pipelineCache.mPrewarm = this;
+}
+
+PipelinePrewarm::~PipelinePrewarm()
+{
+  auto& pipelineCache = mDevice.GetPipelineCache();
+
+  {
+    std::lock_guard<std::mutex> lock(pipelineCache.mMutex);
+    pipelineCache.mPrewarm = mPrevious;
+  }
+
+  // errors are reported by the works using the pipelines
+  for (auto& pipeline : mPipelines)
+  {
+    pipeline.wait();
+  }
+}
+
+void PipelinePrewarm::Wait()
+{
+  std::vector<std::shared_future<vk::Pipeline>> pipelines;
+
+  {
+    std::lock_guard<std::mutex> lock(mDevice.GetPipelineCache().mMutex);
+    pipelines = mPipelines;
+  }
+
+  for (auto& pipeline : pipelines)
+  {
+    pipeline.get();
+  }
 }
 
 }  // namespace Renderer
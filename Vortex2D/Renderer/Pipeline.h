@@ -8,7 +8,10 @@
 
 #include <Vortex2D/Renderer/Common.h>
 #include <Vortex2D/Renderer/RenderState.h>
+#include <Vortex2D/Renderer/ThreadPool.h>
 
+#include <future>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -17,6 +20,7 @@ namespace Vortex2D
 namespace Renderer
 {
 class Device;
+class PipelinePrewarm;
 
 /**
  * @brief graphics pipeline which caches the pipeline per render states.
@@ -145,17 +149,68 @@ inline SpecConstInfo SpecConst(Args&&... args)
 }
 
 /**
- * Create pipelines using vulkan's pipeline cache.
+ * @brief Check if the pipeline cache data has a valid header and was created
+ * by the same vendor, device and driver.
+ * @param data pipeline cache data, e.g. read from a file
+ * @param properties properties of the physical device
+ * @return true if the data can be used to create the pipeline cache
+ */
+VORTEX2D_API bool IsPipelineCacheCompatible(const std::vector<char>& data,
+                                            const vk::PhysicalDeviceProperties& properties);
+
+/**
+ * Create pipelines using vulkan's pipeline cache. The pipelines can be created
+ * from several threads.
  */
 class PipelineCache
 {
 public:
+  /**
+   * @brief Number of pipelines created. The cache hits and misses are only
+   * counted if the device supports the pipeline creation feedback extension.
+   */
+  struct Statistics
+  {
+    bool Loaded = false;
+    uint32_t Created = 0;
+    uint32_t Hits = 0;
+    uint32_t Misses = 0;
+  };
+
   PipelineCache(const Device& device);
 
   /**
-   * @brief Create the pipeline cache.
+   * @brief Saves the pipeline cache if it was created with a file. Errors are
+   * ignored, call @ref Save before to handle them.
+   */
+  ~PipelineCache();
+
+  /**
+   * @brief Create the pipeline cache, with the data of the file if it exists
+   * and is compatible with the device.
+   * @param file path of the cache file, or empty
+   * @param creationFeedback if the pipeline creation feedback extension is
+   * enabled
    */
-  void CreateCache();
+  void CreateCache(const std::string& file = {}, bool creationFeedback = false);
+
+  /**
+   * @brief Save the pipeline cache data to the file it was created with.
+   */
+  VORTEX2D_API void Save();
+
+  /**
+   * @brief Save the pipeline cache data to a file. The data is written to a
+   * temporary file which then replaces the file, throws std::runtime_error on
+   * failure.
+   * @param file path of the cache file
+   */
+  VORTEX2D_API void Save(const std::string& file);
+
+  /**
+   * @brief The pipelines created since the cache was created.
+   */
+  VORTEX2D_API Statistics GetStatistics() const;
 
   /**
    * @brief Create a graphics pipeline
@@ -176,6 +231,25 @@ public:
                                                   vk::PipelineLayout layout,
                                                   SpecConstInfo specConstInfo = {});
 
+  /**
+   * @brief Create a compute pipeline without waiting for it. The pipeline is
+   * created on the thread pool of the current @ref PipelinePrewarm, or
+   * immediately if there are none.
+   * @param shader
+   * @param layout
+   * @param specConstInfo
+   * @param deferred create the pipeline only when the future is first waited
+   * on
+   * @return a future on the pipeline
+   */
+  VORTEX2D_API std::shared_future<vk::Pipeline> CreateComputePipelineAsync(
+      vk::ShaderModule shader,
+      vk::PipelineLayout layout,
+      SpecConstInfo specConstInfo = {},
+      bool deferred = false);
+
+  friend class PipelinePrewarm;
+
 private:
   struct GraphicsPipelineCache
   {
@@ -189,13 +263,68 @@ private:
     vk::ShaderModule Shader;
     vk::PipelineLayout Layout;
     SpecConstInfo SpecConst;
-    vk::UniquePipeline Pipeline;
+    std::shared_future<vk::Pipeline> Pipeline;
   };
 
+  vk::Pipeline MakeComputePipeline(vk::ShaderModule shader,
+                                   vk::PipelineLayout layout,
+                                   SpecConstInfo specConstInfo);
+
+  // needs to be called with the mutex locked
+  void Report(const vk::PipelineCreationFeedbackEXT& feedback);
+
   const Device& mDevice;
+  mutable std::mutex mMutex;
   std::vector<GraphicsPipelineCache> mGraphicsPipelines;
   std::vector<ComputePipelineCache> mComputePipelines;
+  std::vector<vk::UniquePipeline> mPipelines;
   vk::UniquePipelineCache mCache;
+  std::string mFile;
+  bool mCreationFeedback;
+  Statistics mStatistics;
+  PipelinePrewarm* mPrewarm;
+};
+
+/**
+ * @brief Creates the compute pipelines in parallel. While it is alive, the
+ * compute pipelines of new @ref Work objects are created on a thread pool and
+ * the works wait for their pipeline only when they are first recorded.
+ * Constructing a @ref Fluid::World in its scope compiles the pipelines of that
+ * configuration in parallel.
+ */
+class PipelinePrewarm
+{
+public:
+  /**
+   * @brief Start creating the compute pipelines on a thread pool.
+   * @param device vulkan device
+   * @param threadCount number of threads of the pool
+   */
+  VORTEX2D_API explicit PipelinePrewarm(
+      const Device& device,
+      unsigned threadCount = std::thread::hardware_concurrency());
+
+  /**
+   * @brief Wait for the pipelines to be created and stop the thread pool.
+   */
+  VORTEX2D_API ~PipelinePrewarm();
+
+  PipelinePrewarm(PipelinePrewarm&&) = delete;
+  PipelinePrewarm& operator=(PipelinePrewarm&&) = delete;
+
+  /**
+   * @brief Wait for the pipelines enqueued so far to be created. Throws the
+   * error of a pipeline which couldn't be created.
+   */
+  VORTEX2D_API void Wait();
+
+  friend class PipelineCache;
+
+private:
+  const Device& mDevice;
+  PipelinePrewarm* mPrevious;
+  ThreadPool mThreadPool;
+  std::vector<std::shared_future<vk::Pipeline>> mPipelines;
 };
 
 }  // namespace Renderer
@@ -0,0 +1,458 @@
+//
+//  Profiler.cpp
+//  Vortex2D
+//
+
+#include "Profiler.h"
+
+#include <Vortex2D/Renderer/Device.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+
+namespace Vortex2D
+{
+namespace Renderer
+{
+namespace
+{
+// the first two queries time the frame, then each scope has a pair
+const uint32_t frameQueries = 2;
+const uint32_t noScope = std::numeric_limits<uint32_t>::max();
+
+uint64_t GetMask(uint32_t validBits)
+{
+  if (validBits >= 64)
+  {
+    return static_cast<uint64_t>(-1);
+  }
+  else
+  {
+    return (static_cast<uint64_t>(1) << validBits) - 1;
+  }
+}
+
+ScopeQueries& GetScopeQueries(const Device& device)
+{
+  auto queries = device.GetScopeQueries();
+  if (queries == nullptr)
+  {
+    throw std::runtime_error("Timestamps not enabled or not supported");
+  }
+
+  return *queries;
+}
+
+std::string Escape(const std::string& str)
+{
+  std::string escaped;
+  for (char c : str)
+  {
+    if (c == '"' || c == '\\')
+      escaped += '\\';
+    escaped += c;
+  }
+  return escaped;
+}
+
+void WriteEvent(std::ostream& stream,
+                const std::string& name,
+                const std::string& category,
+                uint64_t beginNs,
+                uint64_t endNs)
+{
+  // times are in microseconds
+  stream << "{\"name\":\"" << Escape(name) << "\",\"cat\":\"" << Escape(category)
+         << "\",\"ph\":\"X\",\"ts\":" << beginNs / 1000.0
+         << ",\"dur\":" << (endNs - beginNs) / 1000.0 << ",\"pid\":0,\"tid\":0}";
+}
+}  // namespace
+
+void BeginMarker(const Device& device,
+                 vk::CommandBuffer commandBuffer,
+                 const vk::DebugMarkerMarkerInfoEXT& markerInfo)
+{
+  commandBuffer.debugMarkerBeginEXT(markerInfo, device.Loader());
+
+  auto queries = device.GetScopeQueries();
+  if (queries)
+  {
+    queries->BeginScope(commandBuffer, markerInfo.pMarkerName);
+  }
+}
+
+void EndMarker(const Device& device, vk::CommandBuffer commandBuffer)
+{
+  auto queries = device.GetScopeQueries();
+  if (queries)
+  {
+    queries->EndScope(commandBuffer);
+  }
+
+  commandBuffer.debugMarkerEndEXT(device.Loader());
+}
+
+ScopeQueries::ScopeQueries(const Device& device, uint32_t maxScopes)
+    : mMaxScopes(maxScopes), mQueryCount(frameQueries + 2 * maxScopes), mDispatchScopes(false)
+{
+  auto queryPoolInfo = vk::QueryPoolCreateInfo()
+                           .setQueryType(vk::QueryType::eTimestamp)
+                           .setQueryCount(mQueryCount);
+
+  mPool = device.Handle().createQueryPoolUnique(queryPoolInfo);
+
+  device.Execute([&](vk::CommandBuffer commandBuffer) {
+    commandBuffer.resetQueryPool(*mPool, 0, mQueryCount);
+  });
+}
+
+void ScopeQueries::SetDispatchScopes(bool enable)
+{
+  std::lock_guard<std::mutex> lock(mMutex);
+  mDispatchScopes = enable;
+}
+
+void ScopeQueries::BeginScope(vk::CommandBuffer commandBuffer, const std::string& name)
+{
+  std::lock_guard<std::mutex> lock(mMutex);
+  PushScope(commandBuffer, name);
+}
+
+void ScopeQueries::EndScope(vk::CommandBuffer commandBuffer)
+{
+  std::lock_guard<std::mutex> lock(mMutex);
+  PopScope(commandBuffer);
+}
+
+void ScopeQueries::BeginDispatch(vk::CommandBuffer commandBuffer)
+{
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  // only the dispatches in a scope are timed, their index is then reset each
+  // time the parent scope is recorded
+  if (!mDispatchScopes || mStack.empty())
+    return;
+
+  auto name = "Dispatch " + std::to_string(mStack.back().DispatchCount++);
+  PushScope(commandBuffer, name);
+  mStack.back().Dispatch = true;
+}
+
+void ScopeQueries::EndDispatch(vk::CommandBuffer commandBuffer)
+{
+  std::lock_guard<std::mutex> lock(mMutex);
+  if (mStack.empty() || !mStack.back().Dispatch)
+    return;
+
+  PopScope(commandBuffer);
+}
+
+vk::QueryPool ScopeQueries::GetPool() const
+{
+  return *mPool;
+}
+
+uint32_t ScopeQueries::GetQueryCount() const
+{
+  return mQueryCount;
+}
+
+std::vector<std::string> ScopeQueries::GetScopeNames() const
+{
+  std::lock_guard<std::mutex> lock(mMutex);
+  return mScopeNames;
+}
+
+void ScopeQueries::PushScope(vk::CommandBuffer commandBuffer, const std::string& name)
+{
+  auto path = mStack.empty() ? name : mStack.back().Path + "/" + name;
+
+  auto scope = noScope;
+  auto it = mScopeIndices.find(path);
+  if (it != mScopeIndices.end())
+  {
+    scope = it->second;
+  }
+  else if (mScopeNames.size() < mMaxScopes)
+  {
+    scope = static_cast<uint32_t>(mScopeNames.size());
+    mScopeIndices[path] = scope;
+    mScopeNames.push_back(path);
+  }
+
+  if (scope != noScope)
+  {
+    // a scope can execute several times in a frame, the last one is kept
+    uint32_t query = frameQueries + 2 * scope;
+    commandBuffer.resetQueryPool(*mPool, query, 2);
+    commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eAllCommands, *mPool, query);
+  }
+
+  mStack.push_back({scope, path, 0, false});
+}
+
+void ScopeQueries::PopScope(vk::CommandBuffer commandBuffer)
+{
+  if (mStack.empty())
+    return;
+
+  auto scope = mStack.back().Scope;
+  mStack.pop_back();
+
+  if (scope != noScope)
+  {
+    commandBuffer.writeTimestamp(
+        vk::PipelineStageFlagBits::eAllCommands, *mPool, frameQueries + 2 * scope + 1);
+  }
+}
+
+Profiler::Profiler(const Device& device, uint32_t frameCount)
+    : mDevice(device)
+    , mQueries(GetScopeQueries(device))
+    , mBeginCmd(device, false)
+    , mData(2 * mQueries.GetQueryCount())
+    , mSubmittedFrames(0)
+    , mCompletedFrames(0)
+    , mFrameBegun(false)
+    , mOrigin(0)
+    , mHasOrigin(false)
+{
+  if (frameCount == 0)
+  {
+    throw std::runtime_error("Profiler needs at least one frame");
+  }
+
+  if (device.mProfiler != nullptr)
+  {
+    throw std::runtime_error("A profiler is already attached to the device");
+  }
+
+  auto queueProperties = device.GetPhysicalDevice().getQueueFamilyProperties();
+  mMask = GetMask(queueProperties[device.GetFamilyIndex()].timestampValidBits);
+  mPeriod = device.GetPhysicalDevice().getProperties().limits.timestampPeriod;
+
+  auto pool = mQueries.GetPool();
+  auto queryCount = mQueries.GetQueryCount();
+
+  mBeginCmd.Record([&](vk::CommandBuffer commandBuffer) {
+    commandBuffer.resetQueryPool(pool, 0, frameQueries);
+    commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eAllCommands, pool, 0);
+  });
+
+  // each query is copied with its availability
+  vk::DeviceSize size = sizeof(uint64_t) * mData.size();
+
+  mBuffers.reserve(frameCount);
+  mEndCmds.reserve(frameCount);
+  mFrameNames.resize(frameCount);
+  for (uint32_t i = 0; i < frameCount; i++)
+  {
+    mBuffers.emplace_back(
+        device, vk::BufferUsageFlagBits::eTransferDst, VMA_MEMORY_USAGE_GPU_TO_CPU, size);
+  }
+
+  for (uint32_t i = 0; i < frameCount; i++)
+  {
+    mEndCmds.emplace_back(device);
+    mEndCmds.back().Record([&, i](vk::CommandBuffer commandBuffer) {
+      commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eAllCommands, pool, 1);
+      commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eAllCommands,
+                                    vk::PipelineStageFlagBits::eTransfer,
+                                    {},
+                                    nullptr,
+                                    nullptr,
+                                    nullptr);
+      commandBuffer.copyQueryPoolResults(
+          pool,
+          0,
+          queryCount,
+          mBuffers[i].Handle(),
+          0,
+          2 * sizeof(uint64_t),
+          vk::QueryResultFlagBits::e64 | vk::QueryResultFlagBits::eWithAvailability);
+      commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+                                    vk::PipelineStageFlagBits::eTransfer,
+                                    {},
+                                    nullptr,
+                                    nullptr,
+                                    nullptr);
+      commandBuffer.resetQueryPool(pool, 0, queryCount);
+    });
+  }
+
+  device.mProfiler = this;
+}
+
+Profiler::~Profiler()
+{
+  Flush();
+  mDevice.mProfiler = nullptr;
+}
+
+void Profiler::SetDispatchScopes(bool enable)
+{
+  mQueries.SetDispatchScopes(enable);
+}
+
+void Profiler::BeginFrame(const std::string& name)
+{
+  if (mFrameBegun)
+  {
+    throw std::runtime_error("Profiler frame already begun");
+  }
+
+  mFrameBegun = true;
+  mFrameNames[mSubmittedFrames % mEndCmds.size()] = name;
+  mBeginCmd.Submit();
+}
+
+void Profiler::EndFrame()
+{
+  if (!mFrameBegun)
+  {
+    throw std::runtime_error("Profiler frame not begun");
+  }
+
+  mFrameBegun = false;
+
+  Poll();
+
+  if (mSubmittedFrames - mCompletedFrames == mEndCmds.size())
+  {
+    Complete();
+  }
+
+  // the name was set in the slot of this frame when it began
+  auto frame = mSubmittedFrames++;
+  mEndCmds[frame % mEndCmds.size()].Submit();
+}
+
+void Profiler::Poll()
+{
+  while (mSubmittedFrames > mCompletedFrames &&
+         mEndCmds[mCompletedFrames % mEndCmds.size()].Ready())
+  {
+    Complete();
+  }
+}
+
+void Profiler::Flush()
+{
+  while (mSubmittedFrames > mCompletedFrames)
+  {
+    Complete();
+  }
+}
+
+const std::vector<Profiler::Frame>& Profiler::GetFrames() const
+{
+  return mFrames;
+}
+
+void Profiler::ClearFrames()
+{
+  mFrames.clear();
+}
+
+void Profiler::WriteTrace(std::ostream& stream) const
+{
+  stream << std::fixed << std::setprecision(3);
+  stream << "{\"traceEvents\":[";
+
+  bool first = true;
+  for (auto& frame : mFrames)
+  {
+    if (!first)
+      stream << ",\n";
+    first = false;
+
+    WriteEvent(stream, frame.Name, "frame", frame.BeginNs, frame.EndNs);
+    for (auto& scope : frame.Scopes)
+    {
+      // nesting is given by the times, the leaf of the path is enough
+      stream << ",\n";
+      WriteEvent(stream,
+                 scope.Name.substr(scope.Name.find_last_of('/') + 1),
+                 scope.Name,
+                 scope.BeginNs,
+                 scope.EndNs);
+    }
+  }
+
+  stream << "],\"displayTimeUnit\":\"ns\"}\n";
+}
+
+void Profiler::WriteTrace(const std::string& filename) const
+{
+  std::ofstream file(filename);
+  if (!file.is_open())
+  {
+    throw std::runtime_error("Couldn't open trace file: " + filename);
+  }
+
+  WriteTrace(file);
+}
+
+void Profiler::Complete()
+{
+  auto frame = mCompletedFrames++;
+  auto index = frame % mEndCmds.size();
+
+  mEndCmds[index].Wait();
+  mBuffers[index].CopyTo(0, mData.data(), static_cast<uint32_t>(sizeof(uint64_t) * mData.size()));
+
+  auto available = [&](uint32_t query) { return mData[2 * query + 1] != 0; };
+  auto timestamp = [&](uint32_t query) { return mData[2 * query] & mMask; };
+
+  if (!available(0) || !available(1))
+    return;
+
+  if (!mHasOrigin)
+  {
+    mOrigin = timestamp(0);
+    mHasOrigin = true;
+  }
+
+  Frame result;
+  result.Name = mFrameNames[index];
+  result.Index = frame;
+  result.BeginNs = ToNs(timestamp(0));
+  result.EndNs = ToNs(timestamp(1));
+
+  auto scopeNames = mQueries.GetScopeNames();
+
+  for (uint32_t i = 0; i < scopeNames.size(); i++)
+  {
+    uint32_t query = frameQueries + 2 * i;
+    if (!available(query) || !available(query + 1))
+      continue;
+
+    // skip the scopes which executed outside of the frame
+    uint64_t begin = ToNs(timestamp(query));
+    uint64_t end = ToNs(timestamp(query + 1));
+    if (begin < result.BeginNs || end > result.EndNs || end < begin)
+      continue;
+
+    result.Scopes.push_back({scopeNames[i], begin, end});
+  }
+
+  // parents before their children
+  std::stable_sort(
+      result.Scopes.begin(), result.Scopes.end(), [](const Scope& left, const Scope& right) {
+        return left.BeginNs < right.BeginNs ||
+               (left.BeginNs == right.BeginNs && left.EndNs > right.EndNs);
+      });
+
+  mFrames.push_back(std::move(result));
+}
+
+uint64_t Profiler::ToNs(uint64_t timestamp) const
+{
+  uint64_t ticks = timestamp >= mOrigin ? timestamp - mOrigin : 0;
+  return static_cast<uint64_t>(ticks * mPeriod);
+}
+
+}  // namespace Renderer
+}  // namespace Vortex2D
@@ -0,0 +1,263 @@
+//
+//  Profiler.h
+//  Vortex2D
+//
+
+#ifndef Vortex2D_Profiler_h
+#define Vortex2D_Profiler_h
+
+#include <Vortex2D/Renderer/Buffer.h>
+#include <Vortex2D/Renderer/CommandBuffer.h>
+#include <Vortex2D/Renderer/Common.h>
+
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace Vortex2D
+{
+namespace Renderer
+{
+class Device;
+
+/**
+ * @brief Begin a debug marker region. If the device has timestamps, the
+ * region is also timed as a scope named after the marker, see
+ * @ref ScopeQueries.
+ * @param device vulkan device
+ * @param commandBuffer command buffer being recorded
+ * @param markerInfo name and color of the region
+ */
+VORTEX2D_API void BeginMarker(const Device& device,
+                              vk::CommandBuffer commandBuffer,
+                              const vk::DebugMarkerMarkerInfoEXT& markerInfo);
+
+/**
+ * @brief End the last debug marker region begun with @ref BeginMarker.
+ * @param device vulkan device
+ * @param commandBuffer command buffer being recorded
+ */
+VORTEX2D_API void EndMarker(const Device& device, vk::CommandBuffer commandBuffer);
+
+/**
+ * @brief The timestamp queries of the named scopes, owned by the device. The
+ * scopes are the debug marker regions and, optionally, the dispatches of
+ * @ref Work, and are nested by the order they are recorded in, e.g.
+ * "Pressure/PCG Step/Multigrid". They are only created when the device is
+ * created with timestamps, and are then timed in every command buffer
+ * recorded with the device, so the recorded commands never reference a
+ * destroyed query pool and a @ref Profiler can be created at any time.
+ */
+class ScopeQueries
+{
+public:
+  /**
+   * @brief Creates the query pool.
+   * @param device vulkan device
+   * @param maxScopes maximum number of different scopes, further scopes are
+   * not timed
+   */
+  ScopeQueries(const Device& device, uint32_t maxScopes);
+
+  /**
+   * @brief Time each dispatch of @ref Work recorded from now on in a scope as
+   * a child scope, named by its index in the parent scope. Off by default.
+   */
+  VORTEX2D_API void SetDispatchScopes(bool enable);
+
+  /**
+   * @brief Record the beginning of a scope, nested in the current scope.
+   * @param commandBuffer command buffer being recorded
+   * @param name name of the scope
+   */
+  VORTEX2D_API void BeginScope(vk::CommandBuffer commandBuffer, const std::string& name);
+
+  /**
+   * @brief Record the end of the current scope.
+   * @param commandBuffer command buffer being recorded
+   */
+  VORTEX2D_API void EndScope(vk::CommandBuffer commandBuffer);
+
+  /**
+   * @brief Record the beginning of a dispatch scope, if enabled.
+   * @param commandBuffer command buffer being recorded
+   */
+  VORTEX2D_API void BeginDispatch(vk::CommandBuffer commandBuffer);
+
+  /**
+   * @brief Record the end of a dispatch scope, if enabled.
+   * @param commandBuffer command buffer being recorded
+   */
+  VORTEX2D_API void EndDispatch(vk::CommandBuffer commandBuffer);
+
+  /**
+   * @brief The query pool, the first two queries are reserved to time a
+   * frame, then each scope has a pair of queries.
+   */
+  vk::QueryPool GetPool() const;
+
+  /**
+   * @brief Number of queries in the pool.
+   */
+  uint32_t GetQueryCount() const;
+
+  /**
+   * @brief The names of the scopes recorded so far, by scope index.
+   */
+  std::vector<std::string> GetScopeNames() const;
+
+private:
+  struct StackEntry
+  {
+    uint32_t Scope;
+    std::string Path;
+    uint32_t DispatchCount;
+    bool Dispatch;
+  };
+
+  void PushScope(vk::CommandBuffer commandBuffer, const std::string& name);
+  void PopScope(vk::CommandBuffer commandBuffer);
+
+  uint32_t mMaxScopes;
+  uint32_t mQueryCount;
+  vk::UniqueQueryPool mPool;
+
+  mutable std::mutex mMutex;
+  bool mDispatchScopes;
+  std::map<std::string, uint32_t> mScopeIndices;
+  std::vector<std::string> mScopeNames;
+  std::vector<StackEntry> mStack;
+};
+
+/**
+ * @brief Measures the GPU time of the scopes timed by the device, see
+ * @ref ScopeQueries. The time is measured per frame, between @ref BeginFrame
+ * and @ref EndFrame, and resolved without blocking a few frames later. The
+ * results can be written as a Chrome trace, which can be opened in
+ * chrome://tracing or Perfetto.
+ *
+ * The device needs to be created with timestamps. The profiler attaches
+ * itself to the device while it is alive, only one can be attached at a time. The command buffers recorded before it was created
+ * are timed as well. A scope which executes several times in a frame reports
+ * its last execution.
+ */
+class Profiler
+{
+public:
+  /**
+   * @brief A timed scope in a frame, in nanoseconds since the first frame.
+   */
+  struct Scope
+  {
+    std::string Name;
+    uint64_t BeginNs;
+    uint64_t EndNs;
+  };
+
+  /**
+   * @brief A timed frame with the scopes executed during it.
+   */
+  struct Frame
+  {
+    std::string Name;
+    uint64_t Index;
+    uint64_t BeginNs;
+    uint64_t EndNs;
+    std::vector<Scope> Scopes;
+  };
+
+  /**
+   * @brief Attaches the profiler to the device. Throws if the device does not
+   * support timestamps or if a profiler is already attached.
+   * @param device vulkan device
+   * @param frameCount number of frames which can be in flight
+   */
+  VORTEX2D_API explicit Profiler(const Device& device, uint32_t frameCount = 3);
+
+  /**
+   * @brief Resolves the frames in flight and detaches the profiler.
+   */
+  VORTEX2D_API ~Profiler();
+
+  Profiler(Profiler&&) = delete;
+  Profiler& operator=(Profiler&&) = delete;
+
+  /**
+   * @brief Time the dispatches recorded from now on, see
+   * @ref ScopeQueries::SetDispatchScopes.
+   */
+  VORTEX2D_API void SetDispatchScopes(bool enable);
+
+  /**
+   * @brief Start a new frame, after the commands submitted so far.
+   * @param name name of the frame, e.g. "Substep"
+   */
+  VORTEX2D_API void BeginFrame(const std::string& name);
+
+  /**
+   * @brief End the frame and copy its timestamps back. The frames which are
+   * ready are resolved first. If all the frames are in flight, waits for the
+   * oldest one.
+   */
+  VORTEX2D_API void EndFrame();
+
+  /**
+   * @brief Resolve the frames which are ready, without waiting.
+   */
+  VORTEX2D_API void Poll();
+
+  /**
+   * @brief Wait for all the frames in flight and resolve them.
+   */
+  VORTEX2D_API void Flush();
+
+  /**
+   * @brief The resolved frames, in order.
+   */
+  VORTEX2D_API const std::vector<Frame>& GetFrames() const;
+
+  /**
+   * @brief Remove the resolved frames.
+   */
+  VORTEX2D_API void ClearFrames();
+
+  /**
+   * @brief Write the resolved frames and their scopes as a Chrome trace JSON.
+   * @param stream stream to write to
+   */
+  VORTEX2D_API void WriteTrace(std::ostream& stream) const;
+
+  /**
+   * @brief Write the resolved frames and their scopes as a Chrome trace JSON.
+   * @param filename file to write to
+   */
+  VORTEX2D_API void WriteTrace(const std::string& filename) const;
+
+private:
+  void Complete();
+  uint64_t ToNs(uint64_t timestamp) const;
+
+  const Device& mDevice;
+  ScopeQueries& mQueries;
+  uint64_t mMask;
+  double mPeriod;
+
+  CommandBuffer mBeginCmd;
+  std::vector<GenericBuffer> mBuffers;
+  std::vector<CommandBuffer> mEndCmds;
+  std::vector<std::string> mFrameNames;
+  std::vector<uint64_t> mData;
+  uint64_t mSubmittedFrames;
+  uint64_t mCompletedFrames;
+  bool mFrameBegun;
+  uint64_t mOrigin;
+  bool mHasOrigin;
+  std::vector<Frame> mFrames;
+};
+
+}  // namespace Renderer
+}  // namespace Vortex2D
+
+#endif
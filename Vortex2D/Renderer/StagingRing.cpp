@@ -0,0 +1,131 @@
+//
+//  StagingRing.cpp
+//  Vortex2D
+//
+
+#include "StagingRing.h"
+
+#include <Vortex2D/Renderer/Device.h>
+
+#include <algorithm>
+#include <functional>
+
+namespace Vortex2D
+{
+namespace Renderer
+{
+namespace
+{
+// alignment of the sub-allocations, enough for vectors and matrices
+const vk::DeviceSize alignment = 16;
+}  // namespace
+
+StagingRing::StagingRing(const Device& device, vk::DeviceSize frameSize, uint32_t frameCount)
+    : mFrameSize(frameSize)
+    , mStaging(device,
+               vk::BufferUsageFlagBits::eTransferSrc,
+               VMA_MEMORY_USAGE_CPU_ONLY,
+               frameSize * frameCount)
+    , mFrameIndex(0)
+    , mUsedSize(0)
+{
+  mCopyCmds.reserve(frameCount);
+  for (uint32_t i = 0; i < frameCount; i++)
+  {
+    mCopyCmds.emplace_back(device);
+  }
+}
+
+void StagingRing::Upload(GenericBuffer& dstBuffer,
+                         const void* data,
+                         vk::DeviceSize size,
+                         vk::DeviceSize dstOffset)
+{
+  if (dstOffset + size > dstBuffer.Size())
+    throw std::runtime_error("Upload outside of the buffer");
+
+  for (auto& copy : mCopies)
+  {
+    if (copy.Buffer != &dstBuffer)
+      continue;
+
+    // the regions of a copy command cannot overlap, so the same range is
+    // overwritten in place
+    if (copy.Region.dstOffset == dstOffset && copy.Region.size == size)
+    {
+      mStaging.CopyFrom(
+          static_cast<uint32_t>(copy.Region.srcOffset), data, static_cast<uint32_t>(size));
+      return;
+    }
+
+    if (dstOffset < copy.Region.dstOffset + copy.Region.size &&
+        copy.Region.dstOffset < dstOffset + size)
+      throw std::runtime_error("Overlapping uploads in the same frame");
+  }
+
+  if (size > mFrameSize)
+    throw std::runtime_error("Upload larger than a staging ring frame");
+
+  vk::DeviceSize offset = (mUsedSize + alignment - 1) & ~(alignment - 1);
+  if (offset + size > mFrameSize)
+  {
+    Submit();
+    offset = 0;
+  }
+
+  vk::DeviceSize srcOffset = mFrameIndex * mFrameSize + offset;
+  mStaging.CopyFrom(static_cast<uint32_t>(srcOffset), data, static_cast<uint32_t>(size));
+  mCopies.push_back({&dstBuffer, vk::BufferCopy(srcOffset, dstOffset, size)});
+  mUsedSize = offset + size;
+}
+
+void StagingRing::Submit()
+{
+  if (mCopies.empty())
+    return;
+
+  // group the copies by buffer, keeping their order, for one copy per buffer
+  std::stable_sort(mCopies.begin(), mCopies.end(), [](const Copy& left, const Copy& right) {
+    return std::less<GenericBuffer*>()(left.Buffer, right.Buffer);
+  });
+
+  mCopyCmds[mFrameIndex].Record([&](vk::CommandBuffer commandBuffer) {
+    std::vector<vk::BufferCopy> regions;
+    for (std::size_t i = 0; i < mCopies.size(); i++)
+    {
+      regions.push_back(mCopies[i].Region);
+      if (i + 1 < mCopies.size() && mCopies[i + 1].Buffer == mCopies[i].Buffer)
+        continue;
+
+      auto& buffer = *mCopies[i].Buffer;
+      buffer.Barrier(
+          commandBuffer, vk::AccessFlagBits::eShaderRead, vk::AccessFlagBits::eTransferWrite);
+      commandBuffer.copyBuffer(mStaging.Handle(), buffer.Handle(), regions);
+      buffer.Barrier(
+          commandBuffer, vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eShaderRead);
+      regions.clear();
+    }
+  });
+  mCopyCmds[mFrameIndex].Submit();
+
+  mCopies.clear();
+  mUsedSize = 0;
+  mFrameIndex = (mFrameIndex + 1) % static_cast<uint32_t>(mCopyCmds.size());
+
+  // the staging memory of the next frame can only be written once its
+  // previous copies are done
+  mCopyCmds[mFrameIndex].Wait();
+}
+
+vk::DeviceSize StagingRing::GetUsedSize() const
+{
+  return mUsedSize;
+}
+
+uint32_t StagingRing::GetFrameIndex() const
+{
+  return mFrameIndex;
+}
+
+}  // namespace Renderer
+}  // namespace Vortex2D
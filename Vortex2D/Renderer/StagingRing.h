@@ -0,0 +1,96 @@
+//
+//  StagingRing.h
+//  Vortex2D
+//
+
+#ifndef Vortex2D_StagingRing_h
+#define Vortex2D_StagingRing_h
+
+#include <Vortex2D/Renderer/Buffer.h>
+#include <Vortex2D/Renderer/CommandBuffer.h>
+
+#include <vector>
+
+namespace Vortex2D
+{
+namespace Renderer
+{
+/**
+ * @brief A persistently mapped host buffer, split in frames, used to upload
+ * small pieces of data to device buffers. The uploads of a frame are
+ * sub-allocated in the frame and copied with a single command buffer when the
+ * frame is submitted. A frame is only reused once its copies have completed.
+ */
+class StagingRing
+{
+public:
+  /**
+   * @brief Allocates the ring.
+   * @param device vulkan device
+   * @param frameSize size in bytes available to the uploads of one frame
+   * @param frameCount number of frames which can be in flight
+   */
+  VORTEX2D_API StagingRing(const Device& device,
+                           vk::DeviceSize frameSize,
+                           uint32_t frameCount = 2);
+
+  /**
+   * @brief Copy data in the current frame, it is copied to the buffer when
+   * the frame is submitted. Uploading again the same range of the buffer in
+   * the same frame replaces the previous data. If the frame is full, it is
+   * submitted and the data is copied in the next frame.
+   * @param dstBuffer the buffer to copy to
+   * @param data pointer
+   * @param size of data
+   * @param dstOffset offset in the buffer
+   */
+  VORTEX2D_API void Upload(GenericBuffer& dstBuffer,
+                           const void* data,
+                           vk::DeviceSize size,
+                           vk::DeviceSize dstOffset = 0);
+
+  /**
+   * @brief Copy an object in the current frame.
+   */
+  template <typename T>
+  void Upload(GenericBuffer& dstBuffer, const T& t)
+  {
+    Upload(dstBuffer, &t, sizeof(T));
+  }
+
+  /**
+   * @brief Record the copies of the current frame, submit them and start the
+   * next frame. Waits for the copies of the next frame to finish if it is
+   * still in flight. Does nothing if there are no copies.
+   */
+  VORTEX2D_API void Submit();
+
+  /**
+   * @brief Number of bytes used in the current frame.
+   */
+  VORTEX2D_API vk::DeviceSize GetUsedSize() const;
+
+  /**
+   * @brief Index of the current frame.
+   */
+  VORTEX2D_API uint32_t GetFrameIndex() const;
+
+private:
+  struct Copy
+  {
+    GenericBuffer* Buffer;
+    vk::BufferCopy Region;
+  };
+
+  vk::DeviceSize mFrameSize;
+  GenericBuffer mStaging;
+  std::vector<CommandBuffer> mCopyCmds;
+  std::vector<Copy> mCopies;
+  uint32_t mFrameIndex;
+  vk::DeviceSize mUsedSize;
+};
+
+}  // namespace Renderer
+}  // namespace Vortex2D
+
+#endif
@@ -93,6 +93,12 @@ Texture::Texture(const Device& device,
   VkImageCreateInfo vkImageInfo = imageInfo;
   VmaAllocationCreateInfo allocInfo = {};
   allocInfo.usage = memoryUsage;
+  // host visible memory is mapped once for the lifetime of the texture
+  if (memoryUsage != VMA_MEMORY_USAGE_GPU_ONLY)
+  {
+    allocInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+  }
+
   if (vmaCreateImage(
           device.Allocator(), &vkImageInfo, &allocInfo, &mImage, &mAllocation, &mAllocationInfo) !=
       VK_SUCCESS)
@@ -211,16 +217,11 @@ void Texture::CopyFrom(const void* data)
 {
   vk::DeviceSize bytesPerPixel = GetBytesPerPixel(mFormat);
 
-  // TODO use always mapped functionality of VMA
+  if (mAllocationInfo.pMappedData == nullptr)
+    throw std::runtime_error("Not visible image");
 
   VkMemoryPropertyFlags memFlags;
   vmaGetMemoryTypeProperties(mDevice.Allocator(), mAllocationInfo.memoryType, &memFlags);
-  if ((memFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) == 0)
-    throw std::runtime_error("Not visible image");
-
-  void* pData;
-  if (vmaMapMemory(mDevice.Allocator(), mAllocation, &pData) != VK_SUCCESS)
-    throw std::runtime_error("Cannot map buffer");
 
   auto subresource = vk::ImageSubresource()
                          .setAspectMask(vk::ImageAspectFlagBits::eColor)
@@ -230,7 +231,7 @@ void Texture::CopyFrom(const void* data)
   auto srcLayout = mDevice.Handle().getImageSubresourceLayout(mImage, subresource);
 
   const uint8_t* src = (const uint8_t*)data;
-  uint8_t* dst = (uint8_t*)pData;
+  uint8_t* dst = (uint8_t*)mAllocationInfo.pMappedData;
 
   dst += srcLayout.offset;
   for (uint32_t y = 0; y < mHeight; y++)
@@ -243,40 +244,23 @@ void Texture::CopyFrom(const void* data)
 
   if ((memFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) == 0)
   {
-    auto memRange = vk::MappedMemoryRange()
-                        .setMemory(mAllocationInfo.deviceMemory)
-                        .setOffset(mAllocationInfo.offset)
-                        .setSize(mAllocationInfo.size);
-
-    mDevice.Handle().flushMappedMemoryRanges(memRange);
+    vmaFlushAllocation(mDevice.Allocator(), mAllocation, 0, VK_WHOLE_SIZE);
   }
-
-  vmaUnmapMemory(mDevice.Allocator(), mAllocation);
 }
 
 void Texture::CopyTo(void* data)
 {
   vk::DeviceSize bytesPerPixel = GetBytesPerPixel(mFormat);
 
-  // TODO use always mapped functionality of VMA
+  if (mAllocationInfo.pMappedData == nullptr)
+    throw std::runtime_error("Not visible image");
 
   VkMemoryPropertyFlags memFlags;
   vmaGetMemoryTypeProperties(mDevice.Allocator(), mAllocationInfo.memoryType, &memFlags);
-  if ((memFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) == 0)
-    throw std::runtime_error("Not visible image");
-
-  void* pData;
-  if (vmaMapMemory(mDevice.Allocator(), mAllocation, &pData) != VK_SUCCESS)
-    throw std::runtime_error("Cannot map buffer");
 
   if ((memFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) == 0)
   {
-    auto memRange = vk::MappedMemoryRange()
-                        .setMemory(mAllocationInfo.deviceMemory)
-                        .setOffset(mAllocationInfo.offset)
-                        .setSize(mAllocationInfo.size);
-
-    mDevice.Handle().invalidateMappedMemoryRanges(memRange);
+    vmaInvalidateAllocation(mDevice.Allocator(), mAllocation, 0, VK_WHOLE_SIZE);
   }
 
   auto subresource = vk::ImageSubresource()
@@ -287,7 +271,7 @@ void Texture::CopyTo(void* data)
   auto srcLayout = mDevice.Handle().getImageSubresourceLayout(mImage, subresource);
 
   uint8_t* dst = (uint8_t*)data;
-  const uint8_t* src = (const uint8_t*)pData;
+  const uint8_t* src = (const uint8_t*)mAllocationInfo.pMappedData;
 
   src += srcLayout.offset;
   for (uint32_t y = 0; y < mHeight; y++)
@@ -297,8 +281,6 @@ void Texture::CopyTo(void* data)
     src += srcLayout.rowPitch;
     dst += mWidth * bytesPerPixel;
   }
-
-  vmaUnmapMemory(mDevice.Allocator(), mAllocation);
 }
 
 void Texture::CopyFrom(vk::CommandBuffer commandBuffer, Texture& srcImage)
@@ -0,0 +1,92 @@
+//
+//  TextureReadback.cpp
+//  Vortex2D
+//
+
+#include "TextureReadback.h"
+
+#include <Vortex2D/Renderer/Device.h>
+
+namespace Vortex2D
+{
+namespace Renderer
+{
+TextureReadback::TextureReadback(const Device& device,
+                                 Texture& texture,
+                                 Callback callback,
+                                 uint32_t frameCount)
+    : mCallback(callback)
+    , mData(texture.GetWidth() * texture.GetHeight() * GetBytesPerPixel(texture.GetFormat()))
+    , mSubmittedFrames(0)
+    , mCompletedFrames(0)
+{
+  if (frameCount == 0)
+  {
+    throw std::runtime_error("Readback needs at least one frame");
+  }
+
+  mBuffers.reserve(frameCount);
+  mCopyCmds.reserve(frameCount);
+  for (uint32_t i = 0; i < frameCount; i++)
+  {
+    mBuffers.emplace_back(
+        device, vk::BufferUsageFlagBits::eTransferDst, VMA_MEMORY_USAGE_GPU_TO_CPU, mData.size());
+  }
+
+  // the texture and buffers don't change, the copies are recorded once
+  for (uint32_t i = 0; i < frameCount; i++)
+  {
+    mCopyCmds.emplace_back(device);
+    mCopyCmds.back().Record([&, i](vk::CommandBuffer commandBuffer) {
+      mBuffers[i].CopyFrom(commandBuffer, texture);
+    });
+  }
+}
+
+uint64_t TextureReadback::Submit()
+{
+  Poll();
+
+  if (GetPendingCount() == mCopyCmds.size())
+  {
+    Complete();
+  }
+
+  auto frame = mSubmittedFrames++;
+  mCopyCmds[frame % mCopyCmds.size()].Submit();
+  return frame;
+}
+
+void TextureReadback::Poll()
+{
+  while (GetPendingCount() > 0 && mCopyCmds[mCompletedFrames % mCopyCmds.size()].Ready())
+  {
+    Complete();
+  }
+}
+
+void TextureReadback::Flush()
+{
+  while (GetPendingCount() > 0)
+  {
+    Complete();
+  }
+}
+
+uint32_t TextureReadback::GetPendingCount() const
+{
+  return static_cast<uint32_t>(mSubmittedFrames - mCompletedFrames);
+}
+
+void TextureReadback::Complete()
+{
+  auto frame = mCompletedFrames++;
+  auto index = frame % mCopyCmds.size();
+
+  mCopyCmds[index].Wait();
+  mBuffers[index].CopyTo(0, mData.data(), static_cast<uint32_t>(mData.size()));
+  mCallback(frame, mData);
+}
+
+}  // namespace Renderer
+}  // namespace Vortex2D
@@ -0,0 +1,86 @@
+//
+//  TextureReadback.h
+//  Vortex2D
+//
+
+#ifndef Vortex2D_TextureReadback_h
+#define Vortex2D_TextureReadback_h
+
+#include <Vortex2D/Renderer/Buffer.h>
+#include <Vortex2D/Renderer/CommandBuffer.h>
+#include <Vortex2D/Renderer/Texture.h>
+
+#include <functional>
+#include <vector>
+
+namespace Vortex2D
+{
+namespace Renderer
+{
+/**
+ * @brief Reads a texture back to the host without blocking. Each frame, the
+ * texture is copied in one of a ring of host visible buffers, after the
+ * commands submitted so far. The content of a frame is given to a callback
+ * once its copy has completed, at the latest when its buffer is reused N
+ * frames later.
+ */
+class TextureReadback
+{
+public:
+  /**
+   * @brief Called with the index of a frame and the pixels of the texture,
+   * row by row without padding.
+   */
+  using Callback = std::function<void(uint64_t frame, const std::vector<uint8_t>& data)>;
+
+  /**
+   * @brief Creates the ring of buffers and records their copies.
+   * @param device vulkan device
+   * @param texture the texture to read back, needs to stay alive
+   * @param callback called with the content of each frame
+   * @param frameCount number of frames which can be in flight
+   */
+  VORTEX2D_API TextureReadback(const Device& device,
+                               Texture& texture,
+                               Callback callback,
+                               uint32_t frameCount = 3);
+
+  /**
+   * @brief Submit the copy of the texture for a new frame. The frames which
+   * are ready are given to the callback first. If all the buffers are in
+   * use, waits for the oldest frame.
+   * @return the index of the frame
+   */
+  VORTEX2D_API uint64_t Submit();
+
+  /**
+   * @brief Give the frames which are ready to the callback, in order,
+   * without waiting.
+   */
+  VORTEX2D_API void Poll();
+
+  /**
+   * @brief Wait for all the frames in flight and give them to the callback.
+   */
+  VORTEX2D_API void Flush();
+
+  /**
+   * @brief Number of frames submitted but not yet given to the callback.
+   */
+  VORTEX2D_API uint32_t GetPendingCount() const;
+
+private:
+  void Complete();
+
+  Callback mCallback;
+  std::vector<GenericBuffer> mBuffers;
+  std::vector<CommandBuffer> mCopyCmds;
+  std::vector<uint8_t> mData;
+  uint64_t mSubmittedFrames;
+  uint64_t mCompletedFrames;
+};
+
+}  // namespace Renderer
+}  // namespace Vortex2D
+
+#endif
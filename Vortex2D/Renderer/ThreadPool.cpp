@@ -0,0 +1,77 @@
+//
+//  ThreadPool.cpp
+//  Vortex2D
+//
+
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+namespace Vortex2D
+{
+namespace Renderer
+{
+ThreadPool::ThreadPool(unsigned threadCount) : mStop(false)
+{
+  threadCount = std::max(threadCount, 1u);
+  for (unsigned i = 0; i < threadCount; i++)
+  {
+    mThreads.emplace_back(&ThreadPool::Run, this);
+  }
+}
+
+ThreadPool::~ThreadPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mStop = true;
+  }
+
+  mCondition.notify_all();
+  for (auto& thread : mThreads)
+  {
+    thread.join();
+  }
+}
+
+unsigned ThreadPool::GetThreadCount() const
+{
+  return static_cast<unsigned>(mThreads.size());
+}
+
+void ThreadPool::Push(std::function<void()> task)
+{
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mTasks.push(std::move(task));
+  }
+
+  mCondition.notify_one();
+}
+
+void ThreadPool::Run()
+{
+  while (true)
+  {
+    std::function<void()> task;
+
+    {
+      std::unique_lock<std::mutex> lock(mMutex);
+      mCondition.wait(lock, [&] { return mStop || !mTasks.empty(); });
+
+      // the remaining tasks are run before stopping
+      if (mTasks.empty())
+      {
+        return;
+      }
+
+      task = std::move(mTasks.front());
+      mTasks.pop();
+    }
+
+    task();
+  }
+}
+
+}  // namespace Renderer
+}  // namespace Vortex2D
@@ -0,0 +1,81 @@
+//
+//  ThreadPool.h
+//  Vortex2D
+//
+
+#ifndef Vortex2D_ThreadPool_h
+#define Vortex2D_ThreadPool_h
+
+#include <Vortex2D/Renderer/Common.h>
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace Vortex2D
+{
+namespace Renderer
+{
+/**
+ * @brief A fixed number of threads running tasks in the order they were
+ * enqueued.
+ */
+class ThreadPool
+{
+public:
+  /**
+   * @brief Start the threads.
+   * @param threadCount number of threads, at least one thread is started
+   */
+  VORTEX2D_API explicit ThreadPool(unsigned threadCount = std::thread::hardware_concurrency());
+
+  /**
+   * @brief Run the remaining tasks and stop the threads.
+   */
+  VORTEX2D_API ~ThreadPool();
+
+  ThreadPool(ThreadPool&&) = delete;
+  ThreadPool& operator=(ThreadPool&&) = delete;
+
+  /**
+   * @brief Enqueue a task to be run by one of the threads.
+   * @param task a functor, or simply a lambda, without parameters
+   * @return a future on the result of the task
+   */
+  template <typename Task>
+  std::future<typename std::result_of<Task()>::type> Enqueue(Task&& task)
+  {
+    using Result = typename std::result_of<Task()>::type;
+
+    auto packagedTask = std::make_shared<std::packaged_task<Result()>>(std::forward<Task>(task));
+    auto future = packagedTask->get_future();
+    Push([packagedTask]() { (*packagedTask)(); });
+
+    return future;
+  }
+
+  /**
+   * @brief The number of threads.
+   */
+  VORTEX2D_API unsigned GetThreadCount() const;
+
+private:
+  void Push(std::function<void()> task);
+  void Run();
+
+  std::mutex mMutex;
+  std::condition_variable mCondition;
+  std::queue<std::function<void()>> mTasks;
+  bool mStop;
+  std::vector<std::thread> mThreads;
+};
+
+}  // namespace Renderer
+}  // namespace Vortex2D
+
+#endif
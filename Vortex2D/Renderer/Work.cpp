@@ -6,6 +6,7 @@
 #include "Work.h"
 
 #include <Vortex2D/Renderer/DescriptorSet.h>
+#include <Vortex2D/Renderer/Profiler.h>
 #include <Vortex2D/SPIRV/Reflection.h>
 
 namespace Vortex2D
@@ -91,7 +92,8 @@ DispatchParams::DispatchParams(int count)
 Work::Work(const Device& device,
            const ComputeSize& computeSize,
            const SpirvBinary& spirv,
-           const SpecConstInfo& additionalSpecConstInfo)
+           const SpecConstInfo& additionalSpecConstInfo,
+           bool deferred)
     : mComputeSize(computeSize), mDevice(device)
 {
   vk::ShaderModule shaderModule = device.GetShaderModule(spirv);
@@ -111,15 +113,15 @@ Work::Work(const Device& device,
                             SpecConstValue(1, mComputeSize.LocalSize.x),
                             SpecConstValue(2, mComputeSize.LocalSize.y));
 
-    mPipeline =
-        device.GetPipelineCache().CreateComputePipeline(shaderModule, layout, specConstInfo);
+    mPipeline = device.GetPipelineCache().CreateComputePipelineAsync(
+        shaderModule, layout, specConstInfo, deferred);
   }
   else
   {
     Detail::InsertSpecConst(specConstInfo, SpecConstValue(1, mComputeSize.LocalSize.x));
 
-    mPipeline =
-        device.GetPipelineCache().CreateComputePipeline(shaderModule, layout, specConstInfo);
+    mPipeline = device.GetPipelineCache().CreateComputePipelineAsync(
+        shaderModule, layout, specConstInfo, deferred);
   }
 }
 
@@ -133,7 +135,8 @@ Work::Bound Work::Bind(ComputeSize computeSize, const std::vector<Renderer::Bind
   auto descriptorSet = mDevice.GetLayoutManager().MakeDescriptorSet(mPipelineLayout);
   Renderer::Bind(mDevice, descriptorSet, mPipelineLayout, inputs);
 
-  return Bound(computeSize,
+  return Bound(mDevice,
+               computeSize,
                mPipelineLayout.layouts.front().pushConstantSize,
                descriptorSet.pipelineLayout,
                mPipeline,
@@ -145,16 +148,19 @@ Work::Bound Work::Bind(const std::vector<BindingInput>& inputs)
   return Bind(mComputeSize, inputs);
 }
 
-Work::Bound::Bound() : mComputeSize(ComputeSize::Default2D()), mLayout(nullptr), mPipeline(nullptr)
+Work::Bound::Bound()
+    : mDevice(nullptr), mComputeSize(ComputeSize::Default2D()), mLayout(nullptr)
 {
 }
 
-Work::Bound::Bound(const ComputeSize& computeSize,
+Work::Bound::Bound(const Device& device,
+                   const ComputeSize& computeSize,
                    uint32_t pushConstantSize,
                    vk::PipelineLayout layout,
-                   vk::Pipeline pipeline,
+                   std::shared_future<vk::Pipeline> pipeline,
                    vk::UniqueDescriptorSet descriptor)
-    : mComputeSize(computeSize)
+    : mDevice(&device)
+    , mComputeSize(computeSize)
     , mPushConstantSize(pushConstantSize)
     , mLayout(layout)
     , mPipeline(pipeline)
@@ -171,9 +177,16 @@ void Work::Bound::Record(vk::CommandBuffer commandBuffer)
   }
 
   commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, mLayout, 0, {*mDescriptor}, {});
-  commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, mPipeline);
+  commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, mPipeline.get());
+
+  auto queries = mDevice->GetScopeQueries();
+  if (queries)
+    queries->BeginDispatch(commandBuffer);
 
   commandBuffer.dispatch(mComputeSize.WorkSize.x, mComputeSize.WorkSize.y, 1);
+
+  if (queries)
+    queries->EndDispatch(commandBuffer);
 }
 
 void Work::Bound::RecordIndirect(vk::CommandBuffer commandBuffer,
@@ -185,9 +198,16 @@ void Work::Bound::RecordIndirect(vk::CommandBuffer commandBuffer,
     PushConstantOffset(commandBuffer, 4, mComputeSize.DomainSize.y);
   }
   commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, mLayout, 0, {*mDescriptor}, {});
-  commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, mPipeline);
+  commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, mPipeline.get());
+
+  auto queries = mDevice->GetScopeQueries();
+  if (queries)
+    queries->BeginDispatch(commandBuffer);
 
   commandBuffer.dispatchIndirect(dispatchParams.Handle(), 0);
+
+  if (queries)
+    queries->EndDispatch(commandBuffer);
 }
 
 }  // namespace Renderer
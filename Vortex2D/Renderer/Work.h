@@ -127,11 +127,14 @@ public:
    * or one with an actual size.
    * @param spirv binary spirv
    * @param additionalSpecConstInfo additional specialization constants
+   * @param deferred create the pipeline the first time the work is recorded,
+   * for works which are only used on some paths.
    */
   VORTEX2D_API Work(const Device& device,
                     const ComputeSize& computeSize,
                     const SpirvBinary& spirv,
-                    const SpecConstInfo& additionalSpecConstInfo = {});
+                    const SpecConstInfo& additionalSpecConstInfo = {},
+                    bool deferred = false);
 
   /**
    * @brief Is a bound version of @ref Work. This means a buffer or texture was
@@ -174,10 +177,11 @@ public:
     friend class Work;
 
   private:
-    Bound(const ComputeSize& computeSize,
+    Bound(const Device& device,
+          const ComputeSize& computeSize,
           uint32_t pushConstantSize,
           vk::PipelineLayout layout,
-          vk::Pipeline pipeline,
+          std::shared_future<vk::Pipeline> pipeline,
           vk::UniqueDescriptorSet descriptor);
 
     template <typename Arg>
@@ -204,10 +208,11 @@ public:
       }
     }
 
+    const Device* mDevice;
     ComputeSize mComputeSize;
     uint32_t mPushConstantSize;
     vk::PipelineLayout mLayout;
-    vk::Pipeline mPipeline;
+    std::shared_future<vk::Pipeline> mPipeline;
     vk::UniqueDescriptorSet mDescriptor;
   };
 
@@ -231,7 +236,7 @@ private:
   ComputeSize mComputeSize;
   const Device& mDevice;
   Renderer::PipelineLayout mPipelineLayout;
-  vk::Pipeline mPipeline;
+  std::shared_future<vk::Pipeline> mPipeline;
 };
 
 }  // namespace Renderer